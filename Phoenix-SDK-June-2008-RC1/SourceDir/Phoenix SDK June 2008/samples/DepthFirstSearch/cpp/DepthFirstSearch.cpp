@@ -8,8 +8,14 @@
 //
 //    Registers the "DepthFirstSearch" component control.
 //
+//    The phase derives from ParallelFunctionPhase, so c2 may run it on
+//    several functions at once (-threads). Each function's report is
+//    printed as one block, in source order.
+//
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\analysis-cache.h"
+#include "..\..\common\parallel-phase.h"
 #include "DepthFirstSearch.h"
 
 namespace DepthFirstSearch
@@ -56,91 +62,82 @@ Phase::New
 //
 // Description:
 //
-//    Execute is the phase's prime mover; all unit-centric processing occurs
-//    here.  Note that Execute might be thought of as a "callback": as the
-//    C2 host compiles each FunctionUnit, passing it from phase to phase, the
-//    plug-in Execute method is called to do its work.
+//    ExecuteFunction is the phase's prime mover; all unit-centric
+//    processing occurs here.  Note that it might be thought of as a
+//    "callback": as the C2 host compiles each FunctionUnit, passing it from
+//    phase to phase, ParallelFunctionPhase::Execute calls it to do its work.
 //
 // Arguments:
 //
-//    unit - [in] The unit to process.
+//    functionUnit - [in] The function to process.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] Temporary lifetime for the function, unused.
 //
 // Remarks:
 //
-//    Since IR exists only at the FunctionUnit level, we ignore ModuleUnits.
+//    Since IR exists only at the FunctionUnit level, the base class ignores
+//    ModuleUnits.
 //
-//    The order of units in a compiland passed to Execute is indeterminate.
+//    The order in which c2 hands the units of a compiland to the phase is
+//    indeterminate, but the reports are printed in source order.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
-
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
-
-   functionUnit->BuildFlowGraph();
+   // The cache reuses a flow graph an earlier phase left on the unit. One
+   // it builds itself it deletes in the release phase that follows this
+   // one, so later phases see the unit as they would without the plug-in.
 
-   Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
+   Phx::Samples::AnalysisCache ^ cache = Phx::Samples::AnalysisCache::Get(functionUnit);
+   Phx::Graphs::FlowGraph ^      flowGraph = cache->FlowGraph;
 
+   // The walk itself lives in common\graph-order.h, so that other samples
+   // can share it. It keeps its own stack and stores the numbers in arrays
+   // indexed by block Id.
 
-   this->PrenumberDispenser = 1;
-   this->PostnumberDispenser = 1;
-
-   this->DepthFirstWalk(flowGraph->StartBlock);
+   Phx::Samples::GraphOrder ^ order = cache->Order;
 
    for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
    {
-      BlockExtension ^ blockExtension = BlockExtension::Get(block);
-
-      if (blockExtension != nullptr)
+      if (order->IsReached(block))
       {
-         System::Console::WriteLine("Block {0} Prenumber {1} Postnumber {2}", 
-            block->Id, blockExtension->Prenumber, blockExtension->Postnumber);
+         output->AppendLine(System::String::Format("Block {0} Prenumber {1} Postnumber {2}", 
+            block->Id, order->Prenumber(block), order->Postnumber(block)));
       }
       else
       {
-         System::Console::WriteLine("Block {0} is missing extension", block->Id);
+         output->AppendLine(System::String::Format("Block {0} is unreachable", block->Id));
       }
    }
 
-   functionUnit->DeleteFlowGraph();
-}
+   // Classify the edges with respect to the spanning tree the walk found.
 
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    The recursive function that implements the depth-first search.
-//
-//-----------------------------------------------------------------------------
-void
-Phase::DepthFirstWalk(Phx::Graphs::BasicBlock ^ block)
-{
-   BlockExtension ^ blockExtension = BlockExtension::Get(block);
+   array<int> ^ edgeCounts = gcnew array<int>((int) Phx::Samples::EdgeKind::Cross + 1);
 
-   if (blockExtension == nullptr)
+   for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
    {
-      // First time we've encountered this block.
-
-      blockExtension = gcnew BlockExtension();
-      blockExtension->Prenumber = this->PrenumberDispenser++;
-      block->AddExtensionObject(blockExtension);
-
       for each (Phx::Graphs::FlowEdge ^ edge in block->SuccessorEdges)
       {
-         this->DepthFirstWalk(edge->SuccessorNode);
+         edgeCounts[(int) order->Classify(edge)]++;
       }
-
-      blockExtension->Postnumber = this->PostnumberDispenser++;
    }
+
+   output->AppendLine(System::String::Format(
+      "Edges: {0} tree, {1} back, {2} forward, {3} cross, {4} unreached", 
+      gcnew array<System::Object ^> {
+         edgeCounts[(int) Phx::Samples::EdgeKind::Tree],
+         edgeCounts[(int) Phx::Samples::EdgeKind::Back],
+         edgeCounts[(int) Phx::Samples::EdgeKind::Forward],
+         edgeCounts[(int) Phx::Samples::EdgeKind::Cross],
+         edgeCounts[(int) Phx::Samples::EdgeKind::Unreached]
+      }));
 }
 
 //-----------------------------------------------------------------------------
@@ -165,6 +162,11 @@ Phase::DepthFirstWalk(Phx::Graphs::BasicBlock ^ block)
 void
 PlugIn::RegisterObjects()
 {
+   Phx::Samples::AnalysisCache::RegisterObjects(L"depthFirstSearch",
+      L"DepthFirstSearch.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"depthFirstSearch",
+      L"DepthFirstSearch.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -228,6 +230,9 @@ PlugIn::BuildPhases
 
    Phx::Phases::Phase ^ phase = Phase::New(config);
    basePhase->InsertAfter(phase);
+
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //-----------------------------------------------------------------------------
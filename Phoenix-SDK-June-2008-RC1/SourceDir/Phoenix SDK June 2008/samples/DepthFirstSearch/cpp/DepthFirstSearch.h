@@ -26,10 +26,14 @@ namespace DepthFirstSearch
 //    instance of the phase.  Execute is responsible for performing the
 //    actual work of the phase.
 //
+//    This phase only reads the function it is handed, so it derives from
+//    ParallelFunctionPhase and implements ExecuteFunction instead, and c2
+//    may run it on several functions at once.
+//
 //-----------------------------------------------------------------------------
 
 public
-ref class Phase : Phx::Phases::Phase
+ref class Phase : Phx::Samples::ParallelFunctionPhase
 {
 
 public:
@@ -43,9 +47,11 @@ public:
 protected:
 
    virtual void
-   Execute
+   ExecuteFunction
    (
-      Phx::Unit ^ unit
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
    ) override;
 
 #if defined (PHX_DEBUG_SUPPORT)
@@ -55,11 +61,6 @@ public:
 
 #endif
 
-   property unsigned int PrenumberDispenser;
-   property unsigned int PostnumberDispenser;
-
-   void DepthFirstWalk(Phx::Graphs::BasicBlock ^ block);
-
 };
 
 //-----------------------------------------------------------------------------
@@ -102,31 +103,4 @@ public:
    }
 };
 
-public
-ref class BlockExtension : 
-public Phx::Graphs::NodeExtensionObject
-{
-public:
-
-   // Boilerplate code
-
-   static BlockExtension ^
-   Get
-   (
-      Phx::Graphs::BasicBlock ^ block
-   )
-   {
-      return safe_cast<BlockExtension ^>(block->FindExtensionObject(BlockExtension::typeid));
-   }
-
-   // User-specified stuff...
-
-   property unsigned int Prenumber;
-   property unsigned int Postnumber;
-
-private:
-   static unsigned int id;
-
-};
-
 }
@@ -0,0 +1,714 @@
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//   Dominator tree
+//
+// Remarks:
+//
+//    See DominatorTree.h.
+//
+//-----------------------------------------------------------------------------
+
+#include "DominatorTree.h"
+
+namespace Dominators
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    New builds the dominator tree of a flow graph.
+//
+// Arguments:
+//
+//    flowGraph - [in] The flow graph.
+//    algorithm - [in] The algorithm to find immediate dominators with.
+//          Automatic picks Lengauer-Tarjan for graphs of at least
+//          LengauerTarjanThreshold blocks, and the iterative algorithm
+//          otherwise.
+//
+// Returns:
+//
+//    A pointer to the new tree.
+//
+//-----------------------------------------------------------------------------
+
+DominatorTree ^
+DominatorTree::New
+(
+   Phx::Graphs::FlowGraph ^ flowGraph,
+   DominatorAlgorithm       algorithm
+)
+{
+   DominatorTree ^ tree = gcnew DominatorTree();
+
+   if (algorithm == DominatorAlgorithm::Automatic)
+   {
+      algorithm = (flowGraph->NodeCount >= LengauerTarjanThreshold)
+         ? DominatorAlgorithm::LengauerTarjan
+         : DominatorAlgorithm::CooperHarveyKennedy;
+   }
+
+   tree->algorithm = algorithm;
+
+   tree->NumberBlocks(flowGraph);
+
+   if (algorithm == DominatorAlgorithm::LengauerTarjan)
+   {
+      tree->SolveLengauerTarjan();
+   }
+   else
+   {
+      tree->SolveIteratively();
+   }
+
+   tree->NumberTree();
+
+   return tree;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Walk the flow graph depth first from the start block, recording the
+//    preorder, the spanning tree parents and the reverse post order.
+//
+// Remarks:
+//
+//    The walk keeps its own stack of (block, next successor edge) so that
+//    deep graphs do not overflow the thread's stack.
+//
+//-----------------------------------------------------------------------------
+
+void
+DominatorTree::NumberBlocks
+(
+   Phx::Graphs::FlowGraph ^ flowGraph
+)
+{
+   int maxId = 0;
+
+   for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+   {
+      maxId = System::Math::Max(maxId, (int) block->Id);
+   }
+
+   int idCount = maxId + 1;
+
+   this->blocks = gcnew array<Phx::Graphs::BasicBlock ^>(idCount);
+   this->vertices = gcnew array<int>(idCount);
+   this->preorder = gcnew array<int>(idCount);
+   this->parents = gcnew array<int>(idCount);
+   this->reversePostorder = gcnew array<int>(idCount);
+   this->reversePostorderIds = gcnew array<int>(idCount);
+   this->immediateDominators = gcnew array<int>(idCount);
+
+   for (int id = 0; id < idCount; id++)
+   {
+      this->preorder[id] = -1;
+      this->reversePostorder[id] = -1;
+      this->immediateDominators[id] = -1;
+   }
+
+   for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+   {
+      this->blocks[block->Id] = block;
+   }
+
+   array<int> ^                         stackIds = gcnew array<int>(idCount);
+   array<Phx::Graphs::FlowEdge ^> ^     stackEdges = gcnew array<Phx::Graphs::FlowEdge ^>(idCount);
+   array<int> ^                         postorderIds = gcnew array<int>(idCount);
+   int                                  depth = 0;
+   int                                  postorderCount = 0;
+   Phx::Graphs::BasicBlock ^            startBlock = flowGraph->StartBlock;
+
+   this->vertexCount = 0;
+
+   this->preorder[startBlock->Id] = this->vertexCount;
+   this->vertices[this->vertexCount] = startBlock->Id;
+   this->parents[this->vertexCount] = -1;
+   this->vertexCount++;
+
+   stackIds[depth] = startBlock->Id;
+   stackEdges[depth] = startBlock->SuccessorEdgeList;
+   depth++;
+
+   while (depth > 0)
+   {
+      int                      id = stackIds[depth - 1];
+      Phx::Graphs::FlowEdge ^  edge = stackEdges[depth - 1];
+
+      if (edge == nullptr)
+      {
+         // All successors done: the block is finished.
+
+         postorderIds[postorderCount++] = id;
+         depth--;
+
+         continue;
+      }
+
+      stackEdges[depth - 1] = edge->NextSuccessorEdge;
+
+      Phx::Graphs::BasicBlock ^ successor = edge->SuccessorNode;
+
+      if (this->preorder[successor->Id] != -1)
+      {
+         continue;
+      }
+
+      this->preorder[successor->Id] = this->vertexCount;
+      this->vertices[this->vertexCount] = successor->Id;
+      this->parents[this->vertexCount] = this->preorder[id];
+      this->vertexCount++;
+
+      stackIds[depth] = successor->Id;
+      stackEdges[depth] = successor->SuccessorEdgeList;
+      depth++;
+   }
+
+   for (int i = 0; i < postorderCount; i++)
+   {
+      int id = postorderIds[postorderCount - 1 - i];
+
+      this->reversePostorderIds[i] = id;
+      this->reversePostorder[id] = i;
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find immediate dominators with the iterative algorithm of Cooper,
+//    Harvey and Kennedy.
+//
+// Remarks:
+//
+//    Blocks are visited in reverse post order, so every block but the
+//    start has a processed predecessor (its spanning tree parent) when it
+//    is first visited. A block's immediate dominator is the nearest common
+//    ancestor, in the tree built so far, of its processed predecessors.
+//    The passes repeat until no immediate dominator changes; the last pass
+//    only confirms the result.
+//
+//-----------------------------------------------------------------------------
+
+void
+DominatorTree::SolveIteratively ()
+{
+   int  startId = this->vertices[0];
+   bool isChanged = true;
+
+   this->immediateDominators[startId] = startId;
+   this->passCount = 0;
+
+   while (isChanged)
+   {
+      isChanged = false;
+      this->passCount++;
+
+      for (int i = 1; i < this->vertexCount; i++)
+      {
+         int id = this->reversePostorderIds[i];
+         int newDominator = -1;
+
+         for (Phx::Graphs::FlowEdge ^ edge = this->blocks[id]->PredecessorEdgeList;
+            edge != nullptr; edge = edge->NextPredecessorEdge)
+         {
+            int predecessorId = edge->PredecessorNode->Id;
+
+            // Skip predecessors that are unreachable or not processed yet.
+
+            if (this->immediateDominators[predecessorId] == -1)
+            {
+               continue;
+            }
+
+            newDominator = (newDominator == -1)
+               ? predecessorId
+               : this->Intersect(predecessorId, newDominator);
+         }
+
+         if (this->immediateDominators[id] != newDominator)
+         {
+            this->immediateDominators[id] = newDominator;
+            isChanged = true;
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the nearest common ancestor of two blocks in the dominator tree
+//    built so far, by walking up from whichever is later in reverse post
+//    order.
+//
+//-----------------------------------------------------------------------------
+
+int
+DominatorTree::Intersect
+(
+   int id1,
+   int id2
+)
+{
+   while (id1 != id2)
+   {
+      while (this->reversePostorder[id1] > this->reversePostorder[id2])
+      {
+         id1 = this->immediateDominators[id1];
+      }
+
+      while (this->reversePostorder[id2] > this->reversePostorder[id1])
+      {
+         id2 = this->immediateDominators[id2];
+      }
+   }
+
+   return id1;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find immediate dominators with the algorithm of Lengauer and Tarjan,
+//    using path compression without balancing.
+//
+// Remarks:
+//
+//    Works on preorder numbers. Vertices are processed in reverse preorder:
+//    each one's semidominator is the smallest semidominator found by
+//    evaluating its predecessors in the forest linked so far. A vertex is
+//    then parked in the bucket of its semidominator, and when its parent's
+//    turn comes the bucket yields either the immediate dominator or a
+//    vertex whose immediate dominator is the same, fixed up in a final
+//    pass in preorder.
+//
+//-----------------------------------------------------------------------------
+
+void
+DominatorTree::SolveLengauerTarjan ()
+{
+   int          count = this->vertexCount;
+   array<int> ^ dominators = gcnew array<int>(count);
+   array<int> ^ bucketHeads = gcnew array<int>(count);
+   array<int> ^ bucketNext = gcnew array<int>(count);
+
+   this->semidominators = gcnew array<int>(count);
+   this->labels = gcnew array<int>(count);
+   this->ancestors = gcnew array<int>(count);
+   this->compressPath = gcnew System::Collections::Generic::Stack<int>();
+
+   for (int v = 0; v < count; v++)
+   {
+      this->semidominators[v] = v;
+      this->labels[v] = v;
+      this->ancestors[v] = -1;
+      bucketHeads[v] = -1;
+   }
+
+   for (int w = count - 1; w > 0; w--)
+   {
+      Phx::Graphs::BasicBlock ^ block = this->blocks[this->vertices[w]];
+
+      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+         edge != nullptr; edge = edge->NextPredecessorEdge)
+      {
+         int v = this->preorder[edge->PredecessorNode->Id];
+
+         if (v == -1)
+         {
+            continue;
+         }
+
+         int u = this->Evaluate(v);
+
+         if (this->semidominators[u] < this->semidominators[w])
+         {
+            this->semidominators[w] = this->semidominators[u];
+         }
+      }
+
+      bucketNext[w] = bucketHeads[this->semidominators[w]];
+      bucketHeads[this->semidominators[w]] = w;
+
+      int parent = this->parents[w];
+
+      this->ancestors[w] = parent;
+
+      for (int v = bucketHeads[parent]; v != -1; v = bucketNext[v])
+      {
+         int u = this->Evaluate(v);
+
+         dominators[v] = (this->semidominators[u] < this->semidominators[v])
+            ? u : parent;
+      }
+
+      bucketHeads[parent] = -1;
+   }
+
+   for (int w = 1; w < count; w++)
+   {
+      if (dominators[w] != this->semidominators[w])
+      {
+         dominators[w] = dominators[dominators[w]];
+      }
+   }
+
+   this->immediateDominators[this->vertices[0]] = this->vertices[0];
+
+   for (int w = 1; w < count; w++)
+   {
+      this->immediateDominators[this->vertices[w]] = this->vertices[dominators[w]];
+   }
+
+   this->passCount = 1;
+
+   this->semidominators = nullptr;
+   this->labels = nullptr;
+   this->ancestors = nullptr;
+   this->compressPath = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the vertex with the smallest semidominator on the forest path
+//    above the given vertex, compressing the path on the way.
+//
+// Remarks:
+//
+//    The compression is done with an explicit stack rather than by
+//    recursion, since the paths can be as long as the graph.
+//
+//-----------------------------------------------------------------------------
+
+int
+DominatorTree::Evaluate
+(
+   int vertex
+)
+{
+   if (this->ancestors[vertex] == -1)
+   {
+      return vertex;
+   }
+
+   for (int v = vertex; this->ancestors[this->ancestors[v]] != -1;
+      v = this->ancestors[v])
+   {
+      this->compressPath->Push(v);
+   }
+
+   // Update the vertices nearest the root first, as the recursive
+   // formulation does on its way back.
+
+   while (this->compressPath->Count > 0)
+   {
+      int v = this->compressPath->Pop();
+      int ancestor = this->ancestors[v];
+
+      if (this->semidominators[this->labels[ancestor]]
+         < this->semidominators[this->labels[v]])
+      {
+         this->labels[v] = this->labels[ancestor];
+      }
+
+      this->ancestors[v] = this->ancestors[ancestor];
+   }
+
+   return this->labels[vertex];
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Number the blocks with entry and exit times of a depth first walk of
+//    the dominator tree, for constant time Dominates queries.
+//
+//-----------------------------------------------------------------------------
+
+void
+DominatorTree::NumberTree ()
+{
+   int          idCount = this->blocks->Length;
+   array<int> ^ childHeads = gcnew array<int>(idCount);
+   array<int> ^ childNext = gcnew array<int>(idCount);
+   array<int> ^ stack = gcnew array<int>(idCount);
+   int          startId = this->vertices[0];
+   int          depth = 0;
+   int          time = 0;
+
+   this->treeEntry = gcnew array<int>(idCount);
+   this->treeExit = gcnew array<int>(idCount);
+
+   for (int id = 0; id < idCount; id++)
+   {
+      childHeads[id] = -1;
+   }
+
+   for (int i = this->vertexCount - 1; i > 0; i--)
+   {
+      int id = this->vertices[i];
+      int dominatorId = this->immediateDominators[id];
+
+      childNext[id] = childHeads[dominatorId];
+      childHeads[dominatorId] = id;
+   }
+
+   // childHeads doubles as the cursor of each block on the stack.
+
+   this->treeEntry[startId] = time++;
+   stack[depth++] = startId;
+
+   while (depth > 0)
+   {
+      int id = stack[depth - 1];
+      int child = childHeads[id];
+
+      if (child == -1)
+      {
+         this->treeExit[id] = time++;
+         depth--;
+
+         continue;
+      }
+
+      childHeads[id] = childNext[child];
+
+      this->treeEntry[child] = time++;
+      stack[depth++] = child;
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether a block can be reached from the start block.
+//
+//-----------------------------------------------------------------------------
+
+bool
+DominatorTree::IsReachable
+(
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   return (this->preorder[block->Id] != -1);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the immediate dominator of a block.
+//
+// Returns:
+//
+//    The block, or nullptr for the start block and unreachable blocks.
+//
+//-----------------------------------------------------------------------------
+
+Phx::Graphs::BasicBlock ^
+DominatorTree::ImmediateDominator
+(
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   int dominatorId = this->immediateDominators[block->Id];
+
+   if ((dominatorId == -1) || (dominatorId == (int) block->Id))
+   {
+      return nullptr;
+   }
+
+   return this->blocks[dominatorId];
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether one block dominates another.
+//
+// Remarks:
+//
+//    Every block dominates itself. Apart from that, dominance is only
+//    defined between reachable blocks.
+//
+//-----------------------------------------------------------------------------
+
+bool
+DominatorTree::Dominates
+(
+   Phx::Graphs::BasicBlock ^ dominator,
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   int dominatorId = dominator->Id;
+   int id = block->Id;
+
+   if ((this->preorder[dominatorId] == -1) || (this->preorder[id] == -1))
+   {
+      return (dominatorId == id);
+   }
+
+   return (this->treeEntry[dominatorId] <= this->treeEntry[id])
+      && (this->treeExit[id] <= this->treeExit[dominatorId]);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the set of all dominators of a block, as the Ids of the blocks on
+//    its path to the root of the tree.
+//
+// Arguments:
+//
+//    block - [in] The block.
+//    lifetime - [in] The lifetime to allocate the set in.
+//
+// Returns:
+//
+//    A new bit vector, in the form the dataflow solution in Dominators.cpp
+//    produces. The caller owns it.
+//
+//-----------------------------------------------------------------------------
+
+Phx::BitVector::Sparse ^
+DominatorTree::GetDominators
+(
+   Phx::Graphs::BasicBlock ^ block,
+   Phx::Lifetime ^           lifetime
+)
+{
+   Phx::BitVector::Sparse ^ dominators = Phx::BitVector::Sparse::New(lifetime);
+   int                      id = block->Id;
+
+   dominators->SetBit(id);
+
+   while ((this->immediateDominators[id] != -1)
+      && (this->immediateDominators[id] != id))
+   {
+      id = this->immediateDominators[id];
+      dominators->SetBit(id);
+   }
+
+   return dominators;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the dominance frontier of a block: the blocks where its dominance
+//    ends.
+//
+// Remarks:
+//
+//    The frontiers of all blocks are computed on the first call.
+//
+//-----------------------------------------------------------------------------
+
+array<Phx::Graphs::BasicBlock ^> ^
+DominatorTree::GetDominanceFrontier
+(
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   if (this->frontiers == nullptr)
+   {
+      this->ComputeFrontiers();
+   }
+
+   return this->frontiers[block->Id];
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compute the dominance frontiers of all blocks.
+//
+// Remarks:
+//
+//    Only join points are in frontiers. For each join point, every block
+//    from each predecessor up to, but not including, the join point's
+//    immediate dominator has the join point in its frontier. A block can
+//    be reached through several predecessors of the same join point, but
+//    only consecutively, so checking the last entry avoids duplicates.
+//
+//-----------------------------------------------------------------------------
+
+void
+DominatorTree::ComputeFrontiers ()
+{
+   int idCount = this->blocks->Length;
+
+   array<System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^> ^ lists =
+      gcnew array<System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^>(idCount);
+
+   for (int i = 0; i < this->vertexCount; i++)
+   {
+      int                       id = this->vertices[i];
+      Phx::Graphs::BasicBlock ^ block = this->blocks[id];
+
+      if (block->PredecessorCount < 2)
+      {
+         continue;
+      }
+
+      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+         edge != nullptr; edge = edge->NextPredecessorEdge)
+      {
+         int runner = edge->PredecessorNode->Id;
+
+         if (this->preorder[runner] == -1)
+         {
+            continue;
+         }
+
+         while (runner != this->immediateDominators[id])
+         {
+            System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^ list =
+               lists[runner];
+
+            if (list == nullptr)
+            {
+               list = gcnew System::Collections::Generic::List<Phx::Graphs::BasicBlock ^>();
+               lists[runner] = list;
+            }
+
+            if ((list->Count == 0) || (list[list->Count - 1] != block))
+            {
+               list->Add(block);
+            }
+
+            runner = this->immediateDominators[runner];
+         }
+      }
+   }
+
+   array<Phx::Graphs::BasicBlock ^> ^ empty = gcnew array<Phx::Graphs::BasicBlock ^>(0);
+
+   this->frontiers = gcnew array<array<Phx::Graphs::BasicBlock ^> ^>(idCount);
+
+   for (int id = 0; id < idCount; id++)
+   {
+      this->frontiers[id] = (lists[id] == nullptr) ? empty : lists[id]->ToArray();
+   }
+}
+
+}
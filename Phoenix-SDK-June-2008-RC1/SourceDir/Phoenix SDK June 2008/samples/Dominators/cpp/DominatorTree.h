@@ -0,0 +1,211 @@
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//   Dominator tree
+//
+// Remarks:
+//
+//    The dataflow formulation in Dominators.cpp keeps a set of dominators
+//    for every block and starts every set but the entry's at the universal
+//    set, so it needs time and memory quadratic in the number of blocks.
+//
+//    DominatorTree computes only the immediate dominator of each block,
+//    which is all the sets encode. Two algorithms are provided:
+//
+//    Cooper, Harvey and Kennedy's iterative algorithm walks the blocks in
+//    reverse post order and intersects the dominator tree paths of each
+//    block's processed predecessors. It is simple and fast on the
+//    reducible, shallow graphs compilers usually see.
+//
+//    Lengauer and Tarjan's algorithm computes semidominators over a depth
+//    first spanning tree and links them with path compression. It does
+//    not iterate, so it is used when the graph is large enough that the
+//    number of passes of the iterative algorithm matters.
+//
+//    Once the tree is known, its blocks are numbered in a depth first walk
+//    of the tree, so that a dominates b exactly when b's interval lies in
+//    a's. Dominance frontiers are only computed when first asked for.
+//
+//    All per-block data lives in arrays indexed by block Id. Blocks that
+//    cannot be reached from the start block are not in the tree.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Dominators
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The algorithms DominatorTree can use to find immediate dominators.
+//
+//-----------------------------------------------------------------------------
+
+public
+enum class DominatorAlgorithm
+{
+   Automatic,
+   CooperHarveyKennedy,
+   LengauerTarjan
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The dominator tree of a flow graph.
+//
+//-----------------------------------------------------------------------------
+
+public
+ref class DominatorTree
+{
+public:
+
+   // Graphs with at least this many blocks use Lengauer-Tarjan when the
+   // algorithm is Automatic.
+
+   static const int LengauerTarjanThreshold = 5000;
+
+   static DominatorTree ^
+   New
+   (
+      Phx::Graphs::FlowGraph ^ flowGraph,
+      DominatorAlgorithm       algorithm
+   );
+
+   bool
+   IsReachable
+   (
+      Phx::Graphs::BasicBlock ^ block
+   );
+
+   Phx::Graphs::BasicBlock ^
+   ImmediateDominator
+   (
+      Phx::Graphs::BasicBlock ^ block
+   );
+
+   bool
+   Dominates
+   (
+      Phx::Graphs::BasicBlock ^ dominator,
+      Phx::Graphs::BasicBlock ^ block
+   );
+
+   Phx::BitVector::Sparse ^
+   GetDominators
+   (
+      Phx::Graphs::BasicBlock ^ block,
+      Phx::Lifetime ^           lifetime
+   );
+
+   array<Phx::Graphs::BasicBlock ^> ^
+   GetDominanceFrontier
+   (
+      Phx::Graphs::BasicBlock ^ block
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The algorithm that built the tree
+   //
+   //--------------------------------------------------------------------------
+
+   property DominatorAlgorithm Algorithm
+   {
+      DominatorAlgorithm get() { return this->algorithm; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of passes over the blocks the iterative algorithm made;
+   //    1 for Lengauer-Tarjan
+   //
+   //--------------------------------------------------------------------------
+
+   property int PassCount
+   {
+      int get() { return this->passCount; }
+   }
+
+private:
+
+   void NumberBlocks (Phx::Graphs::FlowGraph ^ flowGraph);
+
+   void SolveIteratively ();
+
+   int Intersect (int id1, int id2);
+
+   void SolveLengauerTarjan ();
+
+   int Evaluate (int vertex);
+
+   void NumberTree ();
+
+   void ComputeFrontiers ();
+
+private:
+
+   DominatorAlgorithm algorithm;
+
+   int passCount;
+
+   // Indexed by block Id
+
+   array<Phx::Graphs::BasicBlock ^> ^ blocks;
+
+   // The reachable blocks in depth first preorder, and each block's
+   // preorder number and depth first spanning tree parent. preorder is -1
+   // for unreachable blocks.
+
+   array<int> ^ vertices;
+
+   array<int> ^ preorder;
+
+   array<int> ^ parents;
+
+   int vertexCount;
+
+   // Reverse post order number, indexed by block Id, and the block Ids in
+   // that order
+
+   array<int> ^ reversePostorder;
+
+   array<int> ^ reversePostorderIds;
+
+   // Immediate dominator Id, indexed by block Id; -1 if not known or
+   // unreachable. The start block is its own immediate dominator.
+
+   array<int> ^ immediateDominators;
+
+   // Interval numbers from a depth first walk of the dominator tree
+
+   array<int> ^ treeEntry;
+
+   array<int> ^ treeExit;
+
+   // Lengauer-Tarjan working arrays, indexed by preorder number
+
+   array<int> ^ semidominators;
+
+   array<int> ^ labels;
+
+   array<int> ^ ancestors;
+
+   System::Collections::Generic::Stack<int> ^ compressPath;
+
+   // Dominance frontiers, computed on first use
+
+   array<array<Phx::Graphs::BasicBlock ^> ^> ^ frontiers;
+};
+
+}
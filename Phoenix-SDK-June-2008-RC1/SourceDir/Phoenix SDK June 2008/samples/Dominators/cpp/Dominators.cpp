@@ -8,9 +8,18 @@
 //
 //    Registers the "Dominators" component control.
 //
+//    The phase derives from ParallelFunctionPhase, so c2 may run it on
+//    several functions at once (-threads). Each function's dominator sets
+//    are printed as one block, in source order.
+//
+//    The flow graph comes from an AnalysisCache (common\analysis-cache.h),
+//    so one an earlier phase built is reused rather than rebuilt.
+//
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\analysis-cache.h"
 #include "Dominators.h"
+#include "DominatorTree.h"
 
 namespace Dominators
 {
@@ -56,41 +65,42 @@ Phase::New
 //
 // Description:
 //
-//    Execute is the phase's prime mover; all unit-centric processing occurs
-//    here.  Note that Execute might be thought of as a "callback": as the
-//    C2 host compiles each FunctionUnit, passing it from phase to phase, the
-//    plug-in Execute method is called to do its work.
+//    ExecuteFunction is the phase's prime mover; all unit-centric
+//    processing occurs here.  Note that it might be thought of as a
+//    "callback": as the C2 host compiles each FunctionUnit, passing it from
+//    phase to phase, ParallelFunctionPhase::Execute calls it to do its work.
 //
 // Arguments:
 //
-//    unit - [in] The unit to process.
+//    functionUnit - [in] The function to process.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] Temporary lifetime for the function, for the
+//          dominator sets read off the tree.
 //
 // Remarks:
 //
-//    Since IR exists only at the FunctionUnit level, we ignore ModuleUnits.
+//    Since IR exists only at the FunctionUnit level, the base class ignores
+//    ModuleUnits.
 //
-//    The order of units in a compiland passed to Execute is indeterminate.
+//    The order in which c2 hands the units of a compiland to the phase is
+//    indeterminate, but the reports are printed in source order.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
-
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
+   // Data flow solutions require the flow graph. The cache reuses one an
+   // earlier phase left on the unit. One it builds itself it deletes in
+   // the release phase that follows this one.
 
-   // Data flow solutions require the flow graph.
-
-   functionUnit->BuildFlowGraph();
-   
-   Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
+   Phx::Samples::AnalysisCache ^ cache = Phx::Samples::AnalysisCache::Get(functionUnit);
+   Phx::Graphs::FlowGraph ^      flowGraph = cache->FlowGraph;
 
    // ISSUES:
    //
@@ -103,39 +113,169 @@ Phase::Execute
       functionUnit->Dump();
    }
 
-   // Solve the dominance equations.
+   if (Phase::DataflowControl->IsEnabled(functionUnit))
+   {
+      // Solve the dominance equations.
 
-   DominanceWalker ^ walker = DominanceWalker::New(functionUnit);
-   walker->Initialize(Phx::Dataflow::Direction::Forward, functionUnit);
-   walker->SetBoundaryConditions(flowGraph);
-   walker->Traverse(Phx::Dataflow::TraversalKind::Iterative, functionUnit);
+      DominanceWalker ^ walker = this->SolveDataflow(functionUnit);
+
+      // Display the results
+
+      output->AppendLine(System::String::Format("** Dominance computation for {0}", 
+         Phx::Utility::Undecorate(functionUnit->NameString, false)));
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         DominanceData ^ dominanceData = 
+            safe_cast<DominanceData ^>(walker->GetBlockData(block->Id));
+
+         if (block->PredecessorCount == 0 && ! block->IsStart)
+         {
+            output->AppendLine(System::String::Format("{0} (unreachable) is dominated by {1}", 
+               block->Id, block->Id));
+         }
+         else
+         {
+            output->AppendLine(System::String::Format("{0} is dominated by {1}", 
+               block->Id, dominanceData->OutBitVector));
+         }
+      }
+
+      // Clean up.
+
+      walker->Delete();
+
+      return;
+   }
+
+   // Build the dominator tree and display the same sets, read off the
+   // tree. Unreachable blocks are not in the tree; like the dataflow
+   // solution, we report them as dominated by themselves only.
 
-   // Display the results
+   DominatorTree ^ tree = DominatorTree::New(flowGraph, DominatorAlgorithm::Automatic);
 
-   System::Console::WriteLine("** Dominance computation for {0}", 
-      Phx::Utility::Undecorate(functionUnit->NameString, false));
+   output->AppendLine(System::String::Format("** Dominance computation for {0}", 
+      Phx::Utility::Undecorate(functionUnit->NameString, false)));
 
    for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
    {
-      DominanceData ^ dominanceData = 
-         safe_cast<DominanceData ^>(walker->GetBlockData(block->Id));
-
-      if (block->PredecessorCount == 0 && ! block->IsStart)
+      if (!tree->IsReachable(block))
       {
-         System::Console::WriteLine("{0} (unreachable) is dominated by {1}", 
-            block->Id, block->Id);
+         output->AppendLine(System::String::Format("{0} (unreachable) is dominated by {1}", 
+            block->Id, block->Id));
       }
       else
       {
-         System::Console::WriteLine("{0} is dominated by {1}", 
-            block->Id, dominanceData->OutBitVector);
+         Phx::BitVector::Sparse ^ dominators = tree->GetDominators(block, lifetime);
+
+         output->AppendLine(System::String::Format("{0} is dominated by {1}", 
+            block->Id, dominators));
+
+         dominators->Delete();
       }
    }
 
-   // Clean up.
+   if (Phase::CheckControl->IsEnabled(functionUnit))
+   {
+      DominanceWalker ^ walker = this->SolveDataflow(functionUnit);
+
+      this->CrossCheck(flowGraph, walker, output, lifetime);
 
-   walker->Delete();
-   functionUnit->DeleteFlowGraph();
+      walker->Delete();
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Solve the dominance equations as an iterative dataflow problem.
+//
+// Returns:
+//
+//    The walker holding the solution. The caller deletes it.
+//
+//-----------------------------------------------------------------------------
+
+DominanceWalker ^
+Phase::SolveDataflow
+(
+   Phx::FunctionUnit ^ functionUnit
+)
+{
+   DominanceWalker ^ walker = DominanceWalker::New(functionUnit);
+   walker->Initialize(Phx::Dataflow::Direction::Forward, functionUnit);
+   walker->SetBoundaryConditions(functionUnit->FlowGraph);
+   walker->Traverse(Phx::Dataflow::TraversalKind::Iterative, functionUnit);
+
+   return walker;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compare the dominator trees built by both algorithms with the dataflow
+//    solution, block by block, and report any difference.
+//
+// Remarks:
+//
+//    Only blocks reachable from the start block are compared. The dataflow
+//    sets of unreachable blocks depend on how their predecessors were
+//    initialized and carry no meaning.
+//
+//-----------------------------------------------------------------------------
+
+void
+Phase::CrossCheck
+(
+   Phx::Graphs::FlowGraph ^      flowGraph,
+   DominanceWalker ^             walker,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
+)
+{
+   array<DominatorAlgorithm> ^ algorithms = gcnew array<DominatorAlgorithm> {
+      DominatorAlgorithm::CooperHarveyKennedy,
+      DominatorAlgorithm::LengauerTarjan
+   };
+
+   for each (DominatorAlgorithm algorithm in algorithms)
+   {
+      DominatorTree ^ tree = DominatorTree::New(flowGraph, algorithm);
+      int             blockCount = 0;
+      int             mismatchCount = 0;
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         if (!tree->IsReachable(block))
+         {
+            continue;
+         }
+
+         DominanceData ^ dominanceData = 
+            safe_cast<DominanceData ^>(walker->GetBlockData(block->Id));
+         Phx::BitVector::Sparse ^ dominators = tree->GetDominators(block, lifetime);
+
+         blockCount++;
+
+         if (!dominators->Equals(dominanceData->OutBitVector))
+         {
+            mismatchCount++;
+
+            output->AppendLine(System::String::Format("{0}: dataflow {1}, tree {2}", 
+               block->Id, dominanceData->OutBitVector, dominators));
+         }
+
+         dominators->Delete();
+      }
+
+      output->AppendLine(System::String::Format(
+         "Dominator tree check ({0}, {1} passes): {2} blocks, {3} mismatches",
+         gcnew array<System::Object ^> {
+            algorithm, tree->PassCount, blockCount, mismatchCount
+         }));
+   }
 }
 
 //-----------------------------------------------------------------------------
@@ -160,6 +300,20 @@ Phase::Execute
 void
 PlugIn::RegisterObjects()
 {
+   Phase::DataflowControl =
+      Phx::Controls::SetBooleanControl::New(L"dominatorsDataflow",
+         L"Compute dominators as an iterative dataflow problem",
+         L"Dominators.cpp");
+
+   Phase::CheckControl =
+      Phx::Controls::SetBooleanControl::New(L"dominatorsCheck",
+         L"Check the dominator tree against the dataflow solution",
+         L"Dominators.cpp");
+
+   Phx::Samples::AnalysisCache::RegisterObjects(L"dominators", L"Dominators.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"dominators",
+      L"Dominators.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -224,6 +378,9 @@ PlugIn::BuildPhases
 
    Phx::Phases::Phase ^ phase = Phase::New(config);
    basePhase->InsertAfter(phase);
+
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //-----------------------------------------------------------------------------
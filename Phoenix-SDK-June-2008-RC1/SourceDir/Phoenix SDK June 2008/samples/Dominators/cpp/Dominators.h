@@ -10,9 +10,13 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\parallel-phase.h"
+
 namespace Dominators
 {
 
+ref class DominanceWalker;
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -26,10 +30,14 @@ namespace Dominators
 //    instance of the phase.  Execute is responsible for performing the
 //    actual work of the phase.
 //
+//    This phase only reads the function it is handed, so it derives from
+//    ParallelFunctionPhase and implements ExecuteFunction instead, and c2
+//    may run it on several functions at once.
+//
 //-----------------------------------------------------------------------------
 
 public
-ref class Phase : Phx::Phases::Phase
+ref class Phase : Phx::Samples::ParallelFunctionPhase
 {
 
 public:
@@ -40,12 +48,23 @@ public:
       Phx::Phases::PhaseConfiguration ^ config
    );
 
+   // Solve the dominance equations as a dataflow problem, as the sample
+   // originally did, instead of building a DominatorTree
+
+   static Phx::Controls::SetBooleanControl ^ DataflowControl;
+
+   // Solve both ways and compare the results
+
+   static Phx::Controls::SetBooleanControl ^ CheckControl;
+
 protected:
 
    virtual void
-   Execute
+   ExecuteFunction
    (
-      Phx::Unit ^ unit
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
    ) override;
 
 #if defined (PHX_DEBUG_SUPPORT)
@@ -55,6 +74,22 @@ public:
 
 #endif
 
+private:
+
+   DominanceWalker ^
+   SolveDataflow
+   (
+      Phx::FunctionUnit ^ functionUnit
+   );
+
+   void
+   CrossCheck
+   (
+      Phx::Graphs::FlowGraph ^      flowGraph,
+      DominanceWalker ^             walker,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
+   );
 };
 
 //-----------------------------------------------------------------------------
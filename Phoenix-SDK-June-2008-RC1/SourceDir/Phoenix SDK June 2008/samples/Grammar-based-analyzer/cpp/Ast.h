@@ -440,12 +440,10 @@ ref class VariableNode : public Node, public IExpression
 public:
    VariableNode
    (
-      int   lineNumber,
-      char* variableStart,
-      int   variableLength
+      int      lineNumber,
+      String ^ variable
    )
-      : Node(lineNumber), _variable(gcnew String(variableStart, 0,
-         variableLength))
+      : Node(lineNumber), _variable(variable)
    {
    }
 
@@ -550,11 +548,9 @@ public:
    (
       int                lineNumber,
       Phx::Types::Type ^ symbolType,
-      char*              paramNameStart,
-      int                paramNameLength
+      String ^           paramName
    )
-      : Node(lineNumber), _type(symbolType)
-         , _parameter(gcnew String(paramNameStart, 0, paramNameLength))
+      : Node(lineNumber), _type(symbolType), _parameter(paramName)
    {
    }
 
@@ -596,13 +592,11 @@ ref class AssignmentNode : public UnaryNode
 public:
    AssignmentNode
    (
-      int   lineNumber,
-      char* variableStart,
-      int   variableLength,
-      Node^ expression
+      int      lineNumber,
+      String ^ variable,
+      Node^    expression
    )
-      : UnaryNode(lineNumber, expression), _variable(gcnew String(variableStart,
-         0, variableLength))
+      : UnaryNode(lineNumber, expression), _variable(variable)
    {
    }
 
@@ -943,12 +937,11 @@ public:
    HeaderNode
    (
       int          lineNumber,
-      char*        functionNameStart,
-      int          functionNameLength,
+      String ^     functionName,
       List<Node^>^ formalParameterList
    )
       : PolyadicNode(lineNumber, formalParameterList),
-         _functionName(gcnew String(functionNameStart, 0, functionNameLength))
+         _functionName(functionName)
    {
    }
 
@@ -1019,12 +1012,11 @@ public:
    FunctionCallNode
    (
       int          lineNumber,
-      char*        functionNameStart,
-      int          functionNameLength,
+      String ^     functionName,
       List<Node^>^ actualParameterList
    )
       : PolyadicNode(lineNumber, actualParameterList),
-         _function(gcnew String(functionNameStart, 0, functionNameLength))
+         _function(functionName)
    {
    }
 
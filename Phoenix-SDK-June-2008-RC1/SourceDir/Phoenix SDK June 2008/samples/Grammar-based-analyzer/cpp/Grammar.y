@@ -11,6 +11,9 @@
 // Include definition of abstract class Node.
 #include "Ast.h"
 
+// Interned identifier names.
+#include "IdentifierTable.h"
+
 extern "C" int yyparse();
 
 using namespace System::Collections::Generic;
@@ -110,6 +113,7 @@ void yyerror(char*);
   {
      char* tokenStart;
      int   tokenLength;
+     int   tokenHandle;   // IdentifierTable handle (identifiers only)
   } Text;
   int SymbolType;
   int ObjRef;
@@ -168,7 +172,7 @@ procedure_definition :   procedure_header '{' statement_list '}'
                 ;
 
 procedure_header :       ID '(' formal_parameter_list ')'
-                          { $$ = NewNode(gcnew HeaderNode(LineNumber, $1.tokenStart, $1.tokenLength, AstNodeList($3))); }
+                          { $$ = NewNode(gcnew HeaderNode(LineNumber, IdentifierTable::GetName($1.tokenHandle), AstNodeList($3))); }
                 ;
 
 formal_parameter_list:                   %prec LOWER    { $$ = NewNodeList(); }
@@ -181,7 +185,7 @@ formal_parameter_list:                   %prec LOWER    { $$ = NewNodeList(); }
                 ;
 
 formal_parameter :      type ID 
-                           { $$ = NewNode(gcnew FormalParameterNode(LineNumber, ParserGCRoots::_phoenixType[$1], $2.tokenStart, $2.tokenLength)); }
+                           { $$ = NewNode(gcnew FormalParameterNode(LineNumber, ParserGCRoots::_phoenixType[$1], IdentifierTable::GetName($2.tokenHandle))); }
                 ;
 
 type            :       INT    
@@ -218,7 +222,7 @@ else_branch     :       /* empty production has lower precedence than nonempty o
                 ;
 
 assignment      :       ID GETS expression   ';'
-                           { $$ = NewNode(gcnew AssignmentNode(LineNumber, $1.tokenStart, $1.tokenLength, AstNode($3))); }
+                           { $$ = NewNode(gcnew AssignmentNode(LineNumber, IdentifierTable::GetName($1.tokenHandle), AstNode($3))); }
                 ;
 
 return          :       RETURN ';'              
@@ -226,7 +230,7 @@ return          :       RETURN ';'
                 ;
 
 procedure_call   :       ID '(' actual_parameter_list ')' ';'
-                           { $$ = NewNode(gcnew FunctionCallNode(LineNumber, $1.tokenStart, $1.tokenLength, AstNodeList($3))); }
+                           { $$ = NewNode(gcnew FunctionCallNode(LineNumber, IdentifierTable::GetName($1.tokenHandle), AstNodeList($3))); }
                 ;
 
 actual_parameter_list :                 %prec LOWER     { $$ = NewNodeList(); }
@@ -241,7 +245,7 @@ actual_parameter_list :                 %prec LOWER     { $$ = NewNodeList(); }
 expression      :       NUMBER
                            { $$ = NewNode(gcnew NumberNode(LineNumber, $1)); }
                 |       ID
-                           { $$ = NewNode(gcnew VariableNode(LineNumber, $1.tokenStart, $1.tokenLength)); }
+                           { $$ = NewNode(gcnew VariableNode(LineNumber, IdentifierTable::GetName($1.tokenHandle))); }
                 |       FALSE
                            { $$ = NewNode(gcnew LogicalNode(LineNumber, false)); }
                 |       TRUE
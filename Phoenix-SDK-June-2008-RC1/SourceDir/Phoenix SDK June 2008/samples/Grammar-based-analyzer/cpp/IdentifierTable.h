@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Definition of the IdentifierTable class.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+//-----------------------------------------------------------------------------
+//
+// Description: Interns identifier spellings into stable integer handles.
+//
+// Remarks:
+//
+//    The scanner interns every identifier token directly from its
+//    (start, length) slice, so each distinct spelling is converted to a
+//    managed string exactly once no matter how often it occurs.
+//
+//    Lookup uses an open-addressing hash table of handles with linear
+//    probing; the table is kept at most half full.
+//
+//-----------------------------------------------------------------------------
+
+ref class IdentifierTable sealed
+{
+public:
+
+   // Returns the handle for the given spelling, adding it to the
+   // table if it has not been seen before.
+
+   static int
+   Intern
+   (
+      const char * start,
+      int          length
+   );
+
+   // Retrieves the name associated with the given handle.
+
+   static String ^
+   GetName
+   (
+      int handle
+   );
+
+   // The number of distinct identifiers in the table.
+
+   static property int Count
+   {
+      int get()
+      {
+         return names->Count;
+      }
+   }
+
+private:
+
+   static IdentifierTable()
+   {
+      slots = gcnew array<int>(InitialSlotCount);
+      names = gcnew List<String ^>();
+      hashes = gcnew List<unsigned>();
+   }
+
+   // Computes the hash of the given spelling.
+
+   static unsigned
+   Hash
+   (
+      const char * start,
+      int          length
+   );
+
+   // Determines whether the given name has the given spelling.
+
+   static bool
+   Matches
+   (
+      String ^     name,
+      const char * start,
+      int          length
+   );
+
+   // Doubles the size of the slot table and rehashes all handles.
+
+   static void Grow();
+
+private:
+
+   literal int InitialSlotCount = 1024;
+
+   // Hash slots; each holds a handle plus one, or zero when empty.
+
+   static array<int> ^ slots;
+
+   // Names and cached hash values, indexed by handle.
+
+   static List<String ^> ^ names;
+   static List<unsigned> ^ hashes;
+};
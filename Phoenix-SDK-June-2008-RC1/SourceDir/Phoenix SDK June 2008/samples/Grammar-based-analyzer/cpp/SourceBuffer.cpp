@@ -0,0 +1,146 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Implementation of the SourceBuffer class.
+//
+// Remarks:
+//
+//-----------------------------------------------------------------------------
+
+#include "SourceBuffer.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+SourceBuffer::SourceBuffer()
+   : fileHandle(INVALID_HANDLE_VALUE)
+   , mappingHandle(NULL)
+   , base(NULL)
+   , size(0)
+{
+}
+
+SourceBuffer::~SourceBuffer()
+{
+   this->Close();
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Maps the given file into memory.
+//
+// Remarks:
+//
+//    Empty files, files larger than the scanner can address and files
+//    without room for the flex sentinels on their last page are rejected.
+//
+// Returns:
+//
+//    true if the file was mapped; false otherwise.
+//
+//-----------------------------------------------------------------------------
+
+bool
+SourceBuffer::Open
+(
+   const char * fileName
+)
+{
+   this->Close();
+
+   HANDLE file = ::CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+   if (file == INVALID_HANDLE_VALUE)
+   {
+      return false;
+   }
+
+   LARGE_INTEGER fileSize;
+   if (! ::GetFileSizeEx(file, &fileSize)
+      || fileSize.QuadPart == 0
+      || fileSize.QuadPart > MAXINT - 2)
+   {
+      ::CloseHandle(file);
+      return false;
+   }
+
+   // Check that the zero-filled tail of the last page can hold the
+   // two sentinel characters.
+
+   SYSTEM_INFO systemInfo;
+   ::GetSystemInfo(&systemInfo);
+
+   DWORD tail = (DWORD) (fileSize.QuadPart % systemInfo.dwPageSize);
+   if (tail == 0 || systemInfo.dwPageSize - tail < 2)
+   {
+      ::CloseHandle(file);
+      return false;
+   }
+
+   HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0,
+      NULL);
+   if (mapping == NULL)
+   {
+      ::CloseHandle(file);
+      return false;
+   }
+
+   void * view = ::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+   if (view == NULL)
+   {
+      ::CloseHandle(mapping);
+      ::CloseHandle(file);
+      return false;
+   }
+
+   this->fileHandle = file;
+   this->mappingHandle = mapping;
+   this->base = (char *) view;
+   this->size = (int) fileSize.QuadPart;
+
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Unmaps the current file, if any.
+//
+// Remarks:
+//
+//    Token slices handed out while scanning the file are invalid after
+//    this call.
+//
+//-----------------------------------------------------------------------------
+
+void
+SourceBuffer::Close()
+{
+   if (this->base != NULL)
+   {
+      ::UnmapViewOfFile(this->base);
+      this->base = NULL;
+   }
+
+   if (this->mappingHandle != NULL)
+   {
+      ::CloseHandle(this->mappingHandle);
+      this->mappingHandle = NULL;
+   }
+
+   if (this->fileHandle != INVALID_HANDLE_VALUE)
+   {
+      ::CloseHandle(this->fileHandle);
+      this->fileHandle = INVALID_HANDLE_VALUE;
+   }
+
+   this->size = 0;
+}
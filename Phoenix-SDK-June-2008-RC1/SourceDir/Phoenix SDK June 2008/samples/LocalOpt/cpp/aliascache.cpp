@@ -0,0 +1,321 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The alias query cache of the local optimization plug in
+//
+//-----------------------------------------------------------------------------
+
+#include "utility.h"
+#include "dagcore.h"
+#include "aliascache.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Static constructor for an AliasCache.
+//
+// Arguments:
+//
+//    aliasInfo - The alias information of the function
+//    tagCount - The number of location tags of the function
+//
+// Returns:
+//
+//    AliasCache object.
+//
+//--------------------------------------------------------------------------
+
+AliasCache ^
+AliasCache::New
+(
+   Phx::Alias::Info ^ aliasInfo,
+   int                tagCount
+)
+{
+   AliasCache ^ cache = gcnew AliasCache();
+
+   cache->aliasInfo = aliasInfo;
+
+   cache->tagAliases = gcnew array<array<int> ^>(tagCount);
+   cache->tagPrimaries = gcnew array<int>(tagCount);
+   cache->tagEpochs = gcnew array<int>(tagCount);
+
+   cache->pairKeys = gcnew array<long long>(64);
+   cache->pairResults = gcnew array<bool>(64);
+   cache->pairEpochs = gcnew array<int>(64);
+
+   cache->allocationCount = 6;
+   cache->epoch = 1;
+
+   return cache;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Forget all cached answers
+//
+//--------------------------------------------------------------------------
+
+void
+AliasCache::Reset ()
+{
+   this->epoch++;
+   this->pairCount = 0;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the tags that may partially overlap the given tag
+//
+// Returns:
+//
+//    The tags, in the order the alias package enumerates them. The array
+//    belongs to the cache and must not be changed.
+//
+//--------------------------------------------------------------------------
+
+array<int> ^
+AliasCache::GetMayPartialAliases
+(
+   int aliasTag
+)
+{
+   if ((aliasTag >= this->tagEpochs->Length)
+      || (this->tagEpochs[aliasTag] != this->epoch))
+   {
+      this->ComputeTag(aliasTag);
+   }
+
+   return this->tagAliases[aliasTag];
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the primary tag of the given tag
+//
+//--------------------------------------------------------------------------
+
+int
+AliasCache::GetPrimaryTag
+(
+   int aliasTag
+)
+{
+   if ((aliasTag >= this->tagEpochs->Length)
+      || (this->tagEpochs[aliasTag] != this->epoch))
+   {
+      this->ComputeTag(aliasTag);
+   }
+
+   return this->tagPrimaries[aliasTag];
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether two tags may partially overlap
+//
+// Remarks:
+//
+//    Overlap is symmetric, so both orders of a pair share one entry.
+//
+//--------------------------------------------------------------------------
+
+bool
+AliasCache::MayPartiallyOverlap
+(
+   int aliasTag1,
+   int aliasTag2
+)
+{
+   this->overlapQueries++;
+
+   if (aliasTag1 == aliasTag2)
+   {
+      this->overlapHits++;
+
+      return true;
+   }
+
+   int       low = System::Math::Min(aliasTag1, aliasTag2);
+   int       high = System::Math::Max(aliasTag1, aliasTag2);
+   long long key = ((long long)low << 32) | (unsigned int)high;
+   int       mask = this->pairKeys->Length - 1;
+   int       slot = DagCore::Mix(key) & mask;
+
+   while (this->pairEpochs[slot] == this->epoch)
+   {
+      if (this->pairKeys[slot] == key)
+      {
+         this->overlapHits++;
+
+         return this->pairResults[slot];
+      }
+
+      slot = (slot + 1) & mask;
+   }
+
+   bool result = this->aliasInfo->MayPartiallyOverlap(low, high);
+
+   this->pairKeys[slot] = key;
+   this->pairResults[slot] = result;
+   this->pairEpochs[slot] = this->epoch;
+
+   if (++this->pairCount * 2 >= this->pairKeys->Length)
+   {
+      this->GrowPairTable();
+   }
+
+   return result;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Grow the tag-indexed arrays so that the given tag can be stored
+//
+//--------------------------------------------------------------------------
+
+void
+AliasCache::EnsureTagCapacity
+(
+   int aliasTag
+)
+{
+   if (aliasTag < this->tagEpochs->Length)
+   {
+      return;
+   }
+
+   int newLength = System::Math::Max(aliasTag + 1, this->tagEpochs->Length * 2);
+
+   System::Array::Resize(this->tagAliases, newLength);
+   System::Array::Resize(this->tagPrimaries, newLength);
+   System::Array::Resize(this->tagEpochs, newLength);
+
+   this->allocationCount += 3;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Ask the alias package for the alias set and the primary tag of the
+//    given tag
+//
+// Remarks:
+//
+//    The set's array is reused when the tag is recomputed in a later
+//    epoch and the set has not grown.
+//
+//--------------------------------------------------------------------------
+
+void
+AliasCache::ComputeTag
+(
+   int aliasTag
+)
+{
+   this->EnsureTagCapacity(aliasTag);
+
+   Phx::Alias::MemberPosition memberPosition = Phx::Alias::MemberPosition();
+   array<int> ^               aliases = this->tagAliases[aliasTag];
+   int                        count = 0;
+
+   if (aliases == nullptr)
+   {
+      aliases = gcnew array<int>(4);
+   }
+
+   for (int mayPOTag = this->aliasInfo->GetFirstMayPartialAlias(aliasTag,
+         &memberPosition);
+        mayPOTag != ((int)Alias::Constants::InvalidTag);
+        mayPOTag = this->aliasInfo->GetNextMayPartialAlias(aliasTag, &memberPosition))
+   {
+      if (count == aliases->Length)
+      {
+         System::Array::Resize(aliases, count * 2);
+      }
+
+      aliases[count++] = mayPOTag;
+   }
+
+   if (count != aliases->Length)
+   {
+      System::Array::Resize(aliases, count);
+   }
+
+   this->tagAliases[aliasTag] = aliases;
+   this->tagPrimaries[aliasTag] = this->aliasInfo->GetPrimaryTag(aliasTag);
+   this->tagEpochs[aliasTag] = this->epoch;
+
+   this->aliasSetsComputed++;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Double the size of the pair table and rehash the current entries
+//
+//--------------------------------------------------------------------------
+
+void
+AliasCache::GrowPairTable ()
+{
+   array<long long> ^ oldKeys = this->pairKeys;
+   array<bool> ^      oldResults = this->pairResults;
+   array<int> ^       oldEpochs = this->pairEpochs;
+   int                capacity = oldKeys->Length * 2;
+   int                mask = capacity - 1;
+
+   this->pairKeys = gcnew array<long long>(capacity);
+   this->pairResults = gcnew array<bool>(capacity);
+   this->pairEpochs = gcnew array<int>(capacity);
+
+   this->allocationCount += 3;
+
+   for (int i = 0; i < oldKeys->Length; i++)
+   {
+      if (oldEpochs[i] != this->epoch)
+      {
+         continue;
+      }
+
+      int slot = DagCore::Mix(oldKeys[i]) & mask;
+
+      while (this->pairEpochs[slot] == this->epoch)
+      {
+         slot = (slot + 1) & mask;
+      }
+
+      this->pairKeys[slot] = oldKeys[i];
+      this->pairResults[slot] = oldResults[i];
+      this->pairEpochs[slot] = this->epoch;
+   }
+}
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
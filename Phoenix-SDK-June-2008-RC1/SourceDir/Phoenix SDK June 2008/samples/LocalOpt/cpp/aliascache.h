@@ -0,0 +1,172 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The alias query cache of the local optimization plug in.
+//
+// Remarks:
+//
+//    Every use and definition the DAG builds walks the may-partial alias
+//    set of its tag, and every definition asks the alias package whether
+//    it overlaps each recent use and definition it finds there. In a
+//    block full of pointer accesses the same few tags meet over and over,
+//    so the same questions are asked a quadratic number of times.
+//
+//    The cache answers them instead. The alias set and the primary tag of
+//    a tag are computed the first time the tag is seen, and the overlap of
+//    two tags the first time the pair is queried. Both are emptied when
+//    the DAG is reset for the next instruction range, by bumping an epoch,
+//    so tags handed out for new temporaries never see a stale answer.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Lazily computed alias sets, primary tags and tag pair overlaps
+//
+//-----------------------------------------------------------------------------
+
+public ref class AliasCache
+{
+
+public:
+
+   static AliasCache ^
+   New
+   (
+      Phx::Alias::Info ^ aliasInfo,
+      int                tagCount
+   );
+
+   void Reset ();
+
+   array<int> ^ GetMayPartialAliases (int aliasTag);
+
+   int GetPrimaryTag (int aliasTag);
+
+   bool
+   MayPartiallyOverlap
+   (
+      int aliasTag1,
+      int aliasTag2
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of overlap queries made since the cache was created
+   //
+   //--------------------------------------------------------------------------
+
+   property int OverlapQueries
+   {
+      int get () { return overlapQueries; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of overlap queries answered without asking the alias
+   //    package
+   //
+   //--------------------------------------------------------------------------
+
+   property int OverlapHits
+   {
+      int get () { return overlapHits; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of alias sets computed since the cache was created
+   //
+   //--------------------------------------------------------------------------
+
+   property int AliasSetsComputed
+   {
+      int get () { return aliasSetsComputed; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of arrays allocated by this cache since it was created,
+   //    not counting the alias sets themselves
+   //
+   //--------------------------------------------------------------------------
+
+   property int AllocationCount
+   {
+      int get () { return allocationCount; }
+   }
+
+private:
+
+   void EnsureTagCapacity (int aliasTag);
+
+   void ComputeTag (int aliasTag);
+
+   void GrowPairTable ();
+
+private:
+
+   Phx::Alias::Info ^ aliasInfo;
+
+   // The current epoch. Entries stamped with an older epoch are empty.
+
+   int epoch;
+
+   int allocationCount;
+
+   // Indexed by alias tag: the may-partial alias set and the primary tag
+   // of the tag
+
+   array<array<int> ^> ^ tagAliases;
+
+   array<int> ^ tagPrimaries;
+
+   array<int> ^ tagEpochs;
+
+   // The overlap results, in an open addressing table keyed on the tag
+   // pair with the smaller tag in the high half
+
+   array<long long> ^ pairKeys;
+
+   array<bool> ^ pairResults;
+
+   array<int> ^ pairEpochs;
+
+   int pairCount;
+
+   // Statistics
+
+   int overlapQueries;
+
+   int overlapHits;
+
+   int aliasSetsComputed;
+};
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
@@ -12,6 +12,7 @@
 #include "utility.h"
 #include "dag.h"
 #include "dagwalker.h"
+#include "rules.h"
 
 namespace Phx
 {
@@ -53,17 +54,23 @@ DAG::New
 
    // Initialize members of a DAG
 
-   dag->rootList = gcnew DagNodeList();
+   dag->core = DagCore::New(tableSize);
 
-   dag->exprToNodeMap = gcnew ExprToNodeMap(tableSize);
+   int tagCount = functionUnit->AliasInfo->NumberLocationTags + 1;
 
-   dag->opndToNodeMap = gcnew OpndToNodeMap(tableSize);
+   dag->tagDefNodes = gcnew array<DagNode ^>(tagCount);
+   dag->tagDefEpochs = gcnew array<int>(tagCount);
+   dag->tagUseNodes = gcnew array<DagNodeList ^>(tagCount);
+   dag->tagUseEpochs = gcnew array<int>(tagCount);
+   dag->primaryUseNodes = gcnew array<DagNodeList ^>(tagCount);
+   dag->primaryUseEpochs = gcnew array<int>(tagCount);
+   dag->primaryVisits = gcnew array<int>(tagCount);
 
-   dag->tagToUseNodeMap =
-      gcnew TagToUseNodeMap(functionUnit->AliasInfo->NumberLocationTags);
+   dag->aliasCache = AliasCache::New(functionUnit->AliasInfo, tagCount);
+   dag->ruleCounts = RuleTable::NewCounts();
 
-   dag->tagToDefNodeMap =
-      gcnew TagToDefNodeMap(functionUnit->AliasInfo->NumberLocationTags);
+   dag->allocationCount = 8;
+   dag->epoch = 1;
 
    return dag;
 }
@@ -72,14 +79,290 @@ DAG::New
 //
 // Description:
 //
-//    Lookup the DagNode for the given operand in the opndToNodeMap. If the
+//    Empty the DAG so that it can be built for the next instruction range
+//    of the same function.
+//
+// Remarks:
+//
+//    Nodes of the previous range must not be used after the reset. The
+//    tables keep their capacity; the tag-indexed maps are emptied by
+//    bumping the epoch rather than by clearing them. The alias cache is
+//    emptied too, since the previous range may have created temporaries
+//    with new tags.
+//
+//--------------------------------------------------------------------------
+
+void
+DAG::Reset ()
+{
+   this->epoch++;
+
+   this->core->Reset();
+   this->aliasCache->Reset();
+
+   this->lastCallNode = nullptr;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Start a new walk over the DAG
+//
+// Returns:
+//
+//    The pass number the walk stamps its visited nodes with. It differs
+//    from the stamp of every node, since nodes are created with zero.
+//
+//--------------------------------------------------------------------------
+
+int
+DAG::NewWalkPass ()
+{
+   return ++this->walkPass;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Look up the latest definition node for the given alias tag
+//
+// Returns:
+//
+//    The definition node recorded in the current epoch, or nullptr
+//
+//--------------------------------------------------------------------------
+
+DagNode ^
+DAG::LookupDefNode
+(
+   int aliasTag
+)
+{
+   if ((aliasTag >= this->tagDefEpochs->Length)
+      || (this->tagDefEpochs[aliasTag] != this->epoch))
+   {
+      return nullptr;
+   }
+
+   return this->tagDefNodes[aliasTag];
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Record the given node as the latest definition node for the given tag
+//
+//--------------------------------------------------------------------------
+
+void
+DAG::SetDefNode
+(
+   int       aliasTag,
+   DagNode ^ node
+)
+{
+   this->EnsureTagCapacity(aliasTag);
+
+   this->tagDefNodes[aliasTag] = node;
+   this->tagDefEpochs[aliasTag] = this->epoch;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Look up the recent use nodes for the given alias tag
+//
+// Returns:
+//
+//    The list of use nodes recorded in the current epoch, or nullptr
+//
+//--------------------------------------------------------------------------
+
+DagNodeList ^
+DAG::LookupUseNodes
+(
+   int aliasTag
+)
+{
+   if ((aliasTag >= this->tagUseEpochs->Length)
+      || (this->tagUseEpochs[aliasTag] != this->epoch))
+   {
+      return nullptr;
+   }
+
+   return this->tagUseNodes[aliasTag];
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add the given node to the recent use nodes for the given alias tag
+//
+// Remarks:
+//
+//    The list for a tag is allocated the first time the tag is used in
+//    the function and cleared the first time it is used in each epoch.
+//
+//--------------------------------------------------------------------------
+
+void
+DAG::AddUseNode
+(
+   int       aliasTag,
+   DagNode ^ node
+)
+{
+   this->EnsureTagCapacity(aliasTag);
+
+   DagNodeList ^ nodeList = this->tagUseNodes[aliasTag];
+
+   if (nodeList == nullptr)
+   {
+      nodeList = gcnew DagNodeList();
+      this->tagUseNodes[aliasTag] = nodeList;
+      this->allocationCount++;
+   }
+
+   if (this->tagUseEpochs[aliasTag] != this->epoch)
+   {
+      nodeList->Clear();
+      this->tagUseEpochs[aliasTag] = this->epoch;
+   }
+
+   nodeList->Add(node);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Look up the memory use nodes filed under the given primary tag
+//
+// Returns:
+//
+//    The list of use nodes recorded in the current epoch, or nullptr
+//
+//--------------------------------------------------------------------------
+
+DagNodeList ^
+DAG::LookupGroupNodes
+(
+   int primaryTag
+)
+{
+   if ((primaryTag >= this->primaryUseEpochs->Length)
+      || (this->primaryUseEpochs[primaryTag] != this->epoch))
+   {
+      return nullptr;
+   }
+
+   return this->primaryUseNodes[primaryTag];
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    File the given memory use node under the given primary tag
+//
+// Remarks:
+//
+//    A node is filed once per distinct primary tag in its alias set, not
+//    once per tag, so a definition meets it at most once per group it
+//    scans. A definition whose alias set shares a primary tag with the
+//    node's but no tag receives an order edge to it that it would not get
+//    otherwise; that is conservative but keeps each group a single list.
+//
+//--------------------------------------------------------------------------
+
+void
+DAG::AddGroupNode
+(
+   int       primaryTag,
+   DagNode ^ node
+)
+{
+   this->EnsureTagCapacity(primaryTag);
+
+   DagNodeList ^ nodeList = this->primaryUseNodes[primaryTag];
+
+   if (nodeList == nullptr)
+   {
+      nodeList = gcnew DagNodeList();
+      this->primaryUseNodes[primaryTag] = nodeList;
+      this->allocationCount++;
+   }
+
+   if (this->primaryUseEpochs[primaryTag] != this->epoch)
+   {
+      nodeList->Clear();
+      this->primaryUseEpochs[primaryTag] = this->epoch;
+   }
+
+   // The tags of one alias set are filed together, so a node already in
+   // the group is its last entry
+
+   if ((nodeList->Count == 0) || (nodeList[nodeList->Count - 1] != node))
+   {
+      nodeList->Add(node);
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Grow the tag-indexed arrays so that the given tag can be stored
+//
+// Remarks:
+//
+//    The arrays are sized to the number of location tags when the DAG is
+//    created. This only triggers if the alias package hands out a larger
+//    tag later in the function.
+//
+//--------------------------------------------------------------------------
+
+void
+DAG::EnsureTagCapacity
+(
+   int aliasTag
+)
+{
+   if (aliasTag < this->tagDefEpochs->Length)
+   {
+      return;
+   }
+
+   int newLength = System::Math::Max(aliasTag + 1, this->tagDefEpochs->Length * 2);
+
+   System::Array::Resize(this->tagDefNodes, newLength);
+   System::Array::Resize(this->tagDefEpochs, newLength);
+   System::Array::Resize(this->tagUseNodes, newLength);
+   System::Array::Resize(this->tagUseEpochs, newLength);
+   System::Array::Resize(this->primaryUseNodes, newLength);
+   System::Array::Resize(this->primaryUseEpochs, newLength);
+   System::Array::Resize(this->primaryVisits, newLength);
+
+   this->allocationCount += 7;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Lookup the DagNode for the given operand in the operand table. If the
 //    result node is a definition node, the target node that the definition node points
 //    to will be returned to enable copy propogation if possible.
 //
 // Arguments:
 //
 //    operand - The operand to look up
-//    hashCode - The hash code of the node to search or create
+//    operandKey - The key of the operand, from GetOperandKey
 //
 // Returns:
 //
@@ -91,12 +374,12 @@ DagNode ^
 DAG::LookupOpnd
 (
    Phx::IR::Operand ^ operand,
-   int             hashCode
+   long long          operandKey
 )
 {
-   // Lookup in the opndToNodeMap
+   // Lookup in the operand table
 
-   DagNode ^ node = this->opndToNodeMap->Lookup(OpndKey::New(operand, hashCode));
+   DagNode ^ node = this->core->LookupOperand(operand, operandKey);
 
    if ((node == nullptr) || node->IsInvalid)
    {
@@ -123,8 +406,8 @@ DAG::LookupOpnd
       if (operand->BaseOperand != nullptr)
       {
          DagNode ^ baseNode =
-            this->opndToNodeMap->Lookup(OpndKey::New(operand->BaseOperand,
-                  GetHashCode(operand->BaseOperand)));
+            this->core->LookupOperand(operand->BaseOperand,
+               GetOperandKey(operand->BaseOperand));
 
          if (baseNode != nullptr)
          {
@@ -136,8 +419,8 @@ DAG::LookupOpnd
       if (operand->IndexOperand != nullptr)
       {
          DagNode ^ indexNode =
-            this->opndToNodeMap->Lookup(OpndKey::New(operand->IndexOperand,
-                  GetHashCode(operand->IndexOperand)));
+            this->core->LookupOperand(operand->IndexOperand,
+               GetOperandKey(operand->IndexOperand));
 
          if (indexNode != nullptr)
          {
@@ -149,8 +432,8 @@ DAG::LookupOpnd
       if (operand->SegmentOperand != nullptr)
       {
          DagNode ^ segNode =
-            this->opndToNodeMap->Lookup(OpndKey::New(operand->SegmentOperand,
-                  GetHashCode(operand->SegmentOperand)));
+            this->core->LookupOperand(operand->SegmentOperand,
+               GetOperandKey(operand->SegmentOperand));
 
          if (segNode != nullptr)
          {
@@ -248,6 +531,8 @@ DAG::FindOrCreateSimpleNode
 
    int      hashCode = DAG::GetHashCode(operand);
 
+   long long operandKey = DAG::GetOperandKey(operand);
+
    DagNode ^ node = nullptr;
 
    bool     isCSECandidate = DAG::IsSimpleCSECandidate(operand, nodeKind);
@@ -256,9 +541,9 @@ DAG::FindOrCreateSimpleNode
    {
       // The given operand is a candidate for CSE
 
-      // look up in the opndToNodeMap for any cached information
+      // look up in the operand table for any cached information
 
-      node = this->LookupOpnd(operand, hashCode);
+      node = this->LookupOpnd(operand, operandKey);
 
       if (node != nullptr)
       {
@@ -287,9 +572,9 @@ DAG::FindOrCreateSimpleNode
          this->EnforceEvlOrderForUse(newNode);
       }
 
-      // Cache the mapping information the the opndToNodemap
+      // Cache the mapping information the the operand table
 
-      this->opndToNodeMap->Insert(OpndKey::New(operand, hashCode), newNode);
+      this->core->InsertOperand(operand, operandKey, newNode);
 
    }
 
@@ -302,7 +587,7 @@ DAG::FindOrCreateSimpleNode
    // Add the new node to the root node list since a new node is always a
    // root node in the DAG
 
-   this->rootList->Add(newNode);
+   this->core->AddRoot(newNode);
 
    return newNode;
 }
@@ -345,13 +630,15 @@ DAG::FindOrCreateMemNode
 
    int      hashCode = GetHashCode(operand);
 
+   long long operandKey = GetOperandKey(operand);
+
    DagNode ^ node = nullptr;
 
-   // look up in the opndToNodeMap for any cached information
+   // look up in the operand table for any cached information
 
    if (DAG::IsSimpleCSECandidate(operand, nodeKind))
    {
-      node = this->LookupOpnd(operand, hashCode);
+      node = this->LookupOpnd(operand, operandKey);
 
       if (node != nullptr)
       {
@@ -362,7 +649,7 @@ DAG::FindOrCreateMemNode
    }
 
    // No DAG information cached for the operand, create a dag node and
-   // look up in the exprToNodeMap for common expression matching
+   // look up in the expression table for common expression matching
 
    DagNode ^ newNode = DagNode::New(operand, hashCode, nodeKind);
 
@@ -423,17 +710,17 @@ DAG::FindOrCreateMemNode
    this->ResolveMemNode(newNode);
 
    // After resolve all of its base/index/segment operand, try look up in the
-   // opndToNodeMap again
+   // operand table again
 
    operand = newNode->NewDstOpnd->AsMemoryOperand;
 
-   // hashCode might change if base/index/segment operands change
+   // The key might change if base/index/segment operands change
 
-   hashCode = GetHashCode(operand);
+   operandKey = GetOperandKey(operand);
 
    if (DAG::IsSimpleCSECandidate(operand, nodeKind))
    {
-      node = this->LookupOpnd(operand, hashCode);
+      node = this->LookupOpnd(operand, operandKey);
 
       if (node != nullptr)
       {
@@ -451,13 +738,11 @@ DAG::FindOrCreateMemNode
 
    // Search in the expression map
 
-   NodeKey ^ searchKey = NodeKey::New(newNode, hashCode);
-
    if ((nodeKind & DagNodeKind::Use) != (DagNodeKind)0)
    {
       // We always create a new definition node, so no need to lookup for definition node
 
-      node = this->exprToNodeMap->Lookup(searchKey);
+      node = this->core->LookupExpression(newNode, operandKey);
 
       if (node != nullptr)
       {
@@ -469,9 +754,9 @@ DAG::FindOrCreateMemNode
 
          this->RemoveNode(newNode);
 
-         // Cache the mapping information in the opndToNodeMap
+         // Cache the mapping information in the operand table
 
-         this->opndToNodeMap->Insert(OpndKey::New(operand, hashCode), node);
+         this->core->InsertOperand(operand, operandKey, node);
 
          // If the found node has target node, which is its congruence 
          // class, return the target node if it is safe
@@ -498,7 +783,7 @@ DAG::FindOrCreateMemNode
 
       // Cache dag information
 
-      this->opndToNodeMap->Insert(OpndKey::New(operand, hashCode), newNode);
+      this->core->InsertOperand(operand, operandKey, newNode);
    }
 
    // Currently, Phoenix does not support arbtrary type of temporaries.
@@ -509,7 +794,7 @@ DAG::FindOrCreateMemNode
 
    // Add the new node to the root list since a new node is always a root
 
-   this->rootList->Add(newNode);
+   this->core->AddRoot(newNode);
 
    return newNode;
 }
@@ -613,19 +898,12 @@ DAG::FindOrCreateExprNode
             // Add evaluation order constraints between this node and all nodes
             // that are possibly used by this instruction
 
-            int                         aliasTag = srcOperand->AliasTag;
-            Phx::Alias::MemberPosition memberPosition = Phx::Alias::MemberPosition();
-            int                         srcTag;
+            array<int> ^ srcTags =
+               this->aliasCache->GetMayPartialAliases(srcOperand->AliasTag);
 
-            for (srcTag =
-               this->aliasInfo->GetFirstMayPartialAlias(srcOperand->AliasTag,
-                  &memberPosition);
-                 srcTag != ((int)Alias::Constants::InvalidTag);
-                 srcTag = this->aliasInfo->GetNextMayPartialAlias(aliasTag,
-                    &memberPosition))
+            for each (int srcTag in srcTags)
             {
-               DagNode ^ implicitSrcNode =
-                  this->tagToDefNodeMap->Lookup(srcTag);
+               DagNode ^ implicitSrcNode = this->LookupDefNode(srcTag);
 
                if (implicitSrcNode != nullptr)
                {
@@ -678,7 +956,7 @@ DAG::FindOrCreateExprNode
       }
    }
 
-   // Now look up the new expression in the exprToNodeMap for common
+   // Now look up the new expression in the expression table for common
    // expression match.
 
    Phx::IR::Operand ^ dstOperand = instruction->DestinationOperand;
@@ -689,9 +967,9 @@ DAG::FindOrCreateExprNode
 
       // Look up the common expression
 
-      NodeKey ^ searchKey = NodeKey::New(newNode, hashCode);
+      long long expressionKey = this->GetExpressionKey(newNode);
 
-      node = this->exprToNodeMap->Lookup(searchKey);
+      node = this->core->LookupExpression(newNode, expressionKey);
 
       if (node != nullptr)
       {
@@ -704,7 +982,7 @@ DAG::FindOrCreateExprNode
 
       // put the new expression in the hash table 
 
-      this->exprToNodeMap->Insert(searchKey, newNode);
+      this->core->InsertExpression(newNode, expressionKey);
    }
 
    // Enforce evaluation order before calls
@@ -725,7 +1003,7 @@ DAG::FindOrCreateExprNode
 
    // Add the new node to the root node list 
 
-   this->rootList->Add(newNode);
+   this->core->AddRoot(newNode);
 
    return newNode;
 }
@@ -736,7 +1014,7 @@ DAG::FindOrCreateExprNode
 //
 //    A helper function that determines whether the given operand and 
 //    nodeKind is candidate of simple common sub-expression (CSE), in
-//    which case we can look up the opndToNodeMap first.
+//    which case we can look up the operand table first.
 //
 // Arguments:
 //
@@ -758,8 +1036,8 @@ DAG::IsSimpleCSECandidate
 {
    if ((nodeKind & DagNodeKind::Use) == (DagNodeKind)0)
    {
-      // Only uses node can be matched in the opndToNodeMap.
-      // For expression nodes, we need to look op the exprToNodeMap.
+      // Only uses node can be matched in the operand table.
+      // For expression nodes, we need to look up the expression table.
       // For definition nodes, we always create a new node for a definition operand, and
       // thus no need to lookup
 
@@ -768,7 +1046,7 @@ DAG::IsSimpleCSECandidate
 
    if ((nodeKind & DagNodeKind::Memory) != (DagNodeKind)0)
    {
-      // Memory operand is always cached in opndToNodeMap
+      // Memory operand is always cached in the operand table
 
       return true;
    }
@@ -992,6 +1270,8 @@ DAG::Fold
 
    newNode = this->FindOrCreateSimpleNode(newImmediateOperand, DagNodeKind::Use);
 
+   this->ruleCounts[RuleTable::FoldRule->Index]++;
+
    return true;
 }
 
@@ -1014,12 +1294,15 @@ DAG::Fold
 //
 // Remarks:
 //
-//    we only implement some very simple optimizatoins here. Readers are
-//    encouraged to extend this function to perform many other useful 
-//    simplifications. Right now, cases are handled are
+//    The simplifications are binary operations with one constant operand,
+//    e.g.
 //
 //       MUL X, 2 ^N  -> SHL X, N
 //       DIV X, 2 ^N  -> SHR X, N
+//       ADD X, 0     -> X
+//
+//    The full list is in RuleTable::Build; readers are encouraged to add
+//    rules there rather than here.
 //
 //--------------------------------------------------------------------------
 
@@ -1034,25 +1317,34 @@ DAG::Simplify
 
    Phx::Common::Opcode::Index opcode = Common::Opcode::GetIndex(instruction->Opcode);
 
-   if ((opcode != Phx::Common::Opcode::Index::Multiply)
-      && (opcode != Phx::Common::Opcode::Index::Divide))
+   if (!RuleTable::HasRules(opcode))
    {
-      // we only handle MUL and DIV now
-
       return false;
    }
 
-   Phx::IR::Operand ^           power2Opnd = nullptr;
-
-   long long                power2Value = -1;
+   array<DagNode ^> ^        srcNodes = gcnew array<DagNode ^>(2);
+   array<Phx::Types::Type ^> ^ srcTypes = gcnew array<Phx::Types::Type ^>(2);
+   Phx::IR::Operand ^        constOpnd = nullptr;
+   long long                 constValue = 0;
+   int                       constPosition = -1;
+   int                       numSrc = 0;
 
    for each (Phx::IR::Operand ^ srcOperand in
       Phx::IR::Operand::IteratorEditingExplicitSource(instruction))
    {
+      if (numSrc > 1)
+      {
+         // All rules are for binary operations
+
+         return false;
+      }
+
       // Find the congruence class of the src operand first.
       // This might change some src operand to constant, which instroduces
       // optimization opportunities.
 
+      srcTypes[numSrc] = srcOperand->Type;
+
       DagNode ^       srcNode = this->FindOrCreateNode(srcOperand,
          DagNodeKind::Use);
       Phx::IR::Operand ^ newLabel = srcNode->Label;
@@ -1070,61 +1362,101 @@ DAG::Simplify
       }
       else
       {
-         // constant src operand
-		 Phx::IR::ImmediateOperand ^ constSrc = newLabel->AsImmediateOperand;
+         // constant src operand. Expressions with two constants are left
+         // to Fold.
 
-         if ((constSrc->IntValue > 0)
-            && Phx::Utility::IsPowerOf2(constSrc->IntValue)
-            && ((opcode != Phx::Common::Opcode::Index::Divide)
-               || (srcOperand != instruction->SourceOperand)))
-         {
-            // For DIV, we can only perform strength reduction if the 
-            // second src operand is a power of 2
-
-            power2Opnd = srcOperand;
-            power2Value = constSrc->IntValue;
-
-         }
-         else
+         if (!newLabel->IsIntImmediate || (constOpnd != nullptr))
          {
             return false;
          }
+
+         constOpnd = srcOperand;
+         constValue = newLabel->AsImmediateOperand->IntValue;
+         constPosition = numSrc;
       }
+
+      srcNodes[numSrc++] = srcNode;
    }
 
-   // The expression can be folded to a single integer value
+   if ((numSrc != 2) || (constOpnd == nullptr))
+   {
+      return false;
+   }
+
+   SimplifyRule ^ rule = RuleTable::Lookup(opcode, constValue, (constPosition == 0));
 
-   if (power2Value > 1)
+   if (rule == nullptr)
    {
-      // tranformation: x* (2 ^N) -> shl X N
+      return false;
+   }
 
-      if (opcode == Phx::Common::Opcode::Index::Multiply)
-      {
-         instruction->Opcode = Phx::Common::Opcode::ShiftLeft;
-      }
-      else
+   int otherPosition = 1 - constPosition;
+
+   switch (rule->Rewrite)
+   {
+      case RuleRewrite::ShiftLeftByLog2:
+      case RuleRewrite::ShiftRightByLog2:
       {
-         instruction->Opcode = Phx::Common::Opcode::ShiftRight;
+         // tranformation: x* (2 ^N) -> shl X N
+
+         if (rule->Rewrite == RuleRewrite::ShiftLeftByLog2)
+         {
+            instruction->Opcode = Phx::Common::Opcode::ShiftLeft;
+         }
+         else
+         {
+            instruction->Opcode = Phx::Common::Opcode::ShiftRight;
+         }
+
+         int            logValue = Phx::Utility::Log2(constValue);
+
+         Phx::IR::Operand ^ newSourceOperand = Phx::IR::ImmediateOperand::New(functionUnit,
+            constOpnd->Type, (__int64)logValue);
+
+         instruction->UnlinkSource(constOpnd);
+         instruction->AppendSource(newSourceOperand);
+
+         // create a new dag node for the new instruction
+
+         newNode = this->FindOrCreateExprNode(instruction->DestinationOperand, DagNodeKind::Expression);
+
+         break;
       }
 
-      int            logValue = Phx::Utility::Log2(power2Value);
+      case RuleRewrite::OtherOperand:
+
+         // The result is the non-constant operand. Its type must be the
+         // type of the result, or an assignment would convert it.
+
+         if (srcTypes[otherPosition] != instruction->DestinationOperand->Type)
+         {
+            return false;
+         }
+
+         newNode = srcNodes[otherPosition];
 
-      Phx::IR::Operand ^ newSourceOperand = Phx::IR::ImmediateOperand::New(functionUnit,
-         power2Opnd->Type, (__int64)logValue);
+         break;
 
-      instruction->UnlinkSource(power2Opnd);
-      instruction->AppendSource(newSourceOperand);
+      case RuleRewrite::Zero:
+      {
+         Phx::IR::Operand ^ zeroOperand = Phx::IR::ImmediateOperand::New(functionUnit,
+            instruction->DestinationOperand->Type, (__int64)0);
 
-      // create a new dag node for the new instruction
+         newNode = this->FindOrCreateSimpleNode(zeroOperand, DagNodeKind::Use);
 
-      newNode = this->FindOrCreateExprNode(instruction->DestinationOperand, DagNodeKind::Expression);
+         break;
+      }
 
-      // simplification succeeds
+      default:
 
-      return true;
+         return false;
    }
 
-   return false;
+   // simplification succeeds
+
+   this->ruleCounts[rule->Index]++;
+
+   return true;
 }
 
 //--------------------------------------------------------------------------
@@ -1198,9 +1530,9 @@ DAG::HandleDstOpnd
       this->EnforceEvlOrderForDef(dstOperand, newExplicitDefNode);
    }
 
-   // Cache the mapping information in the opndToNodeMap
+   // Cache the mapping information in the operand table
 
-   this->opndToNodeMap->Insert(OpndKey::New(dstOperand, GetHashCode(dstOperand)),
+   this->core->InsertOperand(dstOperand, GetOperandKey(dstOperand),
       newExplicitDefNode);
 
    // set the targetNode for the new definition node and add the assignment 
@@ -1442,11 +1774,13 @@ DAG::UpdateRenameMap
    OpndToOpndMap ^ renameMap
 )
 {
-   // Iterate all items in the opndToNodeMap and update the renameMap
+   // Iterate all items in the operand table and update the renameMap
    // accordingly
 
-   for each (DagNode ^ node in this->opndToNodeMap->Values)
+   for (int i = 0; i < this->core->OperandCount; i++)
    {
+      DagNode ^ node = this->core->GetOperandNode(i);
+
       if (!node->IsDefNode)
       {
          // Only definition node needs to be cached in the rename map
@@ -1706,6 +2040,220 @@ DAG::GetHashCode
    return hashCode;
 }
 
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Generate the 64-bit key of the input operand for the operand table
+//
+// Returns:
+//
+//    The key generated.
+//
+// Remarks:
+//
+//    The key packs the operand kind in bits 60-63, a detail field in bits
+//    32-59 and the operand's identity (an alias tag, a value or an id) in
+//    bits 0-31. Operands that CompareOperand finds equal have equal keys.
+//    Only alias tags, ids, offsets, values and bit sizes go into the key,
+//    so it does not depend on object hash codes.
+//
+//--------------------------------------------------------------------------
+
+long long
+DAG::GetOperandKey
+(
+   Phx::IR::Operand ^ operand
+)
+{
+   long long          identity = 0;
+   long long          detail = 0;
+   Phx::Alias::Info ^ aliasInfo = operand->FunctionUnit->AliasInfo;
+
+   switch (operand->OperandKind)
+   {
+
+      case Phx::IR::OperandKind::VariableOperand:
+      {
+         Phx::IR::Operand ^ variableOperand = operand->AsVariableOperand;
+
+         if (variableOperand->IsVariableAddress)
+         {
+            identity = aliasInfo->GetPrimaryTag(variableOperand->AliasTag);
+            detail = 1;
+         }
+         else
+         {
+            identity = aliasInfo->MustExactTag(variableOperand->AliasTag);
+         }
+
+         break;
+      }
+
+      case Phx::IR::OperandKind::MemoryOperand:
+      {
+         Phx::IR::MemoryOperand ^ memoryOperand = operand->AsMemoryOperand;
+
+         identity = aliasInfo->MustExactTag(memoryOperand->AliasTag);
+
+         // The bit offset from the base, then one bit each for an address
+         // and for the presence of base, index and segment operands
+
+         detail = memoryOperand->Field->BitOffset
+            + Phx::Utility::BytesToBits(((unsigned int)memoryOperand->ByteOffset));
+
+         detail = (detail << 4)
+            | (memoryOperand->IsAddress ? 1 : 0)
+            | ((memoryOperand->BaseOperand != nullptr) ? 2 : 0)
+            | ((memoryOperand->IndexOperand != nullptr) ? 4 : 0)
+            | ((memoryOperand->SegmentOperand != nullptr) ? 8 : 0);
+
+         break;
+      }
+
+      case Phx::IR::OperandKind::AliasOperand:
+      {
+         Phx::IR::AliasOperand ^ aliasOperand = operand->AsAliasOperand;
+
+         identity = aliasInfo->MustExactTag(aliasOperand->AliasTag);
+
+         if (identity == ((int)Alias::Constants::InvalidTag))
+         {
+            // This alias tag has no equivalent exact reference.
+
+            identity = aliasOperand->AliasTag;
+         }
+         break;
+      }
+
+      case Phx::IR::OperandKind::ImmediateOperand:
+      {
+         Phx::IR::ImmediateOperand ^ immediateOperand = operand->AsImmediateOperand;
+
+         if (immediateOperand->IsSymbolicImmediate)
+         {
+            // Generally not resolved so use the external id.
+
+            identity = immediateOperand->Symbol->ExternId;
+            detail = 1;
+            break;
+         }
+
+         Phx::Types::Type ^ type = immediateOperand->Type;
+         long long          value;
+
+         if (type->IsFloat)
+         {
+            // CompareOperand compares float values with ==, so both zeros
+            // must get the same key
+
+            double floatValue = immediateOperand->FloatValue;
+
+            value = (floatValue == 0.0)
+               ? 0 : System::BitConverter::DoubleToInt64Bits(floatValue);
+         }
+         else if (type->IsPointer || type->IsInt || type->IsConditionCode)
+         {
+            value = immediateOperand->IntValue;
+         }
+         else
+         {
+            throw gcnew System::Exception("Bad immediate type."
+               + " Don't know how to generate the operand key");
+         }
+
+         // distinguish ImmOpnds by their size
+
+         identity = value;
+         detail = ((value >> 32) ^ (((long long)type->BitSize) << 20))
+            | (type->IsFloat ? 2 : 0);
+
+         break;
+      }
+
+      case Phx::IR::OperandKind::FunctionOperand:
+      {
+         identity = operand->AsFunctionOperand->Symbol->ExternId;
+
+         break;
+      }
+
+      case Phx::IR::OperandKind::LabelOperand:
+      {
+         Phx::IR::LabelOperand ^ labelOperand = operand->AsLabelOperand;
+
+         identity = labelOperand->LabelId;
+
+         if (labelOperand->LabelSymbol != nullptr)
+         {
+            detail = labelOperand->LabelSymbol->ExternId;
+         }
+
+         break;
+      }
+
+      default:
+
+         throw gcnew System::Exception("Unimplemented type of operand!"
+            + " Don't know how to generate the operand key");
+
+   }
+
+   return (((long long)operand->OperandKind & 0xF) << 60)
+      | ((detail & 0x0FFFFFFF) << 32)
+      | (identity & 0xFFFFFFFF);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Generate the 64-bit value number key of the given expression node for
+//    the common expression table
+//
+// Returns:
+//
+//    The key generated.
+//
+// Remarks:
+//
+//    Two expression nodes only match if they have the same opcode and the
+//    very same source nodes, so the key is built from the opcode and the
+//    node numbers of the sources: the opcode in bits 48-63, and the first
+//    two sources in bits 24-47 and 0-23. Further sources are rare and are
+//    folded in arithmetically. The result type is left to NodeKey::Match,
+//    since compatible types are allowed to match.
+//
+//--------------------------------------------------------------------------
+
+long long
+DAG::GetExpressionKey
+(
+   DagNode ^ node
+)
+{
+   Phx::IR::Instruction ^ instruction = node->Label->Instruction;
+
+   long long key = ((long long)Phx::Common::Opcode::GetIndex(instruction->Opcode)
+      & 0xFFFF) << 48;
+
+   for (int i = 0; i < node->SrcList->Count; i++)
+   {
+      long long number = this->core->GetNodeNumber(node->SrcList[i]) + 1;
+
+      if (i < 2)
+      {
+         key |= (number & 0xFFFFFF) << ((1 - i) * 24);
+      }
+      else
+      {
+         key = (key * 31) + number;
+      }
+   }
+
+   return key;
+}
+
 //--------------------------------------------------------------------------
 //
 // Description:
@@ -2034,7 +2582,7 @@ DAG::RemoveNode
 
    if (node->IsRoot)
    {
-      this->rootList->Remove(node);
+      this->core->RemoveRoot(node);
    }
 
    // Update the status of its children
@@ -2044,7 +2592,7 @@ DAG::RemoveNode
       for each (DagEdge ^ childEdge in node->ChildrenList)
       {
          DagNode ^ child = childEdge->ToNode;
-         child->ParentList->Remove(childEdge);
+         DagCore::RemoveEdge(child->ParentList, childEdge);
 
          if (childEdge->Kind != DagEdgeKind::OrderDep)
          {
@@ -2054,7 +2602,7 @@ DAG::RemoveNode
          if (child->ParentList->Count == 0)
          {
             child->IsRoot = true;
-            this->rootList->Add(child);
+            this->core->AddRoot(child);
          }
       }
    }
@@ -2090,17 +2638,15 @@ DAG::EnforceEvlOrderForUse
 
 #endif
 
-   int                         aliasTag = node->Label->AliasTag;
-   Phx::Alias::MemberPosition memberPosition = Phx::Alias::MemberPosition();
+   array<int> ^ mayPOTags =
+      this->aliasCache->GetMayPartialAliases(node->Label->AliasTag);
+   bool         isGrouped = this->groupByPrimaryTag && node->IsMemNode;
 
-   for (int mayPOTag = this->aliasInfo->GetFirstMayPartialAlias(aliasTag,
-         &memberPosition);
-        mayPOTag != ((int)Alias::Constants::InvalidTag);
-        mayPOTag = this->aliasInfo->GetNextMayPartialAlias(aliasTag, &memberPosition))
+   for each (int mayPOTag in mayPOTags)
    {
       // Look up the latest definition node for this use
 
-      DagNode ^ latestDefNode = this->tagToDefNodeMap->Lookup(mayPOTag);
+      DagNode ^ latestDefNode = this->LookupDefNode(mayPOTag);
 
       if (latestDefNode != nullptr)
       {
@@ -2117,26 +2663,15 @@ DAG::EnforceEvlOrderForUse
          this->AddEdge(node, latestDefNode, DagEdgeKind::OrderDep);
       }
 
-      // Insert it as a new use for the given tag
+      // Insert it as a new use for the given tag, or for its primary tag
 
-      if (this->tagToUseNodeMap->ContainsKey(mayPOTag))
+      if (isGrouped)
       {
-         // A use node list already exists, simply insert to it
-
-         DagNodeList ^ nodelist = this->tagToUseNodeMap[mayPOTag];
-
-         nodelist->Add(node);
+         this->AddGroupNode(this->aliasCache->GetPrimaryTag(mayPOTag), node);
       }
       else
       {
-         // First use node for the given tag, create a node list
-         // and insert it to the map
-
-         DagNodeList ^ nodelist = gcnew DagNodeList();
-
-         nodelist->Add(node);
-
-         this->tagToUseNodeMap->Add(mayPOTag, nodelist);
+         this->AddUseNode(mayPOTag, node);
       }
    }
 
@@ -2170,6 +2705,9 @@ DAG::EnforceEvlOrderForUse
 //    instruction, the input node is the expression node of the instruction, 
 //    instead of the definition node in normal cases.
 //
+//    Overlap between tags is answered by the alias cache, so a pair of
+//    tags that meets repeatedly in the range is only checked once.
+//
 //--------------------------------------------------------------------------
 
 void
@@ -2186,71 +2724,56 @@ DAG::EnforceEvlOrderForDef
 
 #endif
 
-   int                         aliasTag = operand->AliasTag;
-   Phx::Alias::MemberPosition memberPosition = Phx::Alias::MemberPosition();
+   int          aliasTag = operand->AliasTag;
+   array<int> ^ mayPOTags = this->aliasCache->GetMayPartialAliases(aliasTag);
 
-   for (int mayPOTag = this->aliasInfo->GetFirstMayPartialAlias(aliasTag,
-         &memberPosition);
-        mayPOTag != ((int)Alias::Constants::InvalidTag);
-        mayPOTag = this->aliasInfo->GetNextMayPartialAlias(aliasTag, &memberPosition))
+   if (this->groupByPrimaryTag)
+   {
+      this->visitStamp++;
+   }
+
+   for each (int mayPOTag in mayPOTags)
    {
       // Look up the recent use nodes first
 
-      DagNodeList ^ nodeList = this->tagToUseNodeMap->Lookup(mayPOTag);
+      DagNodeList ^ nodeList = this->LookupUseNodes(mayPOTag);
 
       if (nodeList != nullptr)
       {
          for each (DagNode ^ useNode in nodeList)
          {
-            // Double check whether the two operands may overlap partially
-
-            if (!this->aliasInfo->MayPartiallyOverlap(useNode->Label, operand)
-               || useNode->IsKilled)
-            {
-               // The overlap is not direct, or the use node is already 
-               // processed previously, we simply add evaluation order 
-               // between them
-
-               this->AddEdge(node, useNode, DagEdgeKind::OrderDep);
-               continue;
-            }
-
-            // There are some overlap between the use operand and the
-            // new definition operand. The use operand becomes invalid now.
+            this->KillUseNode(useNode, operand, node);
+         }
+      }
 
-            // Invalidate all nodes that are depentdent on the useNode
-            // Evaluation order is enforced during the invalidation
+      // Then the memory use nodes filed under the tag's primary tag, unless
+      // this definition has already scanned them
 
-            this->InvalidateNode(useNode, node);
+      if (this->groupByPrimaryTag)
+      {
+         int primaryTag = this->aliasCache->GetPrimaryTag(mayPOTag);
 
-            // Set the useNode to IsKilled so that we don't need to 
-            // process it if it appears again. Note, one aliag tag
-            // might be overlapping several tags, so it's possible that
-            // one use node appears in several entries in the
-            // tagToUseNodeMap.
+         this->EnsureTagCapacity(primaryTag);
 
-            useNode->IsKilled = true;
+         if (this->primaryVisits[primaryTag] != this->visitStamp)
+         {
+            this->primaryVisits[primaryTag] = this->visitStamp;
 
-            // If an identifier is assigned multiple times, it's possible
-            // to eliminate dead stores. But due to the conservative 
-            // killing process, we need to make sure that an identifier 
-            // is killed by the same identifier before we elimiate the 
-            // dead stores. IsKilledBySelf is a property for this purpose
+            DagNodeList ^ groupList = this->LookupGroupNodes(primaryTag);
 
-            if (DAG::CanKillEachOther(useNode, node))
+            if (groupList != nullptr)
             {
-               // We do structural comparison to decide the equality of
-               // two memory operands. Otherwise, lexical comparison is
-               // performed.
-
-               useNode->IsKilledBySelf = true;
+               for each (DagNode ^ useNode in groupList)
+               {
+                  this->KillUseNode(useNode, operand, node);
+               }
             }
          }
       }
 
       // Look up the latest definition node for this use
 
-      DagNode ^ latestDefNode = this->tagToDefNodeMap->Lookup(mayPOTag);
+      DagNode ^ latestDefNode = this->LookupDefNode(mayPOTag);
 
       if (latestDefNode != nullptr)
       {
@@ -2263,7 +2786,8 @@ DAG::EnforceEvlOrderForDef
 #endif
 
          if (latestDefNode->IsKilled || latestDefNode->IsExprNode
-            || !this->aliasInfo->MayPartiallyOverlap(latestDefNode->Label, operand))
+            || !this->aliasCache->MayPartiallyOverlap(
+               latestDefNode->Label->AliasTag, aliasTag))
          {
             this->AddEdge(node, latestDefNode, DagEdgeKind::OrderDep);
          }
@@ -2292,11 +2816,83 @@ DAG::EnforceEvlOrderForDef
 
       // Insert it as the latest node for the given tag
 
-      this->tagToDefNodeMap->Insert(mayPOTag, node);
+      this->SetDefNode(mayPOTag, node);
    }
 
 }
 
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Process a recent use node found by a new definition
+//
+// Arguments:
+//
+//    useNode - The recent use node
+//    operand - The dst operand being defined
+//    node  - The dag node that defines it, see EnforceEvlOrderForDef
+//
+// Returns:
+//
+//    Nothing.
+//
+//--------------------------------------------------------------------------
+
+void
+DAG::KillUseNode
+(
+   DagNode ^          useNode,
+   Phx::IR::Operand ^ operand,
+   DagNode ^          node
+)
+{
+   // Double check whether the two operands may overlap partially
+
+   if (useNode->IsKilled
+      || !this->aliasCache->MayPartiallyOverlap(useNode->Label->AliasTag,
+         operand->AliasTag))
+   {
+      // The overlap is not direct, or the use node is already 
+      // processed previously, we simply add evaluation order 
+      // between them
+
+      this->AddEdge(node, useNode, DagEdgeKind::OrderDep);
+      return;
+   }
+
+   // There are some overlap between the use operand and the
+   // new definition operand. The use operand becomes invalid now.
+
+   // Invalidate all nodes that are depentdent on the useNode
+   // Evaluation order is enforced during the invalidation
+
+   this->InvalidateNode(useNode, node);
+
+   // Set the useNode to IsKilled so that we don't need to 
+   // process it if it appears again. Note, one aliag tag
+   // might be overlapping several tags, so it's possible that
+   // one use node appears in several entries in the
+   // tag use lists.
+
+   useNode->IsKilled = true;
+
+   // If an identifier is assigned multiple times, it's possible
+   // to eliminate dead stores. But due to the conservative 
+   // killing process, we need to make sure that an identifier 
+   // is killed by the same identifier before we elimiate the 
+   // dead stores. IsKilledBySelf is a property for this purpose
+
+   if (DAG::CanKillEachOther(useNode, node))
+   {
+      // We do structural comparison to decide the equality of
+      // two memory operands. Otherwise, lexical comparison is
+      // performed.
+
+      useNode->IsKilledBySelf = true;
+   }
+}
+
 //--------------------------------------------------------------------------
 //
 // Description:
@@ -2358,7 +2954,7 @@ DAG::AddEdge
       // it's not root any more
 
       child->IsRoot = false;
-      this->rootList->Remove(child);
+      this->core->RemoveRoot(child);
    }
 
    DagEdge ^ newEdge = DagEdge::New(parent, child, edgeKind);
@@ -2372,8 +2968,11 @@ DAG::AddEdge
          // edge to evaluate.
          // Note, edges are compared by their from/to nodes, not kind
 
-         parent->ChildrenList->Remove(newEdge);
-         child->ParentList->Remove(newEdge);
+         if (this->core->HasEdge(parent, child))
+         {
+            parent->ChildrenList->Remove(newEdge);
+            child->ParentList->Remove(newEdge);
+         }
       }
       else if ((child->Height + 1) > parent->Height)
       {
@@ -2384,21 +2983,22 @@ DAG::AddEdge
          parent->Height = child->Height + 1;
       }
 
-      parent->ChildrenList->Add(newEdge);
+      DagCore::InsertChildEdge(parent->ChildrenList, newEdge);
       child->ParentList->Add(newEdge);
+      this->core->InsertEdge(parent, child);
 
       // update the number of real parents for the child
 
       child->NumRealParent++;
    }
-   else if (!parent->ChildrenList->Contains(newEdge))
+   else if (this->core->InsertEdge(parent, child))
    {
       // The purpose of OrderDep edges are to enforce the ToNode of the edge
       // to be evaluated before the FromNode of the edge. All kinds of edges
       // will enforce this evaluation order. Therefore, we only need add one
       // OrderDep edge when there is no edge between the given two nodes.
 
-      parent->ChildrenList->Add(newEdge);
+      DagCore::InsertChildEdge(parent->ChildrenList, newEdge);
       child->ParentList->Add(newEdge);
    }
 }
@@ -2453,8 +3053,11 @@ DagNode::New
    }
 
    // At the time a DagNode is created, it's always a root in the DAG.
+   // It is numbered and given a root slot by the DagCore later.
 
    newNode->isRoot = true;
+   newNode->number = -1;
+   newNode->rootSlot = -1;
    return newNode;
 }
 
@@ -2607,21 +3210,46 @@ NodeKey::Equals
    NodeKey ^ that
 )
 {
-   if (this->node->IsInvalid || that->node->IsInvalid)
+   if (this->GetHashCode() != that->GetHashCode())
    {
-      // Invalidated node cannot be used as commond expression
-
       return false;
    }
 
-   if (this->GetHashCode() != that->GetHashCode())
+   return NodeKey::Match(this->node, that->node);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Check whether the two nodes compute the same value. Shared by NodeKey
+//    and the common expression table of the DagCore.
+//
+// Arguments:
+//
+//    nodeA - The node already recorded
+//    nodeB - The node being matched
+//
+// Returns:
+//
+//    True if nodeB can be replaced by nodeA, false otherwise
+//
+//--------------------------------------------------------------------------
+
+bool
+NodeKey::Match
+(
+   DagNode ^ nodeA,
+   DagNode ^ nodeB
+)
+{
+   if (nodeA->IsInvalid || nodeB->IsInvalid)
    {
+      // Invalidated node cannot be used as commond expression
+
       return false;
    }
 
-   DagNode ^ nodeA = this->node;
-   DagNode ^ nodeB = that->node;
-
    if (nodeA->IsDefNode)
    {
       // We always create a new definition node
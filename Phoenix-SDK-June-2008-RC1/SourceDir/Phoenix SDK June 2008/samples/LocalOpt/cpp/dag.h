@@ -13,6 +13,8 @@
 #pragma once
 
 #include "utility.h"
+#include "dagcore.h"
+#include "aliascache.h"
 
 namespace Phx
 {
@@ -34,7 +36,6 @@ ref class NodeKey;
 typedef System::Collections::Generic::List<DagEdge ^> DagEdgeList;
 typedef System::Collections::Generic::List<DagNode ^> DagNodeList;
 typedef Hashtable<OpndKey ^, Phx::IR::Operand ^> OpndToOpndMap;
-typedef Hashtable<OpndKey ^, DagNode ^> OpndToNodeMap;
 typedef Hashtable<NodeKey ^, DagNode ^> ExprToNodeMap;
 typedef Hashtable<int, DagNode ^> TagToDefNodeMap;
 typedef Hashtable<int, System::Collections::Generic::List<DagNode ^> ^>
@@ -99,11 +100,15 @@ public:
       int             tableSize
    ) ;
 
+   void Reset ();
+
+   int NewWalkPass ();
+
    DagNode ^
    LookupOpnd
    (
       Phx::IR::Operand ^ operand,
-      int             hashCode
+      long long          operandKey
    );
 
    DagNode ^
@@ -150,6 +155,12 @@ public:
       Phx::IR::Instruction ^ instruction
    );
 
+   static long long
+   GetOperandKey
+   (
+      Phx::IR::Operand ^ operand
+   );
+
    static bool
    CompareOperand
    (
@@ -181,7 +192,83 @@ public:
 
    property DagNodeList ^ RootList
    {
-      DagNodeList ^ get() { return this->rootList; }
+      DagNodeList ^ get() { return this->core->RootList; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The index-based structures behind the DAG. Exposed so that callers
+   //    can report the size of the DAG built.
+   //
+   //--------------------------------------------------------------------------
+
+   property DagCore ^ Core
+   {
+      DagCore ^ get() { return this->core; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of tables, arrays and lists allocated by this DAG since
+   //    it was created, including those of its core
+   //
+   //--------------------------------------------------------------------------
+
+   property int AllocationCount
+   {
+      int get()
+      {
+         return this->allocationCount + this->core->AllocationCount
+            + this->aliasCache->AllocationCount;
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The cache answering the DAG's alias queries. Exposed so that callers
+   //    can report how many queries it answered.
+   //
+   //--------------------------------------------------------------------------
+
+   property AliasCache ^ Aliases
+   {
+      AliasCache ^ get() { return this->aliasCache; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    How often each rule fired in this DAG, indexed by SimplifyRule::Index.
+   //    The counts are kept per DAG rather than on the shared rules, so that
+   //    functions compiled on different threads do not race on them.
+   //
+   //--------------------------------------------------------------------------
+
+   property array<int> ^ RuleCounts
+   {
+      array<int> ^ get() { return this->ruleCounts; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Whether memory use nodes are filed under the primary tags of their
+   //    alias sets instead of under every tag of the set, see AddGroupNode
+   //
+   //--------------------------------------------------------------------------
+
+   property bool GroupByPrimaryTag
+   {
+      bool get() { return this->groupByPrimaryTag; }
+      void set(bool value) { this->groupByPrimaryTag = value; }
    }
 
 private:
@@ -258,6 +345,14 @@ private:
       DagNode ^       node
    );
 
+   void
+   KillUseNode
+   (
+      DagNode ^          useNode,
+      Phx::IR::Operand ^ operand,
+      DagNode ^          node
+   );
+
    static bool
    CanKillEachOther
    (
@@ -273,35 +368,99 @@ private:
       DagEdgeKind edgeKind
    );
 
+   DagNode ^ LookupDefNode (int aliasTag);
+
+   void
+   SetDefNode
+   (
+      int       aliasTag,
+      DagNode ^ node
+   );
+
+   DagNodeList ^ LookupUseNodes (int aliasTag);
+
+   void
+   AddUseNode
+   (
+      int       aliasTag,
+      DagNode ^ node
+   );
+
+   DagNodeList ^ LookupGroupNodes (int primaryTag);
+
+   void
+   AddGroupNode
+   (
+      int       primaryTag,
+      DagNode ^ node
+   );
+
+   void EnsureTagCapacity (int aliasTag);
+
+   long long GetExpressionKey (DagNode ^ node);
+
 private:
 
-   // The list of root nodes in the DAG
+   // The root set, the edge set, the operand table and the common
+   // expression table of the DAG. The operand table maps an operand to
+   // the dag node it attaches to; the common expression table is used to
+   // match common expressions
 
-   DagNodeList ^ rootList;
+   DagCore ^ core;
 
-   // A hash map from an operand to the dag node it attaches to
-   // It is used to query dag node information of an operand
+   // The current epoch. The DAG is reused for every instruction range of
+   // a function; entries of the tag-indexed arrays below stamped with an
+   // older epoch are treated as empty, so Reset does not clear them.
 
-   OpndToNodeMap ^ opndToNodeMap;
+   int epoch;
 
-   // A hash map from an expression to an existing dag node
-   // It is used to match common expression
+   int allocationCount;
 
-   ExprToNodeMap ^ exprToNodeMap;
+   // The number of the latest code generation walk over this DAG. A walk
+   // stamps the nodes it finishes with its number, so that a node shared
+   // by several trees is only walked once. Nodes start at zero.
 
-   // A hash map from alias tag to its may-partial-overlap definition nodes
+   int walkPass;
+
+   // A map, indexed by alias tag, from a tag to its latest may-partial-overlap
+   // definition node.
    // It is used to enforce correct evaluation order between new uses and the
    // latest definitions, and new definitions and recent uses, and new definitions and old definitions
-   // It is a single-value hashtable, i.e., we only keep the latest definition in 
-   // the hashtable
 
-   TagToDefNodeMap ^ tagToDefNodeMap;
+   array<DagNode ^> ^ tagDefNodes;
+
+   array<int> ^ tagDefEpochs;
 
-   // A hash map from alias tag to its may-partial-overlap use nodes
+   // A map, indexed by alias tag, from a tag to its may-partial-overlap use nodes
    // It is used to enforce correct evaluation order between new definition and the
-   // recent uses. It is a multi-value hashtable
+   // recent uses. The lists are kept across epochs and cleared on first use
+   // in a new epoch.
+
+   array<DagNodeList ^> ^ tagUseNodes;
+
+   array<int> ^ tagUseEpochs;
+
+   // A map, indexed by primary tag, from a tag to the memory use nodes whose
+   // alias sets contain a tag with that primary tag. Only used when
+   // groupByPrimaryTag is set; memory use nodes are then left out of
+   // tagUseNodes. primaryVisits stamps the groups a definition has already
+   // scanned with visitStamp.
+
+   bool groupByPrimaryTag;
+
+   array<DagNodeList ^> ^ primaryUseNodes;
+
+   array<int> ^ primaryUseEpochs;
+
+   array<int> ^ primaryVisits;
 
-   TagToUseNodeMap ^ tagToUseNodeMap;
+   int visitStamp;
+
+   // Alias sets and tag overlaps, computed once per epoch
+
+   AliasCache ^ aliasCache;
+
+   array<int> ^ ruleCounts;
 
    // Cached functionUnit and its aliasInfo
 
@@ -385,7 +544,8 @@ public:
    //
    // Description:
    //
-   //    The children list of this node 
+   //    The children list of this node, kept in decreasing priority of the
+   //    edges by DagCore::InsertChildEdge
    //
    //--------------------------------------------------------------------------
 
@@ -680,6 +840,36 @@ public:
       void set (bool value) { isRoot = value; }
    }
 
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of this node in the DagCore, or -1 if it has not been
+   //    connected to any other node yet
+   //
+   //--------------------------------------------------------------------------
+
+   property int Number
+   {
+      int get () { return number; }
+      void set (int value) { number = value; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The index of this node in the DagCore's root slots, or -1 if it is
+   //    not in the root list
+   //
+   //--------------------------------------------------------------------------
+
+   property int RootSlot
+   {
+      int get () { return rootSlot; }
+      void set (int value) { rootSlot = value; }
+   }
+
    //--------------------------------------------------------------------------
    //
    // Description:
@@ -775,6 +965,10 @@ private:
 
    bool isRoot;
 
+   int number;
+
+   int rootSlot;
+
    DagNode ^ targetNode;
 
    DagNode ^ baseNode;
@@ -1062,6 +1256,13 @@ public:
 
    virtual bool Equals (NodeKey ^ that);
 
+   static bool
+   Match
+   (
+      DagNode ^ nodeA,
+      DagNode ^ nodeB
+   );
+
 private:
 
    int hashCode;
@@ -0,0 +1,808 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The index-based core of the DAG for the local optimization plug in
+//
+//-----------------------------------------------------------------------------
+
+#include "utility.h"
+#include "dag.h"
+#include "dagcore.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Static constructor for a DagCore.
+//
+// Arguments:
+//
+//    sizeHint - The expected number of nodes, usually the number of
+//       instructions in the range
+//
+// Returns:
+//
+//    DagCore object.
+//
+//--------------------------------------------------------------------------
+
+DagCore ^
+DagCore::New
+(
+   int sizeHint
+)
+{
+   DagCore ^ core = gcnew DagCore();
+
+   core->rootSlots = gcnew DagNodeList(sizeHint);
+
+   // Both tables are kept at most half full. An instruction contributes
+   // about two edges and at most one expression.
+
+   int edgeCapacity = 16;
+
+   while (edgeCapacity < (sizeHint * 4))
+   {
+      edgeCapacity <<= 1;
+   }
+
+   int expressionCapacity = 16;
+
+   while (expressionCapacity < (sizeHint * 2))
+   {
+      expressionCapacity <<= 1;
+   }
+
+   // An instruction names about three operands
+
+   int operandCapacity = 16;
+
+   while (operandCapacity < (sizeHint * 6))
+   {
+      operandCapacity <<= 1;
+   }
+
+   core->edgeKeys = gcnew array<long long>(edgeCapacity);
+   core->edgeEpochs = gcnew array<int>(edgeCapacity);
+   core->operandSlots = gcnew array<int>(operandCapacity);
+   core->operandSlotEpochs = gcnew array<int>(operandCapacity);
+   core->operandKeys = gcnew array<long long>(operandCapacity / 2);
+   core->operandLabels = gcnew array<Phx::IR::Operand ^>(operandCapacity / 2);
+   core->operandNodes = gcnew array<DagNode ^>(operandCapacity / 2);
+   core->expressionKeys = gcnew array<long long>(expressionCapacity);
+   core->expressionNodes = gcnew array<DagNode ^>(expressionCapacity);
+   core->expressionEpochs = gcnew array<int>(expressionCapacity);
+
+   core->allocationCount = 11;
+   core->epoch = 1;
+
+   return core;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Empty the core so that it can be used for the next instruction range
+//
+// Remarks:
+//
+//    The tables keep their capacity. Bumping the epoch empties them
+//    without touching their slots, so a reset costs the same after a
+//    large block as after a small one.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::Reset ()
+{
+   this->epoch++;
+
+   this->nodeCount = 0;
+   this->edgeCount = 0;
+   this->expressionCount = 0;
+
+   // The entries of the last range are left for the garbage collector
+   // once they are overwritten; clearing them would cost as much as the
+   // range itself.
+
+   this->operandCount = 0;
+
+   this->rootSlots->Clear();
+   this->rootHoles = 0;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add the given node to the end of the root list
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::AddRoot
+(
+   DagNode ^ node
+)
+{
+   node->RootSlot = this->rootSlots->Count;
+   this->rootSlots->Add(node);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Remove the given node from the root list, if it is there
+//
+// Remarks:
+//
+//    The node's slot is cleared rather than removed from the list, so the
+//    order of the remaining roots is kept without shifting them. The slots
+//    are compacted once at least half of them are holes.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::RemoveRoot
+(
+   DagNode ^ node
+)
+{
+   int slot = node->RootSlot;
+
+   if (slot < 0)
+   {
+      // The node was never added to the root list, e.g. a query node that
+      // is discarded after a common expression is found
+
+      return;
+   }
+
+   this->rootSlots[slot] = nullptr;
+   node->RootSlot = -1;
+   this->rootHoles++;
+
+   if ((this->rootHoles > 64) && ((this->rootHoles * 2) > this->rootSlots->Count))
+   {
+      this->CompactRoots();
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Squeeze the holes out of the root slots, keeping the order of roots
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::CompactRoots ()
+{
+   int next = 0;
+
+   for (int slot = 0; slot < this->rootSlots->Count; slot++)
+   {
+      DagNode ^ node = this->rootSlots[slot];
+
+      if (node != nullptr)
+      {
+         node->RootSlot = next;
+         this->rootSlots[next++] = node;
+      }
+   }
+
+   this->rootSlots->RemoveRange(next, this->rootSlots->Count - next);
+   this->rootHoles = 0;
+}
+
+DagNodeList ^ DagCore::RootList::get ()
+{
+   if (this->rootHoles != 0)
+   {
+      this->CompactRoots();
+   }
+
+   return this->rootSlots;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the number of the given node, numbering it if it has none yet
+//
+//--------------------------------------------------------------------------
+
+int
+DagCore::GetNodeNumber
+(
+   DagNode ^ node
+)
+{
+   if (node->Number < 0)
+   {
+      node->Number = this->nodeCount++;
+   }
+
+   return node->Number;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Check whether there is an edge of any kind from parent to child
+//
+// Returns:
+//
+//    True if the two nodes are connected, false otherwise
+//
+//--------------------------------------------------------------------------
+
+bool
+DagCore::HasEdge
+(
+   DagNode ^ parent,
+   DagNode ^ child
+)
+{
+   if ((parent->Number < 0) || (child->Number < 0))
+   {
+      // A node without a number has never been connected
+
+      return false;
+   }
+
+   long long key = (((long long)(parent->Number + 1)) << 32)
+      | (long long)(child->Number + 1);
+
+   int slot = this->FindEdgeSlot(key);
+
+   return (this->edgeEpochs[slot] == this->epoch) && (this->edgeKeys[slot] == key);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Record that there is an edge from parent to child
+//
+// Returns:
+//
+//    True if the two nodes were not connected before, false otherwise
+//
+//--------------------------------------------------------------------------
+
+bool
+DagCore::InsertEdge
+(
+   DagNode ^ parent,
+   DagNode ^ child
+)
+{
+   long long key = (((long long)(this->GetNodeNumber(parent) + 1)) << 32)
+      | (long long)(this->GetNodeNumber(child) + 1);
+
+   int slot = this->FindEdgeSlot(key);
+
+   if ((this->edgeEpochs[slot] == this->epoch) && (this->edgeKeys[slot] == key))
+   {
+      return false;
+   }
+
+   this->edgeKeys[slot] = key;
+   this->edgeEpochs[slot] = this->epoch;
+   this->edgeCount++;
+
+   if ((this->edgeCount * 2) > this->edgeKeys->Length)
+   {
+      this->GrowEdgeTable();
+   }
+
+   return true;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the slot of the given key in the edge table
+//
+// Returns:
+//
+//    The slot holding the key, or the empty slot where it belongs
+//
+//--------------------------------------------------------------------------
+
+int
+DagCore::FindEdgeSlot
+(
+   long long key
+)
+{
+   int mask = this->edgeKeys->Length - 1;
+
+   for (int slot = DagCore::Mix(key) & mask; ; slot = (slot + 1) & mask)
+   {
+      if ((this->edgeEpochs[slot] != this->epoch) || (this->edgeKeys[slot] == key))
+      {
+         return slot;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Double the size of the edge table and rehash all keys
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::GrowEdgeTable ()
+{
+   array<long long> ^ oldKeys = this->edgeKeys;
+   array<int> ^       oldEpochs = this->edgeEpochs;
+
+   this->edgeKeys = gcnew array<long long>(oldKeys->Length * 2);
+   this->edgeEpochs = gcnew array<int>(oldKeys->Length * 2);
+   this->allocationCount += 2;
+
+   for (int i = 0; i < oldKeys->Length; i++)
+   {
+      if (oldEpochs[i] == this->epoch)
+      {
+         int slot = this->FindEdgeSlot(oldKeys[i]);
+
+         this->edgeKeys[slot] = oldKeys[i];
+         this->edgeEpochs[slot] = this->epoch;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Look up the node recorded for the given operand
+//
+// Arguments:
+//
+//    operand - The operand to look up
+//    key - The operand's key, from DAG::GetOperandKey
+//
+// Returns:
+//
+//    The node recorded for an operand lexically equal to the given one,
+//    or nullptr
+//
+//--------------------------------------------------------------------------
+
+DagNode ^
+DagCore::LookupOperand
+(
+   Phx::IR::Operand ^ operand,
+   long long          key
+)
+{
+   int mask = this->operandSlots->Length - 1;
+
+   this->operandLookups++;
+
+   for (int slot = DagCore::Mix(key) & mask; ; slot = (slot + 1) & mask)
+   {
+      this->operandProbes++;
+
+      if (this->operandSlotEpochs[slot] != this->epoch)
+      {
+         return nullptr;
+      }
+
+      int entry = this->operandSlots[slot] - 1;
+
+      if (this->operandKeys[entry] == key)
+      {
+         if (DAG::CompareOperand(this->operandLabels[entry], operand))
+         {
+            return this->operandNodes[entry];
+         }
+
+         this->operandCollisions++;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Record the node of the given operand, replacing the node recorded for
+//    a lexically equal operand if there is one
+//
+// Arguments:
+//
+//    operand - The operand
+//    key - The operand's key, from DAG::GetOperandKey
+//    node - The node to record
+//
+// Remarks:
+//
+//    A replaced entry keeps its place in the insertion order.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::InsertOperand
+(
+   Phx::IR::Operand ^ operand,
+   long long          key,
+   DagNode ^          node
+)
+{
+   int mask = this->operandSlots->Length - 1;
+   int slot = DagCore::Mix(key) & mask;
+
+   while (this->operandSlotEpochs[slot] == this->epoch)
+   {
+      int entry = this->operandSlots[slot] - 1;
+
+      if ((this->operandKeys[entry] == key)
+         && DAG::CompareOperand(this->operandLabels[entry], operand))
+      {
+         this->operandLabels[entry] = operand;
+         this->operandNodes[entry] = node;
+         return;
+      }
+
+      slot = (slot + 1) & mask;
+   }
+
+   int entry = this->operandCount++;
+
+   this->operandKeys[entry] = key;
+   this->operandLabels[entry] = operand;
+   this->operandNodes[entry] = node;
+   this->operandSlots[slot] = entry + 1;
+   this->operandSlotEpochs[slot] = this->epoch;
+
+   if ((this->operandCount * 2) >= this->operandSlots->Length)
+   {
+      this->GrowOperandTable();
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the node of the operand inserted index-th into the operand table
+//
+//--------------------------------------------------------------------------
+
+DagNode ^
+DagCore::GetOperandNode
+(
+   int index
+)
+{
+   return this->operandNodes[index];
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Double the size of the operand table and rehash all entries
+//
+// Remarks:
+//
+//    The entry arrays are kept at half the number of slots, so they fill
+//    up exactly when the slots reach half full.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::GrowOperandTable ()
+{
+   int capacity = this->operandSlots->Length * 2;
+
+   this->operandSlots = gcnew array<int>(capacity);
+   this->operandSlotEpochs = gcnew array<int>(capacity);
+
+   System::Array::Resize(this->operandKeys, capacity / 2);
+   System::Array::Resize(this->operandLabels, capacity / 2);
+   System::Array::Resize(this->operandNodes, capacity / 2);
+
+   this->allocationCount += 5;
+
+   int mask = capacity - 1;
+
+   for (int entry = 0; entry < this->operandCount; entry++)
+   {
+      int slot = DagCore::Mix(this->operandKeys[entry]) & mask;
+
+      while (this->operandSlotEpochs[slot] == this->epoch)
+      {
+         slot = (slot + 1) & mask;
+      }
+
+      this->operandSlots[slot] = entry + 1;
+      this->operandSlotEpochs[slot] = this->epoch;
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Look up a common expression for the given node
+//
+// Arguments:
+//
+//    node - The new node being matched
+//    key - The key of the new node, from DAG::GetExpressionKey or, for a
+//       memory node, DAG::GetOperandKey
+//
+// Returns:
+//
+//    The existing node that computes the same value, or nullptr
+//
+// Remarks:
+//
+//    Nodes invalidated by a kill stay in the table until their slot is
+//    reused. They can never match, so they are stepped over without being
+//    counted as collisions.
+//
+//--------------------------------------------------------------------------
+
+DagNode ^
+DagCore::LookupExpression
+(
+   DagNode ^ node,
+   long long key
+)
+{
+   int mask = this->expressionNodes->Length - 1;
+
+   this->expressionLookups++;
+
+   for (int slot = DagCore::Mix(key) & mask; ; slot = (slot + 1) & mask)
+   {
+      this->expressionProbes++;
+
+      if (this->expressionEpochs[slot] != this->epoch)
+      {
+         return nullptr;
+      }
+
+      DagNode ^ candidate = this->expressionNodes[slot];
+
+      if ((this->expressionKeys[slot] == key) && !candidate->IsInvalid)
+      {
+         if (NodeKey::Match(candidate, node))
+         {
+            return candidate;
+         }
+
+         this->expressionCollisions++;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add the given node to the common expression table
+//
+// Remarks:
+//
+//    The caller has already looked the expression up and not found it, so
+//    the node is simply added; the table never holds two valid nodes that
+//    match each other. The first slot on the probe path that holds an
+//    invalidated node is reused, which leaves the probe paths of the other
+//    entries unbroken.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::InsertExpression
+(
+   DagNode ^ node,
+   long long key
+)
+{
+   int mask = this->expressionNodes->Length - 1;
+   int slot = DagCore::Mix(key) & mask;
+
+   while (this->expressionEpochs[slot] == this->epoch)
+   {
+      if (this->expressionNodes[slot]->IsInvalid)
+      {
+         this->expressionNodes[slot] = node;
+         this->expressionKeys[slot] = key;
+         return;
+      }
+
+      slot = (slot + 1) & mask;
+   }
+
+   this->expressionNodes[slot] = node;
+   this->expressionKeys[slot] = key;
+   this->expressionEpochs[slot] = this->epoch;
+   this->expressionCount++;
+
+   if ((this->expressionCount * 2) > this->expressionNodes->Length)
+   {
+      this->GrowExpressionTable();
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Double the size of the expression table and rehash all entries
+//
+// Remarks:
+//
+//    Invalidated nodes are dropped on the way.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::GrowExpressionTable ()
+{
+   array<long long> ^ oldKeys = this->expressionKeys;
+   array<DagNode ^> ^ oldNodes = this->expressionNodes;
+   array<int> ^       oldEpochs = this->expressionEpochs;
+
+   this->expressionKeys = gcnew array<long long>(oldKeys->Length * 2);
+   this->expressionNodes = gcnew array<DagNode ^>(oldNodes->Length * 2);
+   this->expressionEpochs = gcnew array<int>(oldNodes->Length * 2);
+   this->allocationCount += 3;
+   this->expressionCount = 0;
+
+   int mask = this->expressionNodes->Length - 1;
+
+   for (int i = 0; i < oldNodes->Length; i++)
+   {
+      if ((oldEpochs[i] != this->epoch) || oldNodes[i]->IsInvalid)
+      {
+         continue;
+      }
+
+      int slot = DagCore::Mix(oldKeys[i]) & mask;
+
+      while (this->expressionEpochs[slot] == this->epoch)
+      {
+         slot = (slot + 1) & mask;
+      }
+
+      this->expressionNodes[slot] = oldNodes[i];
+      this->expressionKeys[slot] = oldKeys[i];
+      this->expressionEpochs[slot] = this->epoch;
+      this->expressionCount++;
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Remove the given edge object from the given edge list
+//
+// Remarks:
+//
+//    The edge is matched by identity and searched for from the end, since
+//    the edges removed while building the DAG are the ones just added to
+//    a discarded query node. List::Remove would compare from the front.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::RemoveEdge
+(
+   DagEdgeList ^ edgeList,
+   DagEdge ^     edge
+)
+{
+   for (int i = edgeList->Count - 1; i >= 0; i--)
+   {
+      if (edgeList[i] == edge)
+      {
+         edgeList->RemoveAt(i);
+         return;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Insert the given edge into a children list, keeping the list in the
+//    order in which the walkers evaluate children
+//
+// Remarks:
+//
+//    The list is kept in decreasing priority. The edge goes after the
+//    edges of equal priority already there, so children of equal priority
+//    are evaluated in the order they were added. An edge's priority is
+//    fixed when the edge is created, so the order stays valid.
+//
+//--------------------------------------------------------------------------
+
+void
+DagCore::InsertChildEdge
+(
+   DagEdgeList ^ childrenList,
+   DagEdge ^     edge
+)
+{
+   unsigned int priority = edge->Priority;
+   int          low = 0;
+   int          high = childrenList->Count;
+
+   // Find the first edge with a lower priority
+
+   while (low < high)
+   {
+      int middle = (low + high) / 2;
+
+      if (childrenList[middle]->Priority >= priority)
+      {
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
+      }
+   }
+
+   childrenList->Insert(low, edge);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Scramble the bits of a key so that consecutive node numbers and
+//    additive hash codes spread over the table
+//
+//--------------------------------------------------------------------------
+
+int
+DagCore::Mix
+(
+   long long key
+)
+{
+   unsigned long long bits = (unsigned long long) key;
+
+   bits ^= bits >> 33;
+   bits *= 0xff51afd7ed558ccdULL;
+   bits ^= bits >> 33;
+
+   return (int)(bits & 0x7fffffff);
+}
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
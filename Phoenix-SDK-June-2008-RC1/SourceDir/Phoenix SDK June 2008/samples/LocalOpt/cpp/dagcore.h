@@ -0,0 +1,330 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The index-based core of the DAG for the local optimization plug in.
+//
+// Remarks:
+//
+//    The DAG class keeps the DagNode and DagEdge objects that the walkers
+//    and the code generator work on. This file holds the structures the DAG
+//    consults while it is being built: the root set, the set of connected
+//    node pairs, the operand table and the common expression table. They
+//    are kept in flat integer arrays indexed by node number, so that the
+//    queries made for every new edge and every new expression take
+//    constant time instead of scanning node lists.
+//
+//    The operand and expression tables are keyed on 64-bit value numbers
+//    (see DAG::GetOperandKey and DAG::GetExpressionKey). A lookup hashes
+//    the key and probes in place, so it allocates nothing; the structural
+//    comparison only runs when two keys are equal, and the number of times
+//    it then fails is counted as a key collision. Expressions invalidated
+//    by a kill are skipped without being counted, and their slots reused.
+//
+//    The plug-in is built as verifiable code, so the arrays are managed
+//    arrays rather than native memory.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+// forward declaration
+
+ref class DagNode;
+ref class DagEdge;
+
+typedef System::Collections::Generic::List<DagEdge ^> DagEdgeList;
+typedef System::Collections::Generic::List<DagNode ^> DagNodeList;
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Node numbering, root set, edge set and expression table of a DAG
+//
+//-----------------------------------------------------------------------------
+
+public ref class DagCore
+{
+
+public:
+
+   static DagCore ^
+   New
+   (
+      int sizeHint
+   );
+
+   void Reset ();
+
+   static int Mix (long long key);
+
+   void AddRoot (DagNode ^ node);
+
+   void RemoveRoot (DagNode ^ node);
+
+   bool
+   HasEdge
+   (
+      DagNode ^ parent,
+      DagNode ^ child
+   );
+
+   bool
+   InsertEdge
+   (
+      DagNode ^ parent,
+      DagNode ^ child
+   );
+
+   int GetNodeNumber (DagNode ^ node);
+
+   DagNode ^
+   LookupOperand
+   (
+      Phx::IR::Operand ^ operand,
+      long long          key
+   );
+
+   void
+   InsertOperand
+   (
+      Phx::IR::Operand ^ operand,
+      long long          key,
+      DagNode ^          node
+   );
+
+   DagNode ^ GetOperandNode (int index);
+
+   DagNode ^
+   LookupExpression
+   (
+      DagNode ^ node,
+      long long key
+   );
+
+   void
+   InsertExpression
+   (
+      DagNode ^ node,
+      long long key
+   );
+
+   static void
+   RemoveEdge
+   (
+      DagEdgeList ^ edgeList,
+      DagEdge ^     edge
+   );
+
+   static void
+   InsertChildEdge
+   (
+      DagEdgeList ^ childrenList,
+      DagEdge ^     edge
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The roots of the DAG, in the order they became roots
+   //
+   // Remarks:
+   //
+   //    Removing a root leaves a hole in the slot list; the holes are
+   //    squeezed out here, so the returned list must not be kept across
+   //    further changes to the DAG.
+   //
+   //--------------------------------------------------------------------------
+
+   property DagNodeList ^ RootList
+   {
+      DagNodeList ^ get ();
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of nodes numbered and distinct node pairs connected so far
+   //
+   //--------------------------------------------------------------------------
+
+   property int NodeCount
+   {
+      int get () { return nodeCount; }
+   }
+
+   property int EdgeCount
+   {
+      int get () { return edgeCount; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of operands in the operand table. GetOperandNode returns
+   //    their nodes in the order the operands were first inserted.
+   //
+   //--------------------------------------------------------------------------
+
+   property int OperandCount
+   {
+      int get () { return operandCount; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Lookup statistics of the operand and expression tables since the
+   //    core was created: lookups made, table slots examined, and lookups
+   //    that found an equal key on an operand or node that did not match
+   //
+   //--------------------------------------------------------------------------
+
+   property long long OperandLookups
+   {
+      long long get () { return operandLookups; }
+   }
+
+   property long long OperandProbes
+   {
+      long long get () { return operandProbes; }
+   }
+
+   property long long OperandCollisions
+   {
+      long long get () { return operandCollisions; }
+   }
+
+   property long long ExpressionLookups
+   {
+      long long get () { return expressionLookups; }
+   }
+
+   property long long ExpressionProbes
+   {
+      long long get () { return expressionProbes; }
+   }
+
+   property long long ExpressionCollisions
+   {
+      long long get () { return expressionCollisions; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of arrays and lists allocated by this core since it was
+   //    created
+   //
+   //--------------------------------------------------------------------------
+
+   property int AllocationCount
+   {
+      int get () { return allocationCount; }
+   }
+
+private:
+
+   int
+   FindEdgeSlot
+   (
+      long long key
+   );
+
+   void GrowEdgeTable ();
+
+   void GrowOperandTable ();
+
+   void GrowExpressionTable ();
+
+   void CompactRoots ();
+
+private:
+
+   // The current epoch. Table slots stamped with an older epoch are empty,
+   // so Reset does not need to clear the tables.
+
+   int epoch;
+
+   int allocationCount;
+
+   // The number of nodes that have been given a node number
+
+   int nodeCount;
+
+   // The root slots. A removed root leaves a nullptr hole behind until the
+   // slots are compacted; each root node records its own slot index.
+
+   DagNodeList ^ rootSlots;
+
+   int rootHoles;
+
+   // Open-addressing set of connected (parent, child) node number pairs.
+   // A pair is packed as ((parent + 1) << 32) | (child + 1).
+
+   array<long long> ^ edgeKeys;
+
+   array<int> ^ edgeEpochs;
+
+   int edgeCount;
+
+   // The operand table. The entries are kept in insertion order; the
+   // open-addressing slots hold entry index + 1. Entries with equal keys
+   // are told apart by DAG::CompareOperand.
+
+   array<int> ^ operandSlots;
+
+   array<int> ^ operandSlotEpochs;
+
+   array<long long> ^ operandKeys;
+
+   array<Phx::IR::Operand ^> ^ operandLabels;
+
+   array<DagNode ^> ^ operandNodes;
+
+   int operandCount;
+
+   // Open-addressing common expression table. Entries with equal keys
+   // are told apart by NodeKey::Match.
+
+   array<long long> ^ expressionKeys;
+
+   array<DagNode ^> ^ expressionNodes;
+
+   array<int> ^ expressionEpochs;
+
+   int expressionCount;
+
+   long long operandLookups;
+
+   long long operandProbes;
+
+   long long operandCollisions;
+
+   long long expressionLookups;
+
+   long long expressionProbes;
+
+   long long expressionCollisions;
+};
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
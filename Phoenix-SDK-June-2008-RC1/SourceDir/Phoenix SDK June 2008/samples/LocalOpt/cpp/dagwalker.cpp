@@ -25,7 +25,7 @@ namespace LocalOpt
 //
 // Description:
 //
-//    Recursive implementation of a depth-first traverse on the given tree 
+//    Depth-first traverse on the given tree, using an explicit stack
 //
 // Arguments:
 //
@@ -37,9 +37,23 @@ namespace LocalOpt
 //
 // Remarks:
 //
-//    Recursive implementation is easier to understand. However, stack
-//    overflow is possible. Currently it seems OK for the benchmarks we
-//    tested. If the stack overflow does happen, it has to be re-implemented
+//    Each stack entry holds a node, the result of its PreAction and the
+//    index of the next child edge to look at. The walk behaves exactly as
+//    the recursive formulation would: a Stop from any action ends the
+//    whole walk, and a node whose PostAction does not return Continue is
+//    left unvisited for the current pass. Long chains of expressions no
+//    longer risk overflowing the thread stack.
+//
+//    To improve the quality of generated code, we evaluate children edges
+//    in the order of their prioirty. The orderDep edges have the highest 
+//    priority to be evaluated since the current node must be evaluated
+//    after those children node. The assignDep edges have the lowest 
+//    priority since if the current node is a memory node, assignment must
+//    be evaluated after all of its base/index/segment nodes are evaluated.
+//    Value edges are sorted by the height of the toNode of this edge, deeper 
+//    children are evaluated earlier so that better register usage can be
+//    achieved. The DAG keeps every ChildrenList in this order as edges are
+//    added, so the walker does not sort.
 //
 //--------------------------------------------------------------------------
 
@@ -55,90 +69,201 @@ DagWalker::Walk
 
 #endif
 
-   // Initialize the return state to be Continue
+   WalkControl ret1 = this->Enter(dagNode);
 
-   WalkControl ret1 = WalkControl::Continue;
+   if (ret1 == WalkControl::Stop)
+   {
+      // something bad happened
 
-   // do PreAction if it's required 
+      return ret1;
+   }
 
-   if (this->doPreAction)
+   while (this->stackDepth > 0)
    {
-      ret1 = this->PreAction(dagNode);
+      int       top = this->stackDepth - 1;
+      DagNode ^ node = this->stackNodes[top];
 
-      if (ret1 == WalkControl::Stop)
+      ret1 = this->stackControls[top];
+
+      // Find the next child of the top node that still needs to be walked
+
+      DagEdgeList ^ childrenList = node->ChildrenList;
+      DagNode ^     nextChild = nullptr;
+      int           index = this->stackChildren[top];
+
+      while ((nextChild == nullptr) && (index < childrenList->Count))
       {
-         // something bad happened
+         DagEdge ^ edge = childrenList[index++];
 
-         return ret1;
-      }
-   }
+         if ((ret1 == WalkControl::Skip) && (edge->Kind != DagEdgeKind::OrderDep))
+         {
+            // The current node is skipped, we don't need to process the whole
+            // expression subtree. But we still need to evaluate children with
+            // orderDep edges
 
-   // To improve the quality of generated code, we evaluate children edges
-   // in the order of their prioirty. The orderDep edges have the highest 
-   // priority to be evaluated since the current node must be evaluated
-   // after those children node. The assignDep edges have the lowest 
-   // priority since if the current node is a memory node, assignment must
-   // be evaluated after all of its base/index/segment nodes are evaluated.
-   // Value edges are sorted by the height of the toNode of this edge, deeper 
-   // children are evaluated earlier so that better register usage can be
-   // achieved.
+            continue;
+         }
 
-   // Sort the ChildrenList based on their priority value
+         if (edge->ToNode->VisitPass == this->visitPass)
+         {
+            // has been handled by other tree
 
-   dagNode->ChildrenList->Sort();
+            continue;
+         }
 
-   // Evaluate each node in the sorted Children List
+         nextChild = edge->ToNode;
+      }
 
-   for each (DagEdge ^ edge in dagNode->ChildrenList)
-   {
-      DagNode ^ nextChild = edge->ToNode;
+      this->stackChildren[top] = index;
 
-      if ((ret1 == WalkControl::Skip) && (edge->Kind != DagEdgeKind::OrderDep))
+      if (nextChild != nullptr)
       {
-         // The current node is skipped, we don't need to process the whole
-         // expression subtree. But we still need to evaluate children with
-         // orderDep edges
+         if (this->Enter(nextChild) == WalkControl::Stop)
+         {
+            // something bad happened
+
+            this->stackDepth = 0;
+            return WalkControl::Stop;
+         }
 
          continue;
       }
 
-      if (nextChild->VisitPass == currentPass)
+      // All children are done; pop the node and perform postAction if required
+
+      this->stackNodes[top] = nullptr;
+      this->stackDepth--;
+
+      if ((ret1 != WalkControl::Skip) && this->doPostAction)
       {
-         // has been handled by other tree
+         WalkControl ret2 = this->PostAction(node);
 
-         continue;
+         if (ret2 == WalkControl::Stop)
+         {
+            // something bad happened
+
+            this->stackDepth = 0;
+            return ret2;
+         }
+
+         if (ret2 != WalkControl::Continue)
+         {
+            // The node is not finished. Its parent carries on with its other
+            // children; the walked node itself reports the result.
+
+            if (this->stackDepth == 0)
+            {
+               return ret2;
+            }
+
+            continue;
+         }
       }
 
-      WalkControl ret2 = this->Walk(nextChild);
+      // Update the visit pass of the dag node
 
-      if (ret2 == WalkControl::Stop)
-      {
-         // something bad happened
+      node->VisitPass = this->visitPass;
+   }
+
+   return WalkControl::Continue;
+}
 
-         return ret2;
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Walk every tree of the given forest in order, sharing one stack
+//
+// Arguments:
+//
+//    roots - The root nodes to walk
+//
+// Returns:
+//
+//    WalkControl.Stop if the walk of some tree was stopped, otherwise
+//    WalkControl.Continue
+//
+// Remarks:
+//
+//    As with separate calls to Walk, a stopped tree does not prevent the
+//    remaining trees from being walked.
+//
+//--------------------------------------------------------------------------
+
+WalkControl 
+DagWalker::Walk
+(
+   DagNodeList ^ roots
+)
+{
+   WalkControl result = WalkControl::Continue;
+
+   for each (DagNode ^ rootNode in roots)
+   {
+      if (this->Walk(rootNode) == WalkControl::Stop)
+      {
+         result = WalkControl::Stop;
       }
    }
 
-   // Perform postAction if required
+   return result;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Perform the PreAction of the given node and push it on the walk stack
+//
+// Returns:
+//
+//    The result of the PreAction; the node is not pushed if it is Stop
+//
+//--------------------------------------------------------------------------
+
+WalkControl 
+DagWalker::Enter
+(
+   DagNode ^ dagNode
+)
+{
+   // Initialize the return state to be Continue
 
-   if ((ret1 != WalkControl::Skip) && this->doPostAction)
+   WalkControl ret1 = WalkControl::Continue;
+
+   // do PreAction if it's required 
+
+   if (this->doPreAction)
    {
-      ret1 = this->PostAction(dagNode);
+      ret1 = this->PreAction(dagNode);
 
-      if (ret1 != WalkControl::Continue)
+      if (ret1 == WalkControl::Stop)
       {
-         // something bad happened
-
          return ret1;
       }
    }
 
-   // Update the visit pass of the dag node
+   if (this->stackNodes == nullptr)
+   {
+      this->stackNodes = gcnew array<DagNode ^>(32);
+      this->stackControls = gcnew array<WalkControl>(32);
+      this->stackChildren = gcnew array<int>(32);
+   }
+   else if (this->stackDepth == this->stackNodes->Length)
+   {
+      int newLength = this->stackDepth * 2;
 
-   dagNode->VisitPass = currentPass;
+      System::Array::Resize(this->stackNodes, newLength);
+      System::Array::Resize(this->stackControls, newLength);
+      System::Array::Resize(this->stackChildren, newLength);
+   }
 
-   return WalkControl::Continue;
+   this->stackNodes[this->stackDepth] = dagNode;
+   this->stackControls[this->stackDepth] = ret1;
+   this->stackChildren[this->stackDepth] = 0;
+   this->stackDepth++;
 
+   return ret1;
 }
 
 //--------------------------------------------------------------------------
@@ -233,29 +358,23 @@ DagWalker::DoPostAction::set
 //
 // Description:
 //
-//    A static field used to distinguish node is visited by the current pass
-//    from those haven't
-//
-// Remarks:
-// 
-//    We assume the plug-in is used by only one thread at a time. If the 
-//    plug-in is used in a re-entrant style, we need to change this
-//    implementation
+//    The pass number used to distinguish nodes visited by this walk from
+//    those that haven't been
 //
 //--------------------------------------------------------------------------
 
-int DagWalker::CurrentPass::get ()
+int DagWalker::VisitPass::get ()
 {
-   return currentPass;
+   return visitPass;
 }
 
 void 
-DagWalker::CurrentPass::set
+DagWalker::VisitPass::set
 (
    int value
 )
 {
-   currentPass = value;
+   visitPass = value;
 }
 
 //--------------------------------------------------------------------------
@@ -296,7 +415,7 @@ GenCodeWalker::New
    newWalker->theDag = theDag;
    newWalker->baseInstruction = baseInstruction;
 
-   CurrentPass++;
+   newWalker->VisitPass = theDag->NewWalkPass();
 
    return newWalker;
 }
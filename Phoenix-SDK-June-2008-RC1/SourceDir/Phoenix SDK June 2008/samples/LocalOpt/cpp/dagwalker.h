@@ -64,25 +64,30 @@ public:
       DagNode ^ dagNode
    ) ;
 
+   WalkControl 
+   Walk 
+   (
+      DagNodeList ^ roots
+   ) ;
+
    //--------------------------------------------------------------------------
    //
    // Description:
    //
-   //    A static field used to distinguish node is visited by the current pass
-   //    from those haven't
+   //    The pass number used to distinguish nodes visited by this walk
+   //    from those that haven't been
    //
    // Remarks:
-   // 
-   //    We assume the plug-in is used by only one thread at a time. If the 
-   //    plug-in is used in a re-entrant style, we need to change this
-   //    implementation
+   //
+   //    The number comes from the DAG being walked (see DAG::NewWalkPass),
+   //    so walkers of different functions never share it.
    //
    //--------------------------------------------------------------------------
 
-   property int CurrentPass 
+   property int VisitPass 
    {
-      static int get () ;
-      static void set (int value) ;
+      int get () ;
+      void set (int value) ;
    }
 
 protected: 
@@ -125,13 +130,34 @@ protected:
       void set (bool value) ;
    }
 
+private: 
+   
+   WalkControl 
+   Enter 
+   (
+      DagNode ^ dagNode
+   ) ;
+
 private: 
    
    bool doPreAction;
 
    bool doPostAction;
 
-   static int currentPass = 0;
+   int visitPass;
+
+   // The explicit walk stack: the nodes being walked, the result of each
+   // node's PreAction, and the index of each node's next child edge.
+   // Kept for the life of the walker so that walking a forest allocates
+   // the stack only once.
+
+   array<DagNode ^> ^ stackNodes;
+
+   array<WalkControl> ^ stackControls;
+
+   array<int> ^ stackChildren;
+
+   int stackDepth;
 };
 
 //-----------------------------------------------------------------------------
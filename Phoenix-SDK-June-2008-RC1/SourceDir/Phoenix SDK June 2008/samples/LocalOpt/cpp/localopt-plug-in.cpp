@@ -15,6 +15,10 @@
 //    constant folding, CSE, simple scalar promotion and dead code elimination.
 //    The main algorithms are from Section 9.8 of the red dragon compiler book.
 //
+//    The phase builds its flow graph through an AnalysisCache
+//    (common\analysis-cache.h). A flow graph that was not on the unit before
+//    the phase is deleted in the release phase that follows it.
+//
 // Usage:
 //
 //    csc /r:phx.dll /t:library /out:localOpt.dll 
@@ -28,6 +32,33 @@
 //       DeadStore            dead store elimination
 //       DeadExpr             dead expression elimination
 //       ReduceStrength       simple strength reduction e.g. MUL X 4 -> SHL X 2
+//                            and algebraic identities e.g. ADD X 0 -> X
+//       ExtendedBlockCSE     reuse of expressions computed in the only
+//                            predecessor of a block
+//
+//    The localOptBench control times DAG construction on synthetic 10,000
+//    instruction blocks, once for each function compiled, and prints the
+//    results. The function itself is not changed by the benchmark.
+//
+//    The localOptStats control prints, for each function, the number of
+//    DAG tables allocated, the number a fresh DAG per instruction range
+//    would have allocated, and the number of redundant expressions removed
+//    across basic blocks.
+//
+//    The localOptRules control prints, for each function, how often each
+//    constant folding and simplification rule fired.
+//
+//    In debug builds, the localOptHashStats control prints, for each
+//    function, the lookups made in the DAG's operand and expression tables
+//    and how many of them hit a key collision.
+//
+//    The phase can run on c2's compilation threads (the -threads control).
+//    Each function's reports are printed as one block, in source order
+//    whatever the number of threads. The localOptParallelTiming control
+//    prints the time spent in the phase at the end of the compilation.
+//    parallel-speedup.cmd in samples\common measures the speedup of a
+//    -threads:N compilation over a -threads:1 one and prints that line for
+//    both.
 //
 //-----------------------------------------------------------------------------
 
@@ -36,6 +67,7 @@
 #include "utility.h"
 #include "dag.h"
 #include "dagwalker.h"
+#include "rules.h"
 
 namespace Phx
 {
@@ -63,6 +95,12 @@ void Plugin::RegisterObjects ()
    // Register objects for the LocalOptPhase class
 
    LocalOptPhase::StaticInitialize();
+
+   Phx::Samples::AnalysisCache::RegisterObjects(L"localOpt",
+      L"localopt-plug-in.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"localOpt",
+      L"localopt-plug-in.cpp");
 }
 
 //-----------------------------------------------------------------------------
@@ -109,6 +147,8 @@ Plugin::BuildPhases
 
    mirlowerPhase->InsertAfter(phase);
 
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //--------------------------------------------------------------------------
@@ -150,8 +190,9 @@ LocalOptPhase::New
 //
 // Description:
 //
-//    Static initialization for the LocalOptPhase class. Right now, only 
-//    a component control is registered if it's debug build
+//    Static initialization for the LocalOptPhase class. Registers the
+//    report controls, and a component control if it's debug build, and
+//    builds the simplification rule table
 //
 // Returns:
 //
@@ -161,6 +202,24 @@ LocalOptPhase::New
 
 void LocalOptPhase::StaticInitialize ()
 {
+   benchmarkCtrl = Phx::Controls::SetBooleanControl::New(L"localOptBench",
+      L"time DAG construction on synthetic blocks for each function",
+      L"localopt-plug-in.cpp");
+
+   statsCtrl = Phx::Controls::SetBooleanControl::New(L"localOptStats",
+      L"report DAG table allocations and cross-block redundancies",
+      L"localopt-plug-in.cpp");
+
+   rulesCtrl = Phx::Controls::SetBooleanControl::New(L"localOptRules",
+      L"report how often each simplification rule fired for each function",
+      L"localopt-plug-in.cpp");
+
+   groupMemoryCtrl = Phx::Controls::SetBooleanControl::New(L"localOptGroupMemory",
+      L"file DAG memory uses by primary alias tag for kill processing",
+      L"localopt-plug-in.cpp");
+
+   RuleTable::Build();
+
 #if (PHX_DEBUG_CHECKS)
 
    // This control is for debug purpose only. If it is registered, 
@@ -171,6 +230,10 @@ void LocalOptPhase::StaticInitialize ()
       "perform DAG-based local optimizations; called after MIR Lower",
       "localopt-plug-in.cs");
 
+   hashStatsCtrl = Phx::Controls::SetBooleanControl::New(L"localOptHashStats",
+      L"report operand and expression table lookups and key collisions",
+      L"localopt-plug-in.cpp");
+
 #endif // PHX_DEBUG_CHECKS
 }
 
@@ -178,11 +241,13 @@ void LocalOptPhase::StaticInitialize ()
 //
 // Description:
 //
-//    Executes the Local Optimization phase.
+//    Executes the Local Optimization phase on a function.
 //
 // Arguments:
 //
-//    unit - The function unit to be processed
+//    functionUnit - The function unit to be processed
+//    output - The buffer for the function's reports
+//    lifetime - Temporary lifetime for the function, unused
 //
 // Returns:
 // 
@@ -191,40 +256,39 @@ void LocalOptPhase::StaticInitialize ()
 //-----------------------------------------------------------------------------
 
 void
-LocalOptPhase::Execute
+LocalOptPhase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   // check if the input unit is a FunctionUnit
-
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
-
-   Phx::FunctionUnit ^ functionUnit = dynamic_cast<Phx::FunctionUnit ^>(unit);
-
    // check if alias information is ready
 
    if (!functionUnit->AliasInfo->IsComplete)
    {
-      Phx::Output::WriteLine("Alias information has to be collected in"
+      output->AppendLine("Alias information has to be collected in"
          + "order to collect reaching definitions");
 
       return;
    }
 
+   if (benchmarkCtrl->IsEnabled(functionUnit))
+   {
+      Optimization::Benchmark(functionUnit, 10000, output);
+   }
+
    // prepare flow graph for the current phase
 
-   Phx::Graphs::FlowGraph ^ fg = functionUnit->FlowGraph;
+   Phx::Samples::AnalysisCache ^ cache =
+      Phx::Samples::AnalysisCache::Get(functionUnit);
 
    // If a basic block has a handler edge, its temporaries are not killed
    // across the basic block boundary. In this case, we need to construct 
    // the extended basic block first 
 
-   functionUnit->BuildFlowGraph(
-      Phx::Graphs::BlockStyle::IgnoreHandlerEdges);
+   Phx::Graphs::FlowGraph ^ flowGraph =
+      cache->BuildFlowGraph(Phx::Graphs::BlockStyle::IgnoreHandlerEdges);
 
    // Some ExprTmps are live cross basic blocks, which breaks the assumption
    // of the localOpt phase. See Phoenix IR of \benchi\bench.c, simple(), t183
@@ -236,33 +300,32 @@ LocalOptPhase::Execute
 
    Optimization ^ optimizer = Optimization::New(functionUnit);
 
-   // perform local optimization for each basic block
+   optimizer->GroupMemoryByPrimaryTag = groupMemoryCtrl->IsEnabled(functionUnit);
 
-   for each (Phx::Graphs::BasicBlock ^ block in
-      Phx::Graphs::BasicBlock::Iterator(functionUnit->FlowGraph))
-   {
-       // Skip some special flow basic blocks, such as start/end/exit
+   // perform local optimization for each basic block, carrying available
+   // expressions into single-predecessor successors
 
-      if (block->IsStart || block->IsEnd || block->IsExit)
-      {
-         continue;
-      }
+   optimizer->DoExtendedBlocks(flowGraph);
 
-      // Perform dag-based local optimization on the extended basic block
-      // The instruction count is used as a hint to the size of hash tables
-      // in the DAG
+   if (statsCtrl->IsEnabled(functionUnit))
+   {
+      optimizer->ReportAllocations(output);
+   }
 
-      optimizer->DoRange(block->FirstInstruction, block->LastInstruction,
-         ((int)block->InstructionCount));
+   if (rulesCtrl->IsEnabled(functionUnit))
+   {
+      RuleTable::Report(functionUnit, optimizer->RuleCounts, output);
    }
 
-   // delete the flow graph if it does not exist when entering this phase
+#if defined(PHX_DEBUG_CHECKS)
 
-   if (fg == nullptr)
+   if (hashStatsCtrl->IsEnabled(functionUnit))
    {
-      functionUnit->DeleteFlowGraph();
+      optimizer->ReportHashStatistics(output);
    }
 
+#endif
+
    // build expression temporary again to improve quality of register allocation
 
    functionUnit->ExpressionBuilder->Function(functionUnit, false, false, true);
@@ -372,18 +435,38 @@ Optimization::DoRange
    // DAG process, or can be simplify based on the result of the previous
    // DAG analysis. Therefore, we keep a renameMap for this purpose.
 
-   // Create a renameMap to be used by DAG construction
+   // Create a renameMap to be used by DAG construction. It is emptied
+   // after each instruction range, so one map serves the whole function.
 
-   this->renameMap = gcnew OpndToOpndMap(instructionCount);
+   if (this->renameMap == nullptr)
+   {
+      this->renameMap = gcnew OpndToOpndMap(instructionCount);
+   }
+
+   this->blockCount++;
 
    Phx::IR::Instruction ^ guardInstr = endInstruction->Next;
 
    while (startInstruction != guardInstr)
    {
-      // Create a new DAG use the instruction count of the basic block as
-      // its size hint 
+      // Create the DAG workspace for the function the first time, using the
+      // instruction count of the basic block as its size hint. Later ranges
+      // reset it instead of allocating new tables.
+
+      if (this->workspace == nullptr)
+      {
+         this->workspace = DAG::New(this->functionUnit, instructionCount);
+         this->workspace->GroupByPrimaryTag = this->groupMemoryByPrimaryTag;
+         this->allocationsPerDag = this->workspace->AllocationCount;
+      }
+      else
+      {
+         this->workspace->Reset();
+      }
+
+      DAG ^ theDag = this->workspace;
 
-      DAG ^ theDag = DAG::New(this->functionUnit, instructionCount);
+      this->rangeCount++;
 
       // Build DAG structures for the current instruction range
 
@@ -414,6 +497,260 @@ Optimization::DoRange
    }
 }
 
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Perform local optimization on each basic block of the flow graph,
+//    reusing expressions across the edges into single-predecessor blocks
+//
+// Arguments:
+//
+//    flowGraph - The flow graph of the function
+//
+// Returns:
+//
+//    Nothing.
+//
+// Remarks:
+//
+//    The blocks form trees in which every block but the root has its
+//    parent as its only predecessor. Each tree is walked depth first with
+//    an explicit stack. The value table is marked before a block is
+//    processed and undone to the mark when the block's subtree is done,
+//    so a block sees exactly the expressions available along the path
+//    from its root.
+//
+//    Roots are taken in layout order. A second pass picks up the blocks
+//    left over, which are those on a cycle of single-predecessor blocks
+//    that cannot be reached otherwise.
+//
+//--------------------------------------------------------------------------
+
+void
+Optimization::DoExtendedBlocks
+(
+   Phx::Graphs::FlowGraph ^ flowGraph
+)
+{
+   if (this->valueTable == nullptr)
+   {
+      this->valueTable = ValueTable::New(this->functionUnit);
+   }
+
+   int maxBlockId = 0;
+
+   for each (Phx::Graphs::BasicBlock ^ block in
+      Phx::Graphs::BasicBlock::Iterator(flowGraph))
+   {
+      maxBlockId = System::Math::Max(maxBlockId, ((int)block->Id));
+   }
+
+   array<bool> ^ visited = gcnew array<bool>(maxBlockId + 1);
+
+   // The walk stack. A mark of -1 means that the block is still to be
+   // processed; otherwise its subtree is done once the entry is on top
+   // again, and the table is undone to the mark.
+
+   System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^ stackBlocks =
+      gcnew System::Collections::Generic::List<Phx::Graphs::BasicBlock ^>();
+   System::Collections::Generic::List<int> ^ stackMarks =
+      gcnew System::Collections::Generic::List<int>();
+
+   for (int pass = 0; pass < 2; pass++)
+   {
+      for each (Phx::Graphs::BasicBlock ^ root in
+         Phx::Graphs::BasicBlock::Iterator(flowGraph))
+      {
+         if (visited[root->Id] || IsSpecialBlock(root)
+            || ((pass == 0) && ExtendsPredecessor(root)))
+         {
+            continue;
+         }
+
+         visited[root->Id] = true;
+         stackBlocks->Add(root);
+         stackMarks->Add(-1);
+
+         while (stackBlocks->Count > 0)
+         {
+            int                       top = stackBlocks->Count - 1;
+            Phx::Graphs::BasicBlock ^ block = stackBlocks[top];
+
+            if (stackMarks[top] >= 0)
+            {
+               this->valueTable->Undo(stackMarks[top]);
+               stackBlocks->RemoveAt(top);
+               stackMarks->RemoveAt(top);
+               continue;
+            }
+
+            stackMarks[top] = this->valueTable->Mark();
+
+            this->DoBlock(block);
+
+            // The successors are looked at after the block is processed,
+            // since folding its branch may have removed an edge
+
+            for (Phx::Graphs::FlowEdge ^ edge = block->SuccessorEdgeList;
+                 edge != nullptr;
+                 edge = edge->NextSuccessorEdge)
+            {
+               Phx::Graphs::BasicBlock ^ successor = edge->SuccessorNode;
+
+               if (!visited[successor->Id] && !IsSpecialBlock(successor)
+                  && ExtendsPredecessor(successor))
+               {
+                  visited[successor->Id] = true;
+                  stackBlocks->Add(successor);
+                  stackMarks->Add(-1);
+               }
+            }
+         }
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Perform local optimization on the given block, using and extending
+//    the expressions available on entry to it
+//
+// Arguments:
+//
+//    block - The basic block to process
+//
+// Returns:
+//
+//    Nothing.
+//
+// Remarks:
+//
+//    An instruction whose expression is available is replaced by an
+//    assignment from the holding variable before the DAG is built, so
+//    the DAG propagates the copy as usual. The value table is then brought
+//    up to date from the code generated for the block, which is what the
+//    successors will see.
+//
+//--------------------------------------------------------------------------
+
+void
+Optimization::DoBlock
+(
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   // The instructions around the block are not touched by the DAG, so
+   // they delimit the block however its instructions are replaced
+
+   Phx::IR::Instruction ^ before = block->FirstInstruction->Previous;
+   Phx::IR::Instruction ^ after = block->LastInstruction->Next;
+   Phx::IR::Instruction ^ instruction;
+   Phx::IR::Instruction ^ nextInstruction;
+
+   if (this->valueTable->Count > 0)
+   {
+      for (instruction = block->FirstInstruction;
+           instruction != after;
+           instruction = nextInstruction)
+      {
+         nextInstruction = instruction->Next;
+
+         Phx::IR::Operand ^ holder = nullptr;
+
+         if (ValueTable::IsCandidate(instruction))
+         {
+            holder = this->valueTable->Lookup(instruction);
+         }
+
+         if (holder != nullptr)
+         {
+            Phx::IR::Instruction ^ newInstruction =
+               Phx::IR::ValueInstruction::NewUnary(this->functionUnit,
+                  Common::Opcode::Assign, instruction->DestinationOperand, holder);
+
+            newInstruction->DebugTag = instruction->DebugTag;
+            instruction->InsertBefore(newInstruction);
+            instruction->Unlink();
+            instruction = newInstruction;
+
+            this->crossBlockCount++;
+         }
+
+         this->valueTable->Kill(instruction);
+      }
+   }
+
+   Phx::IR::Instruction ^ first = (before != nullptr)
+      ? before->Next : this->functionUnit->FirstInstruction;
+   Phx::IR::Instruction ^ last = (after != nullptr)
+      ? after->Previous : this->functionUnit->LastInstruction;
+
+   // The instruction count is used as a hint to the size of hash tables
+   // in the DAG
+
+   this->DoRange(first, last, ((int)block->InstructionCount));
+
+   first = (before != nullptr) ? before->Next : this->functionUnit->FirstInstruction;
+
+   for (instruction = first; instruction != after; instruction = instruction->Next)
+   {
+      this->valueTable->Kill(instruction);
+      this->valueTable->Insert(instruction);
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether the given block is a start, end or exit block,
+//    which are not optimized
+//
+//--------------------------------------------------------------------------
+
+bool
+Optimization::IsSpecialBlock
+(
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   return (block->IsStart || block->IsEnd || block->IsExit);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether the given block continues the extended basic block
+//    of its predecessor
+//
+// Returns:
+//
+//    True if the block has exactly one predecessor, and that predecessor
+//    is an ordinary block other than the block itself.
+//
+//--------------------------------------------------------------------------
+
+bool
+Optimization::ExtendsPredecessor
+(
+   Phx::Graphs::BasicBlock ^ block
+)
+{
+   if (block->PredecessorCount != 1)
+   {
+      return false;
+   }
+
+   Phx::Graphs::BasicBlock ^ predecessor =
+      block->PredecessorEdgeList->PredecessorNode;
+
+   return ((predecessor != block) && !IsSpecialBlock(predecessor));
+}
+
 //--------------------------------------------------------------------------
 //
 // Description:
@@ -492,6 +829,262 @@ Optimization::BuildDAG
    return instruction;
 }
 
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Print the DAG table allocations made for the current function, and
+//    the redundancies removed across blocks
+//
+// Remarks:
+//
+//    The first figure counts the workspace DAG's tables, including any
+//    growth, plus the rename map. The second is what allocating a new DAG
+//    for every instruction range and a new rename map for every block
+//    would have cost, not counting growth. Then comes the number of
+//    instructions replaced by an expression computed in a predecessor
+//    block, and how many of the DAG's tag overlap queries were answered
+//    by its alias cache.
+//
+//--------------------------------------------------------------------------
+
+void
+Optimization::ReportAllocations
+(
+   System::Text::StringBuilder ^ output
+)
+{
+   int allocations = 0;
+
+   if (this->workspace != nullptr)
+   {
+      allocations += this->workspace->AllocationCount;
+   }
+
+   if (this->renameMap != nullptr)
+   {
+      allocations++;
+   }
+
+   int perRangeAllocations = (this->rangeCount * this->allocationsPerDag)
+      + this->blockCount;
+   int overlapQueries = 0;
+   int overlapHits = 0;
+
+   if (this->workspace != nullptr)
+   {
+      overlapQueries = this->workspace->Aliases->OverlapQueries;
+      overlapHits = this->workspace->Aliases->OverlapHits;
+   }
+
+   output->AppendLine(System::String::Format(
+      "localOptStats {0}: {1} blocks, {2} ranges, {3} tables allocated"
+      + " ({4} with a DAG per range), {5} redundancies removed across blocks,"
+      + " {6} of {7} alias overlap queries cached",
+      gcnew array<System::Object ^> {
+         this->functionUnit->NameString, this->blockCount, this->rangeCount,
+         allocations, perRangeAllocations, this->crossBlockCount,
+         overlapHits, overlapQueries
+      }));
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Print the lookup statistics of the DAG tables for the current function
+//
+// Remarks:
+//
+//    For the operand table and the common expression table, prints the
+//    number of lookups, the average number of slots examined per lookup,
+//    and the number of key collisions: equal 64-bit keys on operands or
+//    nodes that turned out not to match.
+//
+//--------------------------------------------------------------------------
+
+void
+Optimization::ReportHashStatistics
+(
+   System::Text::StringBuilder ^ output
+)
+{
+   if (this->workspace == nullptr)
+   {
+      return;
+   }
+
+   DagCore ^ core = this->workspace->Core;
+
+   output->AppendLine(System::String::Format(
+      "localOptHashStats {0}: operands {1} lookups, {2:F2} probes/lookup,"
+      + " {3} collisions; expressions {4} lookups, {5:F2} probes/lookup,"
+      + " {6} collisions", gcnew array<System::Object ^> {
+         this->functionUnit->NameString,
+         core->OperandLookups,
+         (core->OperandLookups > 0)
+            ? ((double)core->OperandProbes / core->OperandLookups) : 0.0,
+         core->OperandCollisions,
+         core->ExpressionLookups,
+         (core->ExpressionLookups > 0)
+            ? ((double)core->ExpressionProbes / core->ExpressionLookups) : 0.0,
+         core->ExpressionCollisions
+      }));
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Time BuildDAG on synthetic blocks built in the given function and
+//    print the results
+//
+// Arguments:
+//
+//    functionUnit - The function unit to build the blocks in
+//    instructionCount - The number of instructions in each block
+//    output - The buffer the results are appended to
+//
+// Returns:
+//
+//    Nothing.
+//
+// Remarks:
+//
+//    Three block shapes are timed:
+//
+//       chain      t(i) = t(i-1) + 1; a deep DAG whose constant leaf
+//                  gains a parent per instruction
+//       redundant  every other instruction recomputes the previous
+//                  expression, so half of the new nodes are discarded
+//                  as common expressions
+//       wide       t(i) = s(i % 64) + i; many roots that never get a parent
+//
+//    The blocks only use temporaries, so no evaluation order edges are
+//    needed. BuildDAG only reads the instructions, and each block is
+//    unlinked again after it is timed, so the function is left as it
+//    was; the instruction stream is compared against a snapshot taken
+//    beforehand to make sure of it.
+//
+//--------------------------------------------------------------------------
+
+void
+Optimization::Benchmark
+(
+   Phx::FunctionUnit ^           functionUnit,
+   int                           instructionCount,
+   System::Text::StringBuilder ^ output
+)
+{
+   Optimization ^     optimizer = Optimization::New(functionUnit);
+   Phx::Types::Type ^ type = functionUnit->TypeTable->Int32Type;
+
+   System::Collections::Generic::List<Phx::IR::Instruction ^> ^ snapshot =
+      gcnew System::Collections::Generic::List<Phx::IR::Instruction ^>();
+
+   for each (Phx::IR::Instruction ^ instruction in functionUnit->Instructions)
+   {
+      snapshot->Add(instruction);
+   }
+
+   array<System::String ^> ^ shapes = { "chain", "redundant", "wide" };
+
+   for (int shape = 0; shape < shapes->Length; shape++)
+   {
+      bool isRedundant = (shape == 1);
+      bool isWide = (shape == 2);
+
+      array<Phx::IR::Operand ^> ^ seeds = gcnew array<Phx::IR::Operand ^>(64);
+
+      for (int i = 0; i < seeds->Length; i++)
+      {
+         seeds[i] = Phx::IR::VariableOperand::NewTemporary(functionUnit, type);
+      }
+
+      Phx::IR::Instruction ^ firstInstruction = nullptr;
+      Phx::IR::Instruction ^ lastInstruction = nullptr;
+      Phx::IR::Operand ^     previous = seeds[0];
+
+      for (int i = 0; i < instructionCount; i++)
+      {
+         Phx::IR::Operand ^ source1 = previous;
+         Phx::IR::Operand ^ source2 = Phx::IR::ImmediateOperand::New(functionUnit,
+            type, (__int64)1);
+
+         if (isWide)
+         {
+            source1 = seeds[i % seeds->Length];
+            source2 = Phx::IR::ImmediateOperand::New(functionUnit, type, (__int64)i);
+         }
+
+         Phx::IR::Operand ^ dstOperand =
+            Phx::IR::VariableOperand::NewTemporary(functionUnit, type);
+
+         Phx::IR::Instruction ^ instruction = Phx::IR::ValueInstruction::NewBinary(
+            functionUnit, Phx::Common::Opcode::Add, dstOperand, source1, source2);
+
+         functionUnit->LastInstruction->InsertBefore(instruction);
+
+         if (firstInstruction == nullptr)
+         {
+            firstInstruction = instruction;
+         }
+         lastInstruction = instruction;
+
+         if (!isRedundant || ((i % 2) == 1))
+         {
+            previous = instruction->DestinationOperand;
+         }
+      }
+
+      DAG ^ theDag = DAG::New(functionUnit, instructionCount);
+
+      System::Diagnostics::Stopwatch ^ stopwatch =
+         System::Diagnostics::Stopwatch::StartNew();
+
+      optimizer->BuildDAG(theDag, firstInstruction, lastInstruction);
+
+      stopwatch->Stop();
+
+      output->AppendLine(System::String::Format(
+         "localOptBench {0}: {1,-9} {2} instructions, {3} nodes, {4} edges,"
+         + " {5} roots, {6:F2} ms", functionUnit->NameString, shapes[shape],
+         instructionCount, theDag->Core->NodeCount, theDag->Core->EdgeCount,
+         theDag->RootList->Count, stopwatch->Elapsed.TotalMilliseconds));
+
+      Phx::IR::Instruction::Unlink(Phx::IR::InstructionRange(firstInstruction,
+         lastInstruction));
+   }
+
+   // Check that the function's own instructions are back as they were.
+
+   int index = 0;
+
+   for each (Phx::IR::Instruction ^ instruction in functionUnit->Instructions)
+   {
+      if ((index >= snapshot->Count) || (snapshot[index] != instruction))
+      {
+         break;
+      }
+      index++;
+   }
+
+   if ((index != snapshot->Count)
+      || (functionUnit->LastInstruction != snapshot[snapshot->Count - 1]))
+   {
+      output->AppendLine(System::String::Format(
+         "localOptBench {0}: instruction stream changed at instruction {1}",
+         functionUnit->NameString, index));
+
+#if defined(PHX_DEBUG_CHECKS)
+
+      Phx::Asserts::Assert(false,
+         "LocalOpt.Optimization.Benchmark, function left unchanged");
+
+#endif
+   }
+}
+
 //--------------------------------------------------------------------------
 //
 // Description:
@@ -596,14 +1189,9 @@ Optimization::GenCodeFromDag
       this->functionUnit, theDag, startInstruction);
 
    // DAG is a forest. All root nodes are held by the rootlist of the DAG.
-   // Iterate over the rootlist and generate code for each substree.
-
-   for each (DagNode ^ rootNode in theDag->RootList)
-   {
-      // a root node in the DAG, gen code for it
+   // Walk the rootlist in order and generate code for each substree.
 
-      walker->Walk(rootNode);
-   }
+   walker->Walk(theDag->RootList);
 
    // Update the renameMap using the result of the current DAG process
 
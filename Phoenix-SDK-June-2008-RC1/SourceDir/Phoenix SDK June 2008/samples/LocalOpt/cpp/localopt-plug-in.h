@@ -28,12 +28,23 @@
 //       DeadStore            dead store elimination
 //       DeadExpr             dead expression elimination
 //       ReduceStrength       simple strength reduction e.g. MUL X 4 -> SHL X 2
+//
+//    The localOptBench control times DAG construction on synthetic 10,000
+//    instruction blocks, once for each function compiled, and prints the
+//    results. The function itself is not changed by the benchmark.
+//
+//    The localOptStats control prints, for each function, the number of
+//    DAG tables allocated, and the number a fresh DAG per instruction
+//    range would have allocated.
 //    
 //-----------------------------------------------------------------------------
 
 #pragma once
 
+#include "..\..\common\parallel-phase.h"
+#include "..\..\common\analysis-cache.h"
 #include "dag.h"
+#include "valuetable.h"
 
 namespace Phx
 {
@@ -90,11 +101,17 @@ public:
 //    This optimization phase works in a per basic block style. But if a blcok
 //    ends with an instruction with exception handlers, such as calls, we try
 //    to merge it with its next block to form an extended basic block so that
-//    more optimization opportunities can be exploited.
+//    more optimization opportunities can be exploited. Expressions computed
+//    in a block are also reused in the blocks that can only be entered from
+//    it, see Optimization::DoExtendedBlocks.
+//
+//    The phase only changes the function it is handed and keeps no
+//    per-function state in statics, so c2 may run it on several functions
+//    at once; see ParallelFunctionPhase.
 //
 //-----------------------------------------------------------------------------
 
-public ref class LocalOptPhase : Phx::Phases::Phase
+public ref class LocalOptPhase : Phx::Samples::ParallelFunctionPhase
 {
 public:
 
@@ -112,16 +129,44 @@ protected:
 
    // protected methods
 
-   virtual void Execute (Phx::Unit ^ unit) override ;
+   virtual void
+   ExecuteFunction
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
+   ) override;
 
 private:
 
+   // Control that times DAG construction on synthetic blocks
+
+   static Phx::Controls::SetBooleanControl ^ benchmarkCtrl;
+
+   // Control that reports DAG table allocations
+
+   static Phx::Controls::SetBooleanControl ^ statsCtrl;
+
+   // Control that reports how often each simplification rule fired
+
+   static Phx::Controls::SetBooleanControl ^ rulesCtrl;
+
+   // Control that files memory use nodes by primary alias tag, see
+   // DAG::AddGroupNode
+
+   static Phx::Controls::SetBooleanControl ^ groupMemoryCtrl;
+
 #if defined(PHX_DEBUG_CHECKS)
 
    // Component control for debugging purpose only
 
    static Phx::Controls::ComponentControl ^ localOptCompCtrl;
 
+   // Control that reports lookup statistics of the DAG's operand and
+   // expression tables
+
+   static Phx::Controls::SetBooleanControl ^ hashStatsCtrl;
+
 #endif
 
 };
@@ -152,6 +197,12 @@ public:
       int              instructionCount
    );
 
+   void
+   DoExtendedBlocks
+   (
+      Phx::Graphs::FlowGraph ^ flowGraph
+   );
+
    Phx::IR::Instruction ^
    BuildDAG
    (
@@ -166,6 +217,14 @@ public:
       Phx::IR::Instruction ^ instruction
    ) ;
 
+   static void
+   Benchmark
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      int                           instructionCount,
+      System::Text::StringBuilder ^ output
+   );
+
    void
    GenCodeFromDag
    (
@@ -180,8 +239,62 @@ public:
       Phx::IR::Instruction ^ instruction
    );
 
+   void ReportAllocations (System::Text::StringBuilder ^ output);
+
+   void ReportHashStatistics (System::Text::StringBuilder ^ output);
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    How often each simplification rule fired in the function, or
+   //    nullptr if no instruction range was optimized
+   //
+   //--------------------------------------------------------------------------
+
+   property array<int> ^ RuleCounts
+   {
+      array<int> ^ get ()
+      {
+         return (workspace == nullptr) ? nullptr : workspace->RuleCounts;
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Whether the DAG files memory use nodes by primary alias tag. Must
+   //    be set before the first range is optimized.
+   //
+   //--------------------------------------------------------------------------
+
+   property bool GroupMemoryByPrimaryTag
+   {
+      bool get () { return groupMemoryByPrimaryTag; }
+      void set (bool value) { groupMemoryByPrimaryTag = value; }
+   }
+
 private:
 
+   void
+   DoBlock
+   (
+      Phx::Graphs::BasicBlock ^ block
+   );
+
+   static bool
+   IsSpecialBlock
+   (
+      Phx::Graphs::BasicBlock ^ block
+   );
+
+   static bool
+   ExtendsPredecessor
+   (
+      Phx::Graphs::BasicBlock ^ block
+   );
+
    Phx::IR::Operand ^
    ResolveMemOpnd
    (
@@ -205,6 +318,26 @@ private:
 
    OpndToOpndMap ^ renameMap;
 
+   // The DAG reused for every instruction range of the function
+
+   DAG ^ workspace;
+
+   // The expressions available along the current extended basic block path
+
+   ValueTable ^ valueTable;
+
+   bool groupMemoryByPrimaryTag;
+
+   // Counts for the localOptStats report
+
+   int blockCount;
+
+   int rangeCount;
+
+   int allocationsPerDag;
+
+   int crossBlockCount;
+
 };
 
 } // namespace LocalOpt
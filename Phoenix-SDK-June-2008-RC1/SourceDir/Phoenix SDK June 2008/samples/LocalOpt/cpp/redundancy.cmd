@@ -0,0 +1,35 @@
+@ECHO OFF
+:: Syntax: redundancy <path of LocalOpt.dll>
+::
+:: Compiles each Applications\Tests program with the LocalOpt plug-in and
+:: localOptStats enabled, and reports how many redundancies LocalOpt removed
+:: across basic blocks, per program and in total. Those are the ones block
+:: by block CSE misses. Run from an SDK command prompt.
+
+IF "%1"=="" GOTO error
+
+SETLOCAL ENABLEDELAYEDEXPANSION
+
+SET testDir=%~dp0..\..\..\Applications\Tests\src\cpp
+SET outDir=%TEMP%\localopt-redundancy
+IF NOT EXIST %outDir% MKDIR %outDir%
+
+SET total=0
+
+FOR %%f IN ("%testDir%\*.cpp") DO (
+   SET count=0
+   FOR /F "tokens=4 delims=," %%a IN ('cl /nologo /c /O2 /EHsc /Fo"%outDir%\\" -d2plugin:%1 -d2localOptStats "%%f" ^| findstr /C:"localOptStats"') DO (
+      FOR /F "tokens=1" %%n IN ("%%a") DO SET /A count+=%%n
+   )
+   ECHO %%~nxf: !count! redundancies removed across blocks
+   SET /A total+=!count!
+)
+
+ECHO Total: %total% redundancies removed across blocks
+ENDLOCAL
+GOTO exit
+
+:error
+ECHO "Format: redundancy.cmd <path of LocalOpt.dll>"
+
+:exit
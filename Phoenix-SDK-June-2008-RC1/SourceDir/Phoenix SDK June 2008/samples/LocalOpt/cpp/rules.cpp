@@ -0,0 +1,323 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The algebraic simplification rules of the local optimization plug in
+//
+//-----------------------------------------------------------------------------
+
+#include "utility.h"
+#include "rules.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Build the rule table. This is the only place rules are listed.
+//
+// Remarks:
+//
+//    Expressions whose operands are all constant never get here; DAG::Fold
+//    evaluates them first. Only 32-bit integer and pointer expressions are
+//    simplified, so AllOnes means 0xFFFFFFFF.
+//
+//--------------------------------------------------------------------------
+
+void
+RuleTable::Build ()
+{
+   if (rules != nullptr)
+   {
+      return;
+   }
+
+   rules = gcnew System::Collections::Generic::List<SimplifyRule ^>();
+   dispatch = gcnew array<array<SimplifyRule ^> ^>(0);
+
+   foldRule = gcnew SimplifyRule();
+   foldRule->Name = L"OP C1, C2   -> C";
+   foldRule->Rewrite = RuleRewrite::None;
+   foldRule->Index = 0;
+
+   // Strength reduction
+
+   Define(L"MUL X, 2^N  -> SHL X, N", Phx::Common::Opcode::Index::Multiply,
+      RuleTest::PowerOfTwo, true, RuleRewrite::ShiftLeftByLog2);
+   Define(L"DIV X, 2^N  -> SHR X, N", Phx::Common::Opcode::Index::Divide,
+      RuleTest::PowerOfTwo, false, RuleRewrite::ShiftRightByLog2);
+
+   // Identities
+
+   Define(L"ADD X, 0    -> X", Phx::Common::Opcode::Index::Add,
+      RuleTest::Zero, true, RuleRewrite::OtherOperand);
+   Define(L"SUB X, 0    -> X", Phx::Common::Opcode::Index::Subtract,
+      RuleTest::Zero, false, RuleRewrite::OtherOperand);
+   Define(L"MUL X, 1    -> X", Phx::Common::Opcode::Index::Multiply,
+      RuleTest::One, true, RuleRewrite::OtherOperand);
+   Define(L"DIV X, 1    -> X", Phx::Common::Opcode::Index::Divide,
+      RuleTest::One, false, RuleRewrite::OtherOperand);
+   Define(L"SHL X, 0    -> X", Phx::Common::Opcode::Index::ShiftLeft,
+      RuleTest::Zero, false, RuleRewrite::OtherOperand);
+   Define(L"SHR X, 0    -> X", Phx::Common::Opcode::Index::ShiftRight,
+      RuleTest::Zero, false, RuleRewrite::OtherOperand);
+
+   // Masks
+
+   Define(L"AND X, -1   -> X", Phx::Common::Opcode::Index::BitAnd,
+      RuleTest::AllOnes, true, RuleRewrite::OtherOperand);
+   Define(L"OR X, 0     -> X", Phx::Common::Opcode::Index::BitOr,
+      RuleTest::Zero, true, RuleRewrite::OtherOperand);
+   Define(L"XOR X, 0    -> X", Phx::Common::Opcode::Index::BitXor,
+      RuleTest::Zero, true, RuleRewrite::OtherOperand);
+
+   // Annihilators
+
+   Define(L"MUL X, 0    -> 0", Phx::Common::Opcode::Index::Multiply,
+      RuleTest::Zero, true, RuleRewrite::Zero);
+   Define(L"AND X, 0    -> 0", Phx::Common::Opcode::Index::BitAnd,
+      RuleTest::Zero, true, RuleRewrite::Zero);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add a rule to the table and file it under its opcode
+//
+// Arguments:
+//
+//    name - The text printed in the report
+//    opcode - The opcode of the expressions the rule applies to
+//    test - The test on the constant operand
+//    commutative - True if the constant may also be the first operand
+//    rewrite - The rewrite to perform
+//
+//--------------------------------------------------------------------------
+
+void
+RuleTable::Define
+(
+   System::String ^           name,
+   Phx::Common::Opcode::Index opcode,
+   RuleTest                   test,
+   bool                       commutative,
+   RuleRewrite                rewrite
+)
+{
+   SimplifyRule ^ rule = gcnew SimplifyRule();
+
+   rule->Name = name;
+   rule->Opcode = opcode;
+   rule->Test = test;
+   rule->Commutative = commutative;
+   rule->Rewrite = rewrite;
+   rule->Index = rules->Count + 1;
+
+   rules->Add(rule);
+
+   int index = (int)opcode;
+
+   if (index >= dispatch->Length)
+   {
+      System::Array::Resize(dispatch, index + 1);
+   }
+
+   array<SimplifyRule ^> ^ opcodeRules = dispatch[index];
+
+   if (opcodeRules == nullptr)
+   {
+      opcodeRules = gcnew array<SimplifyRule ^>(0);
+   }
+
+   System::Array::Resize(opcodeRules, opcodeRules->Length + 1);
+   opcodeRules[opcodeRules->Length - 1] = rule;
+
+   dispatch[index] = opcodeRules;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether any rule applies to the given opcode
+//
+//--------------------------------------------------------------------------
+
+bool
+RuleTable::HasRules
+(
+   Phx::Common::Opcode::Index opcode
+)
+{
+   int index = (int)opcode;
+
+   return (index >= 0) && (index < dispatch->Length)
+      && (dispatch[index] != nullptr);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the first rule that applies to an expression
+//
+// Arguments:
+//
+//    opcode - The opcode of the expression
+//    constant - The value of its constant operand
+//    constantIsFirst - True if the constant is the first operand
+//
+// Returns:
+//
+//    The rule, or nullptr if no rule applies.
+//
+//--------------------------------------------------------------------------
+
+SimplifyRule ^
+RuleTable::Lookup
+(
+   Phx::Common::Opcode::Index opcode,
+   long long                  constant,
+   bool                       constantIsFirst
+)
+{
+   if (!HasRules(opcode))
+   {
+      return nullptr;
+   }
+
+   for each (SimplifyRule ^ rule in dispatch[(int)opcode])
+   {
+      if (rule->Matches(constant, constantIsFirst))
+      {
+         return rule;
+      }
+   }
+
+   return nullptr;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Allocate a zeroed array with one fire count for every rule
+//
+//--------------------------------------------------------------------------
+
+array<int> ^
+RuleTable::NewCounts ()
+{
+   return gcnew array<int>(rules->Count + 1);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Report how often each rule fired in the given function
+//
+// Arguments:
+//
+//    functionUnit - The function the counts were taken in
+//    counts - The counts, from NewCounts, or nullptr if no DAG was built
+//    output - The buffer the report is appended to
+//
+// Remarks:
+//
+//    Rules that did not fire are listed too, so that the report shows
+//    which rules the code compiled never exercises.
+//
+//--------------------------------------------------------------------------
+
+void
+RuleTable::Report
+(
+   Phx::FunctionUnit ^           functionUnit,
+   array<int> ^                  counts,
+   System::Text::StringBuilder ^ output
+)
+{
+   if (counts == nullptr)
+   {
+      counts = NewCounts();
+   }
+
+   output->AppendLine(System::String::Format("localOptRules {0}:",
+      functionUnit->NameString));
+
+   output->AppendLine(System::String::Format("   {0,-24} {1,6}",
+      foldRule->Name, counts[foldRule->Index]));
+
+   for each (SimplifyRule ^ rule in rules)
+   {
+      output->AppendLine(System::String::Format("   {0,-24} {1,6}",
+         rule->Name, counts[rule->Index]));
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether the rule's test succeeds on the given constant
+//
+// Arguments:
+//
+//    constant - The value of the constant operand
+//    constantIsFirst - True if the constant is the first operand
+//
+// Returns:
+//
+//    True if the rule applies, false otherwise.
+//
+//--------------------------------------------------------------------------
+
+bool
+SimplifyRule::Matches
+(
+   long long constant,
+   bool      constantIsFirst
+)
+{
+   if (constantIsFirst && !this->Commutative)
+   {
+      return false;
+   }
+
+   switch (this->Test)
+   {
+      case RuleTest::Zero:
+
+         return (constant == 0);
+
+      case RuleTest::One:
+
+         return (constant == 1);
+
+      case RuleTest::AllOnes:
+
+         return ((constant & 0xFFFFFFFFLL) == 0xFFFFFFFFLL);
+
+      case RuleTest::PowerOfTwo:
+
+         return (constant > 1) && Phx::Utility::IsPowerOf2(constant);
+   }
+
+   return false;
+}
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
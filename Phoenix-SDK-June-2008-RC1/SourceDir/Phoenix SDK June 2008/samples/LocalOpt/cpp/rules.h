@@ -0,0 +1,187 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The algebraic simplification rules of the local optimization plug in
+//
+// Remarks:
+//
+//    DAG::Simplify looks at binary integer expressions with one constant
+//    operand. Each rule names an opcode, a test on the constant, whether
+//    the constant may be either operand, and the rewrite to perform. The
+//    rules are listed once in RuleTable::Build, which files them under
+//    their opcode, so finding the rules that can apply to an expression
+//    costs one array index.
+//
+//    Every rule, and the constant folding done by DAG::Fold, counts how
+//    often it fires. The rules themselves are shared by all threads and
+//    never change after Build, so the counts live in an array owned by
+//    each DAG and indexed by the rule's Index. The localOptRules control
+//    prints the counts for each function.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The test a rule makes on the constant operand
+//
+//-----------------------------------------------------------------------------
+
+public enum class RuleTest
+{
+   Zero,          // the constant is 0
+   One,           // the constant is 1
+   AllOnes,       // every bit of the 32-bit constant is set
+   PowerOfTwo     // the constant is 2^N with N > 0
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The rewrite a rule performs once its test succeeds
+//
+//-----------------------------------------------------------------------------
+
+public enum class RuleRewrite
+{
+   None,             // the rule only counts; used for constant folding
+   ShiftLeftByLog2,  // OP X, 2^N  -> SHL X, N
+   ShiftRightByLog2, // OP X, 2^N  -> SHR X, N
+   OtherOperand,     // OP X, C    -> X
+   Zero              // OP X, C    -> 0
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    A simplification rule and the number of times it has fired
+//
+//-----------------------------------------------------------------------------
+
+public ref class SimplifyRule
+{
+public:
+
+   bool
+   Matches
+   (
+      long long constant,
+      bool      constantIsFirst
+   );
+
+   // The text printed in the report
+
+   System::String ^ Name;
+
+   Phx::Common::Opcode::Index Opcode;
+
+   RuleTest Test;
+
+   // True if the constant may be the first operand as well as the second
+
+   bool Commutative;
+
+   RuleRewrite Rewrite;
+
+   // The position of the rule's count in an array from RuleTable::NewCounts
+
+   int Index;
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The simplification rules, filed by opcode
+//
+//-----------------------------------------------------------------------------
+
+public ref class RuleTable abstract sealed
+{
+public:
+
+   static void Build ();
+
+   static SimplifyRule ^
+   Lookup
+   (
+      Phx::Common::Opcode::Index opcode,
+      long long                  constant,
+      bool                       constantIsFirst
+   );
+
+   static bool
+   HasRules
+   (
+      Phx::Common::Opcode::Index opcode
+   );
+
+   static array<int> ^ NewCounts ();
+
+   static void
+   Report
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      array<int> ^                  counts,
+      System::Text::StringBuilder ^ output
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The pseudo rule counting the expressions folded to a constant
+   //
+   //--------------------------------------------------------------------------
+
+   static property SimplifyRule ^ FoldRule
+   {
+      SimplifyRule ^ get () { return foldRule; }
+   }
+
+private:
+
+   static void
+   Define
+   (
+      System::String ^           name,
+      Phx::Common::Opcode::Index opcode,
+      RuleTest                   test,
+      bool                       commutative,
+      RuleRewrite                rewrite
+   );
+
+private:
+
+   // All rules, in the order they were defined
+
+   static System::Collections::Generic::List<SimplifyRule ^> ^ rules;
+
+   // The rules of each opcode, indexed by opcode index. Opcodes without
+   // rules have no entry or a nullptr entry.
+
+   static array<array<SimplifyRule ^> ^> ^ dispatch;
+
+   static SimplifyRule ^ foldRule;
+};
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
@@ -0,0 +1,727 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The scoped available expression table of the local optimization plug in
+//
+//-----------------------------------------------------------------------------
+
+#include "localopt-plug-in.h"
+#include "utility.h"
+#include "dag.h"
+#include "valuetable.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Static constructor for a ValueTable.
+//
+// Arguments:
+//
+//    functionUnit - The function unit whose expressions are recorded
+//
+// Returns:
+//
+//    ValueTable object.
+//
+//--------------------------------------------------------------------------
+
+ValueTable ^
+ValueTable::New
+(
+   Phx::FunctionUnit ^ functionUnit
+)
+{
+   ValueTable ^ table = gcnew ValueTable();
+
+   table->aliasInfo = functionUnit->AliasInfo;
+
+   table->entryInstructions = gcnew array<Phx::IR::Instruction ^>(64);
+   table->entryHashes = gcnew array<int>(64);
+   table->entryKilled = gcnew array<bool>(64);
+   table->chainNext = gcnew array<int>(64);
+   table->chainHeads = gcnew array<int>(64);
+   table->undoLog = gcnew System::Collections::Generic::List<int>(64);
+   table->tagEntries = gcnew System::Collections::Generic::Dictionary<int,
+      System::Collections::Generic::List<int> ^>();
+   table->untaggedEntries = gcnew System::Collections::Generic::List<int>();
+
+   return table;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Take a mark of the current state of the table
+//
+// Returns:
+//
+//    The mark to pass to Undo.
+//
+//--------------------------------------------------------------------------
+
+int
+ValueTable::Mark ()
+{
+   return this->undoLog->Count;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Undo all insertions and kills made since the given mark was taken
+//
+// Arguments:
+//
+//    mark - A mark returned by Mark
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::Undo
+(
+   int mark
+)
+{
+   while (this->undoLog->Count > mark)
+   {
+      int last = this->undoLog->Count - 1;
+      int action = this->undoLog[last];
+
+      this->undoLog->RemoveAt(last);
+
+      if (action >= 0)
+      {
+         // Revive a killed entry
+
+         this->entryKilled[action] = false;
+      }
+      else
+      {
+         // Remove the last entry. It is the head of its chain.
+
+         int entry = --this->entryCount;
+         int chain = this->entryHashes[entry] & (this->chainHeads->Length - 1);
+
+         this->UnindexEntry(entry);
+         this->chainHeads[chain] = this->chainNext[entry];
+         this->entryInstructions[entry] = nullptr;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find an available expression computing the same value as the given
+//    instruction
+//
+// Arguments:
+//
+//    instruction - A candidate instruction, see IsCandidate
+//
+// Returns:
+//
+//    The operand holding the value, or nullptr if the expression is not
+//    available.
+//
+//--------------------------------------------------------------------------
+
+Phx::IR::Operand ^
+ValueTable::Lookup
+(
+   Phx::IR::Instruction ^ instruction
+)
+{
+   int hashCode = GetHashCode(instruction);
+   int chain = hashCode & (this->chainHeads->Length - 1);
+
+   // Chain links are entry index + 1, so that zero ends a chain
+
+   for (int link = this->chainHeads[chain];
+        link != 0;
+        link = this->chainNext[link - 1])
+   {
+      int entry = link - 1;
+
+      if (!this->entryKilled[entry] && (this->entryHashes[entry] == hashCode)
+         && Match(this->entryInstructions[entry], instruction))
+      {
+         return this->entryInstructions[entry]->DestinationOperand;
+      }
+   }
+
+   return nullptr;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Record the expression computed by the given instruction
+//
+// Arguments:
+//
+//    instruction - The instruction. It must stay linked for as long as
+//       the entry may be looked up.
+//
+// Remarks:
+//
+//    Only expressions held in a variable that is not an expression
+//    temporary are recorded; expression temporaries do not live across
+//    blocks. An instruction that redefines one of its own sources, like
+//    x = x + 1, does not make its expression available.
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::Insert
+(
+   Phx::IR::Instruction ^ instruction
+)
+{
+   if (!IsCandidate(instruction))
+   {
+      return;
+   }
+
+   Phx::IR::Operand ^ dstOperand = instruction->DestinationOperand;
+
+   if (!dstOperand->IsVariableOperand || dstOperand->IsExpressionTemporary
+      || dstOperand->AsVariableOperand->IsVariableAddress)
+   {
+      return;
+   }
+
+   for each (Phx::IR::Operand ^ srcOperand in instruction->SourceOperands)
+   {
+      if (this->Overlaps(srcOperand, dstOperand))
+      {
+         return;
+      }
+   }
+
+   if (this->entryCount == this->entryInstructions->Length)
+   {
+      this->Grow();
+   }
+
+   int entry = this->entryCount++;
+   int hashCode = GetHashCode(instruction);
+   int chain = hashCode & (this->chainHeads->Length - 1);
+
+   this->entryInstructions[entry] = instruction;
+   this->entryHashes[entry] = hashCode;
+   this->entryKilled[entry] = false;
+   this->chainNext[entry] = this->chainHeads[chain];
+   this->chainHeads[chain] = entry + 1;
+
+   this->IndexEntry(entry);
+   this->undoLog->Add(-1);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Kill every entry whose value might be changed by the destination
+//    operands of the given instruction
+//
+// Arguments:
+//
+//    instruction - The instruction whose destination operands, explicit
+//       and implicit, are killers
+//
+// Remarks:
+//
+//    An entry is killed if a destination may overlap its holding operand
+//    or any of its source operands, including the address operands of
+//    memory sources.
+//
+//    Only the entries indexed under a tag in the may-partial alias set of
+//    the destination are looked at, so a kill costs the size of that set
+//    and the entries found there rather than the size of the table.
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::Kill
+(
+   Phx::IR::Instruction ^ instruction
+)
+{
+   for each (Phx::IR::Operand ^ dstOperand in instruction->DestinationOperands)
+   {
+      int aliasTag = dstOperand->AliasTag;
+
+      if (aliasTag == ((int)Alias::Constants::InvalidTag))
+      {
+         // No alias set to go by; look at every entry
+
+         for (int entry = 0; entry < this->entryCount; entry++)
+         {
+            if (!this->entryKilled[entry] && this->IsKilledBy(entry, dstOperand))
+            {
+               this->entryKilled[entry] = true;
+               this->undoLog->Add(entry);
+            }
+         }
+
+         continue;
+      }
+
+      this->KillTagged(this->untaggedEntries, dstOperand);
+      this->KillTagged(this->GetTagEntries(aliasTag), dstOperand);
+
+      Phx::Alias::MemberPosition memberPosition = Phx::Alias::MemberPosition();
+
+      for (int mayPOTag = this->aliasInfo->GetFirstMayPartialAlias(aliasTag,
+            &memberPosition);
+           mayPOTag != ((int)Alias::Constants::InvalidTag);
+           mayPOTag = this->aliasInfo->GetNextMayPartialAlias(aliasTag, &memberPosition))
+      {
+         this->KillTagged(this->GetTagEntries(mayPOTag), dstOperand);
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Kill the entries of the given index list that a definition of
+//    dstOperand might change
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::KillTagged
+(
+   System::Collections::Generic::List<int> ^ entries,
+   Phx::IR::Operand ^                        dstOperand
+)
+{
+   if (entries == nullptr)
+   {
+      return;
+   }
+
+   for (int index = 0; index < entries->Count; index++)
+   {
+      int entry = entries[index];
+
+      if (!this->entryKilled[entry] && this->IsKilledBy(entry, dstOperand))
+      {
+         this->entryKilled[entry] = true;
+         this->undoLog->Add(entry);
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether a definition of dstOperand might change the value
+//    of the given entry
+//
+//--------------------------------------------------------------------------
+
+bool
+ValueTable::IsKilledBy
+(
+   int                entry,
+   Phx::IR::Operand ^ dstOperand
+)
+{
+   Phx::IR::Instruction ^ entryInstruction = this->entryInstructions[entry];
+
+   if (this->Overlaps(entryInstruction->DestinationOperand, dstOperand))
+   {
+      return true;
+   }
+
+   for each (Phx::IR::Operand ^ srcOperand in entryInstruction->SourceOperands)
+   {
+      if (this->Overlaps(srcOperand, dstOperand))
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the index list of the given alias tag
+//
+// Returns:
+//
+//    The list, or nullptr if no entry has been indexed under the tag.
+//
+//--------------------------------------------------------------------------
+
+System::Collections::Generic::List<int> ^
+ValueTable::GetTagEntries
+(
+   int aliasTag
+)
+{
+   System::Collections::Generic::List<int> ^ entries = nullptr;
+
+   this->tagEntries->TryGetValue(aliasTag, entries);
+
+   return entries;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add the given entry to the index list of the alias tag of its holding
+//    operand and of each of its non-immediate source operands
+//
+// Remarks:
+//
+//    An entry goes into each list once, even when several of its operands
+//    share a tag, so that UnindexEntry can pop it again.
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::IndexEntry
+(
+   int entry
+)
+{
+   Phx::IR::Instruction ^ entryInstruction = this->entryInstructions[entry];
+   Phx::IR::Operand ^     operand = entryInstruction->DestinationOperand;
+   bool                   isDestination = true;
+
+   while (operand != nullptr)
+   {
+      if (!operand->IsImmediateOperand)
+      {
+         int                                       aliasTag = operand->AliasTag;
+         System::Collections::Generic::List<int> ^ entries;
+
+         if (aliasTag == ((int)Alias::Constants::InvalidTag))
+         {
+            entries = this->untaggedEntries;
+         }
+         else
+         {
+            entries = this->GetTagEntries(aliasTag);
+
+            if (entries == nullptr)
+            {
+               entries = gcnew System::Collections::Generic::List<int>();
+               this->tagEntries->Add(aliasTag, entries);
+            }
+         }
+
+         if ((entries->Count == 0) || (entries[entries->Count - 1] != entry))
+         {
+            entries->Add(entry);
+         }
+      }
+
+      if (isDestination)
+      {
+         operand = entryInstruction->SourceOperand;
+         isDestination = false;
+      }
+      else
+      {
+         operand = operand->Next;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Remove the given entry, the last one, from the index lists
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::UnindexEntry
+(
+   int entry
+)
+{
+   Phx::IR::Instruction ^ entryInstruction = this->entryInstructions[entry];
+   Phx::IR::Operand ^     operand = entryInstruction->DestinationOperand;
+   bool                   isDestination = true;
+
+   while (operand != nullptr)
+   {
+      if (!operand->IsImmediateOperand)
+      {
+         int                                       aliasTag = operand->AliasTag;
+         System::Collections::Generic::List<int> ^ entries =
+            (aliasTag == ((int)Alias::Constants::InvalidTag))
+               ? this->untaggedEntries : this->GetTagEntries(aliasTag);
+
+         if ((entries != nullptr) && (entries->Count > 0)
+            && (entries[entries->Count - 1] == entry))
+         {
+            entries->RemoveAt(entries->Count - 1);
+         }
+      }
+
+      if (isDestination)
+      {
+         operand = entryInstruction->SourceOperand;
+         isDestination = false;
+      }
+      else
+      {
+         operand = operand->Next;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether the expression of the given instruction can be
+//    looked up or recorded
+//
+// Arguments:
+//
+//    instruction - The instruction to check
+//
+// Returns:
+//
+//    True for a value instruction without side effects that has one
+//    explicit destination and only explicit variable, memory and
+//    immediate sources; false otherwise.
+//
+//--------------------------------------------------------------------------
+
+bool
+ValueTable::IsCandidate
+(
+   Phx::IR::Instruction ^ instruction
+)
+{
+   if (!instruction->IsValueInstruction || instruction->IsCopy
+      || instruction->HasOpcodeSideEffect
+      || Optimization::IsNotHandled(instruction))
+   {
+      return false;
+   }
+
+   Phx::IR::Operand ^ dstOperand = instruction->DestinationOperand;
+
+   if ((dstOperand == nullptr) || !dstOperand->IsExplicit
+      || (dstOperand->Next != nullptr))
+   {
+      return false;
+   }
+
+   int sourceCount = 0;
+
+   for each (Phx::IR::Operand ^ srcOperand in instruction->SourceOperands)
+   {
+      if (srcOperand->IsAddressModeOperand)
+      {
+         // Compared and hashed as part of its memory operand
+
+         continue;
+      }
+
+      if (!srcOperand->IsExplicit || srcOperand->IsAliasOperand)
+      {
+         return false;
+      }
+
+      if (!srcOperand->IsVariableOperand && !srcOperand->IsMemoryOperand
+         && !srcOperand->IsImmediateOperand)
+      {
+         return false;
+      }
+
+      sourceCount++;
+   }
+
+   return (sourceCount > 0);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Generate a hash code for the expression of the given instruction
+//
+// Remarks:
+//
+//    DAG::GetHashCode only uses the opcode and the source types, since
+//    the DAG tells expressions apart by their source nodes. The table has
+//    no nodes, so the source operands themselves are hashed as well.
+//
+//--------------------------------------------------------------------------
+
+int
+ValueTable::GetHashCode
+(
+   Phx::IR::Instruction ^ instruction
+)
+{
+   int hashCode = DAG::GetHashCode(instruction);
+
+   for each (Phx::IR::Operand ^ srcOperand in instruction->SourceOperands)
+   {
+      if (!srcOperand->IsAddressModeOperand)
+      {
+         hashCode = (hashCode * 31) + DAG::GetHashCode(srcOperand);
+      }
+   }
+
+   return hashCode;
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compare the expressions of two candidate instructions lexically
+//
+// Returns:
+//
+//    True if both compute the same value of the same type, false otherwise
+//
+//--------------------------------------------------------------------------
+
+bool
+ValueTable::Match
+(
+   Phx::IR::Instruction ^ instructionA,
+   Phx::IR::Instruction ^ instructionB
+)
+{
+   if ((instructionA->Opcode != instructionB->Opcode)
+      || (instructionA->DestinationOperand->Type
+         != instructionB->DestinationOperand->Type))
+   {
+      return false;
+   }
+
+   Phx::IR::Operand ^ srcOperandA = instructionA->SourceOperand;
+   Phx::IR::Operand ^ srcOperandB = instructionB->SourceOperand;
+
+   while (true)
+   {
+      while ((srcOperandA != nullptr) && srcOperandA->IsAddressModeOperand)
+      {
+         srcOperandA = srcOperandA->Next;
+      }
+
+      while ((srcOperandB != nullptr) && srcOperandB->IsAddressModeOperand)
+      {
+         srcOperandB = srcOperandB->Next;
+      }
+
+      if ((srcOperandA == nullptr) || (srcOperandB == nullptr))
+      {
+         return (srcOperandA == srcOperandB);
+      }
+
+      if (!DAG::CompareOperand(srcOperandA, srcOperandB))
+      {
+         return false;
+      }
+
+      srcOperandA = srcOperandA->Next;
+      srcOperandB = srcOperandB->Next;
+   }
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determine whether a definition of dstOperand might change the value
+//    of operand
+//
+//--------------------------------------------------------------------------
+
+bool
+ValueTable::Overlaps
+(
+   Phx::IR::Operand ^ operand,
+   Phx::IR::Operand ^ dstOperand
+)
+{
+   if (operand->IsImmediateOperand)
+   {
+      return false;
+   }
+
+   return this->aliasInfo->MayPartiallyOverlap(dstOperand, operand);
+}
+
+//--------------------------------------------------------------------------
+//
+// Description:
+//
+//    Double the entry arrays, and the chain heads once the chains get long
+//
+// Remarks:
+//
+//    Rehashing visits the entries in insertion order, so every entry is
+//    still the head of its chain when it is the last entry.
+//
+//--------------------------------------------------------------------------
+
+void
+ValueTable::Grow ()
+{
+   int capacity = this->entryInstructions->Length * 2;
+
+   System::Array::Resize(this->entryInstructions, capacity);
+   System::Array::Resize(this->entryHashes, capacity);
+   System::Array::Resize(this->entryKilled, capacity);
+   System::Array::Resize(this->chainNext, capacity);
+
+   if (this->entryCount > (this->chainHeads->Length * 2))
+   {
+      this->chainHeads = gcnew array<int>(this->chainHeads->Length * 4);
+
+      int mask = this->chainHeads->Length - 1;
+
+      for (int entry = 0; entry < this->entryCount; entry++)
+      {
+         int chain = this->entryHashes[entry] & mask;
+
+         this->chainNext[entry] = this->chainHeads[chain];
+         this->chainHeads[chain] = entry + 1;
+      }
+   }
+}
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
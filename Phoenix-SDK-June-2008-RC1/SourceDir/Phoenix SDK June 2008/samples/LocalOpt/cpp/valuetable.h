@@ -0,0 +1,183 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    The scoped available expression table of the local optimization plug in.
+//
+// Remarks:
+//
+//    The DAG only sees one basic block at a time. When a block has a single
+//    predecessor, every expression still available at the end of the
+//    predecessor is available on entry to it. The optimizer walks the
+//    trees of such blocks (extended basic blocks) depth first, and this
+//    table carries the expressions computed along the current path of the
+//    walk.
+//
+//    Every change to the table is recorded in an undo log. The walk takes
+//    a mark before it processes a block and undoes to the mark once the
+//    block's subtree is done, so sibling blocks never see each other's
+//    expressions and nothing has to be copied at a branch.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace LocalOpt
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Expressions available along the current extended basic block path,
+//    each held in a variable
+//
+//-----------------------------------------------------------------------------
+
+public ref class ValueTable
+{
+
+public:
+
+   static ValueTable ^
+   New
+   (
+      Phx::FunctionUnit ^ functionUnit
+   );
+
+   int Mark ();
+
+   void Undo (int mark);
+
+   Phx::IR::Operand ^
+   Lookup
+   (
+      Phx::IR::Instruction ^ instruction
+   );
+
+   void
+   Insert
+   (
+      Phx::IR::Instruction ^ instruction
+   );
+
+   void
+   Kill
+   (
+      Phx::IR::Instruction ^ instruction
+   );
+
+   static bool
+   IsCandidate
+   (
+      Phx::IR::Instruction ^ instruction
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The number of entries in the table, including killed ones
+   //
+   //--------------------------------------------------------------------------
+
+   property int Count
+   {
+      int get () { return entryCount; }
+   }
+
+private:
+
+   static int GetHashCode (Phx::IR::Instruction ^ instruction);
+
+   static bool
+   Match
+   (
+      Phx::IR::Instruction ^ instructionA,
+      Phx::IR::Instruction ^ instructionB
+   );
+
+   bool
+   Overlaps
+   (
+      Phx::IR::Operand ^ operand,
+      Phx::IR::Operand ^ dstOperand
+   );
+
+   bool
+   IsKilledBy
+   (
+      int                entry,
+      Phx::IR::Operand ^ dstOperand
+   );
+
+   void
+   KillTagged
+   (
+      System::Collections::Generic::List<int> ^ entries,
+      Phx::IR::Operand ^                        dstOperand
+   );
+
+   System::Collections::Generic::List<int> ^
+   GetTagEntries
+   (
+      int aliasTag
+   );
+
+   void IndexEntry (int entry);
+
+   void UnindexEntry (int entry);
+
+   void Grow ();
+
+private:
+
+   Phx::Alias::Info ^ aliasInfo;
+
+   // The entries, in the order they were inserted. Each entry is the
+   // instruction that computed the expression; its destination operand
+   // holds the value.
+
+   array<Phx::IR::Instruction ^> ^ entryInstructions;
+
+   array<int> ^ entryHashes;
+
+   array<bool> ^ entryKilled;
+
+   int entryCount;
+
+   // Hash chains. A new entry goes to the head of its chain, and entries
+   // are only ever removed from the end, so undoing an insertion simply
+   // pops the head of its chain.
+
+   array<int> ^ chainHeads;
+
+   array<int> ^ chainNext;
+
+   // The undo log. An entry index records a kill; -1 records an insertion.
+
+   System::Collections::Generic::List<int> ^ undoLog;
+
+   // The entries by the alias tag of each operand they depend on, so that
+   // a kill only visits the entries in the may-partial alias set of the
+   // killer. Entries join the end of a list when inserted and are only
+   // removed from the end, like the hash chains. Operands without a valid
+   // tag go to untaggedEntries, which every kill visits.
+
+   System::Collections::Generic::Dictionary<int,
+      System::Collections::Generic::List<int> ^> ^ tagEntries;
+
+   System::Collections::Generic::List<int> ^ untaggedEntries;
+};
+
+} // namespace LocalOpt
+} // namespace Samples
+} // namespace Phx
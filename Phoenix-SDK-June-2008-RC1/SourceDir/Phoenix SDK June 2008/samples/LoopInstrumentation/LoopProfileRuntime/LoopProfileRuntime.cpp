@@ -0,0 +1,205 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Runtime for the profiling mode of the LoopInstrumentation plug-in.
+//
+// Usage:
+//
+//    Compile the program with the plug-in and -loopInstrumentationProfile,
+//    and link it with LoopProfileRuntime.lib.
+//
+// Remarks:
+//
+//    The instrumented code counts loop entries and iterations itself and
+//    only calls in here when it leaves a loop, so nothing is printed until
+//    the process exits. The records are not locked; counts from loops run
+//    on several threads at once may be lost.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "..\cpp\LoopProfile.h"
+
+// The linker sorts the ".lprof$..." sections by the text after the '$', so
+// every record the plug-in emitted lies between these two markers.
+
+#pragma section(".lprof$a", read, write)
+#pragma section(".lprof$z", read, write)
+
+__declspec(allocate(".lprof$a")) LoopProfileRecord LoopProfileFirst = { 0 };
+__declspec(allocate(".lprof$z")) LoopProfileRecord LoopProfileLast = { 0 };
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Record one exit from a loop.
+//
+// Arguments:
+//
+//    record - [in] The loop's record.
+//    trips - [in] The number of times the loop header ran since the loop
+//          was entered.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+extern "C"
+void __cdecl
+LoopProfileExit
+(
+   LoopProfileRecord * record,
+   unsigned int        trips
+)
+{
+   unsigned int bucket = 0;
+
+   for (unsigned int remaining = trips; remaining != 0; remaining >>= 1)
+   {
+      bucket++;
+   }
+
+   if ((record->Exits == 0) || (trips < record->MinTrips))
+   {
+      record->MinTrips = trips;
+   }
+
+   if (trips > record->MaxTrips)
+   {
+      record->MaxTrips = trips;
+   }
+
+   record->Exits++;
+   record->Iterations += trips;
+   record->Buckets[bucket]++;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Print one loop's record and its trip count histogram.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+DumpRecord
+(
+   const LoopProfileRecord * record
+)
+{
+   printf("Loop at %.*s line %u: %u entries, %I64u iterations\n",
+      LOOP_PROFILE_NAME_LENGTH, record->FunctionName, record->Line,
+      record->Entries, record->Iterations);
+
+   if (record->Exits == 0)
+   {
+      printf("   no exits recorded\n");
+
+      return;
+   }
+
+   printf("   trips per entry: min %u, avg %.1f, max %u\n",
+      record->MinTrips,
+      (double) record->Iterations / record->Exits,
+      record->MaxTrips);
+
+   if (record->Entries > record->Exits)
+   {
+      // Exception edges out of the loop are not instrumented.
+
+      printf("   %u exits not recorded\n", record->Entries - record->Exits);
+   }
+
+   for (unsigned int bucket = 0; bucket < LOOP_PROFILE_BUCKETS; bucket++)
+   {
+      if (record->Buckets[bucket] == 0)
+      {
+         continue;
+      }
+
+      unsigned __int64 low = (bucket == 0) ? 0 : (1ui64 << (bucket - 1));
+      unsigned __int64 high = (bucket == 0) ? 0 : ((low << 1) - 1);
+
+      printf("   %10I64u - %10I64u: %u\n", low, high, record->Buckets[bucket]);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Print every loop record in the image. Registered with atexit.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void __cdecl
+DumpProfile()
+{
+   // Step a word at a time through anything that is not a record, since
+   // the linker may pad between the sections of different objects.
+
+   const unsigned int * word = (const unsigned int *) (&LoopProfileFirst + 1);
+   const unsigned int * last = (const unsigned int *) &LoopProfileLast;
+
+   printf("Loop profile\n");
+
+   while (word < last)
+   {
+      if (*word != LOOP_PROFILE_MAGIC)
+      {
+         word++;
+
+         continue;
+      }
+
+      const LoopProfileRecord * record = (const LoopProfileRecord *) word;
+
+      if (record->Entries != 0)
+      {
+         DumpRecord(record);
+      }
+
+      word = (const unsigned int *) (record + 1);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Register DumpProfile with atexit. Called by the C runtime during
+//    startup, through the pointer placed in ".CRT$XCU".
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void __cdecl
+RegisterDumpProfile()
+{
+   atexit(DumpProfile);
+}
+
+#pragma section(".CRT$XCU", read)
+
+__declspec(allocate(".CRT$XCU")) void (__cdecl * LoopProfileInitializer)() =
+   RegisterDumpProfile;
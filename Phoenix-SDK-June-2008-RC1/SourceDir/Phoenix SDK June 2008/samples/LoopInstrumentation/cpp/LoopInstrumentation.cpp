@@ -10,6 +10,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\loop-forest.h"
+#include "LoopProfile.h"
 #include "LoopInstrumentation.h"
 
 namespace LoopInstrumentation
@@ -89,68 +91,61 @@ void Phase::Execute
 
    Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
 
-   flowGraph->BuildDominators();
-
    if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
    {
       functionUnit->Dump();
    }
 
-   // We'll keep track of all loops via their extension objects.
+   // Find all the loops, and describe each with an extension object on its
+   // header, visiting the headers in depth first post order.
 
    System::Collections::Generic::List<LoopExtensionObject ^> ^ loops =
       gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
 
-   // Walk flow graph in depth first post order
-
-   Phx::Graphs::NodeFlowOrder ^ postOrder = 
-      Phx::Graphs::NodeFlowOrder::New(flowGraph->Lifetime);
+   Phx::Samples::LoopForest ^ forest = Phx::Samples::LoopForest::New(flowGraph);
+   Phx::Samples::GraphOrder ^ order = forest->Order;
 
-   postOrder->Build(flowGraph, Phx::Graphs::Order::PostOrder);
-
-   for (unsigned int i = 1; i <= postOrder->NodeCount; ++i)
+   for (int position = order->BlockCount; position >= 1; position--)
    {
-      Phx::Graphs::BasicBlock ^ block = postOrder->Node(i)->AsBasicBlock;
+      Phx::Graphs::BasicBlock ^ block = order->BlockInReversePostorder(position);
+      int                       loopNumber = forest->LoopHeadedBy(block);
 
-      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
+      if (loopNumber == 0)
       {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (block->Dominates(predBlock))
-         {
-            // Do we know about this header already?
-
-            LoopExtensionObject ^ loop = LoopExtensionObject::Get(block);
+         continue;
+      }
 
-            if (loop == nullptr)
-            {
-               // Evidently a new loop... 
-               // Create an extension object to describe it.
+      // Irreducible loops have more than one entry, so they have no single
+      // preheader. Leave them out; the loops nested in them are still
+      // handled.
 
-               loop = gcnew LoopExtensionObject();
-               loop->LoopHeader = block;
-               loop->FunctionUnit = functionUnit;
-               loop->ChildLoops = gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
-               block->AddExtensionObject(loop);
-               loops->Add(loop);
+      if (forest->IsIrreducible(loopNumber))
+      {
+         continue;
+      }
 
-               // Determine extent of the body and gather up nested loops.
+      LoopExtensionObject ^ loop = LoopExtensionObject::New(forest, loopNumber);
+      loop->FunctionUnit = functionUnit;
 
-               this->FindLoopBody(block);
-            }
-         }
-      }
+      block->AddExtensionObject(loop);
+      loops->Add(loop);
    }
 
-   // Determine which loops are top level (they will not have parents)
-   // and compute the loop nesting depth and loop exits.
+   // Now that every loop has its object, link each to the loop around it.
 
    for each (LoopExtensionObject ^ loop in loops)
    {
-      if (loop->ParentLoop == nullptr)
+      int parent = forest->Parent(forest->LoopHeadedBy(loop->LoopHeader));
+
+      while ((parent != 0) && forest->IsIrreducible(parent))
+      {
+         parent = forest->Parent(parent);
+      }
+
+      if (parent != 0)
       {
-         loop->ComputeDepth();
+         loop->ParentLoop = LoopExtensionObject::Get(forest->Header(parent));
+         loop->ParentLoop->ChildLoops->Add(loop);
       }
    }
 
@@ -175,176 +170,46 @@ void Phase::Execute
       edge->FlowGraph->SplitEdge(edge);
    }
 
-   // We need to do this for each module unit... 
-
-   if (this->GlobalEnterStringSymbol == nullptr)
+   if (Phase::ProfileControl->IsEnabled(functionUnit))
    {
-      this->CreateLiteralStrings(functionUnit->ParentModuleUnit);
-   }
-
-   this->ImportLiteralStrings(functionUnit);
+      // Give every loop a counter record in the profile section, in place
+      // of the printf format strings.
 
-   for each (LoopExtensionObject ^ loop in loops)
-   {
-      if (loop->ParentLoop == nullptr)
+      for each (LoopExtensionObject ^ loop in loops)
       {
-         loop->Instrument();
-      }
-   }
+         Phx::Symbols::GlobalVariableSymbol ^ recordSymbol =
+            this->CreateProfileRecord(functionUnit->ParentModuleUnit, loop);
 
-   if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
-   {
-      functionUnit->Dump();
+         loop->ProfileRecordSymbol =
+            Phx::Symbols::NonLocalVariableSymbol::New(functionUnit->SymbolTable, recordSymbol);
+      }
    }
-
-   functionUnit->DeleteFlowGraph();
-}
-
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    FindLoopBody takes a loop header and, for each back-edge to this header,
-//    it collects all nodes reachable backward from the back-edge's source.
-//
-//    In addition it instantiates the ParentLoop and ChildLoops members of the
-//    LoopExtensionObject for the block.
-//    
-// Arguments:
-//
-//    block - [in] A loop header.
-//
-//-----------------------------------------------------------------------------
-
-void Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
-{   
-   // We should have attached an extension.
-
-   LoopExtensionObject ^ loop = LoopExtensionObject::Get(block);
-
-   // We'll use a bit vector to track the membership of blocks 
-   // in the loop body.
-
-   loop->AllLoopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   // The BackEdges bit vector will be used to identify predecessors to
-   // loop headers from outside the loop.
-
-   loop->BackEdges =
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   // Add the header to the loop
-
-   loop->AllLoopBlocks->SetBit(block->Id);
-
-   // We'll use a second bit vector to track the set of blocks whose
-   // predecessors still need to be visited.
-
-   Phx::BitVector::Sparse ^ blocksToVisit = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-      edge != nullptr; edge = edge->NextPredecessorEdge)
+   else
    {
-      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
+      // We need to do this for each module unit... 
 
-      if (block->Dominates(predBlock))
+      if (this->GlobalEnterStringSymbol == nullptr)
       {
-         // Add backedge to set of backedges
-
-         loop->BackEdges->SetBit(edge->Id);
-
-         // Add the backedge source to the loop body.
-
-         loop->AllLoopBlocks->SetBit(predBlock->Id);
-
-         // Add it as a place to start walking from.
-
-         blocksToVisit->SetBit(predBlock->Id);
+         this->CreateLiteralStrings(functionUnit->ParentModuleUnit);
       }
-   }
 
-   // Now perform a reverse graph reachability transitive closure.
+      this->ImportLiteralStrings(functionUnit);
+   }
 
-   while (!blocksToVisit->IsEmpty)
+   for each (LoopExtensionObject ^ loop in loops)
    {
-      Phx::Graphs::BasicBlock ^ blockToVisit = 
-         block->FlowGraph->Block(blocksToVisit->RemoveFirstBit());
-
-      // If this block is itself a loop header, it represents a nested loop.
-
-      LoopExtensionObject ^ nestedLoop = LoopExtensionObject::Get(blockToVisit);
-
-      if (nestedLoop != nullptr)
-      {
-         // It may be indirectly nested -- that is contained in a loop
-         // that the current loop contains. See if we've already determined a parent.
-
-         if (nestedLoop->ParentLoop == nullptr)
-         {
-            // Nope, this is a directly nested loop, so lay claim to it.
-
-            nestedLoop->ParentLoop = loop;
-            loop->ChildLoops->Add(nestedLoop);
-         }
-      }
-
-      for (Phx::Graphs::FlowEdge ^ edge = blockToVisit->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
+      if (loop->ParentLoop == nullptr)
       {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (!loop->AllLoopBlocks->GetBit(predBlock->Id))
-         {
-            // This block is also in the loop.
-
-            loop->AllLoopBlocks->SetBit(predBlock->Id);
-
-            // And we need to check its predecessors
-
-            blocksToVisit->SetBit(predBlock->Id);
-         }
+         loop->Instrument();
       }
    }
-}
-
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    FindLoopExits visits each body block found in its receiver and, if it has
-//    a successor that is not in the loop, its last instruction is recorded as an exit.
-//
-//-----------------------------------------------------------------------------
 
-void LoopExtensionObject::FindLoopExits()
-{
-   // We should have attached an extension.
-
-   LoopExtensionObject ^ loop = this;
-   Phx::Graphs::BasicBlock ^ block = loop->LoopHeader;
-
-   // Find the set of exit blocks...
-
-   loop->ExitLoopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   for each (unsigned int blockId in loop->AllLoopBlocks)
+   if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
    {
-      Phx::Graphs::BasicBlock ^ loopBlock = block->FlowGraph->Block(blockId);
-
-      for (Phx::Graphs::FlowEdge ^ edge = loopBlock->SuccessorEdgeList; 
-         edge != nullptr; edge = edge->NextSuccessorEdge)
-      {
-         Phx::Graphs::BasicBlock ^ successorBlock = edge->SuccessorNode;
-
-         if (!loop->AllLoopBlocks->GetBit(successorBlock->Id))
-         {
-            loop->ExitLoopBlocks->SetBit(loopBlock->Id);
-         }
-      }
+      functionUnit->Dump();
    }
+
+   functionUnit->DeleteFlowGraph();
 }
 
 //-----------------------------------------------------------------------------
@@ -369,6 +234,11 @@ void LoopExtensionObject::FindLoopExits()
 void
    PlugIn::RegisterObjects()
 {
+   Phase::ProfileControl =
+      Phx::Controls::SetBooleanControl::New(L"loopInstrumentationProfile",
+      L"Count loop entries and trips in a data section instead of printing, "
+      L"and print a trip count histogram at exit (link with LoopProfileRuntime.lib)",
+      L"LoopInstrumentation.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -447,6 +317,55 @@ System::String^ PlugIn::NameString::get()
    return L"LoopInstrumentation";
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create the LoopExtensionObject describing one loop of a loop forest.
+//
+// Remarks:
+//
+//    The forest has already found the blocks, exits and depth of the loop;
+//    the object keeps them as bit vectors. ParentLoop and ChildLoops are
+//    set by the caller once every loop has its object.
+//
+//-----------------------------------------------------------------------------
+
+LoopExtensionObject ^
+LoopExtensionObject::New
+(
+   Phx::Samples::LoopForest ^ forest,
+   int                        loopNumber
+)
+{
+   LoopExtensionObject ^     loop = gcnew LoopExtensionObject();
+   Phx::Graphs::BasicBlock ^ header = forest->Header(loopNumber);
+   Phx::Lifetime ^           lifetime = header->Graph->Lifetime;
+
+   loop->LoopHeader = header;
+   loop->ChildLoops = gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
+   loop->AllLoopBlocks = forest->GetBlocks(loopNumber, lifetime);
+   loop->ExclusiveLoopBlocks = forest->GetExclusiveBlocks(loopNumber, lifetime);
+   loop->ExitLoopBlocks = forest->GetExitBlocks(loopNumber, lifetime);
+   loop->LoopDepth = forest->Depth(loopNumber) - 1;
+   loop->IsIrreducible = forest->IsIrreducible(loopNumber);
+
+   // The back edges are the edges into the header from inside the loop.
+
+   loop->BackEdges = Phx::BitVector::Sparse::New(lifetime);
+
+   for (Phx::Graphs::FlowEdge ^ edge = header->PredecessorEdgeList; 
+      edge != nullptr; edge = edge->NextPredecessorEdge)
+   {
+      if (forest->IsBackEdge(edge))
+      {
+         loop->BackEdges->SetBit(edge->Id);
+      }
+   }
+
+   return loop;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -515,46 +434,6 @@ void LoopExtensionObject::DescribeAll()
    }
 }
 
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    Visit loop descriptors in depth-first order, compute depths in pre-order,
-//    and perform //    set operations to compute inclusive and exclusive sets
-//    of body blocks.
-//
-//-----------------------------------------------------------------------------
-
-void LoopExtensionObject::ComputeDepth()
-{
-   // Compute depth top-down.
-
-   if (this->ParentLoop == nullptr)
-   {
-      this->LoopDepth = 0;
-   }
-   else
-   {
-      this->LoopDepth = this->ParentLoop->LoopDepth + 1;
-   }
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      child->ComputeDepth();
-   }
-
-   // Compute exclusive blocks bottom up.
-
-   this->ExclusiveLoopBlocks = this->AllLoopBlocks->Copy();
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      this->ExclusiveLoopBlocks->Minus(child->AllLoopBlocks);
-   }
-
-   this->FindLoopExits();
-}
-
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -693,6 +572,94 @@ void LoopExtensionObject::Instrument()
    this->LoopCounterSymbol = Phx::Symbols::LocalVariableSymbol::NewAuto(symbolTable, 
       0, loopCounterPhxName, typeTable->Int32Type);
 
+   if (this->ProfileRecordSymbol != nullptr)
+   {
+      this->CreateProfileExitSymbol();
+   }
+   else
+   {
+      this->CreatePrintfSymbol();
+   }
+
+   // Instrument preheaders, body, and postexits.
+
+   for (Phx::Graphs::FlowEdge ^ edge = this->LoopHeader->PredecessorEdgeList; 
+      edge != nullptr; 
+      edge = edge->NextPredecessorEdge)
+   {
+      if (this->BackEdges->GetBit(edge->Id))
+      {
+         continue;
+      }
+
+      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
+
+      if (this->ProfileRecordSymbol != nullptr)
+      {
+         this->ProfilePreheader(predBlock);
+      }
+      else
+      {
+         this->InstrumentPreheader(predBlock);
+      }
+   }
+
+   this->InstrumentBody(this->LoopHeader);
+
+   for each (unsigned int blockId in this->ExitLoopBlocks)
+   {
+      Phx::Graphs::BasicBlock ^ loopBlock = this->FunctionUnit->FlowGraph->Block(blockId);
+
+      for (Phx::Graphs::FlowEdge ^ edge = loopBlock->SuccessorEdgeList; 
+         edge != nullptr; edge = edge->NextSuccessorEdge)
+      {
+
+         // Continue if this successor edge isn't the loop exit itself
+
+         if (this->AllLoopBlocks->GetBit(edge->SuccessorNode->Id))
+         {
+            continue;
+         }
+
+         // If it's an exception edge, then we won't instrument this exit.
+
+         if (edge->IsException)
+         {
+            continue;
+         }
+
+         if (this->ProfileRecordSymbol != nullptr)
+         {
+            this->ProfilePostexit(edge->SuccessorNode);
+         }
+         else
+         {
+            this->InstrumentPostexit(edge->SuccessorNode);
+         }
+      }
+   }
+
+   // Instrument any nested loops.
+
+   for each(LoopExtensionObject ^ child in this->ChildLoops)
+   {
+      child->Instrument();
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create the symbol for printf, which prints the entry and exit messages.
+//    
+//-----------------------------------------------------------------------------
+
+void LoopExtensionObject::CreatePrintfSymbol()
+{
+   Phx::FunctionUnit ^ functionUnit = this->FunctionUnit;
+   Phx::Types::Table ^ typeTable = functionUnit->TypeTable;
+
    // Create the symbol for printf
    //
    //    int __cdecl printf(const char *, ...);
@@ -736,57 +703,49 @@ void LoopExtensionObject::Instrument()
    this->PrintfSymbol = Phx::Symbols::FunctionSymbol::New(
       functionUnit->ParentModuleUnit->SymbolTable, 0, printfName, printfType,
       Phx::Symbols::Visibility::GlobalReference);
+}
 
-   // Instrument preheaders, body, and postexits.
-
-   for (Phx::Graphs::FlowEdge ^ edge = this->LoopHeader->PredecessorEdgeList; 
-      edge != nullptr; 
-      edge = edge->NextPredecessorEdge)
-   {
-      if (this->BackEdges->GetBit(edge->Id))
-      {
-         continue;
-      }
-
-      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-      this->InstrumentPreheader(predBlock);
-   }
-
-   this->InstrumentBody(this->LoopHeader);
-
-   for each (unsigned int blockId in this->ExitLoopBlocks)
-   {
-      Phx::Graphs::BasicBlock ^ loopBlock = this->FunctionUnit->FlowGraph->Block(blockId);
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create the symbol for the runtime routine that records a loop exit.
+//
+// Remarks:
+//
+//    The routine is defined in LoopProfileRuntime.cpp:
+//
+//       void __cdecl LoopProfileExit(LoopProfileRecord *, unsigned int);
+//    
+//-----------------------------------------------------------------------------
 
-      for (Phx::Graphs::FlowEdge ^ edge = loopBlock->SuccessorEdgeList; 
-         edge != nullptr; edge = edge->NextSuccessorEdge)
-      {
+void LoopExtensionObject::CreateProfileExitSymbol()
+{
+   Phx::FunctionUnit ^ functionUnit = this->FunctionUnit;
+   Phx::Types::Table ^ typeTable = functionUnit->TypeTable;
 
-         // Continue if this successor edge isn't the loop exit itself
+   Phx::Types::FunctionTypeBuilder ^ functionTypeBuilder =
+      Phx::Types::FunctionTypeBuilder::New(typeTable);
 
-         if (this->AllLoopBlocks->GetBit(edge->SuccessorNode->Id))
-         {
-            continue;
-         }
+   functionTypeBuilder->Begin();
+   functionTypeBuilder->CallingConventionKind =
+      Phx::Types::CallingConventionKind::CDecl;
+   functionTypeBuilder->AppendReturnParameter(typeTable->VoidType);
 
-         // If it's an exception edge, then we won't instrument this exit.
+   Phx::Types::Type ^ ptrToRecordType = Phx::Types::PointerType::New(typeTable,
+      Phx::Types::PointerTypeKind::UnmanagedPointer, typeTable->NativePointerBitSize,
+      typeTable->UInt32Type, nullptr);
 
-         if (edge->IsException)
-         {
-            continue;
-         }
+   functionTypeBuilder->AppendParameter(ptrToRecordType);
+   functionTypeBuilder->AppendParameter(this->LoopCounterSymbol->Type);
 
-         this->InstrumentPostexit(edge->SuccessorNode);
-      }
-   }
+   Phx::Types::FunctionType ^ profileExitType = functionTypeBuilder->GetFunctionType();
 
-   // Instrument any nested loops.
+   Phx::Name profileExitName = Phx::Name::New(functionUnit->Lifetime, "_LoopProfileExit");
 
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      child->Instrument();
-   }
+   this->ProfileExitSymbol = Phx::Symbols::FunctionSymbol::New(
+      functionUnit->ParentModuleUnit->SymbolTable, 0, profileExitName, profileExitType,
+      Phx::Symbols::Visibility::GlobalReference);
 }
 
 //-----------------------------------------------------------------------------
@@ -923,6 +882,123 @@ Phx::Symbols::GlobalVariableSymbol ^
    return stringSym;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the section that holds the LoopProfileRecords of the module,
+//    creating it the first time the module asks.
+//
+// Remarks: 
+//
+//    The linker places the ".lprof$m" sections of all objects between the
+//    markers LoopProfileRuntime defines in ".lprof$a" and ".lprof$z", which
+//    is how the runtime finds the records at exit.
+//
+//    The section symbol belongs to the module's symbol table, so one phase
+//    object compiling several modules keeps a section for each.
+//    
+//-----------------------------------------------------------------------------
+
+Phx::Symbols::SectionSymbol ^ Phase::GetProfileSection(Phx::ModuleUnit ^ moduleUnit)
+{
+   Phx::Symbols::SectionSymbol ^ profileSectSym;
+
+   if (Phase::profileSectionSymbols == nullptr)
+   {
+      Phase::profileSectionSymbols = gcnew System::Collections::Generic::Dictionary<
+         Phx::ModuleUnit ^, Phx::Symbols::SectionSymbol ^>();
+   }
+   else if (Phase::profileSectionSymbols->TryGetValue(moduleUnit, profileSectSym))
+   {
+      return profileSectSym;
+   }
+
+   profileSectSym = Phx::Symbols::SectionSymbol::New(
+      moduleUnit->SymbolTable, 0, Phx::Name::New(moduleUnit->Lifetime, ".lprof$m"));
+
+   // The counters are updated in place, so unlike the strings the section
+   // is writable. Iterations is 64 bits wide, so align to 8 bytes.
+
+   profileSectSym->IsReadable = true;
+   profileSectSym->IsWritable = true;
+   profileSectSym->IsInitialize = true;
+   profileSectSym->Alignment = Phx::Alignment(Phx::Alignment::Kind::AlignTo8Bytes);
+
+   profileSectSym->Section = Phx::Coff::Section::New(profileSectSym);
+
+   Phase::profileSectionSymbols->Add(moduleUnit, profileSectSym);
+
+   return profileSectSym;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create the LoopProfileRecord for a loop.
+//
+// Remarks: 
+//
+//    The record starts out zero apart from the fields that identify the
+//    loop to the runtime: its magic number, line and function name.
+//    
+//-----------------------------------------------------------------------------
+
+Phx::Symbols::GlobalVariableSymbol ^
+   Phase::CreateProfileRecord
+   (
+   Phx::ModuleUnit ^ moduleUnit,
+   LoopExtensionObject ^ loop
+   )
+{
+   Phx::Types::Table ^ typeTable = moduleUnit->TypeTable;
+   Phx::Symbols::Table ^ symbolTable = moduleUnit->SymbolTable;
+   Phx::FunctionUnit ^ functionUnit = loop->FunctionUnit;
+
+   LoopProfileRecord record = { 0 };
+
+   record.Magic = LOOP_PROFILE_MAGIC;
+   record.Line = functionUnit->DebugInfo->GetLineNumber(loop->LoopHeader->FirstInstruction->DebugTag);
+
+   System::String ^ functionName = Phx::Utility::Undecorate(functionUnit->NameString, false);
+
+   for (int i = 0; (i < functionName->Length) && (i < LOOP_PROFILE_NAME_LENGTH); i++)
+   {
+      record.FunctionName[i] = (char) functionName->default[i];
+   }
+
+   Phx::Name recordName = Phx::Name::New(moduleUnit->Lifetime,
+      System::String::Format("$LP{0}", Phase::profileRecordCount++));
+
+   Phx::Types::Type ^ recordType =
+      Phx::Types::UnmanagedArrayType::New(typeTable, 
+      Phx::Utility::BytesToBits(sizeof(LoopProfileRecord)),
+      nullptr, typeTable->UInt32Type);
+
+   Phx::Symbols::GlobalVariableSymbol ^ recordSym =
+      Phx::Symbols::GlobalVariableSymbol::New(symbolTable, 
+      symbolTable->ExternIdMap->AllocateId(),
+      recordName, recordType, Phx::Symbols::Visibility::File);
+
+   Phx::Symbols::SectionSymbol ^ profileSectSym = this->GetProfileSection(moduleUnit);
+
+   recordSym->AllocationBaseSectionSymbol = profileSectSym;
+   recordSym->Alignment = Phx::Alignment(Phx::Alignment::Kind::AlignTo8Bytes);
+
+   Phx::Section ^ profileSection = profileSectSym->Section;
+
+   Phx::IR::DataInstruction ^ recordInstr =
+      Phx::IR::DataInstruction::New(profileSection->DataUnit, sizeof(LoopProfileRecord));
+
+   recordInstr->WriteBytes(0, reinterpret_cast<unsigned char *>(&record), 
+      sizeof(LoopProfileRecord));
+   profileSection->AppendInstruction(recordInstr);
+   recordSym->Location = Phx::Symbols::DataLocation::New(recordInstr);
+
+   return recordSym;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -951,8 +1027,19 @@ void LoopExtensionObject::InstrumentPreheader(Phx::Graphs::BasicBlock ^ block)
    block->LastInstruction->InsertBefore(callInstruction);
    callInstruction->DebugTag = block->LastInstruction->DebugTag;
 
-   // Initialize the loop counter to zero.
+   this->InitializeCounter(block);
+}
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Generate IR for initializing the loop counter to zero.
+//
+//-----------------------------------------------------------------------------
+
+void LoopExtensionObject::InitializeCounter(Phx::Graphs::BasicBlock ^ block)
+{
    Phx::IR::Operand ^ loopCounter = Phx::IR::VariableOperand::New(this->FunctionUnit, this->LoopCounterSymbol->Type, this->LoopCounterSymbol);
    Phx::IR::Operand ^ zero = Phx::IR::ImmediateOperand::New(this->FunctionUnit, this->LoopCounterSymbol->Type, 0LL);
    Phx::IR::Instruction ^ assignInstruction = Phx::IR::ValueInstruction::NewUnary(this->FunctionUnit, Phx::Common::Opcode::Assign, loopCounter, zero);
@@ -1017,4 +1104,96 @@ void LoopExtensionObject::InstrumentPostexit(Phx::Graphs::BasicBlock ^ block)
    callInstruction->DebugTag = block->FirstInstruction->DebugTag;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Generate IR for counting an entry in the loop's profile record and
+//    initializing the loop counter to zero.
+//
+// Remarks: 
+//
+//    Unlike InstrumentPreheader, this makes no call.
+//
+//-----------------------------------------------------------------------------
+
+void LoopExtensionObject::ProfilePreheader(Phx::Graphs::BasicBlock ^ block)
+{
+   // record.Entries = record.Entries + 1
+
+   unsigned int entriesOffset = offsetof(LoopProfileRecord, Entries);
+
+   Phx::IR::Operand ^ entries = this->ProfileFieldOperand(entriesOffset);
+   Phx::IR::Operand ^ one = Phx::IR::ImmediateOperand::New(this->FunctionUnit, entries->Type, 1LL);
+   Phx::IR::Instruction ^ incrementInstruction = Phx::IR::ValueInstruction::NewBinary(this->FunctionUnit, 
+      Phx::Common::Opcode::Add, entries, this->ProfileFieldOperand(entriesOffset), one);
+
+   block->LastInstruction->InsertBefore(incrementInstruction);
+   incrementInstruction->DebugTag = block->LastInstruction->DebugTag;
+
+   this->InitializeCounter(block);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Generate IR for recording the trip count in the loop's profile record.
+//
+// Remarks: 
+//
+//    The call happens once per exit from the loop, not once per iteration;
+//    the runtime only updates the record, and prints nothing until the
+//    process exits.
+//
+//-----------------------------------------------------------------------------
+
+void LoopExtensionObject::ProfilePostexit(Phx::Graphs::BasicBlock ^ block)
+{
+   // LoopProfileExit(&record, loopCount);
+
+   Phx::IR::Operand ^ recordOperand = Phx::IR::VariableOperand::New(this->FunctionUnit, 
+      this->FunctionUnit->TypeTable->UInt32Type, this->ProfileRecordSymbol);
+   recordOperand->ChangeToAddress();
+
+   Phx::IR::Operand ^ loopCounterOperand = Phx::IR::VariableOperand::New(this->FunctionUnit, 
+      this->LoopCounterSymbol->Type, this->LoopCounterSymbol);
+
+   Phx::IR::Instruction ^ callInstruction = Phx::IR::CallInstruction::New(this->FunctionUnit, Phx::Common::Opcode::Call, this->ProfileExitSymbol);
+   callInstruction->AppendSource(recordOperand);
+   callInstruction->AppendSource(loopCounterOperand);
+
+   block->FirstInstruction->InsertAfter(callInstruction);
+   callInstruction->DebugTag = block->FirstInstruction->DebugTag;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create an operand for a 32 bit field of the loop's profile record.
+//
+// Arguments:
+//
+//    byteOffset - [in] Offset of the field in LoopProfileRecord.
+//
+// Remarks: 
+//
+//    Nothing but the runtime refers to the record, so the memory is not
+//    aliased by the program.
+//
+//-----------------------------------------------------------------------------
+
+Phx::IR::Operand ^ LoopExtensionObject::ProfileFieldOperand(unsigned int byteOffset)
+{
+   Phx::FunctionUnit ^ functionUnit = this->FunctionUnit;
+   Phx::Types::Type ^ fieldType = functionUnit->TypeTable->UInt32Type;
+
+   return Phx::IR::MemoryOperand::New(functionUnit, fieldType, 
+      this->ProfileRecordSymbol, nullptr, byteOffset, 
+      Phx::Alignment::NaturalAlignment(fieldType),
+      functionUnit->AliasInfo->NotAliasedMemoryTag,
+      functionUnit->SafetyInfo->SafeTag);
+}
+
 }
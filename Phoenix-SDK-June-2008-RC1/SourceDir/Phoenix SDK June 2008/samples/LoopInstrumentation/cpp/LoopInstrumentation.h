@@ -13,6 +13,8 @@
 namespace LoopInstrumentation
 {
 
+ref class LoopExtensionObject;
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -48,6 +50,10 @@ protected:
       Phx::Unit ^ unit
    ) override;
 
+public:
+
+   static Phx::Controls::SetBooleanControl ^ ProfileControl;
+
 #if defined (PHX_DEBUG_SUPPORT)
 
 public:
@@ -64,8 +70,6 @@ public:
 
 private:
 
-   void FindLoopBody(Phx::Graphs::BasicBlock ^ block);
-
    property Phx::BitVector::Sparse ^ TopLevelLoops;
    
    Phx::Symbols::GlobalVariableSymbol ^ CreateInitializedString
@@ -78,6 +82,21 @@ private:
 
    void CreateLiteralStrings(Phx::ModuleUnit ^ moduleUnit);
    void ImportLiteralStrings(Phx::FunctionUnit ^ functionUnit);
+
+   Phx::Symbols::SectionSymbol ^ GetProfileSection(Phx::ModuleUnit ^ moduleUnit);
+
+   Phx::Symbols::GlobalVariableSymbol ^ CreateProfileRecord
+   (
+      Phx::ModuleUnit ^ moduleUnit,
+      LoopExtensionObject ^ loop
+   );
+
+   static unsigned int profileRecordCount;
+
+   // The profile section of each module unit instrumented so far
+
+   static System::Collections::Generic::Dictionary<Phx::ModuleUnit ^,
+      Phx::Symbols::SectionSymbol ^> ^ profileSectionSymbols;
 };
 
 //-----------------------------------------------------------------------------
@@ -133,6 +152,15 @@ public ref class LoopExtensionObject : Phx::Graphs::NodeExtensionObject
 {
 public:
 
+   // Create the object describing a loop of a loop forest.
+
+   static LoopExtensionObject ^
+   New
+   (
+      Phx::Samples::LoopForest ^ forest,
+      int                        loopNumber
+   );
+
    // Return associated extension object.
 
    static LoopExtensionObject ^
@@ -145,14 +173,18 @@ public:
 
    void Describe();
    void DescribeAll();
-   void ComputeDepth();
-   void FindLoopExits();
    System::Collections::Generic::List<Phx::Graphs::FlowEdge ^> ^
    DetermineEdgesToSplit();
    void Instrument();
+   void CreatePrintfSymbol();
+   void CreateProfileExitSymbol();
    void InstrumentPreheader(Phx::Graphs::BasicBlock ^ block);
    void InstrumentBody(Phx::Graphs::BasicBlock ^ block);
    void InstrumentPostexit(Phx::Graphs::BasicBlock ^ block);
+   void InitializeCounter(Phx::Graphs::BasicBlock ^ block);
+   void ProfilePreheader(Phx::Graphs::BasicBlock ^ block);
+   void ProfilePostexit(Phx::Graphs::BasicBlock ^ block);
+   Phx::IR::Operand ^ ProfileFieldOperand(unsigned int byteOffset);
 
    // Data of interest
 
@@ -170,11 +202,19 @@ public:
 
    property unsigned int LoopDepth;
 
+   property bool IsIrreducible;
+
    property System::String ^ LoopName;
    property System::String ^ LoopCounterName;
    property Phx::Symbols::LocalVariableSymbol ^ LoopCounterSymbol;
    property Phx::Symbols::FunctionSymbol ^ PrintfSymbol;
 
+   // Profiling mode only: the loop's LoopProfileRecord, and the runtime
+   // routine that records each exit.
+
+   property Phx::Symbols::NonLocalVariableSymbol ^ ProfileRecordSymbol;
+   property Phx::Symbols::FunctionSymbol ^ ProfileExitSymbol;
+
 private:
 
    static unsigned int id;
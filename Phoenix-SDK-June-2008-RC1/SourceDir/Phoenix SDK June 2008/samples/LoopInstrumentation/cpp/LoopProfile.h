@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//   Loop profile records
+//
+// Remarks:
+//
+//    In profiling mode the LoopInstrumentation plug-in allocates one
+//    LoopProfileRecord per loop in the ".lprof$m" section of the object it
+//    compiles, and the instrumented code updates it in place:
+//
+//       Entries - incremented inline at every preheader.
+//       Exits, Iterations, MinTrips, MaxTrips, Buckets - updated by
+//          LoopProfileExit, called with the trip count at every post exit.
+//
+//    The linker merges the ".lprof$m" sections of all objects between the
+//    ".lprof$a" and ".lprof$z" markers defined by LoopProfileRuntime, which
+//    prints every record found there when the process exits.
+//
+//    This header is shared by the plug-in, which writes the initial image
+//    of the records, and by the runtime, which reads them, so it must stay
+//    plain C.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+
+// The first word of every record, so the runtime can skip padding the
+// linker puts between the sections of different objects.
+
+#define LOOP_PROFILE_MAGIC 0x4650524C
+
+// Trip counts are bucketed by bit length: bucket 0 counts loops left
+// before the first iteration, bucket k those with 2^(k-1) <= trips < 2^k.
+
+#define LOOP_PROFILE_BUCKETS 33
+
+#define LOOP_PROFILE_NAME_LENGTH 60
+
+typedef struct LoopProfileRecord
+{
+   unsigned int     Magic;
+   unsigned int     Line;
+   unsigned int     Entries;
+   unsigned int     Exits;
+   unsigned __int64 Iterations;
+   unsigned int     MinTrips;
+   unsigned int     MaxTrips;
+   unsigned int     Buckets[LOOP_PROFILE_BUCKETS];
+   char             FunctionName[LOOP_PROFILE_NAME_LENGTH];
+} LoopProfileRecord;
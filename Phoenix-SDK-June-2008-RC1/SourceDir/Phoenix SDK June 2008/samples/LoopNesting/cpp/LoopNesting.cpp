@@ -8,8 +8,14 @@
 //
 //    Registers the "LoopNesting" component control.
 //
+//    The phase derives from ParallelFunctionPhase, so c2 may run it on
+//    several functions at once (-threads). Each function's report is
+//    printed as one block, in source order.
+//
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\analysis-cache.h"
+#include "..\..\common\parallel-phase.h"
 #include "LoopNesting.h"
 
 namespace LoopNesting
@@ -56,252 +62,350 @@ Phase::New
 //
 // Description:
 //
-//    Execute is the phase's prime mover; all unit-centric processing occurs
-//    here.  Note that Execute might be thought of as a "callback": as the
-//    C2 host compiles each FunctionUnit, passing it from phase to phase, the
-//    plug-in Execute method is called to do its work.
+//    ExecuteFunction is the phase's prime mover; all unit-centric
+//    processing occurs here.  Note that it might be thought of as a
+//    "callback": as the C2 host compiles each FunctionUnit, passing it from
+//    phase to phase, ParallelFunctionPhase::Execute calls it to do its work.
 //
 // Arguments:
 //
-//    unit - [in] The unit to process.
+//    functionUnit - [in] The function to process.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] Temporary lifetime for the function, unused.
 //
 // Remarks:
 //
-//    Since IR exists only at the FunctionUnit level, we ignore ModuleUnits.
+//    Since IR exists only at the FunctionUnit level, the base class ignores
+//    ModuleUnits.
 //
-//    The order of units in a compiland passed to Execute is indeterminate.
+//    The order in which c2 hands the units of a compiland to the phase is
+//    indeterminate, but the reports are printed in source order.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
-
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
+   // The cache reuses a flow graph an earlier phase left on the unit. One
+   // it builds itself it deletes in the release phase that follows this
+   // one, so later phases see the unit as they would without the plug-in.
 
-   functionUnit->BuildFlowGraph();
+   Phx::Samples::AnalysisCache ^ cache = Phx::Samples::AnalysisCache::Get(functionUnit);
 
-   Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
+   // Find all the loops, then describe each with an extension object on its
+   // header in a single pass.
+   //
+   // The forest numbers the loops in preorder, with the loops nested in a
+   // loop ordered by the depth first post order of their headers. Every
+   // loop therefore comes after the loop around it, whose object already
+   // exists, so the nesting links and the depth are set as each object is
+   // made; and the loops come in the order a depth first walk of the
+   // nesting tree describes them.
 
-   flowGraph->BuildDominators();
+   Phx::Samples::LoopForest ^ forest = cache->Loops;
 
    if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
    {
       functionUnit->Dump();
    }
 
-   // We'll keep track of all loops via their extension objects.
-
-   System::Collections::Generic::List<LoopExtensionObject ^> ^ loops =
-      gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
+   array<LoopExtensionObject ^> ^ loops =
+      gcnew array<LoopExtensionObject ^>(forest->LoopCount + 1);
 
-   // Walk flow graph in depth first post order
-
-   Phx::Graphs::NodeFlowOrder ^ postOrder = 
-      Phx::Graphs::NodeFlowOrder::New(flowGraph->Lifetime);
-
-   postOrder->Build(flowGraph, Phx::Graphs::Order::PostOrder);
-
-   for (unsigned int i = 1; i <= postOrder->NodeCount; ++i)
+   for (int loopNumber = 1; loopNumber <= forest->LoopCount; loopNumber++)
    {
-      Phx::Graphs::BasicBlock ^ block = postOrder->Node(i)->AsBasicBlock;
-
-      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
-      {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (block->Dominates(predBlock))
-         {
-            // Do we know about this header already?
-
-            LoopExtensionObject ^ loop = LoopExtensionObject::Get(block);
-
-            if (loop == nullptr)
-            {
-               // Evidently a new loop...
-               // Create an extension object to describe it.
+      LoopExtensionObject ^ loop = LoopExtensionObject::New(forest, loopNumber,
+         loops[forest->Parent(loopNumber)]);
 
-               loop = gcnew LoopExtensionObject();
-               loop->LoopHeader = block;
-               loop->ChildLoops = gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
-               block->AddExtensionObject(loop);
-               loops->Add(loop);
+      loop->LoopHeader->AddExtensionObject(loop);
+      loops[loopNumber] = loop;
 
-               // Determine extent of the body and gather up nested loops.
-
-               this->FindLoopBody(block);
-            }
-         }
-      }
+      loop->Describe(output);
    }
 
-   // Determine which loops are top level (they will not have parents)
-   // and compute the loop nesting depth and loop exits.
-
-   for each (LoopExtensionObject ^ loop in loops)
+   if (Phase::CheckControl->IsEnabled(functionUnit))
    {
-      if (loop->ParentLoop == nullptr)
-      {
-         loop->ComputeDepth();
-      }
-   }
-
-   for each (LoopExtensionObject ^ loop in loops)
-   {
-      if (loop->ParentLoop == nullptr)
-      {
-         loop->DescribeAll();
-      }
+      this->CheckNesting(cache, loops, output, lifetime);
    }
-
-   functionUnit->DeleteFlowGraph();
 }
 
 //-----------------------------------------------------------------------------
 //
 // Description:
 //
-//    FindLoopBody takes a loop header and, for each back-edge to this header,
-//    it collects all nodes reachable backward from the back-edge's source.
+//    Check the loops against the ones the sample used to compute from
+//    dominators: a block is a loop header if it dominates one of its
+//    predecessors, and the loop body is the header plus every block that
+//    reaches such a back edge without passing through the header. From
+//    those bodies, a loop is nested in every other loop whose body
+//    contains its header, its parent is the innermost of those, its depth
+//    is their number, and its exclusive blocks are its blocks less those of
+//    its children.
 //
-//    In addition it instantiates the ParentLoop and ChildLoops members of the
-//    LoopExtensionObject for the block.
-//    
 // Arguments:
 //
-//    block - [in] A loop header.
+//    cache - [in] The analyses of the function being described.
+//    loops - [in] The loops, indexed by loop number from 1.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] The function's temporary lifetime, for the dominator
+//          bodies.
+//
+// Remarks:
+//
+//    The forest is built without dominators, so the check is independent
+//    of it. Every pair of loops is compared, so this is quadratic in the
+//    number of loops and only meant for checking. The sets are compared as
+//    they are displayed.
+//
+//    Irreducible loops have no dominating header, so they have no
+//    dominator body. If there are any, only the bodies of the reducible
+//    loops are checked, as the nesting around them would differ.
 //
 //-----------------------------------------------------------------------------
 
-void 
-Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
-{   
-   // We should have attached an extension prior to invoking FindLoopBody.
+void
+Phase::CheckNesting
+(
+   Phx::Samples::AnalysisCache ^  cache,
+   array<LoopExtensionObject ^> ^ loops,
+   System::Text::StringBuilder ^  output,
+   Phx::Lifetime ^                lifetime
+)
+{
+   Phx::Graphs::FlowGraph ^ flowGraph = cache->FlowGraph;
+   int                      mismatchCount = 0;
+   int                      headerCount = 0;
+   bool                     hasIrreducibleLoops = false;
+
+   cache->BuildDominators();
 
-   LoopExtensionObject ^ loop = LoopExtensionObject::Get(block);
+   // Every dominator loop header must have a loop in the forest.
 
-   // We'll use a bit vector to track the membership of blocks 
-   // in the loop body.
+   for each (Phx::Graphs::BasicBlock ^ block in
+      Phx::Graphs::BasicBlock::Iterator(flowGraph))
+   {
+      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+         edge != nullptr; edge = edge->NextPredecessorEdge)
+      {
+         if (block->Dominates(edge->PredecessorNode))
+         {
+            headerCount++;
+
+            if (LoopExtensionObject::Get(block) == nullptr)
+            {
+               mismatchCount++;
 
-   loop->AllLoopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
+               output->AppendLine(System::String::Format("No loop for header block {0}",
+                  block->Id));
+            }
 
-   // Add the header to the loop
+            break;
+         }
+      }
+   }
 
-   loop->AllLoopBlocks->SetBit(block->Id);
+   // The dominator bodies, indexed like the loops
 
-   // We'll use a second bit vector to track the set of blocks whose
-   // predecessors still need to be visited.
+   array<Phx::BitVector::Sparse ^> ^ bodies =
+      gcnew array<Phx::BitVector::Sparse ^>(loops->Length);
 
-   Phx::BitVector::Sparse ^ blocksToVisit = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
+   for (int i = 1; i < loops->Length; i++)
+   {
+      if (loops[i]->IsIrreducible)
+      {
+         hasIrreducibleLoops = true;
+      }
+      else
+      {
+         bodies[i] = this->FindDominatorLoopBody(loops[i]->LoopHeader, lifetime);
+      }
+   }
 
-   for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-      edge != nullptr; edge = edge->NextPredecessorEdge)
+   for (int i = 1; i < loops->Length; i++)
    {
-      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
+      LoopExtensionObject ^ loop = loops[i];
 
-      if (block->Dominates(predBlock))
+      if (bodies[i] == nullptr)
       {
-         // Add the backedge source to the loop body.
+         continue;
+      }
 
-         loop->AllLoopBlocks->SetBit(predBlock->Id);
+      if (hasIrreducibleLoops)
+      {
+         if (bodies[i]->ToString() != loop->AllLoopBlocks->ToString())
+         {
+            mismatchCount++;
 
-         // Add it as a place to start walking from.
+            output->AppendLine(System::String::Format(
+               "Body mismatch for loop with header block {0}", loop->LoopHeader->Id));
+         }
 
-         blocksToVisit->SetBit(predBlock->Id);
+         continue;
       }
-   }
 
-   // Now perform a reverse graph reachability transitive closure.
+      LoopExtensionObject ^ parent = nullptr;
+      int                   parentIndex = 0;
+      unsigned int          depth = 0;
 
-   while (!blocksToVisit->IsEmpty)
-   {
-      Phx::Graphs::BasicBlock ^ blockToVisit = 
-         block->FlowGraph->Block(blocksToVisit->RemoveFirstBit());
-
-      // If this block is itself a loop header, it represents a nested loop.
- 
-      LoopExtensionObject ^ nestedLoop = LoopExtensionObject::Get(blockToVisit);
+      Phx::BitVector::Sparse ^ exclusiveBlocks = bodies[i]->Copy();
 
-      if (nestedLoop != nullptr)
+      for (int j = 1; j < loops->Length; j++)
       {
-         // It may be indirectly nested -- that is contained in a loop
-         // that the current loop contains. See if we've already determined a parent.
-         
-         if (nestedLoop->ParentLoop == nullptr)
+         LoopExtensionObject ^ other = loops[j];
+
+         if (other == loop)
          {
-            // Nope, this is a directly nested loop, so lay claim to it.
+            continue;
+         }
 
-            nestedLoop->ParentLoop = loop;
-            loop->ChildLoops->Add(nestedLoop);
+         if (bodies[j]->GetBit(loop->LoopHeader->Id))
+         {
+            depth++;
+
+            // Of the loops containing this one, the innermost is contained
+            // in all the others.
+
+            if ((parent == nullptr)
+               || bodies[parentIndex]->GetBit(other->LoopHeader->Id))
+            {
+               parent = other;
+               parentIndex = j;
+            }
          }
       }
 
-      for (Phx::Graphs::FlowEdge ^ edge = blockToVisit->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
+      for (int j = 1; j < loops->Length; j++)
       {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (!loop->AllLoopBlocks->GetBit(predBlock->Id))
+         if ((j != i) && bodies[i]->GetBit(loops[j]->LoopHeader->Id))
          {
-            // This block is also in the loop.
+            // A contained loop is a child if this loop is the innermost
+            // one around it, that is, if no other loop containing it is
+            // itself inside this one.
 
-            loop->AllLoopBlocks->SetBit(predBlock->Id);
+            bool isChild = true;
 
-            // And we need to check its predecessors
+            for (int k = 1; isChild && (k < loops->Length); k++)
+            {
+               isChild = (k == i) || (k == j)
+                  || !bodies[k]->GetBit(loops[j]->LoopHeader->Id)
+                  || !bodies[i]->GetBit(loops[k]->LoopHeader->Id);
+            }
 
-            blocksToVisit->SetBit(predBlock->Id);
+            if (isChild)
+            {
+               exclusiveBlocks->Minus(bodies[j]);
+            }
          }
       }
+
+      bool isMatch = (bodies[i]->ToString() == loop->AllLoopBlocks->ToString())
+         && (parent == loop->ParentLoop)
+         && (depth == loop->LoopDepth)
+         && (exclusiveBlocks->ToString() == loop->ExclusiveLoopBlocks->ToString());
+
+      if (!isMatch)
+      {
+         mismatchCount++;
+
+         output->AppendLine(System::String::Format(
+            "Nesting mismatch for loop with header block {0}", loop->LoopHeader->Id));
+      }
+
+      exclusiveBlocks->Delete();
+   }
+
+   for (int i = 1; i < bodies->Length; i++)
+   {
+      if (bodies[i] != nullptr)
+      {
+         bodies[i]->Delete();
+      }
    }
+
+   output->AppendLine(System::String::Format(
+      "Loop nesting check for {0}: {1} loops, {2} dominator loop headers,"
+      " {3} mismatches",
+      gcnew array<System::Object ^> {
+         Phx::Utility::Undecorate(flowGraph->FunctionUnit->NameString, false),
+         loops->Length - 1, headerCount, mismatchCount
+      }));
 }
 
 //-----------------------------------------------------------------------------
 //
 // Description:
 //
-//    FindLoopExits visits each body block found in its receiver and, if it has
-//    a successor that is not in the loop, its last instruction is recorded as an exit.
+//    Find the natural loop body of a header from the dominator relation,
+//    the way the sample did before it used the loop forest.
+//
+// Arguments:
+//
+//    header - [in] The loop header. Dominators must have been built.
+//    lifetime - [in] The lifetime to allocate the body in.
+//
+// Returns:
+//
+//    The ids of the blocks in the body, including the header. The caller
+//    deletes the vector.
+//
+// Remarks:
+//
+//    The body is the header, the sources of the back edges to it (the
+//    predecessors it dominates), and everything that reaches one of those
+//    sources backwards without passing through the header.
 //
 //-----------------------------------------------------------------------------
 
-void LoopExtensionObject::FindLoopExits()
+Phx::BitVector::Sparse ^
+Phase::FindDominatorLoopBody
+(
+   Phx::Graphs::BasicBlock ^ header,
+   Phx::Lifetime ^           lifetime
+)
 {
-   // We should have attached an extension.
+   Phx::BitVector::Sparse ^ body = Phx::BitVector::Sparse::New(lifetime);
+   Phx::BitVector::Sparse ^ blocksToVisit = Phx::BitVector::Sparse::New(lifetime);
 
-   LoopExtensionObject ^ loop = this;
-   Phx::Graphs::BasicBlock ^ block = loop->LoopHeader;
+   body->SetBit(header->Id);
 
-   // Find the set of exit blocks...
+   for (Phx::Graphs::FlowEdge ^ edge = header->PredecessorEdgeList;
+      edge != nullptr; edge = edge->NextPredecessorEdge)
+   {
+      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
 
-   loop->ExitLoopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
+      if (header->Dominates(predBlock) && !body->GetBit(predBlock->Id))
+      {
+         body->SetBit(predBlock->Id);
+         blocksToVisit->SetBit(predBlock->Id);
+      }
+   }
 
-   for each (unsigned int blockId in loop->AllLoopBlocks)
+   while (!blocksToVisit->IsEmpty)
    {
-      Phx::Graphs::BasicBlock ^ loopBlock = block->FlowGraph->Block(blockId);
+      Phx::Graphs::BasicBlock ^ blockToVisit =
+         header->FlowGraph->Block(blocksToVisit->RemoveFirstBit());
 
-      for (Phx::Graphs::FlowEdge ^ edge = loopBlock->SuccessorEdgeList; 
-         edge != nullptr; edge = edge->NextSuccessorEdge)
+      for (Phx::Graphs::FlowEdge ^ edge = blockToVisit->PredecessorEdgeList;
+         edge != nullptr; edge = edge->NextPredecessorEdge)
       {
-         Phx::Graphs::BasicBlock ^ successorBlock = edge->SuccessorNode;
+         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
 
-         if (!loop->AllLoopBlocks->GetBit(successorBlock->Id))
+         if (!body->GetBit(predBlock->Id))
          {
-            loop->ExitLoopBlocks->SetBit(loopBlock->Id);
+            body->SetBit(predBlock->Id);
+            blocksToVisit->SetBit(predBlock->Id);
          }
       }
    }
 
+   blocksToVisit->Delete();
+
+   return body;
 }
 
 //-----------------------------------------------------------------------------
@@ -326,6 +430,15 @@ void LoopExtensionObject::FindLoopExits()
 void
 PlugIn::RegisterObjects()
 {
+   Phx::Samples::AnalysisCache::RegisterObjects(L"loopNesting", L"LoopNesting.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"loopNesting",
+      L"LoopNesting.cpp");
+
+   Phase::CheckControl =
+      Phx::Controls::SetBooleanControl::New(L"loopNestingCheck",
+         L"Check the loops against natural loops found from dominators",
+         L"LoopNesting.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -389,6 +502,9 @@ PlugIn::BuildPhases
 
    Phx::Phases::Phase ^ phase = Phase::New(config);
    basePhase->InsertAfter(phase);
+
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //-----------------------------------------------------------------------------
@@ -404,6 +520,59 @@ System::String^ PlugIn::NameString::get()
 	return L"LoopNesting";
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create the LoopExtensionObject describing one loop of a loop forest,
+//    and link it into the nesting tree.
+//
+// Arguments:
+//
+//    forest - [in] The loops of the function.
+//    loopNumber - [in] The number of the loop in the forest.
+//    parentLoop - [in] The object of the loop around it, or nullptr.
+//
+// Remarks:
+//
+//    The forest has already found the blocks and exits of the loop; the
+//    object keeps them as bit vectors. The depth follows from the parent's.
+//
+//-----------------------------------------------------------------------------
+
+LoopExtensionObject ^
+LoopExtensionObject::New
+(
+   Phx::Samples::LoopForest ^ forest,
+   int                        loopNumber,
+   LoopExtensionObject ^      parentLoop
+)
+{
+   LoopExtensionObject ^     loop = gcnew LoopExtensionObject();
+   Phx::Graphs::BasicBlock ^ header = forest->Header(loopNumber);
+   Phx::Lifetime ^           lifetime = header->Graph->Lifetime;
+
+   loop->LoopHeader = header;
+   loop->ChildLoops = gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
+   loop->AllLoopBlocks = forest->GetBlocks(loopNumber, lifetime);
+   loop->ExclusiveLoopBlocks = forest->GetExclusiveBlocks(loopNumber, lifetime);
+   loop->ExitLoopBlocks = forest->GetExitBlocks(loopNumber, lifetime);
+   loop->IsIrreducible = forest->IsIrreducible(loopNumber);
+   loop->ParentLoop = parentLoop;
+
+   if (parentLoop == nullptr)
+   {
+      loop->LoopDepth = 0;
+   }
+   else
+   {
+      loop->LoopDepth = parentLoop->LoopDepth + 1;
+      parentLoop->ChildLoops->Add(loop);
+   }
+
+   return loop;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -435,81 +604,33 @@ LoopExtensionObject::Get
 //
 // Description:
 //
-//    Display the data in a LoopExtensionObject on the console.
+//    Display the data in a LoopExtensionObject in the function's report.
 //    
 //-----------------------------------------------------------------------------
 
-void LoopExtensionObject::Describe()
+void LoopExtensionObject::Describe
+(
+   System::Text::StringBuilder ^ output
+)
 {
    Phx::FunctionUnit ^ functionUnit = this->LoopHeader->FlowGraph->FunctionUnit;
    System::String ^ indent = gcnew System::String(' ', this->LoopDepth);
 
-   System::Console::WriteLine("{0}Loop at {1} line {2}",
-      indent,
-      Phx::Utility::Undecorate(functionUnit->NameString, false),
-      functionUnit->DebugInfo->GetLineNumber(this->LoopHeader->FirstInstruction->DebugTag));
-   System::Console::WriteLine("{0}Header block: {1}", indent, this->LoopHeader->Id);
-   System::Console::WriteLine("{0}Exclusive blocks: {1}", indent, this->ExclusiveLoopBlocks);
-   System::Console::WriteLine("{0}Inclusive blocks: {1}", indent, this->AllLoopBlocks);
-   System::Console::WriteLine("{0}Exit blocks: {1}", indent, this->ExitLoopBlocks);
-}
-
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    Display LoopExtensionObject data in depth-first order.
-//    
-//-----------------------------------------------------------------------------
-
-void LoopExtensionObject::DescribeAll()
-{
-   this->Describe();
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      child->DescribeAll();
-   }
-}
-
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    Visit loop descriptors in depth-first order, compute depths in pre-order,
-//    and perform //    set operations to compute inclusive and exclusive sets
-//    of body blocks.
-//
-//-----------------------------------------------------------------------------
-
-void LoopExtensionObject::ComputeDepth()
-{
-   // Compute depth top-down.
-
-   if (this->ParentLoop == nullptr)
-   {
-      this->LoopDepth = 0;
-   }
-   else
-   {
-      this->LoopDepth = this->ParentLoop->LoopDepth + 1;
-   }
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      child->ComputeDepth();
-   }
-
-   // Compute exclusive blocks bottom up.
-
-   this->ExclusiveLoopBlocks = this->AllLoopBlocks->Copy();
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      this->ExclusiveLoopBlocks->Minus(child->AllLoopBlocks);
-   }
-
-   this->FindLoopExits();
+   output->AppendLine(System::String::Format("{0}{1} at {2} line {3}",
+      gcnew array<System::Object ^> {
+         indent,
+         this->IsIrreducible ? "Irreducible loop" : "Loop",
+         Phx::Utility::Undecorate(functionUnit->NameString, false),
+         functionUnit->DebugInfo->GetLineNumber(this->LoopHeader->FirstInstruction->DebugTag)
+      }));
+   output->AppendLine(System::String::Format("{0}Header block: {1}", indent,
+      this->LoopHeader->Id));
+   output->AppendLine(System::String::Format("{0}Exclusive blocks: {1}", indent,
+      this->ExclusiveLoopBlocks));
+   output->AppendLine(System::String::Format("{0}Inclusive blocks: {1}", indent,
+      this->AllLoopBlocks));
+   output->AppendLine(System::String::Format("{0}Exit blocks: {1}", indent,
+      this->ExitLoopBlocks));
 }
 
 }
@@ -13,6 +13,8 @@
 namespace LoopNesting
 {
 
+ref class LoopExtensionObject;
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -26,10 +28,14 @@ namespace LoopNesting
 //    instance of the phase.  Execute is responsible for performing the
 //    actual work of the phase.
 //
+//    This phase only reads the function it is handed, so it derives from
+//    ParallelFunctionPhase and implements ExecuteFunction instead, and c2
+//    may run it on several functions at once.
+//
 //-----------------------------------------------------------------------------
 
 public
-ref class Phase : Phx::Phases::Phase
+ref class Phase : Phx::Samples::ParallelFunctionPhase
 {
 
 public:
@@ -43,11 +49,17 @@ public:
 protected:
 
    virtual void
-   Execute
+   ExecuteFunction
    (
-      Phx::Unit ^ unit
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
    ) override;
 
+public:
+
+   static Phx::Controls::SetBooleanControl ^ CheckControl;
+
 #if defined (PHX_DEBUG_SUPPORT)
 
 public:
@@ -57,10 +69,21 @@ public:
 
 private:
 
-   void FindLoopBody(Phx::Graphs::BasicBlock ^ block);
-
-   property Phx::BitVector::Sparse ^ TopLevelLoops;
+   void
+   CheckNesting
+   (
+      Phx::Samples::AnalysisCache ^  cache,
+      array<LoopExtensionObject ^> ^ loops,
+      System::Text::StringBuilder ^  output,
+      Phx::Lifetime ^                lifetime
+   );
 
+   Phx::BitVector::Sparse ^
+   FindDominatorLoopBody
+   (
+      Phx::Graphs::BasicBlock ^ header,
+      Phx::Lifetime ^           lifetime
+   );
 };
 
 //-----------------------------------------------------------------------------
@@ -116,6 +139,16 @@ public ref class LoopExtensionObject : Phx::Graphs::NodeExtensionObject
 {
 public:
 
+   // Create the object describing a loop of a loop forest.
+
+   static LoopExtensionObject ^
+   New
+   (
+      Phx::Samples::LoopForest ^ forest,
+      int                        loopNumber,
+      LoopExtensionObject ^      parentLoop
+   );
+
    // Return associated extension object.
 
    static LoopExtensionObject ^
@@ -126,10 +159,7 @@ public:
 
    // Methods
 
-   void Describe();
-   void DescribeAll();
-   void ComputeDepth();
-   void FindLoopExits();
+   void Describe(System::Text::StringBuilder ^ output);
 
    // Data of interest
 
@@ -144,7 +174,6 @@ public:
 
    property unsigned int LoopDepth;
 
-private:
-   static unsigned int id;
+   property bool IsIrreducible;
 };
 }
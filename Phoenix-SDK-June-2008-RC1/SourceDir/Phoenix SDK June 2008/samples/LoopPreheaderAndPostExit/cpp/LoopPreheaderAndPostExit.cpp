@@ -10,6 +10,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\loop-forest.h"
+#include "..\..\common\flow-graph-edit.h"
 #include "LoopPreheaderAndPostExit.h"
 
 namespace LoopPreheaderAndPostExit
@@ -90,89 +92,89 @@ Phase::Execute
 
    Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
 
-   flowGraph->BuildDominators();
-
    if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
    {
       functionUnit->Dump();
    }
 
-   // We'll keep track of all loops via their extension objects.
+   // Find all the loops, and describe each with an extension object on its
+   // header, visiting the headers in depth first post order.
 
    System::Collections::Generic::List<LoopExtensionObject ^> ^ loops =
       gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
 
-   // Walk flow graph in depth first post order
-
-   Phx::Graphs::NodeFlowOrder ^ postOrder = 
-      Phx::Graphs::NodeFlowOrder::New(flowGraph->Lifetime);
-
-   postOrder->Build(flowGraph, Phx::Graphs::Order::PostOrder);
+   Phx::Samples::LoopForest ^ forest = Phx::Samples::LoopForest::New(flowGraph);
+   Phx::Samples::GraphOrder ^ order = forest->Order;
 
-   for (unsigned int i = 1; i <= postOrder->NodeCount; ++i)
+   for (int position = order->BlockCount; position >= 1; position--)
    {
-      Phx::Graphs::BasicBlock ^ block = postOrder->Node(i)->AsBasicBlock;
+      Phx::Graphs::BasicBlock ^ block = order->BlockInReversePostorder(position);
+      int                       loopNumber = forest->LoopHeadedBy(block);
 
-      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
+      if (loopNumber == 0)
       {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (block->Dominates(predBlock))
-         {
-            // Do we know about this header already?
-
-            LoopExtensionObject ^ loop = LoopExtensionObject::Get(block);
-
-            if (loop == nullptr)
-            {
-               // Evidently a new loop...
-               // Create an extension object to describe it.
-
-               loop = gcnew LoopExtensionObject();
-               loop->LoopHeader = block;
-               loop->ChildLoops = gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
-               block->AddExtensionObject(loop);
-               loops->Add(loop);
+         continue;
+      }
 
-               // Determine extent of the body and gather up nested loops.
+      // Irreducible loops have more than one entry, so they have no single
+      // preheader. Leave them out; the loops nested in them are still
+      // handled.
 
-               this->FindLoopBody(block);
-            }
-         }
+      if (forest->IsIrreducible(loopNumber))
+      {
+         continue;
       }
+
+      LoopExtensionObject ^ loop = LoopExtensionObject::New(forest, loopNumber);
+      block->AddExtensionObject(loop);
+      loops->Add(loop);
    }
 
-   // Determine which loops are top level (they will not have parents)
-   // and compute the loop nesting depth and loop exits.
+   // Now that every loop has its object, link each to the loop around it.
 
    for each (LoopExtensionObject ^ loop in loops)
    {
-      if (loop->ParentLoop == nullptr)
+      int parent = forest->Parent(forest->LoopHeadedBy(loop->LoopHeader));
+
+      while ((parent != 0) && forest->IsIrreducible(parent))
+      {
+         parent = forest->Parent(parent);
+      }
+
+      if (parent != 0)
       {
-         loop->ComputeDepth();
+         loop->ParentLoop = LoopExtensionObject::Get(forest->Header(parent));
+         loop->ParentLoop->ChildLoops->Add(loop);
       }
    }
 
-   System::Collections::Generic::List<Phx::Graphs::FlowEdge ^> ^ edgesToSplit =
-      gcnew System::Collections::Generic::List<Phx::Graphs::FlowEdge ^>();
+   // Record the edges every loop needs split, then split them all in one
+   // pass. The edit keeps the dominators up to date as it splits, and the
+   // loops learn their new blocks from the list of splits, so neither has
+   // to be rebuilt.
+
+   Phx::Samples::FlowGraphEdit ^ edit = Phx::Samples::FlowGraphEdit::New(flowGraph);
 
    for each (LoopExtensionObject ^ loop in loops)
    {
-      if (loop->ParentLoop == nullptr)
-      {
-         // Find the edges we need to split to do instrumentation.
+      loop->DetermineEdgesToSplit(edit);
+   }
 
-         edgesToSplit->AddRange(loop->DetermineEdgesToSplit());
-      }
+   edit->Apply();
+
+   for (int split = 0; split < edit->SplitCount; split++)
+   {
+      System::Console::WriteLine("Split edge {0} -> {1} with block {2}",
+         edit->SplitPredecessor(split)->Id,
+         edit->SplitSuccessor(split)->Id,
+         edit->SplitBlock(split)->Id);
    }
 
-   // split the edges
+   this->UpdateLoopBlocks(forest, edit);
 
-   for each (Phx::Graphs::FlowEdge ^ edge in edgesToSplit)
+   if (Phase::CheckControl->IsEnabled(functionUnit))
    {
-      System::Console::WriteLine("Splitting {0}", edge);
-      edge->FlowGraph->SplitEdge(edge);
+      this->CheckEdits(functionUnit, edit, loops);
    }
 
    if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
@@ -187,108 +189,56 @@ Phase::Execute
 //
 // Description:
 //
-//    FindLoopBody takes a loop header and, for each back-edge to this header,
-//    it collects all nodes reachable backward from the back-edge's source.
+//    Add the blocks made by splitting edges to the loops they are in.
 //
-//    In addition it instantiates the ParentLoop and ChildLoops members of the
-//    LoopExtensionObject for the block.
-//    
 // Arguments:
 //
-//    block - [in] A loop header.
+//    forest - [in] The loops of the flow graph before the edit.
+//    edit - [in] The edit, after Apply.
+//
+// Remarks:
+//
+//    A block put on an edge is in every loop that contains both ends of
+//    the edge, and in the exclusive blocks of the innermost of those.
+//    Loops left out because they are irreducible have no object to update.
 //
 //-----------------------------------------------------------------------------
 
-void 
-Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
-{   
-   // We should have attached an extension prior to invoking FindLoopBody.
-
-   LoopExtensionObject ^ loop = LoopExtensionObject::Get(block);
-
-   // We'll use a bit vector to track the membership of blocks 
-   // in the loop body.
-
-   loop->AllLoopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   // The BackEdges bit vector will be used to identify predecessors to
-   // loop headers from outside the loop.
-
-   loop->BackEdges =
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   // Add the header to the loop
-
-   loop->AllLoopBlocks->SetBit(block->Id);
-
-   // We'll use a second bit vector to track the set of blocks whose
-   // predecessors still need to be visited.
-
-   Phx::BitVector::Sparse ^ blocksToVisit = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-      edge != nullptr; edge = edge->NextPredecessorEdge)
+void
+Phase::UpdateLoopBlocks
+(
+   Phx::Samples::LoopForest ^    forest,
+   Phx::Samples::FlowGraphEdit ^ edit
+)
+{
+   for (int split = 0; split < edit->SplitCount; split++)
    {
-      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
+      Phx::Graphs::BasicBlock ^ successor = edit->SplitSuccessor(split);
+      unsigned int              blockId = edit->SplitBlock(split)->Id;
+      int                       loopNumber = forest->LoopOf(edit->SplitPredecessor(split));
 
-      if (block->Dominates(predBlock))
+      while ((loopNumber != 0) && !forest->Contains(loopNumber, successor))
       {
-         // Add backedge to set of backedges
-
-         loop->BackEdges->SetBit(edge->Id);
-
-         // Add the backedge source to the loop body.
-
-         loop->AllLoopBlocks->SetBit(predBlock->Id);
-
-         // Add it as a place to start walking from.
-
-         blocksToVisit->SetBit(predBlock->Id);
+         loopNumber = forest->Parent(loopNumber);
       }
-   }
-
-   // Now perform a reverse graph reachability transitive closure.
-
-   while (!blocksToVisit->IsEmpty)
-   {
-      Phx::Graphs::BasicBlock ^ blockToVisit = 
-         block->FlowGraph->Block(blocksToVisit->RemoveFirstBit());
 
-      // If this block is itself a loop header, it represents a nested loop.
- 
-      LoopExtensionObject ^ nestedLoop = LoopExtensionObject::Get(blockToVisit);
+      bool isInnermost = true;
 
-      if (nestedLoop != nullptr)
+      for (; loopNumber != 0; loopNumber = forest->Parent(loopNumber))
       {
-         // It may be indirectly nested -- that is contained in a loop
-         // that the current loop contains. See if we've already determined a parent.
-         
-         if (nestedLoop->ParentLoop == nullptr)
-         {
-            // Nope, this is a directly nested loop, so lay claim to it.
-
-            nestedLoop->ParentLoop = loop;
-            loop->ChildLoops->Add(nestedLoop);
-         }
-      }
+         LoopExtensionObject ^ loop = LoopExtensionObject::Get(forest->Header(loopNumber));
 
-      for (Phx::Graphs::FlowEdge ^ edge = blockToVisit->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
-      {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (!loop->AllLoopBlocks->GetBit(predBlock->Id))
+         if (loop != nullptr)
          {
-            // This block is also in the loop.
-
-            loop->AllLoopBlocks->SetBit(predBlock->Id);
+            loop->AllLoopBlocks->SetBit(blockId);
 
-            // And we need to check its predecessors
-
-            blocksToVisit->SetBit(predBlock->Id);
+            if (isInnermost)
+            {
+               loop->ExclusiveLoopBlocks->SetBit(blockId);
+            }
          }
+
+         isInnermost = false;
       }
    }
 }
@@ -297,42 +247,82 @@ Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
 //
 // Description:
 //
-//    FindLoopExits visits each body block found in its receiver and, if it has
-//    a successor that is not in the loop, its last instruction is recorded as an exit.
+//    Check what the edit kept up to date against a rebuild: the immediate
+//    dominator of every block, and the inclusive and exclusive blocks of
+//    every loop.
+//
+// Arguments:
+//
+//    functionUnit - [in] The function that was edited.
+//    edit - [in] The edit, after Apply.
+//    loops - [in] The loops, after UpdateLoopBlocks.
+//
+// Remarks:
+//
+//    The sets are compared as they are displayed.
 //
 //-----------------------------------------------------------------------------
 
-void LoopExtensionObject::FindLoopExits()
+void
+Phase::CheckEdits
+(
+   Phx::FunctionUnit ^                                         functionUnit,
+   Phx::Samples::FlowGraphEdit ^                               edit,
+   System::Collections::Generic::List<LoopExtensionObject ^> ^ loops
+)
 {
-   // We should have attached an extension.
-
-   LoopExtensionObject ^ loop = this;
-   Phx::Graphs::BasicBlock ^ block = loop->LoopHeader;
+   Phx::Graphs::FlowGraph ^      flowGraph = functionUnit->FlowGraph;
+   Phx::Lifetime ^               lifetime = flowGraph->Lifetime;
+   Phx::Samples::FlowGraphEdit ^ rebuiltEdit = Phx::Samples::FlowGraphEdit::New(flowGraph);
+   Phx::Samples::LoopForest ^    rebuiltForest = Phx::Samples::LoopForest::New(flowGraph);
+   int                           mismatchCount = 0;
 
-   // Find the set of exit blocks...
+   for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+   {
+      if (edit->ImmediateDominator(block) != rebuiltEdit->ImmediateDominator(block))
+      {
+         mismatchCount++;
 
-   loop->ExitLoopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
+         System::Console::WriteLine("Dominator mismatch for block {0}", block->Id);
+      }
+   }
 
-   for each (unsigned int blockId in loop->AllLoopBlocks)
+   for each (LoopExtensionObject ^ loop in loops)
    {
-      Phx::Graphs::BasicBlock ^ loopBlock = block->FlowGraph->Block(blockId);
+      int loopNumber = rebuiltForest->LoopHeadedBy(loop->LoopHeader);
 
-      for (Phx::Graphs::FlowEdge ^ edge = loopBlock->SuccessorEdgeList; 
-         edge != nullptr; edge = edge->NextSuccessorEdge)
+      if (loopNumber == 0)
       {
-         Phx::Graphs::BasicBlock ^ successorBlock = edge->SuccessorNode;
+         mismatchCount++;
 
-         if (!loop->AllLoopBlocks->GetBit(successorBlock->Id))
-         {
-            loop->ExitLoopBlocks->SetBit(loopBlock->Id);
-         }
+         System::Console::WriteLine("Loop with header block {0} not found after the edit",
+            loop->LoopHeader->Id);
+
+         continue;
+      }
+
+      Phx::BitVector::Sparse ^ allBlocks = rebuiltForest->GetBlocks(loopNumber, lifetime);
+      Phx::BitVector::Sparse ^ exclusiveBlocks =
+         rebuiltForest->GetExclusiveBlocks(loopNumber, lifetime);
+
+      if ((allBlocks->ToString() != loop->AllLoopBlocks->ToString())
+         || (exclusiveBlocks->ToString() != loop->ExclusiveLoopBlocks->ToString()))
+      {
+         mismatchCount++;
+
+         System::Console::WriteLine("Block mismatch for loop with header block {0}",
+            loop->LoopHeader->Id);
       }
+
+      allBlocks->Delete();
+      exclusiveBlocks->Delete();
    }
 
+   System::Console::WriteLine("Edge split check for {0}: {1} splits, {2} mismatches",
+      Phx::Utility::Undecorate(functionUnit->NameString, false),
+      edit->SplitCount, mismatchCount);
 }
 
-
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -355,6 +345,10 @@ void LoopExtensionObject::FindLoopExits()
 void
 PlugIn::RegisterObjects()
 {
+   Phase::CheckControl =
+      Phx::Controls::SetBooleanControl::New(L"loopPreheaderAndPostExitCheck",
+         L"Check the dominators and loop blocks kept by the batched edge splits against a rebuild",
+         L"LoopPreheaderAndPostExit.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -433,6 +427,55 @@ System::String^ PlugIn::NameString::get()
 	return L"LoopPreheaderAndPostExit";
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create the LoopExtensionObject describing one loop of a loop forest.
+//
+// Remarks:
+//
+//    The forest has already found the blocks, exits and depth of the loop;
+//    the object keeps them as bit vectors. ParentLoop and ChildLoops are
+//    set by the caller once every loop has its object.
+//
+//-----------------------------------------------------------------------------
+
+LoopExtensionObject ^
+LoopExtensionObject::New
+(
+   Phx::Samples::LoopForest ^ forest,
+   int                        loopNumber
+)
+{
+   LoopExtensionObject ^     loop = gcnew LoopExtensionObject();
+   Phx::Graphs::BasicBlock ^ header = forest->Header(loopNumber);
+   Phx::Lifetime ^           lifetime = header->Graph->Lifetime;
+
+   loop->LoopHeader = header;
+   loop->ChildLoops = gcnew System::Collections::Generic::List<LoopExtensionObject ^>();
+   loop->AllLoopBlocks = forest->GetBlocks(loopNumber, lifetime);
+   loop->ExclusiveLoopBlocks = forest->GetExclusiveBlocks(loopNumber, lifetime);
+   loop->ExitLoopBlocks = forest->GetExitBlocks(loopNumber, lifetime);
+   loop->LoopDepth = forest->Depth(loopNumber) - 1;
+   loop->IsIrreducible = forest->IsIrreducible(loopNumber);
+
+   // The back edges are the edges into the header from inside the loop.
+
+   loop->BackEdges = Phx::BitVector::Sparse::New(lifetime);
+
+   for (Phx::Graphs::FlowEdge ^ edge = header->PredecessorEdgeList; 
+      edge != nullptr; edge = edge->NextPredecessorEdge)
+   {
+      if (forest->IsBackEdge(edge))
+      {
+         loop->BackEdges->SetBit(edge->Id);
+      }
+   }
+
+   return loop;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -506,47 +549,7 @@ void LoopExtensionObject::DescribeAll()
 //
 // Description:
 //
-//    Visit loop descriptors in depth-first order, compute depths in pre-order,
-//    and perform //    set operations to compute inclusive and exclusive sets
-//    of body blocks.
-//
-//-----------------------------------------------------------------------------
-
-void LoopExtensionObject::ComputeDepth()
-{
-   // Compute depth top-down.
-
-   if (this->ParentLoop == nullptr)
-   {
-      this->LoopDepth = 0;
-   }
-   else
-   {
-      this->LoopDepth = this->ParentLoop->LoopDepth + 1;
-   }
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      child->ComputeDepth();
-   }
-
-   // Compute exclusive blocks bottom up.
-
-   this->ExclusiveLoopBlocks = this->AllLoopBlocks->Copy();
-
-   for each(LoopExtensionObject ^ child in this->ChildLoops)
-   {
-      this->ExclusiveLoopBlocks->Minus(child->AllLoopBlocks);
-   }
-
-   this->FindLoopExits();
-}
-
-//-----------------------------------------------------------------------------
-//
-// Description:
-//
-//    Split critical edges.
+//    Record the critical edges to split in the edit.
 //
 // Remarks:
 // 
@@ -554,14 +557,23 @@ void LoopExtensionObject::ComputeDepth()
 //    from blocks that are control flow splits.
 //    
 //    Walk successors of exits, looking for blocks that are control flow merges.
+//
+//    An edge another loop already recorded, such as one leaving a loop for
+//    the header of the next, is split only once.
+//
+// Returns:
+//
+//    The number of edges this loop needs split.
 //    
 //-----------------------------------------------------------------------------
 
-System::Collections::Generic::List<Phx::Graphs::FlowEdge ^> ^
-LoopExtensionObject::DetermineEdgesToSplit()
+int
+LoopExtensionObject::DetermineEdgesToSplit
+(
+   Phx::Samples::FlowGraphEdit ^ edit
+)
 {
-   System::Collections::Generic::List<Phx::Graphs::FlowEdge ^> ^ edgesToSplit =
-      gcnew System::Collections::Generic::List<Phx::Graphs::FlowEdge ^>();
+   int edgeCount = 0;
 
    for (Phx::Graphs::FlowEdge ^ edge = this->LoopHeader->PredecessorEdgeList; 
       edge != nullptr; 
@@ -598,7 +610,8 @@ LoopExtensionObject::DetermineEdgesToSplit()
          continue;
       }
 
-      edgesToSplit->Add(edge);
+      edit->SplitEdge(edge);
+      edgeCount++;
    }
 
    for each (unsigned int blockId in this->ExitLoopBlocks)
@@ -629,14 +642,15 @@ LoopExtensionObject::DetermineEdgesToSplit()
             continue;
          }
 
-         edgesToSplit->Add(edge);
+         edit->SplitEdge(edge);
+         edgeCount++;
       }
    }
 
-   if (edgesToSplit->Count > 0)
+   if (edgeCount > 0)
    {
       System::Console::WriteLine("Split {0} edges for instrumentation of loop on line {1} in {2}", 
-         edgesToSplit->Count,
+         edgeCount,
 		 this->LoopHeader->FunctionUnit->DebugInfo->GetLineNumber(this->LoopHeader->FirstInstruction->DebugTag),
 		 this->LoopHeader->FunctionUnit->NameString);
    }
@@ -647,7 +661,7 @@ LoopExtensionObject::DetermineEdgesToSplit()
 		this->LoopHeader->FunctionUnit->NameString);
    }
 
-   return edgesToSplit;
+   return edgeCount;
 }
 
 }
@@ -13,6 +13,8 @@
 namespace LoopPreheaderAndPostExit
 {
 
+ref class LoopExtensionObject;
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -48,6 +50,10 @@ protected:
       Phx::Unit ^ unit
    ) override;
 
+public:
+
+   static Phx::Controls::SetBooleanControl ^ CheckControl;
+
 #if defined (PHX_DEBUG_SUPPORT)
 
 public:
@@ -57,7 +63,20 @@ public:
 
 private:
 
-   void FindLoopBody(Phx::Graphs::BasicBlock ^ block);
+   void
+   UpdateLoopBlocks
+   (
+      Phx::Samples::LoopForest ^    forest,
+      Phx::Samples::FlowGraphEdit ^ edit
+   );
+
+   void
+   CheckEdits
+   (
+      Phx::FunctionUnit ^                                         functionUnit,
+      Phx::Samples::FlowGraphEdit ^                               edit,
+      System::Collections::Generic::List<LoopExtensionObject ^> ^ loops
+   );
 
    property Phx::BitVector::Sparse ^ TopLevelLoops;
 
@@ -116,6 +135,15 @@ public ref class LoopExtensionObject : Phx::Graphs::NodeExtensionObject
 {
 public:
 
+   // Create the object describing a loop of a loop forest.
+
+   static LoopExtensionObject ^
+   New
+   (
+      Phx::Samples::LoopForest ^ forest,
+      int                        loopNumber
+   );
+
    // Return associated extension object.
 
    static LoopExtensionObject ^
@@ -128,10 +156,7 @@ public:
 
    void Describe();
    void DescribeAll();
-   void ComputeDepth();
-   void FindLoopExits();
-   System::Collections::Generic::List<Phx::Graphs::FlowEdge ^> ^
-   DetermineEdgesToSplit();
+   int DetermineEdgesToSplit(Phx::Samples::FlowGraphEdit ^ edit);
 
    // Data of interest
 
@@ -147,6 +172,8 @@ public:
 
    property unsigned int LoopDepth;
 
+   property bool IsIrreducible;
+
 private:
    static unsigned int id;
 };
@@ -8,8 +8,14 @@
 //
 //    Registers the "NaturalLoopBodiesAndExits" component control.
 //
+//    The phase derives from ParallelFunctionPhase, so c2 may run it on
+//    several functions at once (-threads). Each function's report is
+//    printed as one block, in source order.
+//
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\analysis-cache.h"
+#include "..\..\common\parallel-phase.h"
 #include "NaturalLoopBodiesAndExits.h"
 
 namespace NaturalLoopBodiesAndExits
@@ -56,170 +62,103 @@ Phase::New
 //
 // Description:
 //
-//    Execute is the phase's prime mover; all unit-centric processing occurs
-//    here.  Note that Execute might be thought of as a "callback": as the
-//    C2 host compiles each FunctionUnit, passing it from phase to phase, the
-//    plug-in Execute method is called to do its work.
+//    ExecuteFunction is the phase's prime mover; all unit-centric
+//    processing occurs here.  Note that it might be thought of as a
+//    "callback": as the C2 host compiles each FunctionUnit, passing it from
+//    phase to phase, ParallelFunctionPhase::Execute calls it to do its work.
 //
 // Arguments:
 //
-//    unit - [in] The unit to process.
+//    functionUnit - [in] The function to process.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] Temporary lifetime for the function, unused.
 //
 // Remarks:
 //
-//    Since IR exists only at the FunctionUnit level, we ignore ModuleUnits.
+//    Since IR exists only at the FunctionUnit level, the base class ignores
+//    ModuleUnits.
 //
-//    The order of units in a compiland passed to Execute is indeterminate.
+//    The order in which c2 hands the units of a compiland to the phase is
+//    indeterminate, but the reports are printed in source order.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
+   // The cache reuses a flow graph an earlier phase left on the unit. One
+   // it builds itself it deletes in the release phase that follows this
+   // one, so later phases see the unit as they would without the plug-in.
 
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
+   Phx::Samples::AnalysisCache ^ cache = Phx::Samples::AnalysisCache::Get(functionUnit);
 
-   functionUnit->BuildFlowGraph();
+   // Find all the loops, then describe each once, visiting the headers in
+   // depth first post order.
 
-   Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
-
-   flowGraph->BuildDominators();
+   Phx::Samples::LoopForest ^ forest = cache->Loops;
+   Phx::Samples::GraphOrder ^ order = forest->Order;
 
    if (Phx::Controls::DebugControls::TraceControl->IsEnabled(this->PhaseControl, functionUnit))
    {
       functionUnit->Dump();
    }
 
-   // Remember loops that we've already seen by putting their IDs in this bit vector.
-
-   Phx::BitVector::Sparse ^ loopHeaders = 
-      Phx::BitVector::Sparse::New(flowGraph->Lifetime);
-
-   // Walk flow graph in depth first post order
-
-   Phx::Graphs::NodeFlowOrder ^ postOrder = 
-      Phx::Graphs::NodeFlowOrder::New(flowGraph->Lifetime);
-
-   postOrder->Build(flowGraph, Phx::Graphs::Order::PostOrder);
-
-   for (unsigned int i = 1; i <= postOrder->NodeCount; ++i)
+   for (int position = order->BlockCount; position >= 1; position--)
    {
-      Phx::Graphs::BasicBlock ^ block = postOrder->Node(i)->AsBasicBlock;
+      int loop = forest->LoopHeadedBy(order->BlockInReversePostorder(position));
 
-      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
+      if (loop != 0)
       {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (block->Dominates(predBlock))
-         {
-            // Do we know about this header already?
-
-            if (!loopHeaders->GetBit(block->Id))
-            {
-               // Evidently a new loop...
-               // Determine extent of the body.
-
-               this->FindLoopBody(block);
-            }
-
-            loopHeaders->SetBit(block->Id);
-         }
+         this->DescribeLoop(forest, loop, output, lifetime);
       }
    }
-
-   functionUnit->DeleteFlowGraph();
 }
 
 //-----------------------------------------------------------------------------
 //
 // Description:
 //
-//    FindLoopBody takes a loop header and, for each back-edge to this header,
-//    it collects all nodes reachable backward from the back-edge's source.
+//    DescribeLoop reports the source lines of the blocks of a loop found by
+//    the loop forest, nested loops included.
 //
-//    In addition, each body block is visited and, if it has a successor that
-//    is not in the loop, its last instruction is recorded as an exit.
+//    In addition, each edge the forest found leaving the loop is described
+//    by the lines of the last instruction of its source and the first
+//    instruction of its target.
 //
 // Arguments:
 //
-//    block - [in] A loop header.
+//    forest - [in] The loops of the function.
+//    loop - [in] The number of the loop to describe.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] The function's temporary lifetime, for the block and
+//          debug tag sets.
 //
 //-----------------------------------------------------------------------------
 
 void 
-Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
+Phase::DescribeLoop
+(
+   Phx::Samples::LoopForest ^    forest,
+   int                           loop,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
+)
 {   
+   Phx::Graphs::BasicBlock ^ block = forest->Header(loop);
    Phx::FunctionUnit ^ functionUnit = block->FlowGraph->FunctionUnit;
 
-   // We'll use a bit vector to track the membership of blocks 
-   // in the loop body.
-
-   Phx::BitVector::Sparse ^ loopBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   // Add the header to the loop
-
-   loopBlocks->SetBit(block->Id);
-
-   // We'll use a second bit vector to track the set of blocks whose
-   // predecessors still need to be visited.
-
-   Phx::BitVector::Sparse ^ blocksToVisit = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
-      edge != nullptr; edge = edge->NextPredecessorEdge)
-   {
-      Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-      if (block->Dominates(predBlock))
-      {
-         // Add the backedge source to the loop body.
-
-         loopBlocks->SetBit(predBlock->Id);
+   // The forest knows the membership of blocks in the loop body.
 
-         // Add it as a place to start walking from.
-
-         blocksToVisit->SetBit(predBlock->Id);
-      }
-   }
-
-   // Now perform a reverse graph reachability transitive closure.
-
-   while (!blocksToVisit->IsEmpty)
-   {
-      Phx::Graphs::BasicBlock ^ blockToVisit = 
-         block->FlowGraph->Block(blocksToVisit->RemoveFirstBit());
-
-      for (Phx::Graphs::FlowEdge ^ edge = blockToVisit->PredecessorEdgeList; 
-         edge != nullptr; edge = edge->NextPredecessorEdge)
-      {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (!loopBlocks->GetBit(predBlock->Id))
-         {
-            // This block is also in the loop.
-
-            loopBlocks->SetBit(predBlock->Id);
-
-            // And we need to check its predecessors
-
-            blocksToVisit->SetBit(predBlock->Id);
-         }
-      }
-   }
+   Phx::BitVector::Sparse ^ loopBlocks = forest->GetBlocks(loop, lifetime);
 
    // Determine what lines these blocks represent. First form the set of debug tags.
 
-   Phx::BitVector::Sparse ^ loopTags = Phx::BitVector::Sparse::New(block->Graph->Lifetime);
+   Phx::BitVector::Sparse ^ loopTags = Phx::BitVector::Sparse::New(lifetime);
 
    for each (unsigned int blockId in loopBlocks)
    {
@@ -248,42 +187,26 @@ Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
    }
 
    
-   // Find the set of exit blocks...
+   // Describe the exits...
 
    System::String ^ exitDescription = "";
    isFirst = true;
 
-   Phx::BitVector::Sparse ^ exitBlocks = 
-      Phx::BitVector::Sparse::New(block->Graph->Lifetime);
-
-   for each (unsigned int blockId in loopBlocks)
+   for each (Phx::Graphs::FlowEdge ^ edge in forest->GetExitEdges(loop))
    {
-      Phx::Graphs::BasicBlock ^ loopBlock = block->FlowGraph->Block(blockId);
-
-      for (Phx::Graphs::FlowEdge ^ edge = loopBlock->SuccessorEdgeList; 
-         edge != nullptr; edge = edge->NextSuccessorEdge)
+      if (!isFirst)
       {
-         Phx::Graphs::BasicBlock ^ successorBlock = edge->SuccessorNode;
-
-         if (!loopBlocks->GetBit(successorBlock->Id))
-         {
-            exitBlocks->SetBit(loopBlock->Id);
-
-            if (!isFirst)
-            {
-               exitDescription += ", ";
-            }
-            isFirst = false;
-
-            Phx::IR::Instruction ^ exitInstruction = loopBlock->LastInstruction;
-            Phx::IR::Instruction ^ targetInstruction = successorBlock->FirstInstruction;
-
-            exitDescription += "from line " 
-               + functionUnit->DebugInfo->GetLineNumber(exitInstruction->DebugTag)
-               + " to "
-               + functionUnit->DebugInfo->GetLineNumber(targetInstruction->DebugTag);
-         }
+         exitDescription += ", ";
       }
+      isFirst = false;
+
+      Phx::IR::Instruction ^ exitInstruction = edge->PredecessorNode->LastInstruction;
+      Phx::IR::Instruction ^ targetInstruction = edge->SuccessorNode->FirstInstruction;
+
+      exitDescription += "from line " 
+         + functionUnit->DebugInfo->GetLineNumber(exitInstruction->DebugTag)
+         + " to "
+         + functionUnit->DebugInfo->GetLineNumber(targetInstruction->DebugTag);
    }
 
    if (isFirst)
@@ -295,13 +218,19 @@ Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
    // Now emit the full set of blocks in the loop and the loop exits.
    
    Phx::IR::Instruction ^ loopHeadLabel = block->FirstInstruction;
+   System::String ^       format = "Found loop: Function {0} file {1} line {2}";
+
+   if (forest->IsIrreducible(loop))
+   {
+      format = "Found irreducible loop: Function {0} file {1} line {2}";
+   }
 
-   System::Console::WriteLine("Found loop: Function {0} file {1} line {2}",
+   output->AppendLine(System::String::Format(format,
       Phx::Utility::Undecorate(functionUnit->NameString, false),
       functionUnit->DebugInfo->GetFileName(loopHeadLabel->DebugTag),
-      functionUnit->DebugInfo->GetLineNumber(loopHeadLabel->DebugTag));
-   System::Console::WriteLine("Body is {0}", loopDescription);
-   System::Console::WriteLine("Exits are {0}", exitDescription);
+      functionUnit->DebugInfo->GetLineNumber(loopHeadLabel->DebugTag)));
+   output->AppendLine(System::String::Format("Body is {0}", loopDescription));
+   output->AppendLine(System::String::Format("Exits are {0}", exitDescription));
 }
 
 //-----------------------------------------------------------------------------
@@ -326,6 +255,11 @@ Phase::FindLoopBody(Phx::Graphs::BasicBlock ^ block)
 void
 PlugIn::RegisterObjects()
 {
+   Phx::Samples::AnalysisCache::RegisterObjects(L"naturalLoopBodiesAndExits",
+      L"NaturalLoopBodiesAndExits.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"naturalLoopBodiesAndExits",
+      L"NaturalLoopBodiesAndExits.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -390,6 +324,9 @@ PlugIn::BuildPhases
 
    Phx::Phases::Phase ^ phase = Phase::New(config);
    basePhase->InsertAfter(phase);
+
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //-----------------------------------------------------------------------------
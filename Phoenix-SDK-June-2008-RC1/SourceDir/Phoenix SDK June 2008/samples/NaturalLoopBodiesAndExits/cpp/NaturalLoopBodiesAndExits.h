@@ -26,10 +26,14 @@ namespace NaturalLoopBodiesAndExits
 //    instance of the phase.  Execute is responsible for performing the
 //    actual work of the phase.
 //
+//    This phase only reads the function it is handed, so it derives from
+//    ParallelFunctionPhase and implements ExecuteFunction instead, and c2
+//    may run it on several functions at once.
+//
 //-----------------------------------------------------------------------------
 
 public
-ref class Phase : Phx::Phases::Phase
+ref class Phase : Phx::Samples::ParallelFunctionPhase
 {
 
 public:
@@ -43,9 +47,11 @@ public:
 protected:
 
    virtual void
-   Execute
+   ExecuteFunction
    (
-      Phx::Unit ^ unit
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
    ) override;
 
 #if defined (PHX_DEBUG_SUPPORT)
@@ -57,7 +63,14 @@ public:
 
 private:
 
-   void FindLoopBody(Phx::Graphs::BasicBlock ^ block);
+   void
+   DescribeLoop
+   (
+      Phx::Samples::LoopForest ^    forest,
+      int                           loop,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
+   );
 
 };
 
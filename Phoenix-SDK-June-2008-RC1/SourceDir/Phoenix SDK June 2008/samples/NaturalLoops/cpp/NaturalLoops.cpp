@@ -8,8 +8,14 @@
 //
 //    Registers the "NaturalLoops" component control.
 //
+//    The phase derives from ParallelFunctionPhase, so c2 may run it on
+//    several functions at once (-threads). Each function's report is
+//    printed as one block, in source order.
+//
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\analysis-cache.h"
+#include "..\..\common\parallel-phase.h"
 #include "NaturalLoops.h"
 
 namespace NaturalLoops
@@ -56,83 +62,183 @@ Phase::New
 //
 // Description:
 //
-//    Execute is the phase's prime mover; all unit-centric processing occurs
-//    here.  Note that Execute might be thought of as a "callback": as the
-//    C2 host compiles each FunctionUnit, passing it from phase to phase, the
-//    plug-in Execute method is called to do its work.
+//    ExecuteFunction is the phase's prime mover; all unit-centric
+//    processing occurs here.  Note that it might be thought of as a
+//    "callback": as the C2 host compiles each FunctionUnit, passing it from
+//    phase to phase, ParallelFunctionPhase::Execute calls it to do its work.
 //
 // Arguments:
 //
-//    unit - [in] The unit to process.
+//    functionUnit - [in] The function to process.
+//    output - [in] The buffer for the function's report.
+//    lifetime - [in] Temporary lifetime for the function, unused.
 //
 // Remarks:
 //
-//    Since IR exists only at the FunctionUnit level, we ignore ModuleUnits.
+//    Since IR exists only at the FunctionUnit level, the base class ignores
+//    ModuleUnits.
 //
-//    The order of units in a compiland passed to Execute is indeterminate.
+//    The order in which c2 hands the units of a compiland to the phase is
+//    indeterminate, but the reports are printed in source order.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   if (!unit->IsFunctionUnit)
+   // The cache reuses a flow graph an earlier phase left on the unit. One
+   // it builds itself it deletes in the release phase that follows this
+   // one, so later phases see the unit as they would without the plug-in.
+
+   Phx::Samples::AnalysisCache ^ cache = Phx::Samples::AnalysisCache::Get(functionUnit);
+
+   if (Phase::TimeControl->IsEnabled(functionUnit))
    {
-      return;
+      this->TimeLoopFinding(cache, output, lifetime);
    }
 
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
+   Phx::Samples::LoopForest ^ forest = cache->Loops;
 
-   functionUnit->BuildFlowGraph();
+   // Report each loop once, visiting the headers in depth first post order.
 
-   Phx::Graphs::FlowGraph ^ flowGraph = functionUnit->FlowGraph;
+   Phx::Samples::GraphOrder ^ order = forest->Order;
 
-   flowGraph->BuildDominators();
+   for (int position = order->BlockCount; position >= 1; position--)
+   {
+      Phx::Graphs::BasicBlock ^ block = order->BlockInReversePostorder(position);
+      int                       loop = forest->LoopHeadedBy(block);
 
-   // Remember loops that we've already seen by putting their IDs in this bit vector.
+      if (loop == 0)
+      {
+         continue;
+      }
 
-   Phx::BitVector::Sparse ^ loopHeaders = 
-      Phx::BitVector::Sparse::New(flowGraph->Lifetime);
+      Phx::IR::Instruction ^ loopHeadLabel = block->FirstInstruction;
+      System::String ^       format = "Found loop: Function {0} file {1} line {2}";
 
-   // Walk flow graph in depth first post order
+      if (forest->IsIrreducible(loop))
+      {
+         format = "Found irreducible loop: Function {0} file {1} line {2}";
+      }
+
+      output->AppendLine(System::String::Format(format,
+         Phx::Utility::Undecorate(functionUnit->NameString, false),
+         functionUnit->DebugInfo->GetFileName(loopHeadLabel->DebugTag),
+         functionUnit->DebugInfo->GetLineNumber(loopHeadLabel->DebugTag)));
+   }
+}
 
-   Phx::Graphs::NodeFlowOrder ^ postOrder = 
-      Phx::Graphs::NodeFlowOrder::New(flowGraph->Lifetime);
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Time finding the loops of the function both ways: with dominators,
+//    the back edges they identify, and a backward walk per loop for its
+//    body; and with a LoopForest.
+//
+// Remarks:
+//
+//    The dominator-based loop bodies are what the loop samples used to
+//    compute for themselves. Their cost grows with the nesting depth, so
+//    the difference shows on functions with deeply nested loops.
+//
+//    The forest timed here is built afresh rather than taken from the
+//    cache, so that the cost of building it is what gets measured. The
+//    bit vectors of the bodies come from the function's temporary
+//    lifetime, which the base class deletes when the function is done.
+//
+//-----------------------------------------------------------------------------
 
-   postOrder->Build(flowGraph, Phx::Graphs::Order::PostOrder);
+void
+Phase::TimeLoopFinding
+(
+   Phx::Samples::AnalysisCache ^ cache,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
+)
+{
+   Phx::Graphs::FlowGraph ^         flowGraph = cache->FlowGraph;
+   Phx::FunctionUnit ^              functionUnit = flowGraph->FunctionUnit;
+   System::Diagnostics::Stopwatch ^ clock = System::Diagnostics::Stopwatch::StartNew();
+   int                              bodyBlockCount = 0;
 
-   for (unsigned int i = 1; i <= postOrder->NodeCount; ++i)
+   cache->BuildDominators();
+
+   Phx::BitVector::Sparse ^ blocksToVisit = Phx::BitVector::Sparse::New(lifetime);
+
+   for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
    {
-      Phx::Graphs::BasicBlock ^ block = postOrder->Node(i)->AsBasicBlock;
+      Phx::BitVector::Sparse ^ loopBlocks = nullptr;
 
       for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList; 
          edge != nullptr; edge = edge->NextPredecessorEdge)
       {
-         Phx::Graphs::BasicBlock ^ predBlock = edge->PredecessorNode;
-
-         if (block->Dominates(predBlock))
+         if (block->Dominates(edge->PredecessorNode))
          {
-            // Do we know about this header already?
-
-            if (!loopHeaders->GetBit(block->Id))
+            if (loopBlocks == nullptr)
             {
-               Phx::IR::Instruction ^ loopHeadLabel = block->FirstInstruction;
+               loopBlocks = Phx::BitVector::Sparse::New(lifetime);
+               loopBlocks->SetBit(block->Id);
+               bodyBlockCount++;
+            }
 
-               System::Console::WriteLine("Found loop: Function {0} file {1} line {2}",
-                  Phx::Utility::Undecorate(functionUnit->NameString, false),
-                  functionUnit->DebugInfo->GetFileName(loopHeadLabel->DebugTag),
-                  functionUnit->DebugInfo->GetLineNumber(loopHeadLabel->DebugTag));
+            if (!loopBlocks->GetBit(edge->PredecessorNode->Id))
+            {
+               loopBlocks->SetBit(edge->PredecessorNode->Id);
+               blocksToVisit->SetBit(edge->PredecessorNode->Id);
+               bodyBlockCount++;
             }
+         }
+      }
+
+      while (!blocksToVisit->IsEmpty)
+      {
+         Phx::Graphs::BasicBlock ^ blockToVisit = 
+            flowGraph->Block(blocksToVisit->RemoveFirstBit());
 
-            loopHeaders->SetBit(block->Id);
+         for (Phx::Graphs::FlowEdge ^ edge = blockToVisit->PredecessorEdgeList; 
+            edge != nullptr; edge = edge->NextPredecessorEdge)
+         {
+            if (!loopBlocks->GetBit(edge->PredecessorNode->Id))
+            {
+               loopBlocks->SetBit(edge->PredecessorNode->Id);
+               blocksToVisit->SetBit(edge->PredecessorNode->Id);
+               bodyBlockCount++;
+            }
          }
       }
+
+      if (loopBlocks != nullptr)
+      {
+         loopBlocks->Delete();
+      }
    }
 
-   functionUnit->DeleteFlowGraph();
+   double dominatorMilliseconds = clock->Elapsed.TotalMilliseconds;
+
+   clock->Reset();
+   clock->Start();
+
+   Phx::Samples::LoopForest ^ forest = Phx::Samples::LoopForest::New(flowGraph);
+
+   double forestMilliseconds = clock->Elapsed.TotalMilliseconds;
+
+   output->AppendLine(System::String::Format(
+      "Loop finding for {0}: {1} blocks, {2} loops, depth {3}, {4} body blocks",
+      gcnew array<System::Object ^> {
+         Phx::Utility::Undecorate(functionUnit->NameString, false),
+         flowGraph->NodeCount, forest->LoopCount, forest->MaxDepth, bodyBlockCount
+      }));
+   output->AppendLine(System::String::Format(
+      "   dominators and bodies {0:F3} ms, loop forest {1:F3} ms",
+      dominatorMilliseconds, forestMilliseconds));
+
+   blocksToVisit->Delete();
 }
 
 //-----------------------------------------------------------------------------
@@ -157,6 +263,15 @@ Phase::Execute
 void
 PlugIn::RegisterObjects()
 {
+   Phx::Samples::AnalysisCache::RegisterObjects(L"naturalLoops", L"NaturalLoops.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"naturalLoops",
+      L"NaturalLoops.cpp");
+
+   Phase::TimeControl =
+      Phx::Controls::SetBooleanControl::New(L"naturalLoopsTime",
+         L"Time finding loops with dominators and with a loop forest",
+         L"NaturalLoops.cpp");
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -221,6 +336,9 @@ PlugIn::BuildPhases
 
    Phx::Phases::Phase ^ phase = Phase::New(config);
    basePhase->InsertAfter(phase);
+
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //-----------------------------------------------------------------------------
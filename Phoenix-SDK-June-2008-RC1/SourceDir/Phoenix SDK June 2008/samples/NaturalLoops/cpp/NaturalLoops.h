@@ -26,10 +26,14 @@ namespace NaturalLoops
 //    instance of the phase.  Execute is responsible for performing the
 //    actual work of the phase.
 //
+//    This phase only reads the function it is handed, so it derives from
+//    ParallelFunctionPhase and implements ExecuteFunction instead, and c2
+//    may run it on several functions at once.
+//
 //-----------------------------------------------------------------------------
 
 public
-ref class Phase : Phx::Phases::Phase
+ref class Phase : Phx::Samples::ParallelFunctionPhase
 {
 
 public:
@@ -43,11 +47,17 @@ public:
 protected:
 
    virtual void
-   Execute
+   ExecuteFunction
    (
-      Phx::Unit ^ unit
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
    ) override;
 
+public:
+
+   static Phx::Controls::SetBooleanControl ^ TimeControl;
+
 #if defined (PHX_DEBUG_SUPPORT)
 
 public:
@@ -55,6 +65,16 @@ public:
 
 #endif
 
+private:
+
+   void
+   TimeLoopFinding
+   (
+      Phx::Samples::AnalysisCache ^ cache,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
+   );
+
 };
 
 //-----------------------------------------------------------------------------
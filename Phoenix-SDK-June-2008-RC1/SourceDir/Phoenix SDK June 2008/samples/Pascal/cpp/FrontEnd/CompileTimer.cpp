@@ -0,0 +1,508 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Implementation of the CompileTimer class.
+//
+// Remarks:
+//
+//-----------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "CompileTimer.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+namespace Pascal
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Enables timing for the rest of the compilation.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::Enable()
+{
+   if (clock != nullptr)
+   {
+      return;
+   }
+
+   openStages = gcnew Stack<Sample ^>();
+   openPhases = gcnew Stack<Sample ^>();
+   samples = gcnew List<Sample ^>();
+   totals = gcnew Dictionary<String ^, Total ^>();
+   totalOrder = gcnew List<String ^>();
+   innermost = nullptr;
+   clock = Stopwatch::StartNew();
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Starts timing the given front-end stage for the given unit.
+//
+// Remarks:
+//
+//    Stages may be nested; End always closes the innermost one.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::Begin
+(
+   String ^ name,
+   String ^ unitName
+)
+{
+   if (! IsEnabled)
+   {
+      return;
+   }
+
+   Sample ^ sample = Start(name, "frontend", nullptr);
+   sample->UnitName = unitName;
+   openStages->Push(sample);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Stops timing the most recently started front-end stage.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::End()
+{
+   if (! IsEnabled || openStages->Count == 0)
+   {
+      return;
+   }
+
+   Stop(openStages->Pop(), nullptr);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Times each phase of the given configuration.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::Attach
+(
+   Phx::Phases::PhaseConfiguration ^ configuration
+)
+{
+   if (! IsEnabled)
+   {
+      return;
+   }
+
+   configuration->PrePhaseEvent.Insert(
+      gcnew Phx::Phases::PhaseConfiguration::InterPhaseEventDelegate(
+         &CompileTimer::PrePhase));
+   configuration->PostPhaseEvent.Insert(
+      gcnew Phx::Phases::PhaseConfiguration::InterPhaseEventDelegate(
+         &CompileTimer::PostPhase));
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Pre-phase event handler; starts timing the given phase.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::PrePhase
+(
+   Phx::Unit ^          unit,
+   Phx::Phases::Phase ^ phase
+)
+{
+   Sample ^ sample = Start(phase->NameString, "phase", unit);
+   sample->UnitName = unit->NameString;
+   openPhases->Push(sample);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Post-phase event handler; stops timing the given phase.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::PostPhase
+(
+   Phx::Unit ^          unit,
+   Phx::Phases::Phase ^ phase
+)
+{
+   if (openPhases->Count == 0)
+   {
+      return;
+   }
+
+   Stop(openPhases->Pop(), unit);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Starts a measurement.
+//
+// Remarks:
+//
+//    Stages and phases nest properly in time, so the measurement that
+//    was innermost when this one started is its parent.
+//
+// Returns:
+//
+//    The new measurement, holding the counter values at the start.
+//
+//-----------------------------------------------------------------------------
+
+CompileTimer::Sample ^
+CompileTimer::Start
+(
+   String ^    name,
+   String ^    category,
+   Phx::Unit ^ unit
+)
+{
+   Sample ^ sample = gcnew Sample();
+   sample->Name = name;
+   sample->Category = category;
+   sample->Parent = innermost;
+   sample->Instructions = CountInstructions(unit);
+   sample->ManagedBytes = GC::GetTotalMemory(false);
+   sample->Collections = GC::CollectionCount(0);
+   sample->NativeBytes = GetNativeBytes();
+
+   innermost = sample;
+
+   // Read the clock last so that the counters are not timed.
+
+   sample->StartTicks = clock->ElapsedTicks;
+   return sample;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Completes the given measurement and adds it to the totals.
+//
+// Remarks:
+//
+//    The managed heap size can shrink across a collection, so negative
+//    growth is reported as zero; the collection count shows that a
+//    collection happened.
+//
+//    The elapsed time is also charged to the parent as child time, so
+//    that each measurement's self time excludes the ones nested in it.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::Stop
+(
+   Sample ^    sample,
+   Phx::Unit ^ unit
+)
+{
+   sample->ElapsedTicks = clock->ElapsedTicks - sample->StartTicks;
+
+   innermost = sample->Parent;
+   if (sample->Parent != nullptr)
+   {
+      sample->Parent->ChildTicks += sample->ElapsedTicks;
+   }
+
+   if (unit != nullptr)
+   {
+      sample->Instructions = CountInstructions(unit) - sample->Instructions;
+   }
+   else
+   {
+      sample->Instructions = 0;
+   }
+   sample->ManagedBytes =
+      Math::Max(0LL, GC::GetTotalMemory(false) - sample->ManagedBytes);
+   sample->Collections = GC::CollectionCount(0) - sample->Collections;
+   sample->NativeBytes = GetNativeBytes() - sample->NativeBytes;
+
+   samples->Add(sample);
+
+   Total ^ total;
+   if (! totals->TryGetValue(sample->Name, total))
+   {
+      total = gcnew Total();
+      total->Name = sample->Name;
+      totals->Add(sample->Name, total);
+      totalOrder->Add(sample->Name);
+   }
+
+   total->Count++;
+   total->ElapsedTicks += sample->ElapsedTicks;
+   total->MaximumTicks = Math::Max(total->MaximumTicks, sample->ElapsedTicks);
+   total->SelfTicks += sample->ElapsedTicks - sample->ChildTicks;
+   total->Instructions += sample->Instructions;
+   total->ManagedBytes += sample->ManagedBytes;
+   total->Collections += sample->Collections;
+   total->NativeBytes += sample->NativeBytes;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Counts the IR instructions in the given unit.
+//
+// Returns:
+//
+//    The number of instructions, or zero if the unit is not a function
+//    unit.
+//
+//-----------------------------------------------------------------------------
+
+int
+CompileTimer::CountInstructions
+(
+   Phx::Unit ^ unit
+)
+{
+   if (unit == nullptr || ! unit->IsFunctionUnit)
+   {
+      return 0;
+   }
+
+   int count = 0;
+   for each (Phx::IR::Instruction ^ instruction
+      in unit->AsFunctionUnit->Instructions)
+   {
+      count++;
+   }
+   return count;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Retrieves the private bytes of the process.
+//
+// Remarks:
+//
+//    This covers native allocations made by Phoenix and the runtime, as
+//    well as the managed heap's own commits.
+//
+// Returns:
+//
+//    The number of private bytes, or zero if it cannot be determined.
+//
+//-----------------------------------------------------------------------------
+
+__int64
+CompileTimer::GetNativeBytes()
+{
+   PROCESS_MEMORY_COUNTERS_EX counters;
+   if (! ::GetProcessMemoryInfo(::GetCurrentProcess(),
+         (PROCESS_MEMORY_COUNTERS *) &counters, sizeof counters))
+   {
+      return 0;
+   }
+   return (__int64) counters.PrivateUsage;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Converts Stopwatch ticks to microseconds.
+//
+//-----------------------------------------------------------------------------
+
+double
+CompileTimer::ToMicroseconds
+(
+   __int64 ticks
+)
+{
+   return ticks * 1000000.0 / Stopwatch::Frequency;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Writes the summary table to the given writer.
+//
+// Remarks:
+//
+//    Rows are sorted by self time, longest first. The total includes
+//    nested phases and stages; the self time and the percentage do not,
+//    so the self times add up to the measured time of the compilation.
+//    A phase whose maximum is close to its total on a large input is the
+//    one to look at for quadratic behavior.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::WriteSummary
+(
+   TextWriter ^ writer
+)
+{
+   if (! IsEnabled)
+   {
+      return;
+   }
+
+   List<Total ^> ^ rows = gcnew List<Total ^>();
+   __int64 totalTicks = 0;
+   for each (String ^ name in totalOrder)
+   {
+      rows->Add(totals[name]);
+      totalTicks += totals[name]->SelfTicks;
+   }
+
+   // Stable sort by descending time.
+
+   for (int i = 1; i < rows->Count; i++)
+   {
+      Total ^ row = rows[i];
+      int j = i - 1;
+      while (j >= 0 && rows[j]->SelfTicks < row->SelfTicks)
+      {
+         rows[j + 1] = rows[j];
+         j--;
+      }
+      rows[j + 1] = row;
+   }
+
+   writer->WriteLine();
+   writer->WriteLine(
+      "{0,-36} {1,6} {2,10} {3,10} {4,10} {5,6} {6,10} {7,12} {8,4} "
+      "{9,12}",
+      gcnew array<Object ^> {
+         "Phase", "Count", "Total ms", "Self ms", "Max ms", "%", "Instrs",
+         "Managed B", "GCs", "Native B"
+      });
+
+   for each (Total ^ row in rows)
+   {
+      String ^ name = row->Name;
+      if (name->Length > 36)
+      {
+         name = name->Substring(0, 36);
+      }
+
+      writer->WriteLine(
+         "{0,-36} {1,6} {2,10:F2} {3,10:F2} {4,10:F2} {5,6:F1} {6,10} "
+         "{7,12} {8,4} {9,12}",
+         gcnew array<Object ^> {
+            name,
+            row->Count,
+            ToMicroseconds(row->ElapsedTicks) / 1000.0,
+            ToMicroseconds(row->SelfTicks) / 1000.0,
+            ToMicroseconds(row->MaximumTicks) / 1000.0,
+            (totalTicks > 0) ? 100.0 * row->SelfTicks / totalTicks : 0.0,
+            row->Instructions,
+            row->ManagedBytes,
+            row->Collections,
+            row->NativeBytes
+         });
+   }
+
+   writer->WriteLine("{0,-36} {1,6} {2,10} {3,10:F2}",
+      "Total", samples->Count, String::Empty,
+      ToMicroseconds(totalTicks) / 1000.0);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Writes all measurements to the given file in Chrome trace-event
+//    format.
+//
+// Remarks:
+//
+//    Each measurement becomes a complete ("X") event. Front-end stages
+//    and phases are written to separate threads so that nested stages
+//    display correctly in the trace viewer.
+//
+//-----------------------------------------------------------------------------
+
+void
+CompileTimer::WriteTrace
+(
+   String ^ fileName
+)
+{
+   if (! IsEnabled)
+   {
+      return;
+   }
+
+   StreamWriter ^ writer = gcnew StreamWriter(fileName);
+   try
+   {
+      writer->WriteLine("{\"traceEvents\":[");
+
+      for (int i = 0; i < samples->Count; i++)
+      {
+         Sample ^ sample = samples[i];
+         writer->Write(String::Format(
+            System::Globalization::CultureInfo::InvariantCulture,
+            "{{\"name\":\"{0}\",\"cat\":\"{1}\",\"ph\":\"X\","
+            "\"ts\":{2:F3},\"dur\":{3:F3},\"pid\":1,\"tid\":{4},"
+            "\"args\":{{\"unit\":\"{5}\",\"instructions\":{6},"
+            "\"managedBytes\":{7},\"collections\":{8},"
+            "\"nativeBytes\":{9}}}}}",
+            gcnew array<Object ^> {
+               Utility::EscapeJson(sample->Name),
+               sample->Category,
+               ToMicroseconds(sample->StartTicks),
+               ToMicroseconds(sample->ElapsedTicks),
+               sample->Category->Equals("phase") ? 2 : 1,
+               Utility::EscapeJson(sample->UnitName),
+               sample->Instructions,
+               sample->ManagedBytes,
+               sample->Collections,
+               sample->NativeBytes
+            }));
+         writer->WriteLine((i + 1 < samples->Count) ? "," : String::Empty);
+      }
+
+      writer->WriteLine("]}");
+   }
+   finally
+   {
+      writer->Close();
+   }
+}
+
+}  // namespace Pascal
@@ -0,0 +1,209 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Definition of the CompileTimer class.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+using namespace System;
+using namespace System::IO;
+using namespace System::Diagnostics;
+using namespace System::Collections::Generic;
+
+namespace Pascal
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description: Records where compile time goes, for the /timing control.
+//
+// Remarks:
+//
+//    Front-end stages (parsing, IR building, writing objects and linking)
+//    are bracketed with Begin and End. Back-end phases are timed through
+//    the pre- and post-phase events of the phase configuration, so every
+//    phase in the list is covered, including target and plug-in phases.
+//
+//    Each measurement records wall time, both in total and excluding the
+//    measurements nested in it, the change in the number of IR
+//    instructions in the function unit, the managed heap growth and
+//    collection count, and the change in the process's private (native)
+//    bytes. Measurements are aggregated by name for the summary table and
+//    kept individually for the Chrome trace-event file.
+//
+//    When timing is disabled, Begin, End and Attach do nothing.
+//
+//-----------------------------------------------------------------------------
+
+ref class CompileTimer sealed
+{
+public:
+
+   // Enables timing for the rest of the compilation.
+
+   static void Enable();
+
+   // Starts timing the given front-end stage for the given unit.
+
+   static void
+   Begin
+   (
+      String ^ name,
+      String ^ unitName
+   );
+
+   // Stops timing the most recently started front-end stage.
+
+   static void End();
+
+   // Times each phase of the given configuration.
+
+   static void
+   Attach
+   (
+      Phx::Phases::PhaseConfiguration ^ configuration
+   );
+
+   // Writes the summary table to the given writer.
+
+   static void
+   WriteSummary
+   (
+      TextWriter ^ writer
+   );
+
+   // Writes all measurements to the given file in Chrome trace-event
+   // format.
+
+   static void
+   WriteTrace
+   (
+      String ^ fileName
+   );
+
+   // Determines whether timing is enabled.
+
+   static property bool IsEnabled
+   {
+      bool get()
+      {
+         return clock != nullptr;
+      }
+   }
+
+private:
+
+   // A measurement in progress or completed.
+
+   ref struct Sample
+   {
+      String ^ Name;
+      String ^ Category;
+      String ^ UnitName;
+      Sample ^ Parent;
+      __int64  StartTicks;
+      __int64  ElapsedTicks;
+      __int64  ChildTicks;
+      int      Instructions;
+      __int64  ManagedBytes;
+      int      Collections;
+      __int64  NativeBytes;
+   };
+
+   // Totals for all measurements with the same name.
+
+   ref struct Total
+   {
+      String ^ Name;
+      int      Count;
+      __int64  ElapsedTicks;
+      __int64  SelfTicks;
+      __int64  MaximumTicks;
+      __int64  Instructions;
+      __int64  ManagedBytes;
+      int      Collections;
+      __int64  NativeBytes;
+   };
+
+   // Starts a measurement; the counters hold their values at the start
+   // until Stop replaces them with the differences.
+
+   static Sample ^
+   Start
+   (
+      String ^    name,
+      String ^    category,
+      Phx::Unit ^ unit
+   );
+
+   // Completes the given measurement.
+
+   static void
+   Stop
+   (
+      Sample ^    sample,
+      Phx::Unit ^ unit
+   );
+
+   // Counts the IR instructions in the given unit; zero for units
+   // other than function units.
+
+   static int CountInstructions(Phx::Unit ^ unit);
+
+   // Retrieves the private bytes of the process.
+
+   static __int64 GetNativeBytes();
+
+   // Converts Stopwatch ticks to microseconds.
+
+   static double ToMicroseconds(__int64 ticks);
+
+   // Pre- and post-phase event handlers.
+
+   static void
+   PrePhase
+   (
+      Phx::Unit ^          unit,
+      Phx::Phases::Phase ^ phase
+   );
+
+   static void
+   PostPhase
+   (
+      Phx::Unit ^          unit,
+      Phx::Phases::Phase ^ phase
+   );
+
+private:
+
+   static Stopwatch ^ clock;
+
+   // Front-end stages that have been started but not ended.
+
+   static Stack<Sample ^> ^ openStages;
+
+   // Phases that are running; a phase may contain a nested phase list.
+
+   static Stack<Sample ^> ^ openPhases;
+
+   // All completed measurements, in completion order.
+
+   static List<Sample ^> ^ samples;
+
+   // The measurement that started most recently and is still running.
+
+   static Sample ^ innermost;
+
+   // Totals by measurement name, and the names in first-seen order.
+
+   static Dictionary<String ^, Total ^> ^ totals;
+   static List<String ^> ^ totalOrder;
+};
+
+}  // namespace Pascal
@@ -13,11 +13,11 @@ using namespace System;
 #include "PrettyPrinter.h"
 #include "Evaluator.h"
 #include "Phases.h"
+#include "Linker.h"
+#include "CompileTimer.h"
 
 using namespace Pascal;
 
-extern bool InitScanner(char* file_name);
-
 // Delegate for StringControl broadcast messages.
 
 delegate void ProcessStringControl(String ^ command);
@@ -80,6 +80,15 @@ public:
            
       InitializePhoenix(args);
 
+      // Start the compile-time profile if /timing or /timingtrace: 
+      // was supplied on the command-line.
+
+      if (timing->GetValue(nullptr) 
+         || ! String::IsNullOrEmpty(timingTrace->GetValue(nullptr)))
+      {
+         CompileTimer::Enable();
+      }
+
       // Ensure we received at least one source file to process.
       
       if (fileNames == nullptr || fileNames->Count == 0)
@@ -93,6 +102,7 @@ public:
             // ReportFatalError throws this exception by default;
             // just catch it and do nothing.
          }
+         Output::Flush();
 
          // Report usage to the user and exit.
 
@@ -100,6 +110,22 @@ public:
          return Exit(-1);
       }
 
+      // Apply the diagnostic options.
+
+      int limit;
+      if (! String::IsNullOrEmpty(errorLimit->GetValue(nullptr))
+         && Int32::TryParse(errorLimit->GetValue(nullptr), limit)
+         && limit >= 0)
+      {
+         Output::DiagnosticLimit = limit;
+      }
+
+      if (! String::IsNullOrEmpty(diagnosticLog->GetValue(nullptr)))
+      {
+         Output::DiagnosticLogWriter = 
+            gcnew StreamWriter(diagnosticLog->GetValue(nullptr));
+      }
+
       // Process each source file.
 
       int totalErrors = 0;
@@ -146,8 +172,7 @@ public:
 
          // Reset error, warning counts for next file.
 
-         Output::ErrorCount = 0;
-         Output::WarningCount = 0;
+         Output::ResetCounts();
       }
 
       // Build the final executable if no errors were 
@@ -179,6 +204,24 @@ public:
          );
       }      
 
+      // Report the compile-time profile.
+
+      if (CompileTimer::IsEnabled)
+      {
+         Output::Flush();
+
+         TextWriter ^ writer = Output::MessageWriter;
+         if (writer == nullptr)
+            writer = Output::DefaultWriter;
+         CompileTimer::WriteSummary(writer);
+
+         String ^ traceFileName = timingTrace->GetValue(nullptr);
+         if (! String::IsNullOrEmpty(traceFileName))
+         {
+            CompileTimer::WriteTrace(traceFileName);
+         }
+      }
+
       return Exit(-totalErrors);
    }
 
@@ -195,6 +238,27 @@ private:
       Phx::Targets::Runtimes::Runtime ^ runtime =
          Phx::GlobalData::GetFirstTargetRuntime();
 
+      // Write any string constants created by the back-end phases.
+
+      ModuleBuilder::LayoutStringSection();
+
+      // If /strstats was supplied on the command-line, report the
+      // string data saved by sharing constants.
+
+      if (reportStringStatistics->GetValue(nullptr))
+      {
+         Output::ReportMessage(String::Format(
+            "{0}: {1} byte(s) of string data requested, {2} emitted, "
+            "{3} saved.",
+            Path::GetFileName(targetFileName),
+            ModuleBuilder::StringBytesRequested,
+            ModuleBuilder::StringBytesEmitted,
+            ModuleBuilder::StringBytesRequested 
+               - ModuleBuilder::StringBytesEmitted
+            )
+         );
+      }
+
       // Prepare to write the object file.
 
       Phx::Coff::ObjectWriter ^ objectWriter = Phx::Coff::ObjectWriter::New(
@@ -216,7 +280,9 @@ private:
          )
       );
       
+      CompileTimer::Begin("WriteObject", Path::GetFileName(targetFileName));
       objectWriter->Write();
+      CompileTimer::End();
 
       // Add the target filename to the list of object files.
 
@@ -230,14 +296,6 @@ private:
       bool debug
    )
    {
-      // Collect the names of each object file in the final image.
-
-      Text::StringBuilder ^ builder = gcnew Text::StringBuilder();
-      for each (String ^ objectFile in objectFiles)
-      {
-         builder->AppendFormat("\"{0}\" ", objectFile);
-      }
-
       // Set the linker output path.
 
       String ^ outFile = Path::Combine(
@@ -245,36 +303,20 @@ private:
          outputFileName
          ); 
 
-      // Append dependent runtime libraries.
-
-      builder->Append("mspvcrt.lib Kernel32.lib User32.lib ");
-
-      // Suppress linker startup banner.
-
-      builder->Append("/NOLOGO ");
-      
-      // Specifiy /OUT path.
-      // Also specify /DEBUG and /PDB options for Debug builds.
-
-      builder->AppendFormat("/OUT:\"{0}\"", outFile);
-
-      if (debug)
-      {
-         builder->AppendFormat(" /PDB:\"{0}\"", 
-            Path::ChangeExtension(outFile, ".pdb")
-         );
-      }
-      
-      // Execute link.exe.
+      // Link the image. The Linker only runs link.exe when the image is
+      // out of date.
 
-      Output::ReportMessage(Environment::NewLine + "Linking...");
+      CompileTimer::Begin("Link", outputFileName);
 
-      int exitCode = Utility::ExecuteProcess(
-         "link.exe", 
-         builder->ToString(),
-         true
+      int exitCode = Linker::Link(
+         objectFiles,
+         outFile,
+         debug,
+         externalLink->GetValue(nullptr)
       );
 
+      CompileTimer::End();
+
       return exitCode;
    }
 
@@ -351,6 +393,10 @@ private:
 
       Phx::GlobalData::BuildPlugInPhases(configuration);
 
+      // Time each phase if /timing was supplied on the command-line.
+
+      CompileTimer::Attach(configuration);
+
       return configuration;
    }
 
@@ -415,9 +461,10 @@ private:
          return nullptr;
       }      
 
-      // Point yyin to the input stream.
+      // Point the scanner to the input file, mapping it into memory
+      // if /map was supplied on the command-line.
       
-      if (! InitScanner(path))
+      if (! InitScanner(path, mapInput->GetValue(nullptr)))
       {
          Output::ReportError(0, Error::InvalidFile, fileName);
          delete[] path;
@@ -426,9 +473,27 @@ private:
       
       delete[] path;
 
-      // Parse the input.
+      // If /lexbench was supplied on the command-line, only run the 
+      // scanner over the input.
+
+      if (scannerBenchmark->GetValue(nullptr))
+      {
+         ReportScannerThroughput(fileName);
+         ReleaseScanner();
+         return nullptr;
+      }
+
+      // Parse the input. The AST copies everything it needs out of the
+      // token slices, so the mapped view can be released right away.
 
+      CompileTimer::Begin("Parse", Path::GetFileName(fileName));
       Ast::Node ^ astRoot = Parse();
+      CompileTimer::End();
+      ReleaseScanner();
+
+      // Write any syntax errors before the listing or generated code.
+
+      Output::Flush();
       
       if (astRoot != nullptr)
       {        
@@ -469,13 +534,27 @@ private:
                );
 
                Evaluator^ evaluator = gcnew Evaluator(fileName);            
-               astRoot->Accept(evaluator);
+
+               CompileTimer::Begin("Evaluate", Path::GetFileName(fileName));
+               try
+               {
+                  astRoot->Accept(evaluator);
+               }
+               finally
+               {
+                  CompileTimer::End();
+               }
+               Output::Flush();
             
                // If no errors were reported, execute the phase list for 
                // each FunctionUnit in the current module.
 
                if (Output::ErrorCount == 0)
                {               
+                  // Lay out the module's string constants.
+
+                  ModuleBuilder::LayoutStringSection();
+
                   for each (Phx::FunctionUnit ^ functionUnit 
                      in ModuleBuilder::FunctionUnits)
                   {
@@ -506,6 +585,55 @@ private:
       return nullptr;
    }
 
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Runs the scanner over the current input file without parsing it
+   //    and reports the scanning throughput.
+   //
+   // Remarks:
+   //
+   //    Only yylex is timed; opening or mapping the file is not included.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   ReportScannerThroughput
+   (
+      String ^ fileName
+   )
+   {
+      __int64 byteCount = (gcnew FileInfo(fileName))->Length;
+      int identifierCount = IdentifierTable::Count;
+      int tokenCount = 0;
+
+      Stopwatch ^ stopwatch = Stopwatch::StartNew();
+      while (yylex() != 0)
+      {
+         tokenCount++;
+      }
+      stopwatch->Stop();
+
+      double seconds = stopwatch->Elapsed.TotalSeconds;
+      double megabytesPerSecond = (seconds > 0.0)
+         ? (byteCount / (1024.0 * 1024.0)) / seconds
+         : 0.0;
+
+      Output::ReportMessage(
+         String::Format("{0}: {1} bytes, {2} tokens, {3} new identifiers "
+            "scanned in {4:F2} ms ({5:F1} MB/s, {6} input).",
+            Path::GetFileName(fileName),
+            byteCount,
+            tokenCount,
+            IdentifierTable::Count - identifierCount,
+            stopwatch->Elapsed.TotalMilliseconds,
+            megabytesPerSecond,
+            IsScannerMapped() ? "mapped" : "stream"
+         )
+      );
+   }
+
    //--------------------------------------------------------------------------
    //
    // Description:
@@ -540,6 +668,14 @@ private:
          optimizeExpressions,
          debugMode,
          clr,
+         mapInput,
+         scannerBenchmark,
+         errorLimit,
+         diagnosticLog,
+         externalLink,
+         reportStringStatistics,
+         timing,
+         timingTrace,
       };
 
       array<Phx::Controls::Control ^>::Sort(
@@ -578,6 +714,14 @@ private:
 
    static int Exit(int exitCode)
    {
+      Output::Flush();
+
+      if (Output::DiagnosticLogWriter)
+      {
+         Output::DiagnosticLogWriter->Close();
+         Output::DiagnosticLogWriter = nullptr;
+      }
+
       if (System::Diagnostics::Debugger::IsAttached)
       {
          System::Console::Write(
@@ -709,6 +853,70 @@ private:
          "Pascal compiler"
       );
 
+      // Boolean control to scan source files from a memory-mapped view.
+
+      mapInput = Phx::Controls::SetBooleanControl::New(
+         "map",
+         "Scan source files in place from a memory-mapped view",
+         "Pascal compiler"
+      );
+
+      // Boolean control to measure scanner throughput.
+
+      scannerBenchmark = Phx::Controls::SetBooleanControl::New(
+         "lexbench",
+         "Report scanner throughput (MB/s) instead of compiling",
+         "Pascal compiler"
+      );
+
+      // Boolean control to always run the external linker.
+
+      externalLink = Phx::Controls::SetBooleanControl::New(
+         "extlink",
+         "Always run link.exe, even when the image is up to date",
+         "Pascal compiler"
+      );
+
+      // Boolean control to report string constant sharing.
+
+      reportStringStatistics = Phx::Controls::SetBooleanControl::New(
+         "strstats",
+         "Report the string data saved by sharing string constants",
+         "Pascal compiler"
+      );
+
+      // Boolean control to report compile-time profiling.
+
+      timing = Phx::Controls::SetBooleanControl::New(
+         "timing",
+         "Report time, IR and allocation counts per phase at exit",
+         "Pascal compiler"
+      );
+
+      // String control to write the compile-time profile as a trace.
+
+      timingTrace = Phx::Controls::StringControl::New(
+         "timingtrace:",
+         "Writes the compile-time profile to the given Chrome trace file",
+         "Pascal compiler"
+      );
+
+      // String control to limit the number of diagnostics per file.
+
+      errorLimit = Phx::Controls::StringControl::New(
+         "errorlimit:",
+         "Maximum number of diagnostics reported per file (0 = no limit)",
+         "Pascal compiler"
+      );
+
+      // String control to write diagnostics to a JSON lines file.
+
+      diagnosticLog = Phx::Controls::StringControl::New(
+         "diaglog:",
+         "Also writes diagnostics to the given file, one JSON object per line",
+         "Pascal compiler"
+      );
+
       // String control to override the default output path.
 
       outpath = Phx::Controls::StringControl::New(
@@ -734,6 +942,14 @@ private:
    static Phx::Controls::SetBooleanControl ^ debugMode;
    static Phx::Controls::SetBooleanControl ^ optimizeExpressions;
    static Phx::Controls::SetBooleanControl ^ clr;
+   static Phx::Controls::SetBooleanControl ^ mapInput;
+   static Phx::Controls::SetBooleanControl ^ scannerBenchmark;
+   static Phx::Controls::SetBooleanControl ^ externalLink;
+   static Phx::Controls::SetBooleanControl ^ reportStringStatistics;
+   static Phx::Controls::SetBooleanControl ^ timing;
+   static Phx::Controls::StringControl     ^ errorLimit;
+   static Phx::Controls::StringControl     ^ diagnosticLog;
+   static Phx::Controls::StringControl     ^ timingTrace;
    static Phx::Controls::StringControl     ^ outpath;    
 
    static Phx::Phases::PhaseConfiguration ^ phaseConfig;
@@ -778,6 +994,7 @@ main
       catch (FatalErrorException ^)
       {
       }
+      Output::Flush();
       termMode = Phx::Term::Mode::Fatal;
    }
 
@@ -792,6 +1009,7 @@ main
       catch (FatalErrorException ^)
       {
       }      
+      Output::Flush();
       termMode = Phx::Term::Mode::Fatal;
    }
   
@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Implementation of the IdentifierTable class.
+//
+// Remarks:
+//
+//-----------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+namespace Pascal
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Returns the handle for the given spelling, adding it to the
+//    table if it has not been seen before.
+//
+// Remarks:
+//
+//    Only a miss allocates; a hit costs one hash and one compare.
+//
+// Returns:
+//
+//    Handle of the identifier.
+//
+//-----------------------------------------------------------------------------
+
+int
+IdentifierTable::Intern
+(
+   const char * start,
+   int          length
+)
+{
+   unsigned hash = Hash(start, length);
+   int mask = slots->Length - 1;
+
+   for (int index = hash & mask; ; index = (index + 1) & mask)
+   {
+      int slot = slots[index];
+      if (slot == 0)
+      {
+         // Not found; add a new entry in this empty slot.
+
+         int handle = names->Count;
+         names->Add(gcnew String(start, 0, length));
+         hashes->Add(hash);
+         slots[index] = handle + 1;
+
+         if (names->Count * 2 > slots->Length)
+         {
+            Grow();
+         }
+         return handle;
+      }
+
+      int handle = slot - 1;
+      if (hashes[handle] == hash && Matches(names[handle], start, length))
+      {
+         return handle;
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Retrieves the name associated with the given handle.
+//
+// Returns:
+//
+//    The identifier name.
+//
+//-----------------------------------------------------------------------------
+
+String ^
+IdentifierTable::GetName
+(
+   int handle
+)
+{
+   Debug::Assert(handle >= 0 && handle < names->Count);
+   return names[handle];
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Computes the FNV-1a hash of the given spelling.
+//
+// Returns:
+//
+//    The hash value.
+//
+//-----------------------------------------------------------------------------
+
+unsigned
+IdentifierTable::Hash
+(
+   const char * start,
+   int          length
+)
+{
+   unsigned hash = 2166136261u;
+   for (int i = 0; i < length; i++)
+   {
+      hash ^= (unsigned char) start[i];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Determines whether the given name has the given spelling.
+//
+// Remarks:
+//
+//    Identifiers are restricted to [a-zA-Z_][a-zA-Z0-9_]* by the scanner,
+//    so each byte corresponds to exactly one character of the name.
+//
+// Returns:
+//
+//    true if the spellings are equal; false otherwise.
+//
+//-----------------------------------------------------------------------------
+
+bool
+IdentifierTable::Matches
+(
+   String ^     name,
+   const char * start,
+   int          length
+)
+{
+   if (name->Length != length)
+   {
+      return false;
+   }
+
+   for (int i = 0; i < length; i++)
+   {
+      if (name[i] != (wchar_t) (unsigned char) start[i])
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Doubles the size of the slot table and rehashes all handles.
+//
+//-----------------------------------------------------------------------------
+
+void
+IdentifierTable::Grow()
+{
+   array<int> ^ newSlots = gcnew array<int>(slots->Length * 2);
+   int mask = newSlots->Length - 1;
+
+   for (int handle = 0; handle < names->Count; handle++)
+   {
+      int index = hashes[handle] & mask;
+      while (newSlots[index] != 0)
+      {
+         index = (index + 1) & mask;
+      }
+      newSlots[index] = handle + 1;
+   }
+
+   slots = newSlots;
+}
+
+}  // namespace Pascal
@@ -0,0 +1,260 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Implementation of the Linker class.
+//
+// Remarks:
+//
+//-----------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "Linker.h"
+
+using namespace System::IO;
+using namespace System::Text;
+using namespace System::Security::Cryptography;
+
+namespace Pascal
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Links the given object files into the given executable.
+//
+// Remarks:
+//
+//    When external is true the fingerprint is not checked and link.exe
+//    is always run.
+//
+// Returns:
+//
+//    The exit code of the link step; 0 on success.
+//
+//-----------------------------------------------------------------------------
+
+int
+Linker::Link
+(
+   List<String ^> ^ objectFiles,
+   String ^         outputFileName,
+   bool             debug,
+   bool             external
+)
+{
+   // Collect the names of each object file in the final image.
+
+   StringBuilder ^ builder = gcnew StringBuilder();
+   for each (String ^ objectFile in objectFiles)
+   {
+      builder->AppendFormat("\"{0}\" ", objectFile);
+   }
+
+   // Append dependent runtime libraries.
+
+   for each (String ^ library in runtimeLibraries)
+   {
+      builder->AppendFormat("{0} ", library);
+   }
+
+   // Suppress linker startup banner.
+
+   builder->Append("/NOLOGO ");
+
+   // Specifiy /OUT path.
+   // Also specify /DEBUG and /PDB options for Debug builds.
+
+   builder->AppendFormat("/OUT:\"{0}\"", outputFileName);
+
+   if (debug)
+   {
+      builder->AppendFormat(" /PDB:\"{0}\"",
+         Path::ChangeExtension(outputFileName, ".pdb")
+      );
+   }
+
+   String ^ arguments = builder->ToString();
+
+   // Reuse the existing image if it was linked from identical inputs.
+
+   String ^ stampFileName = outputFileName + ".link";
+   String ^ fingerprint = nullptr;
+
+   if (! external)
+   {
+      try
+      {
+         fingerprint = ComputeFingerprint(objectFiles, arguments);
+      }
+      catch (IOException ^)
+      {
+         // An unreadable object is link.exe's to report.
+      }
+
+      if (fingerprint != nullptr
+         && File::Exists(outputFileName)
+         && File::Exists(stampFileName)
+         && File::ReadAllText(stampFileName)->Equals(fingerprint))
+      {
+         Output::ReportMessage(String::Format(
+            "{0}Linking...{0}{1} is up to date.",
+            Environment::NewLine, Path::GetFileName(outputFileName)
+            )
+         );
+         return 0;
+      }
+   }
+
+   // Execute link.exe.
+
+   Output::ReportMessage(Environment::NewLine + "Linking...");
+
+   int exitCode = Utility::ExecuteProcess(
+      "link.exe",
+      arguments,
+      true
+   );
+
+   // Record the fingerprint of a successful link; remove a stale one
+   // otherwise.
+
+   try
+   {
+      if (exitCode == 0 && fingerprint != nullptr)
+      {
+         File::WriteAllText(stampFileName, fingerprint);
+      }
+      else if (File::Exists(stampFileName))
+      {
+         File::Delete(stampFileName);
+      }
+   }
+   catch (IOException ^)
+   {
+      // The stamp only saves work on the next build; ignore failures.
+   }
+
+   return exitCode;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Finds the given library on the LIB search path.
+//
+// Returns:
+//
+//    The full path of the library, or nullptr if it was not found.
+//
+//-----------------------------------------------------------------------------
+
+String ^
+Linker::FindLibrary
+(
+   String ^ libraryName
+)
+{
+   if (File::Exists(libraryName))
+   {
+      return Path::GetFullPath(libraryName);
+   }
+
+   String ^ searchPath = Environment::GetEnvironmentVariable("LIB");
+   if (searchPath == nullptr)
+   {
+      return nullptr;
+   }
+
+   for each (String ^ directory in searchPath->Split(L';'))
+   {
+      if (directory->Length == 0)
+      {
+         continue;
+      }
+
+      String ^ libraryPath = Path::Combine(directory->Trim(), libraryName);
+      if (File::Exists(libraryPath))
+      {
+         return libraryPath;
+      }
+   }
+
+   return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Computes the fingerprint of the given link.
+//
+// Remarks:
+//
+//    The fingerprint covers the linker arguments, the path and content of
+//    each object file and the path, size and time stamp of each runtime
+//    library. The objects were just written, so reading them back is
+//    served from the file cache. Their TimeDateStamp, the four bytes at
+//    offset 4 of the COFF file header, changes on every compilation and
+//    is left out.
+//
+// Returns:
+//
+//    The fingerprint as a hexadecimal string.
+//
+//-----------------------------------------------------------------------------
+
+String ^
+Linker::ComputeFingerprint
+(
+   List<String ^> ^ objectFiles,
+   String ^         arguments
+)
+{
+   const int TimeDateStampOffset = 4;
+   const int TimeDateStampSize = 4;
+
+   MD5 ^ hash = MD5::Create();
+
+   array<unsigned char> ^ bytes = Encoding::UTF8->GetBytes(arguments);
+   hash->TransformBlock(bytes, 0, bytes->Length, bytes, 0);
+
+   for each (String ^ objectFile in objectFiles)
+   {
+      bytes = Encoding::UTF8->GetBytes("|" + Path::GetFullPath(objectFile));
+      hash->TransformBlock(bytes, 0, bytes->Length, bytes, 0);
+
+      bytes = File::ReadAllBytes(objectFile);
+      if (bytes->Length >= TimeDateStampOffset + TimeDateStampSize)
+      {
+         Array::Clear(bytes, TimeDateStampOffset, TimeDateStampSize);
+      }
+      hash->TransformBlock(bytes, 0, bytes->Length, bytes, 0);
+   }
+
+   for each (String ^ libraryName in runtimeLibraries)
+   {
+      String ^ libraryPath = FindLibrary(libraryName);
+      FileInfo ^ inputInfo = gcnew FileInfo(
+         libraryPath != nullptr ? libraryPath : libraryName);
+      String ^ identity = String::Format("|{0}|{1:x}|{2:x}",
+         inputInfo->FullName,
+         inputInfo->Exists ? inputInfo->Length : -1,
+         inputInfo->Exists ? inputInfo->LastWriteTimeUtc.Ticks : -1
+      );
+
+      bytes = Encoding::UTF8->GetBytes(identity);
+      hash->TransformBlock(bytes, 0, bytes->Length, bytes, 0);
+   }
+
+   hash->TransformFinalBlock(gcnew array<unsigned char>(0), 0, 0);
+
+   return BitConverter::ToString(hash->Hash)->Replace("-", String::Empty);
+}
+
+}  // namespace Pascal
@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Definition of the Linker class.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+namespace Pascal
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description: Produces the final executable image from the object files
+//              compiled in this session.
+//
+// Remarks:
+//
+//    The image is produced by link.exe. Before running it, the Linker
+//    fingerprints the link options, the content of each object file and
+//    the size and time stamp of each runtime library; if the image on
+//    disk was produced from an identical fingerprint, it is reused and
+//    link.exe is not started.
+//
+//    The object writer stamps each object with the current time, so the
+//    COFF header time stamp is left out of the fingerprint. Rebuilding an
+//    unchanged program therefore skips the link.
+//
+//-----------------------------------------------------------------------------
+
+ref class Linker sealed
+{
+public:
+
+   // Links the given object files into the given executable.
+   // Returns the exit code of the link step (0 on success).
+
+   static int
+   Link
+   (
+      List<String ^> ^ objectFiles,
+      String ^         outputFileName,
+      bool             debug,
+      bool             external
+   );
+
+private:
+
+   // Finds the given library on the LIB search path.
+
+   static String ^
+   FindLibrary
+   (
+      String ^ libraryName
+   );
+
+   // Computes the fingerprint of the given link.
+
+   static String ^
+   ComputeFingerprint
+   (
+      List<String ^> ^ objectFiles,
+      String ^         arguments
+   );
+
+private:
+
+   // Runtime libraries every Pascal program is linked against.
+
+   static array<String ^> ^ runtimeLibraries =
+      { "mspvcrt.lib", "Kernel32.lib", "User32.lib" };
+};
+
+}  // namespace Pascal
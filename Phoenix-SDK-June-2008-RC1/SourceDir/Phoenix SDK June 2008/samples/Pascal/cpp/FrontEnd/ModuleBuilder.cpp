@@ -247,6 +247,13 @@ ModuleBuilder::NewContext()
    stringTable = 
       gcnew Dictionary<String ^, Phx::Symbols::GlobalVariableSymbol ^>();
 
+   stringTypes = gcnew Dictionary<unsigned, Phx::Types::Type ^>();
+
+   pendingStringInstructions = gcnew List<Phx::IR::DataInstruction ^>();
+
+   StringBytesRequested = 0;
+   StringBytesEmitted = 0;
+
    headFunctionUnitData = nullptr;
 
    uniqueSymbolId = 100;
@@ -682,6 +689,10 @@ ModuleBuilder::GetStringSymbol
       stringTable->Add(value, stringSymbol);
    }
 
+   // Account for the bytes an unshared constant would have used.
+
+   StringBytesRequested += value->Length + 1;
+
    // Return the string symbol.
 
    return stringSymbol;
@@ -3496,9 +3507,14 @@ ModuleBuilder::InitializeGlobalConstants
 //
 // Remarks:
 //
+//    The symbol and its data instruction are created here, so the symbol
+//    has its Location from the start. The instruction is appended to the
+//    string section by LayoutStringSection, so that the section is filled
+//    in a single pass once the module's string constants are known.
 //
 // Returns:
 //
+//    The new GlobalVariableSymbol.
 //
 //-----------------------------------------------------------------------------
 
@@ -3514,16 +3530,22 @@ ModuleBuilder::CreateInitializedString
    String ^ stringName = 
       String::Format("$SG{0,-3:G}", externalIdCounter);
 
-   // Create an array type to for the string.
+   // Create an array type for the string, or reuse the one created for
+   // an earlier string of the same size.
 
    unsigned len = (unsigned) value->Length + 1;
 
-   Phx::Types::Type ^ stringType = Phx::Types::UnmanagedArrayType::New(
-      moduleUnit->TypeTable,
-      Phx::Utility::BytesToBits(len),
-      nullptr, 
-      moduleUnit->TypeTable->Character8Type
-   );
+   Phx::Types::Type ^ stringType;
+   if (! stringTypes->TryGetValue(len, stringType))
+   {
+      stringType = Phx::Types::UnmanagedArrayType::New(
+         moduleUnit->TypeTable,
+         Phx::Utility::BytesToBits(len),
+         nullptr, 
+         moduleUnit->TypeTable->Character8Type
+      );
+      stringTypes->Add(len, stringType);
+   }
 
    // Create the global symbol for the string.
 
@@ -3546,7 +3568,7 @@ ModuleBuilder::CreateInitializedString
    stringSymbol->Alignment = 
       Phx::Alignment(Phx::Alignment::Kind::AlignTo1Byte);
 
-   // Write the string to the string data section.
+   // Create the string data and queue it for the string data section.
 
    Phx::IR::DataInstruction ^ stringInstruction = 
       Phx::IR::DataInstruction::New(
@@ -3555,14 +3577,49 @@ ModuleBuilder::CreateInitializedString
       );
 
    stringInstruction->WriteString(0, value);
-   stringSectionSymbol->Section->AppendInstruction(stringInstruction);
-   stringSymbol->Location = Phx::Symbols::DataLocation::New(stringInstruction);
+
+   stringSymbol->Location = 
+      Phx::Symbols::DataLocation::New(stringInstruction);
+
+   pendingStringInstructions->Add(stringInstruction);
+   StringBytesEmitted += len;
 
    externalIdCounter++;
 
    return stringSymbol;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Appends the data of all string constants created since the last
+//    call to the current module's string section.
+//
+// Remarks:
+//
+//    Call this method after the module has been evaluated and again
+//    before it is written; the second call is a no-op unless later
+//    phases created new string constants.
+//
+// Returns:
+//
+//   void
+//
+//-----------------------------------------------------------------------------
+
+void
+ModuleBuilder::LayoutStringSection()
+{
+   for each (Phx::IR::DataInstruction ^ stringInstruction 
+      in pendingStringInstructions)
+   {
+      stringSectionSymbol->Section->AppendInstruction(stringInstruction);
+   }
+
+   pendingStringInstructions->Clear();
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:
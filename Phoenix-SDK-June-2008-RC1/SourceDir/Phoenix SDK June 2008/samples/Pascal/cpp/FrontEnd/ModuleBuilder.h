@@ -120,6 +120,11 @@ public:
       String ^ value
    );
 
+   // Appends the data of all string constants created since the last
+   // call to the current module's string section.
+
+   static void LayoutStringSection();
+
    // Retrieves a non-local variable symbol for the given
    // global variable.
 
@@ -503,6 +508,16 @@ public: // properties
 
    static property Dictionary<unsigned int, int> ^ StringSymbolLengths;
 
+   // The number of bytes of string data requested by the compiler for
+   // the current module, counting every use of every string constant.
+
+   static property int StringBytesRequested;
+
+   // The number of bytes of string data written to the string section
+   // of the current module.
+
+   static property int StringBytesEmitted;
+
    // Retrieves the current symbol table from the symbol stack.
 
    static property Phx::Symbols::Table ^ TopScope
@@ -693,6 +708,13 @@ private: // data
    static Dictionary<String ^, 
       Phx::Symbols::GlobalVariableSymbol ^> ^ stringTable;
 
+   // Caches the character array type for each string size, in bytes.
+   static Dictionary<unsigned, Phx::Types::Type ^> ^ stringTypes;
+
+   // Data of the string constants that has not yet been appended to the
+   // string section.
+   static List<Phx::IR::DataInstruction ^> ^ pendingStringInstructions;
+
    // External identifier used when creating symbols for global variables.
    static unsigned externalIdCounter;   
 
@@ -11,6 +11,7 @@
 
 using namespace System;
 using namespace System::Diagnostics;
+using namespace System::Text;
 
 #include "stdafx.h"
 #include "Ast.h"
@@ -70,6 +71,11 @@ Output::ReportMessage
    String ^ message
 )
 {
+   // Write any pending diagnostics first so that they appear before
+   // this message.
+
+   Flush();
+
    // Format message string.
 
    if (lineNumber >= 0)
@@ -126,8 +132,8 @@ Output::ReportWarning
    Object ^ arg0
 )
 {
-   String ^ message = String::Format(errorMap[warning], arg0);
-   InternalReportMessage(Output::warning, lineNumber, message, (int)warning);
+   RecordDiagnostic(Severity::Warning, lineNumber, warning, 
+      gcnew array<Object ^> { arg0 });
    WarningCount++;
 }
 
@@ -153,8 +159,7 @@ Output::ReportError
    Error error
 )
 {
-   InternalReportMessage(Output::error, lineNumber, 
-      errorMap[error], (int)error);
+   RecordDiagnostic(Severity::Error, lineNumber, error, nullptr);
    ErrorCount++;
 }
 
@@ -181,8 +186,8 @@ Output::ReportError
    Object ^ arg0
 )
 {
-   String ^ message = String::Format(errorMap[error], arg0);
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   RecordDiagnostic(Severity::Error, lineNumber, error, 
+      gcnew array<Object ^> { arg0 });
    ErrorCount++;
 }
 
@@ -210,8 +215,8 @@ Output::ReportError
    Object ^ arg1
 )
 {
-   String ^ message = String::Format(errorMap[error], arg0, arg1);
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   RecordDiagnostic(Severity::Error, lineNumber, error, 
+      gcnew array<Object ^> { arg0, arg1 });
    ErrorCount++;
 }
 
@@ -240,8 +245,8 @@ Output::ReportError
    Object ^ arg2
 )
 {
-   String ^ message = String::Format(errorMap[error], arg0, arg1, arg2);
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   RecordDiagnostic(Severity::Error, lineNumber, error, 
+      gcnew array<Object ^> { arg0, arg1, arg2 });
    ErrorCount++;
 }
 
@@ -308,17 +313,17 @@ void Output::ReportFatalError
    Error error
 )
 {
-   String ^ message = errorMap[error];
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   RecordDiagnostic(Severity::Error, lineNumber, error, nullptr);
    ErrorCount++;
 
-   InternalReportMessage(Output::fatalError, lineNumber, 
-      "unable to recover from previous error(s); stopping compilation.",
-      (int)Error::FatalError);
+   RecordDiagnostic(Severity::FatalError, lineNumber, Error::FatalError, 
+      nullptr);
 
-   // Throw fatal error message. This will be caught by the main() function.
+   // Throw fatal error message. This will be caught by the main() function,
+   // which does not look at the text; the message itself is written with
+   // the recorded diagnostic.
 
-   throw gcnew FatalErrorException(lineNumber, message);
+   throw gcnew FatalErrorException(lineNumber, fatalErrorMessage);
 }
 
 //-----------------------------------------------------------------------------
@@ -343,17 +348,18 @@ void Output::ReportFatalError
    Object ^ arg0
 )
 {
-   String ^ message = String::Format(errorMap[error], arg0);
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   array<Object ^> ^ arguments = gcnew array<Object ^> { arg0 };
+   RecordDiagnostic(Severity::Error, lineNumber, error, arguments);
    ErrorCount++;
 
-   InternalReportMessage(Output::fatalError, lineNumber, 
-      "unable to recover from previous error(s); stopping compilation.", 
-      (int)Error::FatalError);
+   RecordDiagnostic(Severity::FatalError, lineNumber, Error::FatalError, 
+      nullptr);
 
-   // Throw fatal error message. This will be caught by the main() function.
+   // Throw fatal error message. This will be caught by the main() function,
+   // which does not look at the text, so the arguments are formatted only
+   // when the recorded diagnostic is written.
 
-   throw gcnew FatalErrorException(lineNumber, message);
+   throw gcnew FatalErrorException(lineNumber, fatalErrorMessage);
 }
 
 //-----------------------------------------------------------------------------
@@ -380,17 +386,18 @@ Output::ReportFatalError
    Object ^ arg1
 )
 {
-   String ^ message = String::Format(errorMap[error], arg0, arg1);
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   array<Object ^> ^ arguments = gcnew array<Object ^> { arg0, arg1 };
+   RecordDiagnostic(Severity::Error, lineNumber, error, arguments);
    ErrorCount++;
 
-   InternalReportMessage(Output::fatalError, lineNumber, 
-      "unable to recover from previous error(s); stopping compilation.",
-      (int)Error::FatalError);
+   RecordDiagnostic(Severity::FatalError, lineNumber, Error::FatalError, 
+      nullptr);
 
-   // Throw fatal error message. This will be caught by the main() function.
+   // Throw fatal error message. This will be caught by the main() function,
+   // which does not look at the text, so the arguments are formatted only
+   // when the recorded diagnostic is written.
 
-   throw gcnew FatalErrorException(lineNumber, message);
+   throw gcnew FatalErrorException(lineNumber, fatalErrorMessage);
 }
 
 //-----------------------------------------------------------------------------
@@ -418,27 +425,35 @@ Output::ReportFatalError
    Object ^ arg2
 )
 {
-   String ^ message = String::Format(errorMap[error], arg0, arg1, arg2);
-   InternalReportMessage(Output::error, lineNumber, message, (int)error);
+   array<Object ^> ^ arguments = 
+      gcnew array<Object ^> { arg0, arg1, arg2 };
+   RecordDiagnostic(Severity::Error, lineNumber, error, arguments);
    ErrorCount++;
 
-   InternalReportMessage(Output::fatalError, lineNumber, 
-      "unable to recover from previous error(s); stopping compilation.",
-      (int)Error::FatalError);
+   RecordDiagnostic(Severity::FatalError, lineNumber, Error::FatalError, 
+      nullptr);
 
-   // Throw fatal error message. This will be caught by the main() function.
+   // Throw fatal error message. This will be caught by the main() function,
+   // which does not look at the text, so the arguments are formatted only
+   // when the recorded diagnostic is written.
 
-   throw gcnew FatalErrorException(lineNumber, message);
+   throw gcnew FatalErrorException(lineNumber, fatalErrorMessage);
 }
 
 //-----------------------------------------------------------------------------
 //
 // Description:
 //
-//    Internal method for writing strings to the output stream.
+//    Records the given diagnostic for the next Flush.
 //
 // Remarks:
 //
+//    A diagnostic that repeats one already reported for the current source
+//    file is counted but not recorded again. Once DiagnosticLimit distinct
+//    diagnostics have been recorded, further errors and warnings are only 
+//    counted; fatal errors are always recorded. Over the limit, argument
+//    lists are only looked up, so that dropped diagnostics do not grow the
+//    interned lists.
 //
 // Returns:
 //
@@ -447,62 +462,331 @@ Output::ReportFatalError
 //-----------------------------------------------------------------------------
 
 void
-Output::InternalReportMessage
+Output::RecordDiagnostic
 (
-   String ^ messageType, 
-   int      lineNumber,
-   String ^ message,
-   int      messageNumber
+   Severity          severity,
+   int               lineNumber,
+   Error             code,
+   array<Object ^> ^ arguments
 )
 {
-   String ^ output;
+   bool isOverLimit = severity != Severity::FatalError
+      && DiagnosticLimit > 0
+      && reportedDiagnostics->Count >= DiagnosticLimit;
 
-   // Write source file / line information if a valid line number
-   // was provided.
+   int argumentHandle = InternArguments(arguments, ! isOverLimit);
 
-   if (lineNumber >= 0)
+   // An argument list that was never interned cannot belong to a
+   // diagnostic already reported.
+
+   Diagnostic diagnostic(severity, lineNumber, code, argumentHandle);
+
+   if (argumentHandle != -2 && reportedDiagnostics->ContainsKey(diagnostic))
    {
-      output = String::Format(
-         "{0}({1}) ",
-         CurrentSourceFileName, 
-         lineNumber
-      );
+      repeatedCount++;
+      return;
+   }
 
-      if (MessageWriter)
-         MessageWriter->Write(output);
-      else
-         Console::Write(output);
+   if (isOverLimit)
+   {
+      overLimitCount++;
+      return;
    }
 
-   // Add in the message number if one was provided.
+   reportedDiagnostics->Add(diagnostic, true);
+   pendingDiagnostics->Add(diagnostic);
+}
 
-   if (messageNumber >= 0)
-      output = String::Format("{0} P{1}", messageType, messageNumber);
-   else
-      output = messageType;
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Returns the handle for the given argument list.
+//
+// Remarks:
+//
+//    Argument lists are interned by the text of their arguments, so that
+//    two diagnostics reporting the same name compare equal even though 
+//    they were given different argument objects.
+//
+// Returns:
+//
+//   The handle of the argument list, -1 if there are no arguments, or -2
+//   if the list is not interned and isAdding is not set.
+//
+//-----------------------------------------------------------------------------
 
-   // Write the output.
+int
+Output::InternArguments
+(
+   array<Object ^> ^ arguments,
+   bool              isAdding
+)
+{
+   if (arguments == nullptr || arguments->Length == 0)
+   {
+      return -1;
+   }
 
-   if (MessageWriter)
-      MessageWriter->Write(output);
-   else
-   {      
-      if (messageType->Equals(error) || messageType->Equals(fatalError))
+   StringBuilder ^ key = gcnew StringBuilder();
+   for each (Object ^ argument in arguments)
+   {
+      key->Append(argument == nullptr ? String::Empty : argument->ToString());
+      key->Append(L'\0');
+   }
+
+   String ^ keyText = key->ToString();
+   int handle;
+   if (! argumentMap->TryGetValue(keyText, handle))
+   {
+      if (! isAdding)
       {
-         Console::ForegroundColor = System::ConsoleColor::Red;
+         return -2;
+      }
+
+      handle = argumentLists->Count;
+      argumentLists->Add(arguments);
+      argumentMap->Add(keyText, handle);
+   }
+   return handle;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Formats the message text of the given diagnostic.
+//
+// Returns:
+//
+//   The message text.
+//
+//-----------------------------------------------------------------------------
+
+String ^
+Output::FormatDiagnostic
+(
+   Diagnostic diagnostic
+)
+{
+   if (diagnostic.Level == Severity::FatalError)
+   {
+      return fatalErrorMessage;
+   }
+
+   String ^ format = errorMap[diagnostic.Code];
+   if (diagnostic.ArgumentHandle < 0)
+   {
+      return format;
+   }
+   return String::Format(format, argumentLists[diagnostic.ArgumentHandle]);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Formats and writes all pending diagnostics.
+//
+// Remarks:
+//
+//    The whole batch is built in memory and handed to the output stream 
+//    in a single write. Notes are appended for diagnostics that were 
+//    dropped because they repeated an earlier one or exceeded the limit.
+//
+// Returns:
+//
+//   void
+//
+//-----------------------------------------------------------------------------
+
+void
+Output::Flush()
+{
+   if (pendingDiagnostics->Count == 0 
+      && repeatedCount == 0 
+      && overLimitCount == 0)
+   {
+      return;
+   }
+
+   StringBuilder ^ output = gcnew StringBuilder();
+
+   // The console is written entry by entry, each in its own color; the
+   // message writer gets the whole batch at once.
+
+   System::Collections::Generic::List<String ^> ^ entries =
+      gcnew System::Collections::Generic::List<String ^>();
+   System::Collections::Generic::List<bool> ^ entryIsError =
+      gcnew System::Collections::Generic::List<bool>();
+
+   for each (Diagnostic diagnostic in pendingDiagnostics)
+   {
+      String ^ message = FormatDiagnostic(diagnostic);
+      String ^ messageType;
+
+      switch (diagnostic.Level)
+      {
+      case Severity::Warning:
+         messageType = warning;
+         break;
+      case Severity::Error:
+         messageType = error;
+         break;
+      default:
+         messageType = fatalError;
+         break;
+      }
+
+      int entryStart = output->Length;
+
+      // Write source file / line information if a valid line number
+      // was provided.
+
+      if (diagnostic.LineNumber >= 0)
+      {
+         output->AppendFormat("{0}({1}) ", CurrentSourceFileName, 
+            diagnostic.LineNumber);
+      }
+
+      output->AppendFormat("{0} P{1}: {2}", messageType, 
+         (int) diagnostic.Code, message);
+      output->AppendLine();
+
+      entries->Add(output->ToString(entryStart, output->Length - entryStart));
+      entryIsError->Add(diagnostic.Level != Severity::Warning);
+
+      if (DiagnosticLogWriter)
+      {
+         LogDiagnostic(diagnostic, message);
       }
-      Console::Write(output);
-      Console::ResetColor();
    }
 
-   output = String::Format(": {0}", message);
+   int notesStart = output->Length;
+
+   if (repeatedCount > 0)
+   {
+      output->AppendFormat("note: {0} repeated diagnostic(s) not shown.", 
+         repeatedCount);
+      output->AppendLine();
+   }
+
+   if (overLimitCount > 0)
+   {
+      output->AppendFormat(
+         "note: {0} diagnostic(s) over the limit of {1} per file not shown.",
+         overLimitCount, DiagnosticLimit);
+      output->AppendLine();
+   }
+
+   if (output->Length > notesStart)
+   {
+      entries->Add(output->ToString(notesStart, output->Length - notesStart));
+      entryIsError->Add(false);
+   }
+
+   pendingDiagnostics->Clear();
+   repeatedCount = 0;
+   overLimitCount = 0;
+
+   // Write the batch.
 
    if (MessageWriter)
-      MessageWriter->WriteLine(output);
+   {
+      MessageWriter->Write(output->ToString());
+   }
    else
-   {      
-      Console::WriteLine(output);
+   {
+      for (int index = 0; index < entries->Count; index++)
+      {
+         if (entryIsError[index])
+         {
+            Console::ForegroundColor = System::ConsoleColor::Red;
+         }
+         Console::Write(entries[index]);
+         Console::ResetColor();
+      }
    }
+
+   if (DiagnosticLogWriter)
+   {
+      DiagnosticLogWriter->Flush();
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Resets the error and warning counts before the next source file is
+//    compiled.
+//
+// Remarks:
+//
+//    Also forgets the diagnostics reported so far, so that repeats and the
+//    per-file limit are tracked per source file.
+//
+// Returns:
+//
+//   void
+//
+//-----------------------------------------------------------------------------
+
+void
+Output::ResetCounts()
+{
+   Flush();
+
+   ErrorCount = 0;
+   WarningCount = 0;
+
+   reportedDiagnostics->Clear();
+   argumentMap->Clear();
+   argumentLists->Clear();
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Writes the given diagnostic as a JSON object to the diagnostic log.
+//
+// Returns:
+//
+//   void
+//
+//-----------------------------------------------------------------------------
+
+void
+Output::LogDiagnostic
+(
+   Diagnostic diagnostic,
+   String ^   message
+)
+{
+   String ^ severity;
+   switch (diagnostic.Level)
+   {
+   case Severity::Warning:
+      severity = warning;
+      break;
+   case Severity::Error:
+      severity = error;
+      break;
+   default:
+      severity = fatalError;
+      break;
+   }
+
+   DiagnosticLogWriter->WriteLine(String::Format(
+      "{{\"file\":\"{0}\",\"line\":{1},\"severity\":\"{2}\","
+      "\"code\":{3},\"message\":\"{4}\"}}",
+      Utility::EscapeJson(CurrentSourceFileName),
+      diagnostic.LineNumber,
+      severity,
+      (int) diagnostic.Code,
+      Utility::EscapeJson(message)
+   ));
 }
 
 //-----------------------------------------------------------------------------
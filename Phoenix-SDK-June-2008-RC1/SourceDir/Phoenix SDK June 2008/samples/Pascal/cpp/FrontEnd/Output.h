@@ -137,6 +137,75 @@ enum class Error
    InvalidSubrange                     = 3062,
 };
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Severity of a recorded diagnostic.
+//
+//-----------------------------------------------------------------------------
+
+enum class Severity
+{
+   Warning,
+   Error,
+   FatalError
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    A diagnostic recorded for batched output.
+//
+// Remarks: 
+//
+//    The message text is not formatted until the diagnostic is flushed;
+//    the record only holds the source line, the error code and a handle
+//    to the interned argument list (-1 if there are no arguments).
+//    Two records are equal when all of their fields are equal, which is
+//    how repeated diagnostics are detected.
+//    
+//-----------------------------------------------------------------------------
+
+value struct Diagnostic : public IEquatable<Diagnostic>
+{
+public:
+
+   Diagnostic
+   (
+      Severity severity,
+      int      lineNumber,
+      Error    code,
+      int      argumentHandle
+   )
+      : Level(severity)
+      , LineNumber(lineNumber)
+      , Code(code)
+      , ArgumentHandle(argumentHandle)
+   {
+   }
+
+   virtual bool Equals(Diagnostic other)
+   {
+      return this->Level == other.Level
+         && this->LineNumber == other.LineNumber
+         && this->Code == other.Code
+         && this->ArgumentHandle == other.ArgumentHandle;
+   }
+
+   virtual int GetHashCode() override
+   {
+      return (this->LineNumber * 31 + (int) this->Code) * 31 
+         + this->ArgumentHandle;
+   }
+
+   Severity Level;
+   int      LineNumber;
+   Error    Code;
+   int      ArgumentHandle;
+};
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -145,6 +214,12 @@ enum class Error
 //
 // Remarks: 
 //
+//    Errors and warnings are recorded rather than written immediately.
+//    Repeated diagnostics are dropped, at most DiagnosticLimit distinct
+//    diagnostics are kept per source file, and pending diagnostics are
+//    formatted and written in a single write by Flush. Flush is called 
+//    before every informational message, so diagnostics still appear in 
+//    order relative to the rest of the compiler's output.
 //    
 //-----------------------------------------------------------------------------
 
@@ -181,6 +256,25 @@ public:
    static void ReportFatalError(int lineNumber, Error error, Object ^, 
       Object ^, Object ^);
 
+   // Formats and writes all pending diagnostics in one batch.
+
+   static void Flush();
+
+   // Resets the error and warning counts and the per-file diagnostic
+   // limit before the next source file is compiled.
+
+   static void ResetCounts();
+
+   // Maximum number of distinct diagnostics reported per source file; 
+   // zero means no limit. Fatal errors are always reported.
+
+   static property int DiagnosticLimit;
+
+   // Optional writer that receives every flushed diagnostic as one JSON
+   // object per line, for consumption by build tools.
+
+   static property TextWriter ^ DiagnosticLogWriter;
+
    // Writer object for messages.
    
    static property TextWriter ^ MessageWriter;
@@ -213,23 +307,43 @@ private: // methods
    static Output()
    {
       MessageWriter = nullptr;
+      DiagnosticLogWriter = nullptr;
       
       ErrorCount = 0;
       WarningCount = 0;
+      DiagnosticLimit = 100;
+
+      pendingDiagnostics = gcnew List<Diagnostic>();
+      reportedDiagnostics = gcnew Dictionary<Diagnostic, bool>();
+      argumentMap = gcnew Dictionary<String ^, int>();
+      argumentLists = gcnew List<array<Object ^> ^>();
 
       InitializeErrorMap();
    }
 
-   // Internal method for writing strings to the output stream.
+   // Records the given diagnostic for the next Flush.
 
-   static void InternalReportMessage
+   static void RecordDiagnostic
    (
-      String ^ messageType, 
-      int      lineNumber, 
-      String ^ message,
-      int      messageNumber
+      Severity          severity,
+      int               lineNumber,
+      Error             code,
+      array<Object ^> ^ arguments
    );
 
+   // Returns the handle for the given argument list, interning it by
+   // content if isAdding is set.
+
+   static int InternArguments(array<Object ^> ^ arguments, bool isAdding);
+
+   // Formats the message text of the given diagnostic.
+
+   static String ^ FormatDiagnostic(Diagnostic diagnostic);
+
+   // Writes the given diagnostic as a JSON object to the diagnostic log.
+
+   static void LogDiagnostic(Diagnostic diagnostic, String ^ message);
+
    // Initializes the error map.
 
    static void InitializeErrorMap();
@@ -241,10 +355,31 @@ private: // data
    literal String ^ warning = "warning";
    literal String ^ error = "error";
    literal String ^ fatalError = "fatal error";
+   literal String ^ fatalErrorMessage = 
+      "unable to recover from previous error(s); stopping compilation.";
 
    // Maps Error values to their string representations.
 
    static Dictionary<Error, String ^> ^ errorMap;
+
+   // Diagnostics recorded since the last Flush.
+
+   static List<Diagnostic> ^ pendingDiagnostics;
+
+   // Every distinct diagnostic recorded for the current source file.
+
+   static Dictionary<Diagnostic, bool> ^ reportedDiagnostics;
+
+   // Interned argument lists, and the map from their content to handles.
+
+   static Dictionary<String ^, int> ^ argumentMap;
+   static List<array<Object ^> ^> ^ argumentLists;
+
+   // Diagnostics dropped since the last Flush, because they repeated an
+   // earlier one or exceeded DiagnosticLimit.
+
+   static int repeatedCount;
+   static int overLimitCount;
 };
 
 }  // namespace Pascal
\ No newline at end of file
@@ -89,6 +89,7 @@ typedef union {
   {
      char* tokenStart;
      int   tokenLength;
+     int   tokenHandle;   // IdentifierTable handle (identifiers only)
   } Text;  
   int ObjRef;
   int RelOp;
@@ -2248,7 +2249,7 @@ case 255:
 break;
 case 256:
 { /*identifier*/
-	yyval.ObjRef = AddNode(gcnew Ast::IdentifierNode(LineNum, yyvsp[0].Text.tokenStart, yyvsp[0].Text.tokenLength));
+	yyval.ObjRef = AddNode(gcnew Ast::IdentifierNode(LineNum, Pascal::IdentifierTable::GetName(yyvsp[0].Text.tokenHandle)));
 }
 break;
 case 257:
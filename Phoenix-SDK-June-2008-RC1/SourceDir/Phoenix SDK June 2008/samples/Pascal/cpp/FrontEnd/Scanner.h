@@ -12,4 +12,17 @@
 
 #pragma once
 
-extern "C" int yylex(void);
\ No newline at end of file
+extern "C" int yylex(void);
+
+// Points the scanner at the given file, optionally scanning it in place
+// from a memory-mapped view.
+
+extern bool InitScanner(char* file_name, bool mapFile);
+
+// Releases the mapped view of the current file, if any.
+
+extern void ReleaseScanner();
+
+// Flags whether the current file is being scanned from a mapped view.
+
+extern bool IsScannerMapped();
@@ -0,0 +1,88 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Definition of the SourceBuffer class.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Pascal
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description: Maps a source file into memory so that the scanner can
+//              tokenize it in place rather than copying it through YY_INPUT.
+//
+// Remarks:
+//
+//    The view is mapped copy-on-write because flex temporarily stores a
+//    NUL over the character that follows each token. Only the pages that
+//    are written to that way get a private copy.
+//
+//    flex also requires two NUL sentinels after the last character of the
+//    buffer. These come from the zero-filled tail of the last mapped page,
+//    so Open fails (and the caller falls back to stream input) when the
+//    file leaves fewer than two bytes of slack on that page.
+//
+//-----------------------------------------------------------------------------
+
+class SourceBuffer
+{
+public:
+
+   SourceBuffer();
+   ~SourceBuffer();
+
+   // Maps the given file (a UTF-8 encoded path) into memory.
+   // Returns false if the file cannot be mapped for scanning.
+
+   bool Open(const char * fileName);
+
+   // Unmaps the current file, if any.
+
+   void Close();
+
+   // Retrieves the first character of the mapped file.
+
+   char * GetBase() const
+   {
+      return this->base;
+   }
+
+   // Retrieves the size of the file, in bytes.
+
+   int GetSize() const
+   {
+      return this->size;
+   }
+
+   // Retrieves the buffer size to pass to yy_scan_buffer, which includes
+   // the two trailing sentinel characters.
+
+   int GetScanSize() const
+   {
+      return this->size + 2;
+   }
+
+private:
+
+   // Disallow copying; the object owns operating system handles.
+
+   SourceBuffer(const SourceBuffer &);
+   SourceBuffer & operator=(const SourceBuffer &);
+
+private:
+
+   void * fileHandle;
+   void * mappingHandle;
+   char * base;
+   int    size;
+};
+
+}  // namespace Pascal
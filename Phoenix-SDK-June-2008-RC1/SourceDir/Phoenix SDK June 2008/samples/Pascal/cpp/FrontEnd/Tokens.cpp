@@ -314,7 +314,7 @@ static yyconst short int yy_accept[197] =
 static yyconst int yy_ec[256] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    2,    3,
-        1,    2,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    2,    2,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    2,    1,    1,    1,    1,    1,    1,    4,    5,
         6,    7,    8,    9,   10,   11,   12,   13,   13,   13,
@@ -497,6 +497,10 @@ char *yytext;
 // Token declarations are generated by yacc (using option -d).
 #include "YaccDeclarations.h"
 
+// Memory-mapped input and identifier interning.
+#include "SourceBuffer.h"
+#include "IdentifierTable.h"
+
 // Rename deprecated POSIX function.
 #define fileno _fileno
 
@@ -516,6 +520,11 @@ extern "C"
 // Global variables.
 int LineNum = 1;
 
+// The mapped source file and the flex buffer that scans it in place,
+// when the scanner runs in memory-mapped mode.
+static Pascal::SourceBuffer sourceBuffer;
+static YY_BUFFER_STATE mappedBufferState = 0;
+
 // Handling of string literals.
 #define MAX_LITERAL_LENGTH 120
 static char literalBuf[MAX_LITERAL_LENGTH + 1];
@@ -533,6 +542,14 @@ inline static void SetTextYylval()
    yylval.Text.tokenLength = yyleng;
 }
 
+// Identifiers are interned as they are scanned; the parser only sees
+// the resulting handle and never copies the spelling again.
+inline static void SetIdentifierYylval()
+{
+   SetTextYylval();
+   yylval.Text.tokenHandle = Pascal::IdentifierTable::Intern(yytext, yyleng);
+}
+
 void yyerror(char *s);
 
 inline static void SetIntYylval()
@@ -555,7 +572,7 @@ inline static void SetRealYylval()
    }
 }
 
-#line 559 "Tokens.cpp"
+#line 576 "Tokens.cpp"
 
 /* Macros after this point can all be overridden by user definitions in
  * section 1.
@@ -706,10 +723,10 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
 
-#line 105 "Pascal.l"
+#line 122 "Pascal.l"
 
 
-#line 713 "Tokens.cpp"
+#line 730 "Tokens.cpp"
 
 	if ( yy_init )
 		{
@@ -794,362 +811,362 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 107 "Pascal.l"
+#line 124 "Pascal.l"
 return(AND);
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 108 "Pascal.l"
+#line 125 "Pascal.l"
 return(ARRAY);
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 109 "Pascal.l"
+#line 126 "Pascal.l"
 return(CASE);
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 110 "Pascal.l"
+#line 127 "Pascal.l"
 return(CONST);
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 111 "Pascal.l"
+#line 128 "Pascal.l"
 return(DIV);
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 112 "Pascal.l"
+#line 129 "Pascal.l"
 return(DO);
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 113 "Pascal.l"
+#line 130 "Pascal.l"
 { SetTextYylval(); return(DOWNTO); }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 114 "Pascal.l"
+#line 131 "Pascal.l"
 return(ELSE);
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 115 "Pascal.l"
+#line 132 "Pascal.l"
 return(END);
 	YY_BREAK
 case 10:
-#line 117 "Pascal.l"
+#line 134 "Pascal.l"
 case 11:
 YY_RULE_SETUP
-#line 117 "Pascal.l"
+#line 134 "Pascal.l"
 {	SetTextYylval(); 
 	return(EXTERNAL); 
 }
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 120 "Pascal.l"
+#line 137 "Pascal.l"
 return(FOR);
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 121 "Pascal.l"
+#line 138 "Pascal.l"
 { SetTextYylval();
 	return(FORWARD);
 }
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 124 "Pascal.l"
+#line 141 "Pascal.l"
 return(FUNCTION);
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 125 "Pascal.l"
+#line 142 "Pascal.l"
 return(GOTO);
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 126 "Pascal.l"
+#line 143 "Pascal.l"
 return(IF);
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 127 "Pascal.l"
+#line 144 "Pascal.l"
 return(IN);
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 128 "Pascal.l"
+#line 145 "Pascal.l"
 return(LABEL);
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 129 "Pascal.l"
+#line 146 "Pascal.l"
 return(MOD);
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 130 "Pascal.l"
+#line 147 "Pascal.l"
 return(NIL);
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 131 "Pascal.l"
+#line 148 "Pascal.l"
 return(NOT);
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 132 "Pascal.l"
+#line 149 "Pascal.l"
 return(OF);
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 133 "Pascal.l"
+#line 150 "Pascal.l"
 return(OR);
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 134 "Pascal.l"
+#line 151 "Pascal.l"
 return(OTHERWISE);
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 135 "Pascal.l"
+#line 152 "Pascal.l"
 return(PACKED);
 	YY_BREAK
 case 26:
 YY_RULE_SETUP
-#line 136 "Pascal.l"
+#line 153 "Pascal.l"
 return(PBEGIN);
 	YY_BREAK
 case 27:
 YY_RULE_SETUP
-#line 137 "Pascal.l"
+#line 154 "Pascal.l"
 return (BFALSE);
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 138 "Pascal.l"
+#line 155 "Pascal.l"
 return(PFILE);
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 139 "Pascal.l"
+#line 156 "Pascal.l"
 return(PROCEDURE);
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 140 "Pascal.l"
+#line 157 "Pascal.l"
 return(PROGRAM);
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 141 "Pascal.l"
+#line 158 "Pascal.l"
 return(RECORD);
 	YY_BREAK
 case 32:
 YY_RULE_SETUP
-#line 142 "Pascal.l"
+#line 159 "Pascal.l"
 return(REPEAT);
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 143 "Pascal.l"
+#line 160 "Pascal.l"
 return(SET);
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 144 "Pascal.l"
+#line 161 "Pascal.l"
 return(THEN);
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 145 "Pascal.l"
+#line 162 "Pascal.l"
 { SetTextYylval(); return(TO); }
 	YY_BREAK
 case 36:
 YY_RULE_SETUP
-#line 146 "Pascal.l"
+#line 163 "Pascal.l"
 return (BTRUE);
 	YY_BREAK
 case 37:
 YY_RULE_SETUP
-#line 147 "Pascal.l"
+#line 164 "Pascal.l"
 return(TYPE);
 	YY_BREAK
 case 38:
 YY_RULE_SETUP
-#line 148 "Pascal.l"
+#line 165 "Pascal.l"
 return(UNTIL);
 	YY_BREAK
 case 39:
 YY_RULE_SETUP
-#line 149 "Pascal.l"
+#line 166 "Pascal.l"
 return(VAR);
 	YY_BREAK
 case 40:
 YY_RULE_SETUP
-#line 150 "Pascal.l"
+#line 167 "Pascal.l"
 return(WHILE);
 	YY_BREAK
 case 41:
 YY_RULE_SETUP
-#line 151 "Pascal.l"
+#line 168 "Pascal.l"
 return(WITH);
 	YY_BREAK
 case 42:
 YY_RULE_SETUP
-#line 152 "Pascal.l"
-{	SetTextYylval();
+#line 169 "Pascal.l"
+{	SetIdentifierYylval();
 		return (IDENTIFIER);	
 	}
 	YY_BREAK
 case 43:
 YY_RULE_SETUP
-#line 156 "Pascal.l"
+#line 173 "Pascal.l"
 return(ASSIGNMENT);
 	YY_BREAK
 case 44:
 YY_RULE_SETUP
-#line 157 "Pascal.l"
+#line 174 "Pascal.l"
 { SetTextYylval();
 		return(CHARACTER_STRING);
 	}
 	YY_BREAK
 case 45:
 YY_RULE_SETUP
-#line 160 "Pascal.l"
+#line 177 "Pascal.l"
 return(COLON);
 	YY_BREAK
 case 46:
 YY_RULE_SETUP
-#line 161 "Pascal.l"
+#line 178 "Pascal.l"
 return(COMMA);
 	YY_BREAK
 case 47:
 YY_RULE_SETUP
-#line 162 "Pascal.l"
+#line 179 "Pascal.l"
 {  SetIntYylval(); 
 		return(DIGSEQ);
 	}
 	YY_BREAK
 case 48:
 YY_RULE_SETUP
-#line 165 "Pascal.l"
+#line 182 "Pascal.l"
 return(DOT);
 	YY_BREAK
 case 49:
 YY_RULE_SETUP
-#line 166 "Pascal.l"
+#line 183 "Pascal.l"
 return(DOTDOT);
 	YY_BREAK
 case 50:
 YY_RULE_SETUP
-#line 167 "Pascal.l"
+#line 184 "Pascal.l"
 return(EQUAL);
 	YY_BREAK
 case 51:
 YY_RULE_SETUP
-#line 168 "Pascal.l"
+#line 185 "Pascal.l"
 return(GE);
 	YY_BREAK
 case 52:
 YY_RULE_SETUP
-#line 169 "Pascal.l"
+#line 186 "Pascal.l"
 return(GT);
 	YY_BREAK
 case 53:
 YY_RULE_SETUP
-#line 170 "Pascal.l"
+#line 187 "Pascal.l"
 return(LBRAC);
 	YY_BREAK
 case 54:
 YY_RULE_SETUP
-#line 171 "Pascal.l"
+#line 188 "Pascal.l"
 return(LE);
 	YY_BREAK
 case 55:
 YY_RULE_SETUP
-#line 172 "Pascal.l"
+#line 189 "Pascal.l"
 return(LPAREN);
 	YY_BREAK
 case 56:
 YY_RULE_SETUP
-#line 173 "Pascal.l"
+#line 190 "Pascal.l"
 return(LT);
 	YY_BREAK
 case 57:
 YY_RULE_SETUP
-#line 174 "Pascal.l"
+#line 191 "Pascal.l"
 return(MINUS);
 	YY_BREAK
 case 58:
 YY_RULE_SETUP
-#line 175 "Pascal.l"
+#line 192 "Pascal.l"
 return(NOTEQUAL);
 	YY_BREAK
 case 59:
 YY_RULE_SETUP
-#line 176 "Pascal.l"
+#line 193 "Pascal.l"
 return(PLUS);
 	YY_BREAK
 case 60:
 YY_RULE_SETUP
-#line 177 "Pascal.l"
+#line 194 "Pascal.l"
 return(RBRAC);
 	YY_BREAK
 case 61:
 YY_RULE_SETUP
-#line 178 "Pascal.l"
+#line 195 "Pascal.l"
 {	SetRealYylval();
 	   return(REALNUMBER);
 	}
 	YY_BREAK
 case 62:
 YY_RULE_SETUP
-#line 181 "Pascal.l"
+#line 198 "Pascal.l"
 {	SetRealYylval();
 	   return(REALNUMBER);
 	}
 	YY_BREAK
 case 63:
 YY_RULE_SETUP
-#line 184 "Pascal.l"
+#line 201 "Pascal.l"
 return(RPAREN);
 	YY_BREAK
 case 64:
 YY_RULE_SETUP
-#line 185 "Pascal.l"
+#line 202 "Pascal.l"
 return(SEMICOLON);
 	YY_BREAK
 case 65:
 YY_RULE_SETUP
-#line 186 "Pascal.l"
+#line 203 "Pascal.l"
 return(SLASH);
 	YY_BREAK
 case 66:
 YY_RULE_SETUP
-#line 187 "Pascal.l"
+#line 204 "Pascal.l"
 return(STAR);
 	YY_BREAK
 case 67:
 YY_RULE_SETUP
-#line 188 "Pascal.l"
+#line 205 "Pascal.l"
 return(STARSTAR);
 	YY_BREAK
 case 68:
-#line 190 "Pascal.l"
+#line 207 "Pascal.l"
 case 69:
 YY_RULE_SETUP
-#line 190 "Pascal.l"
+#line 207 "Pascal.l"
 { SetTextYylval();	return(UPARROW); }
 	YY_BREAK
 case 70:
-#line 192 "Pascal.l"
+#line 209 "Pascal.l"
 case 71:
 YY_RULE_SETUP
-#line 192 "Pascal.l"
+#line 209 "Pascal.l"
 { register int c;
      while ((c = yyinput()))
      {
@@ -1171,17 +1188,17 @@ YY_RULE_SETUP
 	YY_BREAK
 case 72:
 YY_RULE_SETUP
-#line 211 "Pascal.l"
+#line 228 "Pascal.l"
 ;
 	YY_BREAK
 case 73:
 YY_RULE_SETUP
-#line 213 "Pascal.l"
+#line 230 "Pascal.l"
 /*line_no*/LineNum++;
 	YY_BREAK
 case 74:
 YY_RULE_SETUP
-#line 215 "Pascal.l"
+#line 232 "Pascal.l"
 { fprintf (stderr,
     "'%c' (0%o): illegal charcter at line %d\n",
      yytext[0], yytext[0], /*line_no*/LineNum);
@@ -1189,10 +1206,10 @@ YY_RULE_SETUP
 	YY_BREAK
 case 75:
 YY_RULE_SETUP
-#line 220 "Pascal.l"
+#line 237 "Pascal.l"
 ECHO;
 	YY_BREAK
-#line 1196 "Tokens.cpp"
+#line 1213 "Tokens.cpp"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -2085,7 +2102,7 @@ int main()
 	return 0;
 	}
 #endif
-#line 220 "Pascal.l"
+#line 237 "Pascal.l"
 
 
 void commenteof()
@@ -2102,14 +2119,58 @@ int yywrap ()
  return (1);
 }
 
-bool InitScanner(char* file_name)
+// Flags whether the current file is being scanned from a mapped view.
+bool IsScannerMapped()
 {
+   return (mappedBufferState != 0);
+}
+
+// Releases the mapped source file or the stream of the previous file, if
+// any. Token slices into the mapped file are invalid after this call.
+void ReleaseScanner()
+{
+   if (mappedBufferState != 0)
+   {
+      yy_delete_buffer(mappedBufferState);
+      mappedBufferState = 0;
+   }
+   sourceBuffer.Close();
+
+   if ((yyin != 0) && (yyin != stdin))
+   {
+      fclose(yyin);
+   }
    yyin = 0;
+}
+
+// Points the scanner at the given file. In memory-mapped mode the file is
+// scanned in place, without being copied through YY_INPUT; if it cannot
+// be mapped, the scanner falls back to reading it through yyin.
+bool InitScanner(char* file_name, bool mapFile)
+{
+   ReleaseScanner();
+
+   if (mapFile && sourceBuffer.Open(file_name))
+   {
+      mappedBufferState = yy_scan_buffer(
+         sourceBuffer.GetBase(), sourceBuffer.GetScanSize());
+      if (mappedBufferState != 0)
+      {
+         return true;
+      }
+      sourceBuffer.Close();
+   }
+
    fopen_s(&yyin, file_name, "r");
    if (yyin == 0)
    {   
       return false;
    }
+
+   // Deleting the mapped buffer of an earlier file left the scanner with
+   // no current buffer, and yylex only creates one on its first call.
+
+   yyrestart(yyin);
    return true;
 }
 
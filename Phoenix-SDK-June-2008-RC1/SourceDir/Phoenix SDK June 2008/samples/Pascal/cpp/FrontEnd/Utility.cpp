@@ -258,4 +258,63 @@ Utility::GetOperatorString
       Debug::Assert(false);
       return "?";
    }
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Escapes the given string for use in a JSON string literal.
+//
+// Returns:
+//
+//   The escaped string.
+//
+//-----------------------------------------------------------------------------
+
+String ^
+Utility::EscapeJson
+(
+   String ^ text
+)
+{
+   if (text == nullptr)
+   {
+      return String::Empty;
+   }
+
+   System::Text::StringBuilder ^ escaped =
+      gcnew System::Text::StringBuilder(text->Length);
+   for each (wchar_t c in text)
+   {
+      switch (c)
+      {
+      case L'"':
+         escaped->Append("\\\"");
+         break;
+      case L'\\':
+         escaped->Append("\\\\");
+         break;
+      case L'\n':
+         escaped->Append("\\n");
+         break;
+      case L'\r':
+         escaped->Append("\\r");
+         break;
+      case L'\t':
+         escaped->Append("\\t");
+         break;
+      default:
+         if (c < L' ')
+         {
+            escaped->AppendFormat("\\u{0:x4}", (int) c);
+         }
+         else
+         {
+            escaped->Append(c);
+         }
+         break;
+      }
+   }
+   return escaped->ToString();
+}
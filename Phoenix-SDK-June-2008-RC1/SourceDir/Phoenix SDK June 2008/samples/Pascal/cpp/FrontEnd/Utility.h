@@ -71,4 +71,12 @@ public:
    (
       Phx::ConditionCode conditionCode
    );
+
+   // Escapes the given string for use in a JSON string literal.
+
+   static String ^
+   EscapeJson
+   (
+      String ^ text
+   );
 };
\ No newline at end of file
@@ -76,6 +76,7 @@ typedef union {
   {
      char* tokenStart;
      int   tokenLength;
+     int   tokenHandle;   // IdentifierTable handle (identifiers only)
   } Text;  
   int ObjRef;
   int RelOp;
@@ -81,6 +81,7 @@ void yyerror(char*);
   {
      char* tokenStart;
      int   tokenLength;
+     int   tokenHandle;   // IdentifierTable handle (identifiers only)
   } Text;  
   int ObjRef;
   int RelOp;
@@ -1320,7 +1321,7 @@ relop : EQUAL	{ $$ = EQUAL; }
 
 identifier : IDENTIFIER	
 { /*identifier*/
-	$$ = AddNode(gcnew Ast::IdentifierNode(LineNum, $1.tokenStart, $1.tokenLength));
+	$$ = AddNode(gcnew Ast::IdentifierNode(LineNum, Pascal::IdentifierTable::GetName($1.tokenHandle)));
 }
  ;
 
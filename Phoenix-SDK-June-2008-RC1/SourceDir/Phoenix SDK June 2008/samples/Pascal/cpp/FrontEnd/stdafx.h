@@ -16,6 +16,7 @@
 #include "ModuleBuilder.h"
 #include "IRBuilder.h"
 #include "Configuration.h"
+#include "IdentifierTable.h"
 
 #ifdef _DEBUG
 #ifndef YYDEBUG
@@ -7,6 +7,7 @@ namespace Test
     public enum RunKind
     {
         Baseline,
+        Mapped,
         Print,
         Verify,
         Visits,
@@ -44,6 +45,11 @@ namespace Test
                         runKinds.Add(RunKind.Baseline);
                         continue;
                     }
+                    else if (cleanArg.Equals("mapped"))
+                    {
+                        runKinds.Add(RunKind.Mapped);
+                        continue;
+                    }
                     else if (cleanArg.Equals("print"))
                     {
                         runKinds.Add(RunKind.Print);
@@ -78,8 +84,8 @@ namespace Test
             if (all)
             {
                 runKinds.Clear();
-                runKinds.AddRange(new RunKind[]{ RunKind.Print, RunKind.Visits,
-                    RunKind.Baseline, RunKind.Verify });
+                runKinds.AddRange(new RunKind[]{ RunKind.Print, RunKind.Mapped,
+                    RunKind.Visits, RunKind.Baseline, RunKind.Verify });
             }
 
             if (runKinds.Count == 0)
@@ -93,13 +99,14 @@ namespace Test
         public static void PrintUsage()
         {
             Console.WriteLine();
-            Console.WriteLine("Command-line syntax:\r\nmspt.exe [-baseline|print|quick|verify|visits|all]");
+            Console.WriteLine("Command-line syntax:\r\nmspt.exe [-baseline|mapped|print|quick|verify|visits|all]");
 
             Console.WriteLine("   baseline - generate test baseline.");
+            Console.WriteLine("   mapped - pretty print from mapped input and compare with print.");
             Console.WriteLine("   print - pretty print source programs.");
             Console.WriteLine("   verify - verify tests against baseline.");
             Console.WriteLine("   visits - parse source and report AST usage.");
-            Console.WriteLine("   all - perform baseline|print|verify|visits.");
+            Console.WriteLine("   all - perform baseline|mapped|print|verify|visits.");
 
             Console.WriteLine("Note: '/' can be used for '-'.");
             Console.WriteLine("Example: mspt.exe -all");
@@ -56,6 +56,9 @@ namespace Test
                     case RunKind.Print:
                         PrettyPrint(sourceFiles);
                         break;
+                    case RunKind.Mapped:
+                        PrettyPrintMapped(sourceFiles);
+                        break;
                     case RunKind.Visits:
                         PrintVisits(sourceFiles);
                         break;
@@ -238,6 +241,46 @@ namespace Test
             }
         }
 
+        /// <summary>
+        /// Pretty-prints each file in the specified source file list using
+        /// the memory-mapped scanner and compares the result with the
+        /// listing produced by the default scanner.
+        /// </summary>
+        /// <param name="sourceFiles"></param>
+        private static void PrettyPrintMapped(List<string> sourceFiles)
+        {
+            foreach (string sourceFile in sourceFiles)
+            {
+                TestPass testPass = new TestPass(sourceFile);
+                testPass.CommandLine = "/nc /p /map";
+                testPass.OutputFile = Path.ChangeExtension(sourceFile, ".mapped");
+                testPass.ExeFile = "";
+
+                ExecuteTest(testPass);
+            }
+
+            Log.WriteLine("Verifying mapped listings...");
+            foreach (string sourceFile in sourceFiles)
+            {
+                string prettyFile = Path.ChangeExtension(sourceFile, ".pretty");
+                string mappedFile = Path.ChangeExtension(sourceFile, ".mapped");
+
+                if (File.Exists(prettyFile) && File.Exists(mappedFile))
+                {
+                    if (!File.ReadAllText(prettyFile).Equals(File.ReadAllText(mappedFile)))
+                    {
+                        Log.WriteLine(string.Format(
+                           "Listing file '{0}' did not match mapped listing file '{1}'.",
+                           prettyFile, mappedFile
+                           )
+                        );
+                        ++errorCount;
+                    }
+                }
+            }
+            Log.WriteLine("Done.");
+        }
+
         /// <summary>
         /// Prints visitation metric for all files in the specified source file list.
         /// </summary>
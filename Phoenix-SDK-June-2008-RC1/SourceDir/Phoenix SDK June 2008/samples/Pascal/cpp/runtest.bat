@@ -18,7 +18,7 @@ COPY %1\msp.exe %1\Tests
 ECHO Copying mspt.exe...
 COPY %1\mspt.exe %1\Tests
 CD %1\Tests
-mspt.exe -print -visits -verify
+mspt.exe -print -mapped -visits -verify
 CD..\..
 GOTO exit
 :error
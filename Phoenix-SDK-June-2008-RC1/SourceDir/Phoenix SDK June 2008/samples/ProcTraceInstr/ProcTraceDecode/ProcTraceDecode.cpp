@@ -0,0 +1,288 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Decoder for the binary traces written by ProcTraceRuntime.
+//
+//    Prints one line per traced call in the format the runtime used to
+//    print as the program ran, naming each function from the PDB of the
+//    instrumented image.
+//
+// Usage:
+//
+//    Usage: ProcTraceDecode <trace-file> <image-name> [/times]
+//
+//    /times prefixes each line with the thread id and the microseconds
+//    since the trace started.
+//
+// Remarks:
+//
+//    The runtime writes the records in blocks per thread, so they are
+//    sorted by timestamp here to give one timeline.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "windows.h"
+#include "dbghelp.h"
+#include "..\ProcTraceRuntime\ProcTrace.h"
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    qsort comparison: order records by timestamp, then by thread.
+//
+//-----------------------------------------------------------------------------
+
+static int __cdecl
+CompareRecords
+(
+   const void * first,
+   const void * second
+)
+{
+   const ProcTraceRecord * firstRecord = (const ProcTraceRecord *) first;
+   const ProcTraceRecord * secondRecord = (const ProcTraceRecord *) second;
+
+   if (firstRecord->Timestamp != secondRecord->Timestamp)
+   {
+      return (firstRecord->Timestamp < secondRecord->Timestamp) ? -1 : 1;
+   }
+
+   if (firstRecord->ThreadId != secondRecord->ThreadId)
+   {
+      return (firstRecord->ThreadId < secondRecord->ThreadId) ? -1 : 1;
+   }
+
+   return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Read the header and the records of a trace file.
+//
+// Arguments:
+//
+//    fileName - [in] The trace file.
+//    header - [out] Its header.
+//    recordCount - [out] The number of records read.
+//
+// Returns:
+//
+//    The records, allocated with malloc, or NULL if the file could not be
+//    read.
+//
+//-----------------------------------------------------------------------------
+
+static ProcTraceRecord *
+ReadTrace
+(
+   const wchar_t *       fileName,
+   ProcTraceFileHeader * header,
+   size_t *              recordCount
+)
+{
+   FILE * file = ::_wfopen(fileName, L"rb");
+
+   if (file == NULL)
+   {
+      ::fwprintf(stderr, L"Cannot open %s\n", fileName);
+
+      return NULL;
+   }
+
+   if ((::fread(header, sizeof(*header), 1, file) != 1)
+      || (header->Magic != PROCTRACE_MAGIC)
+      || (header->Version != PROCTRACE_VERSION)
+      || (header->RecordSize != sizeof(ProcTraceRecord)))
+   {
+      ::fwprintf(stderr, L"%s is not a ProcTrace trace file\n", fileName);
+      ::fclose(file);
+
+      return NULL;
+   }
+
+   // Read to the end of the file rather than trusting RecordCount, which
+   // is only written if the traced process exited normally.
+
+   size_t            capacity = 65536;
+   size_t            count = 0;
+   ProcTraceRecord * records =
+      (ProcTraceRecord *) ::malloc(capacity * sizeof(ProcTraceRecord));
+
+   while (records != NULL)
+   {
+      count += ::fread(records + count, sizeof(ProcTraceRecord), capacity - count, file);
+
+      if (count < capacity)
+      {
+         break;
+      }
+
+      capacity *= 2;
+      records = (ProcTraceRecord *) ::realloc(records, capacity * sizeof(ProcTraceRecord));
+   }
+
+   ::fclose(file);
+
+   if (records == NULL)
+   {
+      ::fwprintf(stderr, L"Out of memory reading %s\n", fileName);
+
+      return NULL;
+   }
+
+   *recordCount = count;
+
+   return records;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Print a traced call the way ProcTraceRuntime printed it.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+PrintCall
+(
+   HANDLE       process,
+   unsigned int functionAddress
+)
+{
+   if (functionAddress == 0)
+   {
+      ::wprintf(L"In Shout()\n");
+
+      return;
+   }
+
+   ULONG64       buffer[(sizeof(SYMBOL_INFOW) + MAX_SYM_NAME * sizeof(wchar_t)
+                    + sizeof(ULONG64) - 1) / sizeof(ULONG64)];
+   SYMBOL_INFOW * symbol = (SYMBOL_INFOW *) buffer;
+   DWORD64       displacement;
+
+   symbol->SizeOfStruct = sizeof(SYMBOL_INFOW);
+   symbol->MaxNameLen = MAX_SYM_NAME;
+
+   if (::SymFromAddrW(process, functionAddress, &displacement, symbol))
+   {
+      ::wprintf(L"0x%08X, %s\n", functionAddress, symbol->Name);
+   }
+   else
+   {
+      ::wprintf(L"In Function @ 0x%08X\n", functionAddress);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Entry point for application
+//
+// Returns:
+//
+//    0 on success, 1 on error
+//
+//-----------------------------------------------------------------------------
+
+int __cdecl
+wmain
+(
+   int       argc,
+   wchar_t * argv[]
+)
+{
+   if ((argc < 3) || ((argc == 4) && (::_wcsicmp(argv[3], L"/times") != 0)) || (argc > 4))
+   {
+      ::wprintf(L"Usage: ProcTraceDecode <trace-file> <image-name> [/times]\n");
+
+      return 1;
+   }
+
+   bool                doPrintTimes = (argc == 4);
+   ProcTraceFileHeader header;
+   size_t              recordCount = 0;
+   ProcTraceRecord *   records = ReadTrace(argv[1], &header, &recordCount);
+
+   if (records == NULL)
+   {
+      return 1;
+   }
+
+   ::qsort(records, recordCount, sizeof(ProcTraceRecord), CompareRecords);
+
+   // Load the image's symbols at the base it had in the traced process.
+
+   HANDLE process = ::GetCurrentProcess();
+
+   ::SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS);
+
+   if (!::SymInitializeW(process, NULL, FALSE)
+      || (::SymLoadModuleExW(process, NULL, argv[2], NULL, header.ImageBase, 0, NULL, 0)
+         == 0))
+   {
+      ::fwprintf(stderr, L"Cannot load symbols for %s, printing addresses only\n",
+         argv[2]);
+   }
+
+   // Work out the time stamp counter frequency from the performance
+   // counter readings the runtime took at both ends of the run.
+
+   double ticksPerMicrosecond = 0.0;
+
+   if ((header.EndCounter > header.StartCounter) && (header.CounterFrequency != 0))
+   {
+      double seconds = (double) (header.EndCounter - header.StartCounter)
+         / (double) header.CounterFrequency;
+
+      ticksPerMicrosecond =
+         (double) (header.EndTimestamp - header.StartTimestamp) / (seconds * 1.0e6);
+   }
+
+   for (size_t index = 0; index < recordCount; index++)
+   {
+      const ProcTraceRecord * record = &records[index];
+
+      if (doPrintTimes)
+      {
+         if (ticksPerMicrosecond != 0.0)
+         {
+            ::wprintf(L"%6u %14.3f ", record->ThreadId,
+               (double) (record->Timestamp - header.StartTimestamp) / ticksPerMicrosecond);
+         }
+         else
+         {
+            ::wprintf(L"%6u %14I64u ", record->ThreadId,
+               record->Timestamp - header.StartTimestamp);
+         }
+      }
+
+      PrintCall(process, record->FunctionAddress);
+   }
+
+   if (header.StallCount != 0)
+   {
+      ::fwprintf(stderr, L"The traced threads stalled %I64u times waiting for the flusher\n",
+         header.StallCount);
+   }
+
+   ::SymCleanup(process);
+   ::free(records);
+
+   return 0;
+}
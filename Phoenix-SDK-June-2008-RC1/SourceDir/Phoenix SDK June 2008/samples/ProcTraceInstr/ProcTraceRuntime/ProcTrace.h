@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//   Binary trace file layout
+//
+// Remarks:
+//
+//    ProcTraceRuntime writes a ProcTraceFileHeader followed by records, in
+//    blocks of consecutive records from one thread. The blocks of different
+//    threads are interleaved in the order they were flushed, so a reader
+//    that wants one timeline sorts the records by Timestamp.
+//
+//    Timestamps are raw time stamp counter values. The header keeps the
+//    counter and QueryPerformanceCounter at the start and at the end of the
+//    run, from which the decoder works out the counter frequency.
+//
+//    Addresses are those the instrumented code passed, in the executable
+//    loaded at ImageBase.
+//
+//    This header is shared by the runtime and the decoder, so it must stay
+//    plain C.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#define PROCTRACE_MAGIC   0x43525450
+#define PROCTRACE_VERSION 1
+
+typedef struct ProcTraceFileHeader
+{
+   unsigned int     Magic;
+   unsigned int     Version;
+   unsigned int     RecordSize;
+   unsigned int     ImageBase;
+   unsigned __int64 StartTimestamp;
+   unsigned __int64 EndTimestamp;
+   __int64          StartCounter;
+   __int64          EndCounter;
+   __int64          CounterFrequency;
+   unsigned __int64 RecordCount;
+   unsigned __int64 StallCount;
+} ProcTraceFileHeader;
+
+typedef struct ProcTraceRecord
+{
+   unsigned __int64 Timestamp;
+   unsigned int     FunctionAddress;
+   unsigned int     ThreadId;
+} ProcTraceRecord;
@@ -22,10 +22,1404 @@
 //    This is important as we are not raising the IR high enough to have the 
 //    lower process smooth any of the issues over.
 //
+//    Each traced call appends a ProcTraceRecord (see ProcTrace.h) to a ring
+//    of chunks owned by the calling thread, without locks or calls into the
+//    CRT. A full chunk is handed to a flusher thread, which writes it to the
+//    trace file and gives it back. ProcTraceDecode turns the file into the
+//    text this runtime used to print.
+//
+//    The environment variables below control the runtime:
+//
+//       PROCTRACE_FILE - the trace file, ProcTrace.bin by default.
+//       PROCTRACE_CONSOLE - when set, print each call with wprintf and
+//          fflush as before, instead of writing the trace file.
+//
+//    One call in PROCTRACE_SAMPLE_INTERVAL is timed with the time stamp
+//    counter in either mode, and the average is printed to stderr at
+//    process exit, so that the two modes can be compared on the same
+//    program.
+//
+//    ProcTraceInstr also calls ProcTraceExit before every return. In both
+//    modes each thread keeps a shadow stack of the traced functions it is
+//    in, and adds up calls, inclusive and exclusive time per function and
+//    calls and time per caller and callee pair. The totals of all threads
+//    are written to PROCTRACE_PROFILE, ProcTrace.profile by default, when
+//    the process exits.
+//
+//    Frames are matched by the stack pointer at entry, which is the same
+//    at the return. A frame the shadow stack holds below the one being
+//    entered or left was left without reaching a return, by an exception,
+//    a longjmp or a jump to another function, and is closed then.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <intrin.h>
+#include "windows.h"
+#include "ProcTrace.h"
+
+// Records per chunk, and chunks in each thread's ring. A thread stalls only
+// when it fills all of its chunks before the flusher has written any.
+
+#define PROCTRACE_CHUNK_RECORDS   4096
+#define PROCTRACE_RING_CHUNKS     8
+#define PROCTRACE_SAMPLE_INTERVAL 1024
+
+// Shadow stack depth, and sizes of the per-thread profile tables. Both
+// tables are open addressed, so their sizes must be powers of two. Frames
+// and entries that do not fit are counted as lost.
+
+#define PROCTRACE_STACK_DEPTH     1024
+#define PROCTRACE_FUNCTIONS       4096
+#define PROCTRACE_EDGES           16384
+
+// Chunk states. The owning thread fills a chunk, then publishes it as full;
+// the flusher claims it for writing and returns it empty.
+
+#define CHUNK_FILLING 0
+#define CHUNK_FULL    1
+#define CHUNK_WRITING 2
+
+typedef struct TraceChunk
+{
+   volatile LONG   State;
+   unsigned int    Count;
+   ProcTraceRecord Records[PROCTRACE_CHUNK_RECORDS];
+} TraceChunk;
+
+// Profile of one function. Address is 0 while the slot is free.
+// ActiveCount is the number of its frames on the shadow stack, so that a
+// recursive function's time is counted as inclusive only once.
+
+typedef struct ProfileFunction
+{
+   unsigned int     Address;
+   unsigned int     ActiveCount;
+   const wchar_t *  Name;
+   unsigned __int64 CallCount;
+   unsigned __int64 InclusiveTicks;
+   unsigned __int64 ExclusiveTicks;
+} ProfileFunction;
+
+// Profile of the calls from one function to another. Caller is 0 for
+// calls from outside any traced function; Callee is 0 while the slot is
+// free.
+
+typedef struct ProfileEdge
+{
+   unsigned int     Caller;
+   unsigned int     Callee;
+   unsigned __int64 CallCount;
+   unsigned __int64 InclusiveTicks;
+} ProfileEdge;
+
+typedef struct ShadowFrame
+{
+   unsigned int      StackPointer;
+   unsigned __int64  EnterTimestamp;
+   unsigned __int64  ChildTicks;
+   ProfileFunction * Function;
+   ProfileEdge *     Edge;
+} ShadowFrame;
+
+typedef struct ThreadProfile
+{
+   unsigned int     Depth;
+   unsigned __int64 LostCount;
+   ShadowFrame      Frames[PROCTRACE_STACK_DEPTH];
+   ProfileFunction  Functions[PROCTRACE_FUNCTIONS];
+   ProfileEdge      Edges[PROCTRACE_EDGES];
+} ThreadProfile;
+
+// Per thread state. Everything but the chunk states and IsInUse is touched
+// only by the owning thread, until the process detaches. A thread that
+// exits gives its buffer back for the next new thread to claim.
+
+typedef struct ThreadBuffer
+{
+   struct ThreadBuffer * Next;
+   volatile LONG         IsInUse;
+   unsigned int          ThreadId;
+   unsigned int          Current;
+   TraceChunk *          Chunks;
+   ThreadProfile *       Profile;
+   unsigned __int64      CallCount;
+   unsigned __int64      SampleCount;
+   unsigned __int64      SampledCycles;
+   unsigned __int64      StallCount;
+} ThreadBuffer;
+
+static DWORD                    TraceTlsIndex = TLS_OUT_OF_INDEXES;
+static ThreadBuffer * volatile  TraceBuffers = NULL;
+static bool                     IsConsoleMode = false;
+static HANDLE                   TraceFile = INVALID_HANDLE_VALUE;
+static HANDLE                   FlushEvent = NULL;
+static HANDLE                   FlushThread = NULL;
+static HANDLE                   FlushStoppedEvent = NULL;
+static volatile LONG            StopFlushing = 0;
+static ProcTraceFileHeader      TraceHeader;
+static wchar_t                  TraceFileName[MAX_PATH];
+static wchar_t                  ProfileFileName[MAX_PATH];
+static ThreadProfile *          ProfileTotals = NULL;
+
+// The chunk the flusher is writing, with the record count before it and
+// the chunk's own count, so RecoverChunks can tell whether the chunk made
+// it into RecordCount.
+
+static TraceChunk * volatile    WritingChunk = NULL;
+static unsigned __int64         WritingStart = 0;
+static unsigned int             WritingCount = 0;
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Get the calling thread's buffer, on the thread's first traced call
+//    claiming one an exited thread gave back, or creating one.
+//
+// Returns:
+//
+//    The buffer, or NULL if it could not be allocated.
+//
+//-----------------------------------------------------------------------------
+
+static ThreadBuffer *
+GetThreadBuffer()
+{
+   if (TraceTlsIndex == TLS_OUT_OF_INDEXES)
+   {
+      return NULL;
+   }
+
+   ThreadBuffer * buffer = (ThreadBuffer *) ::TlsGetValue(TraceTlsIndex);
+
+   if (buffer != NULL)
+   {
+      return buffer;
+   }
+
+   for (buffer = TraceBuffers; buffer != NULL; buffer = buffer->Next)
+   {
+      if (::InterlockedCompareExchange(&buffer->IsInUse, 1, 0) != 0)
+      {
+         continue;
+      }
+
+      buffer->ThreadId = ::GetCurrentThreadId();
+
+      ::TlsSetValue(TraceTlsIndex, buffer);
+
+      // The exited thread's last chunk may not be written yet.
+
+      if (!IsConsoleMode)
+      {
+         while (buffer->Chunks[buffer->Current].State != CHUNK_FILLING)
+         {
+            buffer->StallCount++;
+            ::SwitchToThread();
+         }
+      }
+
+      return buffer;
+   }
+
+   buffer = (ThreadBuffer *) ::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY,
+      sizeof(ThreadBuffer));
+
+   if (buffer == NULL)
+   {
+      return NULL;
+   }
+
+   // VirtualAlloc gives zeroed pages, so the profile tables start empty.
+
+   buffer->Profile = (ThreadProfile *) ::VirtualAlloc(NULL, sizeof(ThreadProfile),
+      MEM_COMMIT, PAGE_READWRITE);
+
+   if (!IsConsoleMode && (buffer->Profile != NULL))
+   {
+      buffer->Chunks = (TraceChunk *) ::VirtualAlloc(NULL,
+         PROCTRACE_RING_CHUNKS * sizeof(TraceChunk), MEM_COMMIT, PAGE_READWRITE);
+   }
+
+   if ((buffer->Profile == NULL) || (!IsConsoleMode && (buffer->Chunks == NULL)))
+   {
+      if (buffer->Profile != NULL)
+      {
+         ::VirtualFree(buffer->Profile, 0, MEM_RELEASE);
+      }
+
+      ::HeapFree(::GetProcessHeap(), 0, buffer);
+
+      return NULL;
+   }
+
+   buffer->IsInUse = 1;
+   buffer->ThreadId = ::GetCurrentThreadId();
+
+   ::TlsSetValue(TraceTlsIndex, buffer);
+
+   // Push the buffer on the list the flusher walks. Buffers are reused but
+   // never removed, so the flusher can walk the list without a lock.
+
+   ThreadBuffer * head;
+
+   do
+   {
+      head = TraceBuffers;
+      buffer->Next = head;
+   }
+   while (::InterlockedCompareExchangePointer((PVOID volatile *) &TraceBuffers,
+      buffer, head) != head);
+
+   return buffer;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Hand the chunk a thread is filling to the flusher.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+PublishChunk
+(
+   ThreadBuffer * buffer
+)
+{
+   // The interlocked exchange is a full barrier, so the flusher sees the
+   // records before it sees the state.
+
+   ::InterlockedExchange(&buffer->Chunks[buffer->Current].State, CHUNK_FULL);
+   ::SetEvent(FlushEvent);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Append one record to the calling thread's ring.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+AppendRecord
+(
+   ThreadBuffer *   buffer,
+   unsigned int     functionAddress,
+   unsigned __int64 timestamp
+)
+{
+   TraceChunk *      chunk = &buffer->Chunks[buffer->Current];
+   ProcTraceRecord * record = &chunk->Records[chunk->Count];
+
+   record->Timestamp = timestamp;
+   record->FunctionAddress = functionAddress;
+   record->ThreadId = buffer->ThreadId;
+
+   if (++chunk->Count < PROCTRACE_CHUNK_RECORDS)
+   {
+      return;
+   }
+
+   PublishChunk(buffer);
+
+   // Move on to the next chunk, waiting for the flusher if it has not
+   // written it out yet.
+
+   buffer->Current = (buffer->Current + 1) % PROCTRACE_RING_CHUNKS;
+
+   chunk = &buffer->Chunks[buffer->Current];
+
+   while (chunk->State != CHUNK_FILLING)
+   {
+      buffer->StallCount++;
+      ::SwitchToThread();
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find a function's entry in a profile table, adding it if it is not
+//    there.
+//
+// Returns:
+//
+//    The entry, or NULL if the table is full.
+//
+//-----------------------------------------------------------------------------
+
+static ProfileFunction *
+FindFunction
+(
+   ProfileFunction * functions,
+   unsigned int      address
+)
+{
+   unsigned int hash = (address >> 2) * 2654435761u;
+
+   for (unsigned int probe = 0; probe < PROCTRACE_FUNCTIONS; probe++)
+   {
+      ProfileFunction * function = &functions[(hash + probe) & (PROCTRACE_FUNCTIONS - 1)];
+
+      if (function->Address == address)
+      {
+         return function;
+      }
+
+      if (function->Address == 0)
+      {
+         function->Address = address;
+
+         return function;
+      }
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the entry for calls from caller to callee in a profile table,
+//    adding it if it is not there.
+//
+// Returns:
+//
+//    The entry, or NULL if the table is full.
+//
+//-----------------------------------------------------------------------------
+
+static ProfileEdge *
+FindEdge
+(
+   ProfileEdge * edges,
+   unsigned int  caller,
+   unsigned int  callee
+)
+{
+   unsigned int hash = ((caller >> 2) * 31 + (callee >> 2)) * 2654435761u;
+
+   for (unsigned int probe = 0; probe < PROCTRACE_EDGES; probe++)
+   {
+      ProfileEdge * edge = &edges[(hash + probe) & (PROCTRACE_EDGES - 1)];
+
+      if ((edge->Callee == callee) && (edge->Caller == caller))
+      {
+         return edge;
+      }
+
+      if (edge->Callee == 0)
+      {
+         edge->Caller = caller;
+         edge->Callee = callee;
+
+         return edge;
+      }
+   }
+
+   return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Pop the innermost frame of the shadow stack and charge its time.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+PopFrame
+(
+   ThreadProfile *  profile,
+   unsigned __int64 timestamp
+)
+{
+   ShadowFrame *     frame = &profile->Frames[--profile->Depth];
+   ProfileFunction * function = frame->Function;
+   unsigned __int64  elapsed = timestamp - frame->EnterTimestamp;
+
+   function->ExclusiveTicks += elapsed - frame->ChildTicks;
+
+   if (--function->ActiveCount == 0)
+   {
+      function->InclusiveTicks += elapsed;
+   }
+
+   frame->Edge->InclusiveTicks += elapsed;
+
+   if (profile->Depth != 0)
+   {
+      profile->Frames[profile->Depth - 1].ChildTicks += elapsed;
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Pop every frame whose stack pointer is at or below the given one.
+//
+// Remarks:
+//
+//    The stack grows down, so these frames are inside the one at the given
+//    stack pointer, or are that frame.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+CloseFrames
+(
+   ThreadProfile *  profile,
+   unsigned int     stackPointer,
+   unsigned __int64 timestamp
+)
+{
+   while ((profile->Depth != 0)
+      && (profile->Frames[profile->Depth - 1].StackPointer <= stackPointer))
+   {
+      PopFrame(profile, timestamp);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Push a frame for a function being entered.
+//
+// Arguments:
+//
+//    profile - [in] The calling thread's profile.
+//    funcAddress - [in] Address of the function.
+//    functionName - [in] Name of the function, or NULL.
+//    stackPointer - [in] The stack pointer on entry to the function.
+//    timestamp - [in] The time of entry.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+EnterFunction
+(
+   ThreadProfile *  profile,
+   unsigned int     funcAddress,
+   const wchar_t *  functionName,
+   unsigned int     stackPointer,
+   unsigned __int64 timestamp
+)
+{
+   // A frame at or below this one was left without its exit being seen,
+   // for instance by jumping to this function from its last instruction.
+
+   CloseFrames(profile, stackPointer, timestamp);
+
+   if (profile->Depth == PROCTRACE_STACK_DEPTH)
+   {
+      profile->LostCount++;
+
+      return;
+   }
+
+   unsigned int caller = (profile->Depth == 0) ? 0
+      : profile->Frames[profile->Depth - 1].Function->Address;
+
+   // Look the edge up only once the function has a slot, so that the edge
+   // table holds no calls to functions the function table lost.
+
+   ProfileFunction * function = FindFunction(profile->Functions, funcAddress);
+   ProfileEdge *     edge = (function != NULL)
+      ? FindEdge(profile->Edges, caller, funcAddress) : NULL;
+
+   if (edge == NULL)
+   {
+      profile->LostCount++;
+
+      return;
+   }
+
+   if (function->Name == NULL)
+   {
+      function->Name = functionName;
+   }
+
+   function->CallCount++;
+   function->ActiveCount++;
+   edge->CallCount++;
+
+   ShadowFrame * frame = &profile->Frames[profile->Depth++];
+
+   frame->StackPointer = stackPointer;
+   frame->EnterTimestamp = timestamp;
+   frame->ChildTicks = 0;
+   frame->Function = function;
+   frame->Edge = edge;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Pop the frame of a function that is returning.
+//
+// Arguments:
+//
+//    profile - [in] The calling thread's profile.
+//    funcAddress - [in] Address of the function.
+//    stackPointer - [in] The stack pointer at the return, which is the
+//          one the function was entered with.
+//    timestamp - [in] The time of the return.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+LeaveFunction
+(
+   ThreadProfile *  profile,
+   unsigned int     funcAddress,
+   unsigned int     stackPointer,
+   unsigned __int64 timestamp
+)
+{
+   // Frames inside this one were unwound without reaching their returns.
+
+   CloseFrames(profile, stackPointer - 1, timestamp);
+
+   // If the frame is not on top it was never pushed, because the stack or
+   // a table was full, so there is nothing to pop.
+
+   if ((profile->Depth != 0)
+      && (profile->Frames[profile->Depth - 1].StackPointer == stackPointer)
+      && (profile->Frames[profile->Depth - 1].Function->Address == funcAddress))
+   {
+      PopFrame(profile, timestamp);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Trace one call, in whichever mode the runtime is in.
+//
+// Arguments:
+//
+//    funcAddress - [in] Address of the function, 0 for Shout.
+//    functionName - [in] Name of the function, or NULL.
+//    stackPointer - [in] The stack pointer on entry to the function.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+TraceCall
+(
+   unsigned int    funcAddress,
+   const wchar_t * functionName,
+   unsigned int    stackPointer
+)
+{
+   ThreadBuffer * buffer = GetThreadBuffer();
+
+   if (buffer == NULL)
+   {
+      return;
+   }
+
+   bool             isSampled = ((++buffer->CallCount % PROCTRACE_SAMPLE_INTERVAL) == 0);
+   unsigned __int64 start = __rdtsc();
+
+   if (funcAddress != 0)
+   {
+      EnterFunction(buffer->Profile, funcAddress, functionName, stackPointer, start);
+   }
+
+   if (!IsConsoleMode)
+   {
+      AppendRecord(buffer, funcAddress, start);
+   }
+   else if (funcAddress == 0)
+   {
+      ::wprintf(L"In Shout()\n");
+   }
+   else
+   {
+      if (functionName != NULL)
+      {
+         ::wprintf(L"0x%08X, %s\n", funcAddress, functionName);
+      }
+      else
+      {
+         ::wprintf(L"In Function @ 0x%08X\n", funcAddress);
+      }
+
+      ::fflush(stdout);
+   }
+
+   if (isSampled)
+   {
+      buffer->SampledCycles += __rdtsc() - start;
+      buffer->SampleCount++;
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Trace a return from a function into the calling thread's profile.
+//
+// Arguments:
+//
+//    funcAddress - [in] Address of the function.
+//    stackPointer - [in] The stack pointer at the return.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+TraceReturn
+(
+   unsigned int funcAddress,
+   unsigned int stackPointer
+)
+{
+   ThreadBuffer * buffer = GetThreadBuffer();
+
+   if (buffer != NULL)
+   {
+      LeaveFunction(buffer->Profile, funcAddress, stackPointer, __rdtsc());
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Write every full chunk to the trace file and give it back to its
+//    thread.
+//
+// Remarks:
+//
+//    Only one thread writes the file at a time, without a lock: the
+//    flusher while it runs, then StopTrace once the flusher has stopped or
+//    been terminated. A lock the flusher held when ExitProcess terminated
+//    it would never be released, and StopTrace would fail to enter it.
+//
+//    The record count is advanced right after each write, so the file
+//    holds the header and RecordCount records unless the flusher was
+//    terminated in the middle of a chunk. WritingChunk names that chunk
+//    until it is counted and cleared; the interlocked exchanges keep the
+//    stores to it on either side of the others.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+FlushChunks()
+{
+   for (ThreadBuffer * buffer = TraceBuffers; buffer != NULL; buffer = buffer->Next)
+   {
+      for (unsigned int index = 0; index < PROCTRACE_RING_CHUNKS; index++)
+      {
+         TraceChunk * chunk = &buffer->Chunks[index];
+
+         if (::InterlockedCompareExchange(&chunk->State, CHUNK_WRITING, CHUNK_FULL)
+            != CHUNK_FULL)
+         {
+            continue;
+         }
+
+         WritingStart = TraceHeader.RecordCount;
+         WritingCount = chunk->Count;
+
+         ::InterlockedExchangePointer((PVOID volatile *) &WritingChunk, chunk);
+
+         DWORD written;
+
+         ::WriteFile(TraceFile, chunk->Records, chunk->Count * sizeof(ProcTraceRecord),
+            &written, NULL);
+         TraceHeader.RecordCount += chunk->Count;
+         chunk->Count = 0;
+
+         ::InterlockedExchangePointer((PVOID volatile *) &WritingChunk, NULL);
+         ::InterlockedExchange(&chunk->State, CHUNK_FILLING);
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Recover the chunk the flusher was writing when it was terminated.
+//
+// Remarks:
+//
+//    If the chunk in flight still has its records, RecordCount may or may
+//    not include them, so it is set back to what it was before the chunk.
+//    If the records are cleared, they were written and RecordCount is set
+//    to include them. Whatever part of a chunk reached the file past
+//    RecordCount is cut off, and the chunk is published again to be written
+//    whole. A chunk already counted has no records left and is just given
+//    back.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+RecoverChunks()
+{
+   TraceChunk * writingChunk = WritingChunk;
+
+   if (writingChunk != NULL)
+   {
+      TraceHeader.RecordCount = WritingStart;
+
+      if (writingChunk->Count == 0)
+      {
+         TraceHeader.RecordCount += WritingCount;
+      }
+   }
+
+   LARGE_INTEGER end;
+
+   end.QuadPart = sizeof(ProcTraceFileHeader)
+      + TraceHeader.RecordCount * sizeof(ProcTraceRecord);
+
+   ::SetFilePointerEx(TraceFile, end, NULL, FILE_BEGIN);
+   ::SetEndOfFile(TraceFile);
+
+   for (ThreadBuffer * buffer = TraceBuffers; buffer != NULL; buffer = buffer->Next)
+   {
+      for (unsigned int index = 0; index < PROCTRACE_RING_CHUNKS; index++)
+      {
+         TraceChunk * chunk = &buffer->Chunks[index];
+
+         if (chunk->State == CHUNK_WRITING)
+         {
+            ::InterlockedExchange(&chunk->State,
+               (chunk->Count != 0) ? CHUNK_FULL : CHUNK_FILLING);
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The flusher thread: write chunks as threads fill them, and at least
+//    every 100 milliseconds, until StopFlushing is set.
+//
+// Remarks:
+//
+//    It signals FlushStoppedEvent rather than have StopTrace wait for the
+//    thread to exit, which would need the loader lock StopTrace holds.
+//
+// Returns:
+//
+//    0
+//
+//-----------------------------------------------------------------------------
+
+static DWORD WINAPI
+FlushThreadProcedure
+(
+   LPVOID
+)
+{
+   while (StopFlushing == 0)
+   {
+      ::WaitForSingleObject(FlushEvent, 100);
+      FlushChunks();
+   }
+
+   ::SetEvent(FlushStoppedEvent);
+
+   return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Open the trace file and start the flusher, or pick console mode.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+StartTrace()
+{
+   LARGE_INTEGER counter;
+   LARGE_INTEGER frequency;
+
+   TraceTlsIndex = ::TlsAlloc();
+
+   // The exited threads' profiles are added to the totals as they exit.
+
+   ProfileTotals = (ThreadProfile *) ::VirtualAlloc(NULL, sizeof(ThreadProfile),
+      MEM_COMMIT, PAGE_READWRITE);
+
+   // The profile uses the counter readings to convert its times, so they
+   // are taken in console mode too.
+
+   ::QueryPerformanceCounter(&counter);
+   ::QueryPerformanceFrequency(&frequency);
+
+   TraceHeader.Magic = PROCTRACE_MAGIC;
+   TraceHeader.Version = PROCTRACE_VERSION;
+   TraceHeader.RecordSize = sizeof(ProcTraceRecord);
+   TraceHeader.ImageBase = (unsigned int) (UINT_PTR) ::GetModuleHandleW(NULL);
+   TraceHeader.StartTimestamp = __rdtsc();
+   TraceHeader.StartCounter = counter.QuadPart;
+   TraceHeader.CounterFrequency = frequency.QuadPart;
+
+   DWORD length = ::GetEnvironmentVariableW(L"PROCTRACE_PROFILE", ProfileFileName, MAX_PATH);
+
+   if ((length == 0) || (length >= MAX_PATH))
+   {
+      ::lstrcpyW(ProfileFileName, L"ProcTrace.profile");
+   }
+
+   if (::GetEnvironmentVariableW(L"PROCTRACE_CONSOLE", NULL, 0) != 0)
+   {
+      IsConsoleMode = true;
+
+      return;
+   }
+
+   length = ::GetEnvironmentVariableW(L"PROCTRACE_FILE", TraceFileName, MAX_PATH);
+
+   if ((length == 0) || (length >= MAX_PATH))
+   {
+      ::lstrcpyW(TraceFileName, L"ProcTrace.bin");
+   }
+
+   TraceFile = ::CreateFileW(TraceFileName, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+      CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+   if (TraceFile == INVALID_HANDLE_VALUE)
+   {
+      ::fwprintf(stderr, L"ProcTrace: cannot create %s, tracing to the console\n",
+         TraceFileName);
+      IsConsoleMode = true;
+
+      return;
+   }
+
+   // The header is written again with the totals when the trace ends.
+
+   DWORD written;
+
+   ::WriteFile(TraceFile, &TraceHeader, sizeof(TraceHeader), &written, NULL);
+
+   FlushEvent = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+   FlushStoppedEvent = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+   FlushThread = ::CreateThread(NULL, 0, FlushThreadProcedure, NULL, 0, NULL);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add one thread's profile to the totals.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+MergeProfile
+(
+   ThreadProfile *       totals,
+   const ThreadProfile * profile
+)
+{
+   for (unsigned int index = 0; index < PROCTRACE_FUNCTIONS; index++)
+   {
+      const ProfileFunction * function = &profile->Functions[index];
+
+      if (function->Address == 0)
+      {
+         continue;
+      }
+
+      ProfileFunction * total = FindFunction(totals->Functions, function->Address);
+
+      if (total == NULL)
+      {
+         totals->LostCount += function->CallCount;
+
+         continue;
+      }
+
+      if (total->Name == NULL)
+      {
+         total->Name = function->Name;
+      }
+
+      total->CallCount += function->CallCount;
+      total->InclusiveTicks += function->InclusiveTicks;
+      total->ExclusiveTicks += function->ExclusiveTicks;
+   }
+
+   for (unsigned int index = 0; index < PROCTRACE_EDGES; index++)
+   {
+      const ProfileEdge * edge = &profile->Edges[index];
+
+      if (edge->Callee == 0)
+      {
+         continue;
+      }
+
+      ProfileEdge * total = FindEdge(totals->Edges, edge->Caller, edge->Callee);
+
+      if (total == NULL)
+      {
+         totals->LostCount += edge->CallCount;
+
+         continue;
+      }
+
+      total->CallCount += edge->CallCount;
+      total->InclusiveTicks += edge->InclusiveTicks;
+   }
+
+   totals->LostCount += profile->LostCount;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Give back the buffer of a thread that is exiting.
+//
+// Remarks:
+//
+//    The thread's profile is added to the totals and cleared, and its
+//    partly filled chunk handed to the flusher, so that the next new
+//    thread can claim the buffer instead of allocating another. This runs
+//    at thread detach, under the loader lock, so it cannot race StopTrace
+//    or another exiting thread for the totals.
+//
+// Returns:
+//
+//    Nothing
+//
 //-----------------------------------------------------------------------------
 
-#include <stdio.h>
-#include "windows.h"
+static void
+ReleaseThreadBuffer
+(
+   ThreadBuffer * buffer
+)
+{
+   CloseFrames(buffer->Profile, 0xFFFFFFFF, __rdtsc());
+
+   if (ProfileTotals != NULL)
+   {
+      MergeProfile(ProfileTotals, buffer->Profile);
+      ::ZeroMemory(buffer->Profile, sizeof(ThreadProfile));
+   }
+
+   if (!IsConsoleMode && (buffer->Chunks[buffer->Current].Count != 0))
+   {
+      PublishChunk(buffer);
+      buffer->Current = (buffer->Current + 1) % PROCTRACE_RING_CHUNKS;
+   }
+
+   ::TlsSetValue(TraceTlsIndex, NULL);
+
+   // Without the totals the profile could not be cleared, so the buffer
+   // stays with the exited thread and is merged at process detach.
+
+   if (ProfileTotals != NULL)
+   {
+      ::InterlockedExchange(&buffer->IsInUse, 0);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    qsort comparisons: functions by exclusive time, calls by inclusive
+//    time, most first.
+//
+//-----------------------------------------------------------------------------
+
+static int __cdecl
+CompareFunctions
+(
+   const void * first,
+   const void * second
+)
+{
+   unsigned __int64 firstTicks = (*(const ProfileFunction * const *) first)->ExclusiveTicks;
+   unsigned __int64 secondTicks = (*(const ProfileFunction * const *) second)->ExclusiveTicks;
+
+   return (firstTicks > secondTicks) ? -1 : ((firstTicks < secondTicks) ? 1 : 0);
+}
+
+static int __cdecl
+CompareEdges
+(
+   const void * first,
+   const void * second
+)
+{
+   unsigned __int64 firstTicks = (*(const ProfileEdge * const *) first)->InclusiveTicks;
+   unsigned __int64 secondTicks = (*(const ProfileEdge * const *) second)->InclusiveTicks;
+
+   return (firstTicks > secondTicks) ? -1 : ((firstTicks < secondTicks) ? 1 : 0);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Write the profile of all threads to the profile file.
+//
+// Remarks:
+//
+//    Functions are named only when ProcTraceInstr passed their names
+//    (/funcname); otherwise ProcTraceDecode's symbols are the way to name
+//    the addresses.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+WriteProfile
+(
+   ThreadProfile * totals
+)
+{
+   static ProfileFunction * functions[PROCTRACE_FUNCTIONS];
+   static ProfileEdge *     edges[PROCTRACE_EDGES];
+
+   FILE * file = ::_wfopen(ProfileFileName, L"w");
+
+   if (file == NULL)
+   {
+      ::fwprintf(stderr, L"ProcTrace: cannot create %s\n", ProfileFileName);
+
+      return;
+   }
+
+   // Convert time stamp counter ticks with the performance counter
+   // readings taken at both ends of the run, or leave them as ticks.
+
+   double          ticksPerUnit = 1.0;
+   const wchar_t * unit = L"ticks";
+
+   if ((TraceHeader.EndCounter > TraceHeader.StartCounter)
+      && (TraceHeader.CounterFrequency != 0))
+   {
+      double seconds = (double) (TraceHeader.EndCounter - TraceHeader.StartCounter)
+         / (double) TraceHeader.CounterFrequency;
+
+      ticksPerUnit = (double) (TraceHeader.EndTimestamp - TraceHeader.StartTimestamp)
+         / (seconds * 1.0e6);
+      unit = L"us";
+   }
+
+   unsigned int functionCount = 0;
+   unsigned int edgeCount = 0;
+
+   for (unsigned int index = 0; index < PROCTRACE_FUNCTIONS; index++)
+   {
+      if (totals->Functions[index].Address != 0)
+      {
+         functions[functionCount++] = &totals->Functions[index];
+      }
+   }
+
+   for (unsigned int index = 0; index < PROCTRACE_EDGES; index++)
+   {
+      if (totals->Edges[index].Callee != 0)
+      {
+         edges[edgeCount++] = &totals->Edges[index];
+      }
+   }
+
+   ::qsort(functions, functionCount, sizeof(functions[0]), CompareFunctions);
+   ::qsort(edges, edgeCount, sizeof(edges[0]), CompareEdges);
+
+   ::fwprintf(file, L"Functions by exclusive time (%s)\n\n", unit);
+   ::fwprintf(file, L"%12s %14s %14s  %s\n", L"Calls", L"Inclusive", L"Exclusive",
+      L"Function");
+
+   for (unsigned int index = 0; index < functionCount; index++)
+   {
+      const ProfileFunction * function = functions[index];
+
+      ::fwprintf(file, L"%12I64u %14.1f %14.1f  0x%08X %s\n", function->CallCount,
+         function->InclusiveTicks / ticksPerUnit, function->ExclusiveTicks / ticksPerUnit,
+         function->Address, (function->Name != NULL) ? function->Name : L"");
+   }
+
+   ::fwprintf(file, L"\nCalls by inclusive time (%s)\n\n", unit);
+   ::fwprintf(file, L"%12s %14s  %s\n", L"Calls", L"Inclusive", L"Caller -> Callee");
+
+   for (unsigned int index = 0; index < edgeCount; index++)
+   {
+      const ProfileEdge *     edge = edges[index];
+      const ProfileFunction * callee = FindFunction(totals->Functions, edge->Callee);
+      const wchar_t *         calleeName =
+         ((callee != NULL) && (callee->Name != NULL)) ? callee->Name : L"";
+
+      ::fwprintf(file, L"%12I64u %14.1f  ", edge->CallCount,
+         edge->InclusiveTicks / ticksPerUnit);
+
+      if (edge->Caller == 0)
+      {
+         ::fwprintf(file, L"<thread> -> 0x%08X %s\n", edge->Callee, calleeName);
+      }
+      else
+      {
+         const ProfileFunction * caller = FindFunction(totals->Functions, edge->Caller);
+
+         // A full function table leaves the address as the only name.
+
+         ::fwprintf(file, L"0x%08X %s -> 0x%08X %s\n", edge->Caller,
+            ((caller != NULL) && (caller->Name != NULL)) ? caller->Name : L"",
+            edge->Callee, calleeName);
+      }
+   }
+
+   if (totals->LostCount != 0)
+   {
+      ::fwprintf(file, L"\n%I64u calls not profiled: the shadow stack or a table was full\n",
+         totals->LostCount);
+   }
+
+   ::fclose(file);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Write what is left of the trace, complete the header, write the
+//    profile and print the measured cost per call.
+//
+// Arguments:
+//
+//    isProcessExiting - [in] Whether the process is exiting, rather than
+//          unloading the runtime.
+//
+// Remarks:
+//
+//    Called at process detach. When the process is exiting every other
+//    thread, the flusher included, has already been terminated, so their
+//    partly filled chunks can be published from here, and the frames
+//    still on their shadow stacks closed. The flusher may have been
+//    terminated in the middle of a chunk, which is written again.
+//
+//    When the runtime is unloaded instead, the flusher is still running
+//    and is stopped first, so that only this thread writes the file.
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+static void
+StopTrace
+(
+   bool isProcessExiting
+)
+{
+   unsigned __int64 callCount = 0;
+   unsigned __int64 sampleCount = 0;
+   unsigned __int64 sampledCycles = 0;
+   LARGE_INTEGER    counter;
+
+   ::InterlockedExchange(&StopFlushing, 1);
+
+   if (!IsConsoleMode)
+   {
+      if (isProcessExiting)
+      {
+         RecoverChunks();
+      }
+      else if (FlushThread != NULL)
+      {
+         ::SetEvent(FlushEvent);
+         ::WaitForSingleObject(FlushStoppedEvent, INFINITE);
+      }
+   }
+
+   ::QueryPerformanceCounter(&counter);
+
+   TraceHeader.EndTimestamp = __rdtsc();
+   TraceHeader.EndCounter = counter.QuadPart;
+
+   // The threads that exited are in the totals already, and their
+   // buffers are clear, so every buffer can be merged.
+
+   ThreadProfile * totals = ProfileTotals;
+
+   for (ThreadBuffer * buffer = TraceBuffers; buffer != NULL; buffer = buffer->Next)
+   {
+      callCount += buffer->CallCount;
+      sampleCount += buffer->SampleCount;
+      sampledCycles += buffer->SampledCycles;
+      TraceHeader.StallCount += buffer->StallCount;
+
+      CloseFrames(buffer->Profile, 0xFFFFFFFF, TraceHeader.EndTimestamp);
+
+      if (totals != NULL)
+      {
+         MergeProfile(totals, buffer->Profile);
+      }
+
+      if (!IsConsoleMode && (buffer->Chunks[buffer->Current].State == CHUNK_FILLING)
+         && (buffer->Chunks[buffer->Current].Count != 0))
+      {
+         PublishChunk(buffer);
+      }
+   }
+
+   if (!IsConsoleMode)
+   {
+      FlushChunks();
+
+      DWORD written;
+
+      ::SetFilePointer(TraceFile, 0, NULL, FILE_BEGIN);
+      ::WriteFile(TraceFile, &TraceHeader, sizeof(TraceHeader), &written, NULL);
+      ::CloseHandle(TraceFile);
+      TraceFile = INVALID_HANDLE_VALUE;
+   }
+
+   ::fwprintf(stderr, L"ProcTrace: %I64u calls", callCount);
+
+   if (sampleCount != 0)
+   {
+      ::fwprintf(stderr, L", %I64u cycles per call (%s, %I64u sampled)",
+         sampledCycles / sampleCount, IsConsoleMode ? L"console" : L"binary",
+         sampleCount);
+   }
+
+   if (!IsConsoleMode)
+   {
+      ::fwprintf(stderr, L", %I64u records, %I64u stalls, written to %s",
+         TraceHeader.RecordCount, TraceHeader.StallCount, TraceFileName);
+   }
+
+   ::fwprintf(stderr, L"\n");
+
+   if (totals != NULL)
+   {
+      WriteProfile(totals);
+      ::VirtualFree(totals, 0, MEM_RELEASE);
+      ProfileTotals = NULL;
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Start the trace when the runtime is loaded and finish it when the
+//    process exits. A thread that exits gives back its buffer.
+//
+// Returns:
+//
+//    TRUE
+//
+//-----------------------------------------------------------------------------
+
+BOOL WINAPI
+DllMain
+(
+   HINSTANCE,
+   DWORD     reason,
+   LPVOID    reserved
+)
+{
+   switch (reason)
+   {
+   case DLL_PROCESS_ATTACH:
+      StartTrace();
+      break;
+
+   case DLL_THREAD_DETACH:
+      if (TraceTlsIndex != TLS_OUT_OF_INDEXES)
+      {
+         ThreadBuffer * buffer = (ThreadBuffer *) ::TlsGetValue(TraceTlsIndex);
+
+         if (buffer != NULL)
+         {
+            ReleaseThreadBuffer(buffer);
+         }
+      }
+      break;
+
+   case DLL_PROCESS_DETACH:
+
+      // reserved is non-NULL when the process is exiting.
+
+      StopTrace(reserved != NULL);
+      break;
+   }
+
+   return TRUE;
+}
 
 //-----------------------------------------------------------------------------
 //
@@ -70,7 +1464,7 @@ Shout()
 
    // Do work
 
-   ::wprintf(L"In Shout()\n");
+   TraceCall(0, NULL, 0);
 
    // End do work
 
@@ -141,10 +1535,9 @@ ShoutAddr
       mov ebx, eax
    }
 
-   // Do work
+   // Do work.  The function's stack pointer is just above our argument.
 
-   ::wprintf(L"In Function @ 0x%08X\n", funcAddress);
-   ::fflush(stdout);
+   TraceCall(funcAddress, NULL, (unsigned int) (UINT_PTR) (&funcAddress + 1));
 
    // End do work
 
@@ -216,10 +1609,9 @@ ProcTrace
       mov ebx, eax
    }
 
-   // Do work
+   // Do work.  The function's stack pointer is just above our arguments.
 
-   ::wprintf(L"0x%08X, %s\n", funcAddress, functionName);
-   ::fflush(stdout);
+   TraceCall(funcAddress, functionName, (unsigned int) (UINT_PTR) (&functionName + 1));
 
    // End do work
 
@@ -246,3 +1638,78 @@ ProcTrace
    }
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Takes the unsigned int address of a function that is about to return
+//    and closes its frame in the profile
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+extern "C"
+__declspec(naked)
+__declspec(dllexport)
+void _stdcall
+ProcTraceExit
+(
+   unsigned int funcAddress    // Address of the Function
+)
+{
+   _asm
+   {
+      // Set up the stack frame
+
+      push    ebp
+      mov     ebp, esp
+
+      // Store the flags etc
+
+      pushad
+      pushfd
+
+      // Clear directional flag
+
+      cld
+
+      // Save Win32 error flag
+
+      call dword ptr [GetLastError]
+
+      mov ebx, eax
+   }
+
+   // Do work.  The function's stack pointer is just above our argument,
+   // where it was when the function was entered.
+
+   TraceReturn(funcAddress, (unsigned int) (UINT_PTR) (&funcAddress + 1));
+
+   // End do work
+
+   _asm
+   {
+      // Reset win32 error flag
+
+      push ebx
+
+      call dword ptr [SetLastError]
+
+      // Restore flags etc
+
+      popfd
+      popad
+
+      // Restore frame pointer
+
+      pop ebp
+
+      // Pop argument off stack
+
+      ret    0x4
+   }
+}
+
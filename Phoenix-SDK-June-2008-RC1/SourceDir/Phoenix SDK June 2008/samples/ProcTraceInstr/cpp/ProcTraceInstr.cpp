@@ -15,6 +15,14 @@
 //    Usage: ProcTraceInstr /out <filename> /pdbout <filename> [/funcname]
 //              /in <image-name>
 //
+// Remarks:
+//
+//    Every function gets a call to ProcTrace or ShoutAddr on entry, and a
+//    call to ProcTraceExit before each of its returns, from which the
+//    runtime builds its profile. Exceptions do not show in the IR of the
+//    disassembled image, so frames left by an exception are closed by the
+//    runtime instead.
+//
 //-----------------------------------------------------------------------------
 
 #include "..\..\common\samples.h"
@@ -72,6 +80,17 @@ GetExternalFuncType
 );
 
 void                   InitCmdLineParser();
+
+void
+InsertCall
+(
+   Phx::FunctionUnit    ^ function,
+   Phx::IR::Instruction ^ beforeInstruction,
+   Phx::Symbols::Symbol ^ symIAT,
+   Phx::Types::Type     ^ functionType,
+   Phx::Symbols::GlobalVariableSymbol ^ stringSym
+);
+
 Phx::Symbols::GlobalVariableSymbol ^
 InsertFuncNameString
 (
@@ -85,7 +104,9 @@ InstrumentMethod
    Phx::PEModuleUnit ^ module,
    Phx::FunctionUnit     ^ function,
    Phx::Symbols::Symbol    ^ symIAT,
+   Phx::Symbols::Symbol    ^ symExitIAT,
    Phx::Types::Type  ^ functionType,
+   Phx::Types::Type  ^ exitFunctionType,
    bool                doPassFuncName
 );
 
@@ -302,6 +323,14 @@ DoAddInstrumentation
 
    Phx::Symbols::Symbol ^ symIAT = importsym->ImportAddressTableSymbol;
 
+   // The same for the call before each return, which passes only the
+   // address of the function
+
+   Phx::Symbols::ImportSymbol ^ exitImportsym =
+      ::AddImport(module, dll, L"_ProcTraceExit@4");
+   Phx::Types::Type ^       exitFunctionType = ::GetExternalFuncType(module, false);
+   Phx::Symbols::Symbol ^   symExitIAT = exitImportsym->ImportAddressTableSymbol;
+
    // Iterate over each function actually has contribution in the module.
 
    for (Phx::ContributionUnitIterator contribUnitIterator =
@@ -317,8 +346,8 @@ DoAddInstrumentation
 
       functionUnit->DisassembleToBeforeLayout();
 
-      ::InstrumentMethod(module, functionUnit, symIAT, functionType,
-         doPassFuncName);
+      ::InstrumentMethod(module, functionUnit, symIAT, symExitIAT, functionType,
+         exitFunctionType, doPassFuncName);
    }
 }
 
@@ -571,10 +600,13 @@ InsertFuncNameString
 //
 // Remarks:
 //
-//    Creates an Hir call instruction
-//    Appends the appropriate parameters to it in the form of Operands
-//    Inserts the instruction into the IR
-//    Lowers the instruction to LIR
+//    Inserts a call to the entry method before the first real instruction,
+//       passing the function's name if doPassFuncName is set
+//    Inserts a call to ProcTraceExit before each return
+//
+//    A call is inserted right before the return, after the epilogue, so the
+//    stack pointer is the one the function was entered with and the runtime
+//    can match the return to the entry by it.
 //
 // Returns:
 //
@@ -588,23 +620,90 @@ InstrumentMethod
    Phx::PEModuleUnit ^ module,        // Module being instrumented
    Phx::FunctionUnit     ^ function,          // FunctionUnit to instrument
    Phx::Symbols::Symbol    ^ symIAT,        // Symbol of the import to call
+   Phx::Symbols::Symbol    ^ symExitIAT,    // Symbol of the import to call on return
    Phx::Types::Type  ^ functionType,      // FunctionType of the import
+   Phx::Types::Type  ^ exitFunctionType,  // FunctionType of the return import
    bool                doPassFuncName // Pass the name and address of function?
 )
 {
    Phx::IR::Instruction ^ firstinstr = nullptr;
 
+   System::Collections::Generic::List<Phx::IR::Instruction ^> ^ returnInstrs =
+      gcnew System::Collections::Generic::List<Phx::IR::Instruction ^>();
+
    for each (Phx::IR::Instruction ^ instruction in function->Instructions)
    {
       // Don't want a LabelInstruction, PragmaInstruction or DataInstruction
 
-      if (instruction->IsReal)
+      if (!instruction->IsReal)
+      {
+         continue;
+      }
+
+      if (firstinstr == nullptr)
       {
          firstinstr = instruction;
-         break;
       }
+
+      // Collect the returns first, rather than inserting while iterating
+
+      if (instruction->IsReturn)
+      {
+         returnInstrs->Add(instruction);
+      }
+   }
+
+   if (firstinstr == nullptr)
+   {
+      return;
+   }
+
+   Phx::Symbols::GlobalVariableSymbol ^ stringSym = nullptr;
+
+   if (doPassFuncName == true)
+   {
+      // Insert the function name as a String into the IR for use later
+
+      stringSym = ::InsertFuncNameString(module, function);
    }
 
+   ::InsertCall(function, firstinstr, symIAT, functionType, stringSym);
+
+   for each (Phx::IR::Instruction ^ returnInstr in returnInstrs)
+   {
+      ::InsertCall(function, returnInstr, symExitIAT, exitFunctionType, nullptr);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Insert a call to one of the runtime's methods
+//
+// Remarks:
+//
+//    Creates an Hir call instruction
+//    Appends the appropriate parameters to it in the form of Operands
+//    Inserts the instruction into the IR
+//    Lowers the instruction to LIR
+//
+// Returns:
+//
+//    Nothing
+//
+//-----------------------------------------------------------------------------
+
+void
+InsertCall
+(
+   Phx::FunctionUnit    ^ function,          // FunctionUnit to instrument
+   Phx::IR::Instruction ^ beforeInstruction, // Instruction to insert the call before
+   Phx::Symbols::Symbol ^ symIAT,            // Symbol of the import to call
+   Phx::Types::Type     ^ functionType,      // FunctionType of the import
+   Phx::Symbols::GlobalVariableSymbol ^ stringSym // Name to pass, or nullptr
+)
+{
    // Now create the call to the import
 
    // Create an alignment for the MemoryOperand
@@ -643,13 +742,8 @@ InstrumentMethod
 
    call->AppendSource(opndFuncAddress);
 
-   if (doPassFuncName == true)
+   if (stringSym != nullptr)
    {
-      // Insert the function name as a String into the IR for use later
-
-      Phx::Symbols::GlobalVariableSymbol ^ stringSym = ::InsertFuncNameString(module,
-         function);
-
       // now append the string pointer
 
       Phx::IR::MemoryOperand ^ opndStringAddress = Phx::IR::MemoryOperand::NewAddress(
@@ -661,10 +755,9 @@ InstrumentMethod
 
    // Insert it before the instruction
 
-   firstinstr->InsertBefore(call);
+   beforeInstruction->InsertBefore(call);
 
    // Lower the instruction to the LIR of the Target platform
 
    function->Lower->Instruction(call);
 }
-
@@ -0,0 +1,574 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+//    Dense bit matrix solver for the reaching definitions plug-in.
+//
+//-----------------------------------------------------------------------------
+
+using namespace System;
+
+#include "..\..\common\samples.h"
+#include "reaching-defs.h"
+#include "dense-solver.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace ReachingDefs
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Static constructor for the dense solver. Numbers the blocks and builds
+//    the GEN and KILL rows of every block.
+//
+// Arguments:
+//
+//    walker - The walker whose definitions are solved. Collect must have
+//       been called, and the walker must be initialized on the function's
+//       flow graph.
+//
+// Returns:
+//
+//    DenseSolver object.
+//
+//-----------------------------------------------------------------------------
+
+DenseSolver ^
+DenseSolver::New
+(
+   Walker ^ walker
+)
+{
+   DenseSolver ^ solver = gcnew DenseSolver;
+
+   solver->walker = walker;
+   solver->definitionCount = walker->DefTable->DefinitionCount;
+   solver->wordCount = Math::Max(1, (solver->definitionCount + 63) / 64);
+
+   solver->NumberBlocks();
+   solver->BuildTransfer();
+
+   return solver;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Lay the reachable blocks out in reverse post order and record their
+//    predecessors and successors by position.
+//
+//-----------------------------------------------------------------------------
+
+void
+DenseSolver::NumberBlocks()
+{
+   Phx::Graphs::FlowGraph ^ flowGraph = this->walker->FunctionUnit->FlowGraph;
+
+   Phx::Graphs::NodeFlowOrder ^ postOrder =
+      Phx::Graphs::NodeFlowOrder::New(flowGraph->Lifetime);
+
+   postOrder->Build(flowGraph, Phx::Graphs::Order::PostOrder);
+
+   Phx::Int32 maxId = 0;
+
+   for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+   {
+      maxId = Math::Max(maxId, (Phx::Int32) block->Id);
+   }
+
+   this->blockCount = postOrder->NodeCount;
+   this->blocks = gcnew array<Phx::Graphs::BasicBlock ^>(this->blockCount);
+   this->positions = gcnew array<Phx::Int32>(maxId + 1);
+
+   for (Phx::Int32 id = 0; id <= maxId; id++)
+   {
+      this->positions[id] = -1;
+   }
+
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      Phx::Graphs::BasicBlock ^ block =
+         postOrder->Node(this->blockCount - position)->AsBasicBlock;
+
+      this->blocks[position] = block;
+      this->positions[block->Id] = position;
+   }
+
+   // Count the edges between reachable blocks, then fill them in.
+
+   Phx::Int32 predecessorCount = 0;
+   Phx::Int32 successorCount = 0;
+
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      Phx::Graphs::BasicBlock ^ block = this->blocks[position];
+
+      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+         edge != nullptr; edge = edge->NextPredecessorEdge)
+      {
+         if (this->positions[edge->PredecessorNode->Id] >= 0)
+         {
+            predecessorCount++;
+         }
+      }
+
+      for (Phx::Graphs::FlowEdge ^ edge = block->SuccessorEdgeList;
+         edge != nullptr; edge = edge->NextSuccessorEdge)
+      {
+         if (this->positions[edge->SuccessorNode->Id] >= 0)
+         {
+            successorCount++;
+         }
+      }
+   }
+
+   this->predecessorStart = gcnew array<Phx::Int32>(this->blockCount + 1);
+   this->predecessors = gcnew array<Phx::Int32>(predecessorCount);
+   this->predecessorIsException = gcnew array<Phx::Boolean>(predecessorCount);
+   this->successorStart = gcnew array<Phx::Int32>(this->blockCount + 1);
+   this->successors = gcnew array<Phx::Int32>(successorCount);
+
+   predecessorCount = 0;
+   successorCount = 0;
+
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      Phx::Graphs::BasicBlock ^ block = this->blocks[position];
+
+      this->predecessorStart[position] = predecessorCount;
+      this->successorStart[position] = successorCount;
+
+      for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+         edge != nullptr; edge = edge->NextPredecessorEdge)
+      {
+         Phx::Int32 predecessor = this->positions[edge->PredecessorNode->Id];
+
+         if (predecessor >= 0)
+         {
+            this->predecessors[predecessorCount] = predecessor;
+            this->predecessorIsException[predecessorCount] = edge->IsException;
+            predecessorCount++;
+         }
+      }
+
+      for (Phx::Graphs::FlowEdge ^ edge = block->SuccessorEdgeList;
+         edge != nullptr; edge = edge->NextSuccessorEdge)
+      {
+         Phx::Int32 successor = this->positions[edge->SuccessorNode->Id];
+
+         if (successor >= 0)
+         {
+            this->successors[successorCount++] = successor;
+         }
+      }
+   }
+
+   this->predecessorStart[this->blockCount] = predecessorCount;
+   this->successorStart[this->blockCount] = successorCount;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Allocate the set rows and compute GEN and KILL for every block.
+//
+// Remarks:
+//
+//    Walker::EvaluateBlock asserts that an instruction with a handler is
+//    the last one of its block, so only the last instruction is checked
+//    when deciding which blocks need exception rows.
+//
+//-----------------------------------------------------------------------------
+
+void
+DenseSolver::BuildTransfer()
+{
+   Phx::Int32 rowWords = this->blockCount * this->wordCount;
+
+   this->generateRows = gcnew array<System::UInt64>(rowWords);
+   this->killRows = gcnew array<System::UInt64>(rowWords);
+   this->inRows = gcnew array<System::UInt64>(rowWords);
+   this->outRows = gcnew array<System::UInt64>(rowWords);
+
+   this->exceptionRow = gcnew array<Phx::Int32>(this->blockCount);
+   this->exceptionCount = 0;
+
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      Phx::IR::Instruction ^ lastInstruction =
+         this->blocks[position]->LastInstruction;
+
+      if ((lastInstruction != nullptr) && lastInstruction->HasHandlerLabelOperand)
+      {
+         this->exceptionRow[position] = this->exceptionCount++;
+      }
+      else
+      {
+         this->exceptionRow[position] = -1;
+      }
+   }
+
+   Phx::Int32 exceptionWords = this->exceptionCount * this->wordCount;
+
+   this->exceptionGenerateRows = gcnew array<System::UInt64>(exceptionWords);
+   this->exceptionKillRows = gcnew array<System::UInt64>(exceptionWords);
+   this->exceptionOutRows = gcnew array<System::UInt64>(exceptionWords);
+
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      this->BuildBlockTransfer(position);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compute the GEN and KILL rows of one block by walking its instructions
+//    forward, with the same rules as Walker::EvaluateBlock.
+//
+// Remarks:
+//
+//    EvaluateBlock subtracts the whole KILL set from GEN after every
+//    instruction. GEN and KILL never share a bit, so clearing the newly
+//    killed bits from GEN is the same, and keeps the work per instruction
+//    proportional to the definitions it touches rather than to the row.
+//
+//-----------------------------------------------------------------------------
+
+void
+DenseSolver::BuildBlockTransfer
+(
+   Phx::Int32 position
+)
+{
+   Phx::Alias::Info ^          aliasInfo = this->walker->FunctionUnit->AliasInfo;
+   DefsTable ^                 definitionTable = this->walker->DefTable;
+   array<System::UInt64> ^     generateRows = this->generateRows;
+   array<System::UInt64> ^     killRows = this->killRows;
+   Phx::Int32                  row = position * this->wordCount;
+
+   for each (Phx::IR::Instruction ^ instruction in this->blocks[position]->Instructions)
+   {
+      if (instruction->IsSsa)
+      {
+         continue;
+      }
+
+      Phx::Int32 exception = this->exceptionRow[position];
+
+      if (instruction->HasHandlerLabelOperand && (exception >= 0))
+      {
+         Array::Copy(generateRows, row, this->exceptionGenerateRows,
+            exception * this->wordCount, this->wordCount);
+         Array::Copy(killRows, row, this->exceptionKillRows,
+            exception * this->wordCount, this->wordCount);
+      }
+
+      for each (Phx::IR::Operand ^ dstOperand in instruction->DataflowDestinationOperands)
+      {
+         if (dstOperand->IsExpressionTemporary)
+         {
+            continue;
+         }
+
+         foreach_must_total_alias_of_tag(
+            aliasTag, dstOperand->AliasTag, aliasInfo)
+         {
+            for each (DefId id in definitionTable->GetAliasTagDefs(aliasTag))
+            {
+               System::UInt64 bit = 1ULL << (id & 63);
+
+               killRows[row + (id >> 6)] |= bit;
+               generateRows[row + (id >> 6)] &= ~bit;
+            }
+         }
+         next_must_total_alias_of_tag;
+      }
+
+      InstructionExtensionObject ^ extensionObject =
+         InstructionExtensionObject::GetExtensionObject(instruction);
+
+      if (extensionObject != nullptr)
+      {
+         for each (DefId id in extensionObject->DefsBv)
+         {
+            System::UInt64 bit = 1ULL << (id & 63);
+
+            killRows[row + (id >> 6)] &= ~bit;
+            generateRows[row + (id >> 6)] |= bit;
+
+            if (instruction->HasHandlerLabelOperand && (exception >= 0))
+            {
+               this->exceptionGenerateRows[exception * this->wordCount + (id >> 6)] |= bit;
+            }
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Solve for the IN and OUT sets of all reachable blocks.
+//
+// Remarks:
+//
+//    Every block starts pending. A sweep visits the pending blocks in
+//    reverse post order; a block whose OUT changes makes its successors
+//    pending. Successors later in the order are seen in the same sweep, so
+//    another sweep is only needed when a back edge carried a change.
+//
+//-----------------------------------------------------------------------------
+
+void
+DenseSolver::Solve()
+{
+   array<Phx::Boolean> ^ pending = gcnew array<Phx::Boolean>(this->blockCount);
+   Phx::Boolean          isSweepNeeded = true;
+
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      pending[position] = true;
+   }
+
+   this->blockVisits = 0;
+
+   while (isSweepNeeded)
+   {
+      isSweepNeeded = false;
+
+      for (Phx::Int32 position = 0; position < this->blockCount; position++)
+      {
+         if (!pending[position])
+         {
+            continue;
+         }
+
+         pending[position] = false;
+         this->blockVisits++;
+
+         this->Merge(position);
+
+         Phx::Int32     row = position * this->wordCount;
+         Phx::Int32     exception = this->exceptionRow[position];
+         Phx::Boolean   isChanged = Transfer(this->outRows, row, this->inRows, row,
+            this->generateRows, this->killRows, row, this->wordCount);
+
+         if (exception >= 0)
+         {
+            Phx::Int32 exceptionRow = exception * this->wordCount;
+
+            isChanged |= Transfer(this->exceptionOutRows, exceptionRow, this->inRows,
+               row, this->exceptionGenerateRows, this->exceptionKillRows,
+               exceptionRow, this->wordCount);
+         }
+
+         if (!isChanged)
+         {
+            continue;
+         }
+
+         for (Phx::Int32 i = this->successorStart[position];
+            i < this->successorStart[position + 1]; i++)
+         {
+            Phx::Int32 successor = this->successors[i];
+
+            pending[successor] = true;
+
+            if (successor <= position)
+            {
+               isSweepNeeded = true;
+            }
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Set the IN row of a block to the union of its predecessors' OUT rows.
+//    Along an exception edge the predecessor's exception OUT row is used,
+//    as Data::Merge does for MergeFlags::EH.
+//
+//-----------------------------------------------------------------------------
+
+void
+DenseSolver::Merge
+(
+   Phx::Int32 position
+)
+{
+   array<System::UInt64> ^ inRows = this->inRows;
+   Phx::Int32              row = position * this->wordCount;
+
+   Array::Clear(inRows, row, this->wordCount);
+
+   for (Phx::Int32 i = this->predecessorStart[position];
+      i < this->predecessorStart[position + 1]; i++)
+   {
+      Phx::Int32              predecessor = this->predecessors[i];
+      Phx::Int32              exception = this->exceptionRow[predecessor];
+      array<System::UInt64> ^ sourceRows = this->outRows;
+      Phx::Int32              sourceRow = predecessor * this->wordCount;
+
+      if (this->predecessorIsException[i] && (exception >= 0))
+      {
+         sourceRows = this->exceptionOutRows;
+         sourceRow = exception * this->wordCount;
+      }
+
+      for (Phx::Int32 word = 0; word < this->wordCount; word++)
+      {
+         inRows[row + word] |= sourceRows[sourceRow + word];
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The transfer function OUT = GEN | (IN & ~KILL) over one row.
+//
+// Returns:
+//
+//    True if the OUT row changed.
+//
+//-----------------------------------------------------------------------------
+
+Phx::Boolean
+DenseSolver::Transfer
+(
+   array<System::UInt64> ^ outRows,
+   Phx::Int32              outRow,
+   array<System::UInt64> ^ inRows,
+   Phx::Int32              inRow,
+   array<System::UInt64> ^ generateRows,
+   array<System::UInt64> ^ killRows,
+   Phx::Int32              transferRow,
+   Phx::Int32              wordCount
+)
+{
+   System::UInt64 changed = 0;
+
+   for (Phx::Int32 word = 0; word < wordCount; word++)
+   {
+      System::UInt64 out = generateRows[transferRow + word]
+         | (inRows[inRow + word] & ~killRows[transferRow + word]);
+
+      changed |= out ^ outRows[outRow + word];
+      outRows[outRow + word] = out;
+   }
+
+   return (changed != 0);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Copy the solved IN sets into the walker's block data, so that
+//    Walker::CollectOperandInfo can use them.
+//
+// Remarks:
+//
+//    The walker must have been initialized freshly, so its IN sets are
+//    empty.
+//
+//-----------------------------------------------------------------------------
+
+void
+DenseSolver::WriteBack()
+{
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      Data ^ blockData =
+         safe_cast<Data ^>(this->walker->GetBlockData(this->blocks[position]));
+      Phx::Int32 row = position * this->wordCount;
+
+      for (Phx::Int32 word = 0; word < this->wordCount; word++)
+      {
+         System::UInt64 bits = this->inRows[row + word];
+
+         for (Phx::Int32 bit = 0; bits != 0; bit++, bits >>= 1)
+         {
+            if ((bits & 1) != 0)
+            {
+               blockData->InBitVector->SetBit(word * 64 + bit);
+            }
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compare the solved IN sets with those the walker computed.
+//
+// Returns:
+//
+//    True if every reachable block has the same IN set in both.
+//
+//-----------------------------------------------------------------------------
+
+Phx::Boolean
+DenseSolver::Matches
+(
+   Walker ^ walker
+)
+{
+   for (Phx::Int32 position = 0; position < this->blockCount; position++)
+   {
+      Data ^ blockData =
+         safe_cast<Data ^>(walker->GetBlockData(this->blocks[position]));
+      Phx::Int32 row = position * this->wordCount;
+      Phx::Int32 sparseCount = 0;
+      Phx::Int32 denseCount = 0;
+
+      for each (DefId id in blockData->InBitVector)
+      {
+         if ((id >= this->definitionCount)
+            || ((this->inRows[row + (id >> 6)] & (1ULL << (id & 63))) == 0))
+         {
+            return false;
+         }
+
+         sparseCount++;
+      }
+
+      for (Phx::Int32 word = 0; word < this->wordCount; word++)
+      {
+         for (System::UInt64 bits = this->inRows[row + word]; bits != 0;
+            bits &= bits - 1)
+         {
+            denseCount++;
+         }
+      }
+
+      if (sparseCount != denseCount)
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+} // ReachingDefs
+} // Samples
+} // Phx
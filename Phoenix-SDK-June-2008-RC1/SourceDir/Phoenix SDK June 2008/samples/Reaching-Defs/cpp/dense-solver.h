@@ -0,0 +1,207 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Dense bit matrix solver for reaching definitions.
+//
+//    Walker::Compute solves the problem through the generic
+//    Phx::Dataflow::Walker: every block owns four sparse bit vectors, and
+//    the traversal calls the virtual Merge, SamePrecondition and Update
+//    methods of Data for every block it visits. In large functions most
+//    definitions reach most blocks, so the sparse vectors end up dense and
+//    the per-block calls dominate.
+//
+//    DenseSolver computes the same IN sets from the same DefsTable.
+//    Definition ids are already contiguous, so each block's GEN, KILL, IN
+//    and OUT sets are rows of 64-bit words in one array per set, with the
+//    blocks laid out in reverse post order. The transfer function
+//    OUT = GEN | (IN & ~KILL) runs a word at a time over a row, and the
+//    solver sweeps the blocks in reverse post order, visiting only blocks
+//    whose predecessors changed, until nothing changes.
+//
+//    WriteBack copies the IN sets into the walker's block data, so
+//    Walker::CollectOperandInfo builds the operand extension objects
+//    exactly as it does after Walker::Compute.
+//
+// Remarks:
+//
+//    Blocks that cannot be reached from the entry are not solved; their
+//    IN sets are left empty.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace ReachingDefs
+{
+
+ref class Walker;
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Reaching definitions solver over dense per-block bit rows
+//
+//-----------------------------------------------------------------------------
+
+public ref class DenseSolver
+{
+
+public:
+
+   static DenseSolver ^
+   New
+   (
+      Walker ^ walker
+   );
+
+   void Solve();
+
+   void WriteBack();
+
+   Phx::Boolean
+   Matches
+   (
+      Walker ^ walker
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of block visits made by Solve
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 BlockVisits
+   {
+      Phx::Int32 get() { return this->blockVisits; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of reachable blocks the solver works on
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 BlockCount
+   {
+      Phx::Int32 get() { return this->blockCount; }
+   }
+
+private:
+
+   void NumberBlocks();
+
+   void BuildTransfer();
+
+   void
+   BuildBlockTransfer
+   (
+      Phx::Int32 position
+   );
+
+   void
+   Merge
+   (
+      Phx::Int32 position
+   );
+
+   static Phx::Boolean
+   Transfer
+   (
+      array<System::UInt64> ^ outRows,
+      Phx::Int32              outRow,
+      array<System::UInt64> ^ inRows,
+      Phx::Int32              inRow,
+      array<System::UInt64> ^ generateRows,
+      array<System::UInt64> ^ killRows,
+      Phx::Int32              transferRow,
+      Phx::Int32              wordCount
+   );
+
+private:
+
+   Walker ^ walker;
+
+   // Definitions 0 .. definitionCount - 1 are tracked, wordCount words
+   // per row
+
+   Phx::Int32 definitionCount;
+
+   Phx::Int32 wordCount;
+
+   // The reachable blocks in reverse post order, and the position of each
+   // block in that order, indexed by block id; -1 for unreachable blocks
+
+   array<Phx::Graphs::BasicBlock ^> ^ blocks;
+
+   array<Phx::Int32> ^ positions;
+
+   Phx::Int32 blockCount;
+
+   // Predecessors and successors of the block at each position, as
+   // positions. The entries of position p are at [p] .. [p + 1] - 1 of
+   // the start arrays. predecessorIsException marks exception edges,
+   // whose predecessor contributes its exception OUT set.
+
+   array<Phx::Int32> ^ predecessorStart;
+
+   array<Phx::Int32> ^ predecessors;
+
+   array<Phx::Boolean> ^ predecessorIsException;
+
+   array<Phx::Int32> ^ successorStart;
+
+   array<Phx::Int32> ^ successors;
+
+   // The sets, one row per position
+
+   array<System::UInt64> ^ generateRows;
+
+   array<System::UInt64> ^ killRows;
+
+   array<System::UInt64> ^ inRows;
+
+   array<System::UInt64> ^ outRows;
+
+   // The summary sets up to an exception edge, for blocks ending in an
+   // instruction with a handler. exceptionRow holds the row of each
+   // position in these arrays, or -1.
+
+   array<Phx::Int32> ^ exceptionRow;
+
+   array<System::UInt64> ^ exceptionGenerateRows;
+
+   array<System::UInt64> ^ exceptionKillRows;
+
+   array<System::UInt64> ^ exceptionOutRows;
+
+   Phx::Int32 exceptionCount;
+
+   Phx::Int32 blockVisits;
+};
+
+} // namespace ReachingDefs
+} // namespace Samples
+} // namespace Phx
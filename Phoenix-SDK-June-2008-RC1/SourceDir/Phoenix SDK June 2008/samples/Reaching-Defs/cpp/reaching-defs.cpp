@@ -7,7 +7,10 @@
 //    implementing standard iterative algorithm for
 //    reaching definitions.
 //
-//    The plug-in injects a phase after MIR Lower
+//    The plug-in injects a phase after MIR Lower. The phase gets the flow
+//    graph from an AnalysisCache (common\analysis-cache.h), which reuses
+//    one an earlier phase built and deletes one it built itself when the
+//    phase is done.
 //
 // Usage:
 //
@@ -19,7 +22,10 @@ using namespace System;
 using namespace System::IO;
 
 #include "..\..\common\samples.h"
+#include "..\..\common\analysis-cache.h"
 #include "reaching-defs.h"
+#include "dense-solver.h"
+#include "ssa-defs.h"
 
 namespace Phx
 {
@@ -45,6 +51,27 @@ namespace ReachingDefs
 void
 PlugIn::RegisterObjects()
 {
+   Phase::DenseControl =
+      Phx::Controls::SetBooleanControl::New(L"reachingDefsDense",
+         L"Solve reaching definitions with the dense bit matrix solver",
+         L"reaching-defs.cpp");
+
+   Phase::BenchmarkControl =
+      Phx::Controls::SetBooleanControl::New(L"reachingDefsBench",
+         L"Time the sparse and dense reaching definitions solvers",
+         L"reaching-defs.cpp");
+
+   Phase::SsaControl =
+      Phx::Controls::SetBooleanControl::New(L"reachingDefsSsa",
+         L"Answer reaching definitions queries from SSA",
+         L"reaching-defs.cpp");
+
+   Phx::Samples::AnalysisCache::RegisterObjects(L"reachingDefs",
+      L"reaching-defs.cpp");
+
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"reachingDefs",
+      L"reaching-defs.cpp");
+
 #if defined(PHX_DEBUG_SUPPORT)
 
    Phase::DebugControl =
@@ -87,6 +114,9 @@ PlugIn::BuildPhases
    Phase ^ phase = Phase::New(config);
 
    mirLowerPhase->InsertAfter(phase);
+
+   Phx::Samples::AnalysisCache::BuildPhases(config, phase);
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 
 //-----------------------------------------------------------------------------
@@ -121,63 +151,210 @@ Phase::New
 //
 // Description:
 //
-//    Executes the Reaching Definitions phase.
+//    Executes the Reaching Definitions phase on a function.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit // unit  the phase should run for
+   Phx::FunctionUnit ^           functionUnit, // function to process
+   System::Text::StringBuilder ^ output,       // buffer for its report
+   Phx::Lifetime ^               lifetime      // unused; the walker has its own
 )
 {
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
-
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
-
    Phx::Alias::Info ^ aliasInfo = functionUnit->AliasInfo;
 
    // check if alias information is ready
 
    if (!aliasInfo->IsComplete)
    {
-      Output::WriteLine(
+      output->AppendLine(
          L"Alias information has to be collected in order to "
          L"collect reaching definitions");
 
       return;
    }
 
-   // prepare flow graph: we need up-to-date flow graph
+   // prepare flow graph: we need up-to-date flow graph. The cache reuses
+   // the one on the unit or builds one, and deletes one it built in the
+   // release phase after this one.
 
-   if (functionUnit->FlowGraph == nullptr)
+   Phx::Samples::AnalysisCache::Get(functionUnit)->FlowGraph;
+
+   if (!Phase::SsaControl->IsEnabled(functionUnit))
+   {
+      this->ExecuteBitVectors(functionUnit, output);
+   }
+   else if (!Phase::BenchmarkControl->IsEnabled(functionUnit))
+   {
+      this->ExecuteSsa(functionUnit, output);
+   }
+   else
    {
-      functionUnit->BuildFlowGraph();
+      this->CompareModes(functionUnit, output);
    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compute reaching definitions as bit vectors attached to the source
+//    operands.
+//
+// Returns:
+//
+//    A snapshot of the size of the managed heap, taken just before the
+//    results are deleted.
+//
+//-----------------------------------------------------------------------------
 
+Phx::Int64
+Phase::ExecuteBitVectors
+(
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output
+)
+{
    Walker ^ walker = Walker::New(functionUnit);
 
    // Collect definitions we will track.
 
    walker->Collect();
 
-   // Compute In and Out sets for basic blocks.
+   // Compute In and Out sets for basic blocks. When the SSA mode is being
+   // compared, the solvers are not.
 
-   walker->Compute();
+   if (Phase::BenchmarkControl->IsEnabled(functionUnit)
+      && !Phase::SsaControl->IsEnabled(functionUnit))
+   {
+      walker->Benchmark(output);
+   }
+   else if (Phase::DenseControl->IsEnabled(functionUnit))
+   {
+      walker->ComputeDense();
+   }
+   else
+   {
+      walker->Compute();
+   }
 
    // Collect reaching definitions for each operand we track.
    // Dump the information if requested so.
 
-   walker->CollectOperandInfo();
+   walker->CollectOperandInfo(output);
+
+   Phx::Int64 heapBytes = GC::GetTotalMemory(false);
 
    // Clean up what we created.
 
    walker->Delete();
 
-   functionUnit->DeleteFlowGraph();
+   return heapBytes;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Answer the reaching definitions of every source operand from SSA.
+//
+// Returns:
+//
+//    A snapshot of the size of the managed heap, taken just before the
+//    results are deleted.
+//
+//-----------------------------------------------------------------------------
+
+Phx::Int64
+Phase::ExecuteSsa
+(
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output
+)
+{
+   SsaDefs ^ ssaDefs = SsaDefs::New(functionUnit);
+
+   ssaDefs->CollectOperandInfo(output);
+
+   Phx::Int64 heapBytes = GC::GetTotalMemory(false);
+
+   if (Phase::BenchmarkControl->IsEnabled(functionUnit))
+   {
+      output->AppendLine(String::Format(
+         L"reachingDefsSsa {0}: {1} queries, {2} cached, {3} SSA definitions"
+         L" visited, {4} definitions held, {5} partial definitions passed"
+         L" through, {6} partial definitions without a previous value",
+         gcnew array<Object ^> {
+            functionUnit->NameString, ssaDefs->QueryCount, ssaDefs->CacheHits,
+            ssaDefs->VisitCount, ssaDefs->CachedDefinitions,
+            ssaDefs->PartialDefinitions, ssaDefs->PartialDeadEnds
+         }));
+   }
+
+   ssaDefs->Delete();
+
+   return heapBytes;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Run the bit vector mode and then the SSA mode on the function, and
+//    report the time each took and how much larger the managed heap was
+//    while its results were alive.
+//
+// Remarks:
+//
+//    The heap is collected before each mode starts. The size is a single
+//    snapshot taken just before the mode deletes its results, not a peak:
+//    it includes garbage the mode left behind as well as the results
+//    themselves, and misses anything collected during the solve. Both
+//    modes are measured the same way. The bit vector mode runs first because the SSA
+//    mode adds phi instructions and alias operands to the IR for as long
+//    as it lives.
+//
+//-----------------------------------------------------------------------------
+
+void
+Phase::CompareModes
+(
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output
+)
+{
+   System::Diagnostics::Stopwatch ^ clock = gcnew System::Diagnostics::Stopwatch();
+
+   Phx::Int64 baseBytes = GC::GetTotalMemory(true);
+
+   clock->Start();
+
+   Phx::Int64 bitVectorBytes = this->ExecuteBitVectors(functionUnit, output) - baseBytes;
+
+   clock->Stop();
+
+   double bitVectorMs = clock->Elapsed.TotalMilliseconds;
+
+   baseBytes = GC::GetTotalMemory(true);
+
+   clock->Reset();
+   clock->Start();
+
+   Phx::Int64 ssaBytes = this->ExecuteSsa(functionUnit, output) - baseBytes;
+
+   clock->Stop();
+
+   double ssaMs = clock->Elapsed.TotalMilliseconds;
+
+   output->AppendLine(String::Format(
+      L"reachingDefsBench {0}: bit vectors {1:F3} ms, {2} KB heap at end;"
+      L" SSA {3:F3} ms, {4} KB heap at end",
+      gcnew array<Object ^> {
+         functionUnit->NameString, bitVectorMs, bitVectorBytes / 1024,
+         ssaMs, ssaBytes / 1024
+      }));
 }
 
 //-----------------------------------------------------------------------------
@@ -216,14 +393,15 @@ DefsTable::New
    definitionTable->DefToInstrMap =
       IdToInstructionMap::New(lifetime, nullptr, numLocTags);
 
-   // Create LocTag->DefIds mapping
+   // Create LocTag->DefIds mapping. It starts empty; sets are added as
+   // their tags are defined.
 
-   Phx::UInt locationTag;
-   definitionTable->LocTagToDefsArray = gcnew array<BitVector::Sparse ^>(numLocTags);
-   for (locationTag = 0; locationTag < numLocTags; locationTag++)
-   {
-      definitionTable->LocTagToDefsArray[locationTag] = BitVector::Sparse::New(lifetime);
-   }
+   definitionTable->tagSetKeys = gcnew array<Phx::Alias::Tag>(16);
+   definitionTable->tagSets = gcnew array<BitVector::Sparse ^>(16);
+   definitionTable->tagSetCount = 0;
+   definitionTable->emptyDefs = BitVector::Sparse::New(lifetime);
+
+   definitionTable->Arena = ExtensionArena::New(lifetime);
 
    return definitionTable;
 }
@@ -239,45 +417,19 @@ DefsTable::New
 void
 DefsTable::Delete()
 {
-   Phx::FunctionUnit ^ functionUnit = this->FunctionUnit;
-
    // Delete DefId->Instruction mapping
 
    this->DefToInstrMap->Delete();
 
-   // Delete all bitvectors in LocTag->DefIds mapping
-
-   Phx::UInt numLocTags = functionUnit->AliasInfo->NumberLocationTags;
-   Phx::UInt locationTag;
-   for (locationTag = 0; locationTag < numLocTags; locationTag++)
-   {
-      this->LocTagToDefsArray[locationTag]->Delete();
-   }
-
-   // Delete all extending object we created for instructions and operands.
+   // Unlink all extending objects we created for instructions and operands.
+   // They and the LocTag->DefIds sets were allocated in the table's
+   // lifetime, and go away with it.
 
-   for each (Phx::IR::Instruction ^ instruction in functionUnit->Instructions)
-   {
-      InstructionExtensionObject ^ extensionObject =
-         InstructionExtensionObject::GetExtensionObject(instruction);
+   this->Arena->Release();
 
-      if (extensionObject != nullptr)
-      {
-         instruction->UnlinkExtensionObject(extensionObject);
-         extensionObject->Delete();
-      }
-
-      for each (Phx::IR::Operand ^ srcOperand in instruction->DataflowSourceOperands)
-      {
-         OperandExtensionObject ^ extensionObject =
-            OperandExtensionObject::GetExtensionObject(srcOperand);
-         if (extensionObject != nullptr)
-         {
-            srcOperand->UnlinkExtensionObject(extensionObject);
-            extensionObject->Delete();
-         }
-      }
-   }
+   this->tagSetKeys = nullptr;
+   this->tagSets = nullptr;
+   this->tagSetCount = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -304,7 +456,7 @@ DefsTable::AddLocDef
 
    // Record new definition for the LocTag.
 
-   this->LocTagToDefsArray[locationTag]->SetBit(currDefId);
+   this->LookupTagDefs(locationTag, true)->SetBit(currDefId);
 
    // record which instruction generates the defintion
 
@@ -319,8 +471,7 @@ DefsTable::AddLocDef
       InstructionExtensionObject::GetExtensionObject(definitionInstruction);
    if (extensionObject == nullptr)
    {
-      extensionObject = InstructionExtensionObject::New(this->Lifetime);
-      definitionInstruction->AddExtensionObject(extensionObject);
+      extensionObject = this->Arena->Attach(definitionInstruction);
    }
    extensionObject->DefsBv->SetBit(currDefId);
 
@@ -366,7 +517,214 @@ DefsTable::GetAliasTagDefs
 #if defined(PHX_DEBUG_CHECKS)
    Phx::Asserts::Assert(this->FunctionUnit->AliasInfo->IsLocationTag(aliasTag));
 #endif
-   return this->LocTagToDefsArray[aliasTag];
+   return this->LookupTagDefs(aliasTag, false);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the set of defintions for the given LocTag in the table.
+//
+// Returns:
+//
+//    The set. If the tag has none, a new set when doCreate is true, and
+//    the shared empty set otherwise.
+//-----------------------------------------------------------------------------
+
+BitVector::Sparse ^
+DefsTable::LookupTagDefs
+(
+   Phx::Alias::Tag aliasTag, // the tag we need definitions for
+   Phx::Boolean    doCreate  // whether to add a set for a tag without one
+)
+{
+   Phx::Int32 mask = this->tagSets->Length - 1;
+   Phx::Int32 slot = (Phx::Int32) ((Phx::UInt) aliasTag * 2654435761u) & mask;
+
+   while (this->tagSets[slot] != nullptr)
+   {
+      if (this->tagSetKeys[slot] == aliasTag)
+      {
+         return this->tagSets[slot];
+      }
+
+      slot = (slot + 1) & mask;
+   }
+
+   if (!doCreate)
+   {
+      return this->emptyDefs;
+   }
+
+   BitVector::Sparse ^ defsBv = BitVector::Sparse::New(this->Lifetime);
+
+   this->tagSetKeys[slot] = aliasTag;
+   this->tagSets[slot] = defsBv;
+
+   if (++this->tagSetCount * 2 >= this->tagSets->Length)
+   {
+      this->GrowTagSets();
+   }
+
+   return defsBv;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Double the size of the LocTag->DefIds table and rehash its sets.
+//
+//-----------------------------------------------------------------------------
+
+void
+DefsTable::GrowTagSets()
+{
+   array<Phx::Alias::Tag> ^    oldKeys = this->tagSetKeys;
+   array<BitVector::Sparse ^> ^ oldSets = this->tagSets;
+   Phx::Int32                  capacity = oldSets->Length * 2;
+   Phx::Int32                  mask = capacity - 1;
+
+   this->tagSetKeys = gcnew array<Phx::Alias::Tag>(capacity);
+   this->tagSets = gcnew array<BitVector::Sparse ^>(capacity);
+
+   for (Phx::Int32 i = 0; i < oldSets->Length; i++)
+   {
+      if (oldSets[i] == nullptr)
+      {
+         continue;
+      }
+
+      Phx::Int32 slot = (Phx::Int32) ((Phx::UInt) oldKeys[i] * 2654435761u) & mask;
+
+      while (this->tagSets[slot] != nullptr)
+      {
+         slot = (slot + 1) & mask;
+      }
+
+      this->tagSetKeys[slot] = oldKeys[i];
+      this->tagSets[slot] = oldSets[i];
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Static constructor for the extension object arena of a walk.
+//
+// Returns:
+//
+//    ExtensionArena object.
+//
+//-----------------------------------------------------------------------------
+
+ExtensionArena ^
+ExtensionArena::New
+(
+   Phx::Lifetime ^ lifetime // lifetime of the walk
+)
+{
+   ExtensionArena ^ arena = gcnew ExtensionArena;
+
+   arena->lifetime = lifetime;
+   arena->instructions = gcnew System::Collections::Generic::List<Phx::IR::Instruction ^>();
+   arena->instructionObjects =
+      gcnew System::Collections::Generic::List<InstructionExtensionObject ^>();
+   arena->operands = gcnew System::Collections::Generic::List<Phx::IR::Operand ^>();
+   arena->operandObjects =
+      gcnew System::Collections::Generic::List<OperandExtensionObject ^>();
+
+   return arena;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create an extending object and attach it to the given instruction.
+//
+// Returns:
+//
+//    The object.
+//-----------------------------------------------------------------------------
+
+InstructionExtensionObject ^
+ExtensionArena::Attach
+(
+   Phx::IR::Instruction ^ instruction // the instruction to extend
+)
+{
+   InstructionExtensionObject ^ extensionObject =
+      InstructionExtensionObject::New(this->lifetime);
+
+   instruction->AddExtensionObject(extensionObject);
+
+   this->instructions->Add(instruction);
+   this->instructionObjects->Add(extensionObject);
+
+   return extensionObject;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Create an extending object and attach it to the given operand.
+//
+// Returns:
+//
+//    The object.
+//-----------------------------------------------------------------------------
+
+OperandExtensionObject ^
+ExtensionArena::Attach
+(
+   Phx::IR::Operand ^ operand // the operand to extend
+)
+{
+   OperandExtensionObject ^ extensionObject =
+      OperandExtensionObject::New(this->lifetime);
+
+   operand->AddExtensionObject(extensionObject);
+
+   this->operands->Add(operand);
+   this->operandObjects->Add(extensionObject);
+
+   return extensionObject;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Unlink every object attached through the arena.
+//
+// Remarks:
+//
+//    The objects' bit vectors are not deleted here; they are freed when
+//    the walk's lifetime is deleted.
+//
+//-----------------------------------------------------------------------------
+
+void
+ExtensionArena::Release()
+{
+   for (Phx::Int32 i = 0; i < this->instructions->Count; i++)
+   {
+      this->instructions[i]->UnlinkExtensionObject(this->instructionObjects[i]);
+   }
+
+   for (Phx::Int32 i = 0; i < this->operands->Count; i++)
+   {
+      this->operands[i]->UnlinkExtensionObject(this->operandObjects[i]);
+   }
+
+   this->instructions->Clear();
+   this->instructionObjects->Clear();
+   this->operands->Clear();
+   this->operandObjects->Clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -767,6 +1125,78 @@ Walker::Compute()
    this->Traverse(Phx::Dataflow::TraversalKind::Iterative, this->FunctionUnit);
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compute reaching definitions for the specified function with the
+//    dense bit matrix solver.
+//
+// Remarks:
+//
+//    The walker is still initialized, so every block gets its Data, but
+//    Traverse is not run. The solver leaves the IN sets in the block data,
+//    which is all CollectOperandInfo needs; OUT, GEN and KILL stay empty.
+//
+//-----------------------------------------------------------------------------
+
+void
+Walker::ComputeDense()
+{
+   this->Initialize(Phx::Dataflow::Direction::Forward, this->FunctionUnit);
+
+   DenseSolver ^ solver = DenseSolver::New(this);
+
+   solver->Solve();
+   solver->WriteBack();
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Compute reaching definitions with Compute, then again with the dense
+//    solver, and report the time each took and whether they agree.
+//
+// Remarks:
+//
+//    The sparse results are kept for CollectOperandInfo. The dense time
+//    includes numbering the blocks and building GEN and KILL, since
+//    Compute builds those inside Traverse as well.
+//
+//-----------------------------------------------------------------------------
+
+void
+Walker::Benchmark
+(
+   System::Text::StringBuilder ^ output // Buffer for the function's report
+)
+{
+   System::Diagnostics::Stopwatch ^ clock = System::Diagnostics::Stopwatch::StartNew();
+
+   this->Compute();
+
+   double sparseMs = clock->Elapsed.TotalMilliseconds;
+
+   clock->Reset();
+   clock->Start();
+
+   DenseSolver ^ solver = DenseSolver::New(this);
+
+   solver->Solve();
+
+   double denseMs = clock->Elapsed.TotalMilliseconds;
+
+   output->AppendLine(String::Format(
+      L"reachingDefsBench {0}: {1} blocks, {2} definitions, sparse {3:F3} ms,"
+      L" dense {4:F3} ms ({5} block visits), results {6}",
+      gcnew array<Object ^> {
+         this->FunctionUnit->NameString, solver->BlockCount,
+         this->DefTable->DefinitionCount, sparseMs, denseMs, solver->BlockVisits,
+         solver->Matches(this) ? L"agree" : L"differ"
+      }));
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -999,13 +1429,17 @@ Walker::EvaluateBlock
 //
 //-----------------------------------------------------------------------------
 
-void Walker::CollectOperandInfo()
+void Walker::CollectOperandInfo
+(
+   System::Text::StringBuilder ^ output // Buffer for the function's report
+)
 {
    Phx::FunctionUnit  ^ functionUnit = this->FunctionUnit;
    Alias::Info    ^ aliasInfo = functionUnit->AliasInfo;
    DefsTable      ^ definitionTable = this->DefTable;
 
-   Output::WriteLine("** Reaching Definitions for {0}", functionUnit->NameString);
+   output->AppendLine(String::Format("** Reaching Definitions for {0}",
+      functionUnit->NameString));
 
    for each (Phx::Graphs::BasicBlock ^ block in functionUnit->FlowGraph->BasicBlocks)
    {
@@ -1031,7 +1465,7 @@ void Walker::CollectOperandInfo()
          if (Controls::DebugControls::VerboseTraceControl->IsEnabled(
                this->DebugControl, functionUnit))
          {
-            Output::WriteLine(L"{0}", instruction->ToString());
+            output->AppendLine(instruction->ToString());
          }
 #endif
 
@@ -1044,8 +1478,7 @@ void Walker::CollectOperandInfo()
             // Create extending object for the operand.
 
             OperandExtensionObject ^ opndExtensionObject =
-               OperandExtensionObject::New(this->TemporaryLifetime);
-            srcOperand->AddExtensionObject(opndExtensionObject);
+               definitionTable->Arena->Attach(srcOperand);
 
             // Compute combined set of defintions overlapped with the operand.
 
@@ -1069,26 +1502,28 @@ void Walker::CollectOperandInfo()
 
                if (debugInfo->IsValidTag(instruction->DebugTag))
                {
-                  Output::WriteLine(
+                  output->AppendLine(String::Format(
                      L"Use of {0} at {1} line {2}: Reaching Definitions: {3}",
-                     srcOperand->ToString(),
-                     Path::GetFileName(debugInfo->GetFileName(instruction->DebugTag)),
-                     debugInfo->GetLineNumber(instruction->DebugTag),
-                     opndExtensionObject->ReachingDefsBv->ToString());
+                     gcnew array<Object ^> {
+                        srcOperand->ToString(),
+                        Path::GetFileName(debugInfo->GetFileName(instruction->DebugTag)),
+                        debugInfo->GetLineNumber(instruction->DebugTag),
+                        opndExtensionObject->ReachingDefsBv->ToString()
+                     }));
                }
                else
                {
-                  Output::WriteLine(
+                  output->AppendLine(String::Format(
                      L"Use of {0} (no source location available): " +
                      L"Reaching Definitions: {1}",
                      srcOperand->ToString(),
-                     opndExtensionObject->ReachingDefsBv->ToString());
+                     opndExtensionObject->ReachingDefsBv->ToString()));
                }
 
                for each (DefId id in opndExtensionObject->ReachingDefsBv)
                {
-                  Output::WriteLine(L"({0}){1}",
-                     id.ToString(), definitionTable->GetDefInstr(id)->ToString());
+                  output->AppendLine(String::Format(L"({0}){1}",
+                     id.ToString(), definitionTable->GetDefInstr(id)->ToString()));
                }
             }
          }
@@ -17,12 +17,27 @@
 //    
 // Usage:
 //
-//    -PlugIn:reaching-defs.dll
+//    -PlugIn:reaching-defs.dll [-reachingDefsDense] [-reachingDefsBench]
+//       [-reachingDefsSsa]
+//
+//    -reachingDefsDense solves the dataflow problem with DenseSolver
+//    (dense-solver.h) instead of the dataflow walker. -reachingDefsBench
+//    runs both and reports their times for every function.
+//
+//    -reachingDefsSsa answers the per operand queries from SSA with
+//    SsaDefs (ssa-defs.h) instead of attaching bit vectors to operands.
+//    Together with -reachingDefsBench it runs both modes and reports their
+//    times and a snapshot of the heap growth at the end of each instead.
+//
+//    -reachingDefsParallelTiming prints the time spent in the phase; see
+//    ParallelFunctionPhase (common\parallel-phase.h).
 //
 //-----------------------------------------------------------------------------
 
 #pragma once
 
+#include "..\..\common\parallel-phase.h"
+
 namespace Phx
 {
 
@@ -81,10 +96,12 @@ public:
 //    graph.
 //    2. In the sample all auxiliary structures and results, including
 //    operands extending objects are freed at the phase end.
+//    3. The phase only changes the function it is handed, so c2 may run
+//    it on several functions at once; see ParallelFunctionPhase.
 //
 //-----------------------------------------------------------------------------
 
-public ref class Phase : public Phases::Phase
+public ref class Phase : public Phx::Samples::ParallelFunctionPhase
 {
 public:
 
@@ -94,7 +111,17 @@ public:
       Phases::PhaseConfiguration ^ config
    );
 
-   virtual void Execute(Phx::Unit ^ unit) override;
+   // Solve with DenseSolver instead of Walker::Compute
+
+   static Phx::Controls::SetBooleanControl ^ DenseControl;
+
+   // Solve both ways, report the times and check that they agree
+
+   static Phx::Controls::SetBooleanControl ^ BenchmarkControl;
+
+   // Answer the queries from SSA (SsaDefs) instead of bit vectors
+
+   static Phx::Controls::SetBooleanControl ^ SsaControl;
 
 #if defined (PHX_DEBUG_SUPPORT)
 
@@ -102,6 +129,39 @@ public:
    static Phx::Controls::ComponentControl ^ DebugControl;
 
 #endif
+
+protected:
+
+   virtual void
+   ExecuteFunction
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
+   ) override;
+
+private:
+
+   Phx::Int64
+   ExecuteBitVectors
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output
+   );
+
+   Phx::Int64
+   ExecuteSsa
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output
+   );
+
+   void
+   CompareModes
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output
+   );
 };
 
 //-----------------------------------------------------------------------------
@@ -204,6 +264,82 @@ public:
    virtual property BitVector::Sparse ^ ReachingDefsBv;
 };
 
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Arena for the extension objects of one walk.
+//
+//    Every extension object the walk attaches is created here, in the
+//    walk's lifetime, and remembered together with the instruction or
+//    operand it is attached to. Release unlinks exactly those objects. It
+//    does not delete their bit vectors one by one: they live in the walk's
+//    lifetime and are freed with it in one shot. Teardown therefore costs
+//    one unlink per object attached, instead of a search of every
+//    instruction and operand of the function.
+//
+//-----------------------------------------------------------------------------
+
+public ref class ExtensionArena
+{
+
+public:
+
+   static ExtensionArena ^
+   New
+   (
+      Phx::Lifetime ^ lifetime
+   );
+
+   InstructionExtensionObject ^
+   Attach
+   (
+      Phx::IR::Instruction ^ instruction
+   );
+
+   OperandExtensionObject ^
+   Attach
+   (
+      Phx::IR::Operand ^ operand
+   );
+
+   void Release();
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of extension objects currently attached
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 Count
+   {
+      Phx::Int32 get()
+      {
+         return this->instructions->Count + this->operands->Count;
+      }
+   }
+
+private:
+
+   Phx::Lifetime ^ lifetime;
+
+   // The attached objects and what they are attached to, pairwise
+
+   System::Collections::Generic::List<Phx::IR::Instruction ^> ^ instructions;
+
+   System::Collections::Generic::List<InstructionExtensionObject ^> ^ instructionObjects;
+
+   System::Collections::Generic::List<Phx::IR::Operand ^> ^ operands;
+
+   System::Collections::Generic::List<OperandExtensionObject ^> ^ operandObjects;
+};
+
 //-----------------------------------------------------------------------------
 //
 // Description:
@@ -216,6 +352,13 @@ public:
 //    definition.
 //    Extends instructions by bit vectors of definitions they generate.
 //
+// Remarks:
+//
+//    Most location tags of a large function are never defined, so the
+//    per tag sets are created on the first definition of their tag and
+//    kept in a small open addressing table keyed by tag, rather than in
+//    an array holding a set for every tag.
+//
 //-----------------------------------------------------------------------------
 
 public ref class DefsTable : public Phx::Object
@@ -251,13 +394,46 @@ public:
       Phx::Alias::Tag aliasTag
    );
 
-private:
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of definitions recorded so far. Their ids are
+   //    0 .. DefinitionCount - 1.
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property DefId DefinitionCount
+   {
+      DefId get() { return this->CurrDefId; }
+   }
 
    //--------------------------------------------------------------------------
    //
    // Description:
    //
-   //    Mapping DefId->Instruction
+   //    Number of location tags that have a set of definitions
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 TagSetCount
+   {
+      Phx::Int32 get() { return this->tagSetCount; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Arena holding the extension objects of the walk served by the table
    //
    // Remarks:
    //
@@ -265,13 +441,26 @@ private:
    //
    //--------------------------------------------------------------------------
 
-   property IdToInstructionMap ^ DefToInstrMap;
+   property ExtensionArena ^ Arena;
+
+private:
+
+   BitVector::Sparse ^
+   LookupTagDefs
+   (
+      Phx::Alias::Tag aliasTag,
+      Phx::Boolean    doCreate
+   );
+
+   void GrowTagSets();
+
+private:
 
    //--------------------------------------------------------------------------
    //
    // Description:
    //
-   //    Mapping Alias::LocTag -> BitVector::Sparse of DefIds
+   //    Mapping DefId->Instruction
    //
    // Remarks:
    //
@@ -279,7 +468,26 @@ private:
    //
    //--------------------------------------------------------------------------
 
-   property array<BitVector::Sparse ^> ^ LocTagToDefsArray;
+   property IdToInstructionMap ^ DefToInstrMap;
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Mapping Alias::LocTag -> BitVector::Sparse of DefIds, as an open
+   //    addressing table. A slot is empty if its set is null.
+   //
+   //--------------------------------------------------------------------------
+
+   array<Phx::Alias::Tag> ^ tagSetKeys;
+
+   array<BitVector::Sparse ^> ^ tagSets;
+
+   Phx::Int32 tagSetCount;
+
+   // Returned for tags without definitions; never changed
+
+   BitVector::Sparse ^ emptyDefs;
 
    //--------------------------------------------------------------------------
    //
@@ -609,7 +817,11 @@ public:
 
    void Compute();
 
-   void CollectOperandInfo();
+   void ComputeDense();
+
+   void Benchmark(System::Text::StringBuilder ^ output);
+
+   void CollectOperandInfo(System::Text::StringBuilder ^ output);
 
 private:
 
@@ -0,0 +1,327 @@
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+//    Reaching definitions answered from SSA, for the reaching definitions
+//    plug-in.
+//
+//-----------------------------------------------------------------------------
+
+using namespace System;
+using namespace System::IO;
+using namespace System::Collections::Generic;
+
+#include "..\..\common\samples.h"
+#include "ssa-defs.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace ReachingDefs
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Static constructor for SsaDefs. Builds aliased SSA for the function
+//    unless a previous phase already did.
+//
+// Returns:
+//
+//    SsaDefs object.
+//
+//-----------------------------------------------------------------------------
+
+SsaDefs ^
+SsaDefs::New
+(
+   Phx::FunctionUnit ^ functionUnit
+)
+{
+   SsaDefs ^ ssaDefs = gcnew SsaDefs;
+
+   ssaDefs->functionUnit = functionUnit;
+
+   if (functionUnit->SsaInfo == nullptr)
+   {
+      functionUnit->BuildSsaInfo(Phx::SSA::BuildOptions::DefaultAliased);
+      ssaDefs->isSsaOwned = true;
+   }
+
+   ssaDefs->cache = gcnew Dictionary<Phx::IR::Operand ^, array<Phx::IR::Instruction ^> ^>();
+   ssaDefs->pending = gcnew Stack<Phx::IR::Operand ^>();
+   ssaDefs->visitStamps = gcnew Dictionary<Phx::IR::Operand ^, Phx::Int32>();
+   ssaDefs->foundStamps = gcnew Dictionary<Phx::IR::Instruction ^, Phx::Int32>();
+   ssaDefs->found = gcnew List<Phx::IR::Instruction ^>();
+
+   return ssaDefs;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Drop the cached answers, and the SSA information if it was built by
+//    SsaDefs::New.
+//
+//-----------------------------------------------------------------------------
+
+void
+SsaDefs::Delete()
+{
+   this->cache->Clear();
+   this->visitStamps->Clear();
+   this->foundStamps->Clear();
+
+   if (this->isSsaOwned)
+   {
+      this->functionUnit->DeleteSsaInfo();
+      this->isSsaOwned = false;
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Find the definitions that reach the given source operand.
+//
+// Returns:
+//
+//    The defining instructions, in the order the walk found them. The
+//    array belongs to the cache and must not be changed.
+//
+//-----------------------------------------------------------------------------
+
+array<Phx::IR::Instruction ^> ^
+SsaDefs::GetReachingDefinitions
+(
+   Phx::IR::Operand ^ operand
+)
+{
+   array<Phx::IR::Instruction ^> ^ definitions;
+
+   this->queryCount++;
+
+   if (this->cache->TryGetValue(operand, definitions))
+   {
+      this->cacheHits++;
+
+      return definitions;
+   }
+
+   this->Walk(operand);
+
+   definitions = this->found->ToArray();
+   this->cache->Add(operand, definitions);
+   this->cachedDefinitions += definitions->Length;
+
+   return definitions;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Queue the SSA definition of a use, if it has one.
+//
+//-----------------------------------------------------------------------------
+
+void
+SsaDefs::PushUse
+(
+   Phx::IR::Operand ^ useOperand
+)
+{
+   Phx::IR::Operand ^ definitionOperand = useOperand->DefinitionOperand;
+
+   if ((definitionOperand != nullptr)
+      && (definitionOperand != this->functionUnit->SsaInfo->UndefinedDefinitionOperand))
+   {
+      this->pending->Push(definitionOperand);
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Collect into found the definitions reaching the given operand.
+//
+// Remarks:
+//
+//    A source that is not itself in SSA form, such as a memory operand,
+//    starts the walk from the alias operands of its instruction that may
+//    overlap it. Phi webs can be cyclic, so every definition operand is
+//    visited at most once per walk.
+//
+//-----------------------------------------------------------------------------
+
+void
+SsaDefs::Walk
+(
+   Phx::IR::Operand ^ operand
+)
+{
+   Phx::Alias::Info ^ aliasInfo = this->functionUnit->AliasInfo;
+   Phx::Int32         stamp;
+
+   this->walkStamp++;
+   this->found->Clear();
+
+   if (operand->DefinitionOperand != nullptr)
+   {
+      this->PushUse(operand);
+   }
+   else
+   {
+      for each (Phx::IR::Operand ^ srcOperand in operand->Instruction->SourceOperands)
+      {
+         if (srcOperand->IsAliasOperand
+            && aliasInfo->MayPartiallyOverlap(srcOperand, operand))
+         {
+            this->PushUse(srcOperand);
+         }
+      }
+   }
+
+   while (this->pending->Count > 0)
+   {
+      Phx::IR::Operand ^ definitionOperand = this->pending->Pop();
+
+      if (this->visitStamps->TryGetValue(definitionOperand, stamp)
+         && (stamp == this->walkStamp))
+      {
+         continue;
+      }
+
+      this->visitStamps[definitionOperand] = this->walkStamp;
+      this->visitCount++;
+
+      Phx::IR::Instruction ^ instruction = definitionOperand->Instruction;
+
+      if (instruction->Opcode == Phx::Common::Opcode::Phi)
+      {
+         // Whatever reaches any source of the phi reaches its result.
+
+         for each (Phx::IR::Operand ^ srcOperand in instruction->SourceOperands)
+         {
+            this->PushUse(srcOperand);
+         }
+
+         continue;
+      }
+
+      if (!this->foundStamps->TryGetValue(instruction, stamp)
+         || (stamp != this->walkStamp))
+      {
+         this->foundStamps[instruction] = this->walkStamp;
+         this->found->Add(instruction);
+      }
+
+      // A definition that may leave part of the location unchanged lets
+      // the previous value of the tag through. Aliased SSA gives such a
+      // definition a source of the same tag; see the remarks in
+      // ssa-defs.h.
+
+      if (!aliasInfo->MustExactlyOverlap(definitionOperand, operand))
+      {
+         Phx::Boolean isPassedThrough = false;
+
+         for each (Phx::IR::Operand ^ srcOperand in instruction->SourceOperands)
+         {
+            if (srcOperand->AliasTag == definitionOperand->AliasTag)
+            {
+               this->PushUse(srcOperand);
+               isPassedThrough = true;
+            }
+         }
+
+         if (isPassedThrough)
+         {
+            this->partialDefinitions++;
+         }
+         else
+         {
+            this->partialDeadEnds++;
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Query the reaching definitions of every source operand and dump them,
+//    as Walker::CollectOperandInfo does in the bit vector mode.
+//
+//-----------------------------------------------------------------------------
+
+void
+SsaDefs::CollectOperandInfo
+(
+   System::Text::StringBuilder ^ output // Buffer for the function's report
+)
+{
+   Phx::FunctionUnit ^ functionUnit = this->functionUnit;
+   Phx::Debug::Info ^  debugInfo = functionUnit->DebugInfo;
+
+   output->AppendLine(String::Format("** Reaching Definitions (SSA) for {0}",
+      functionUnit->NameString));
+
+   for each (Phx::IR::Instruction ^ instruction in functionUnit->Instructions)
+   {
+      // Phis are not uses of the program; their sources are reached
+      // through the walk.
+
+      if (instruction->IsSsa)
+      {
+         continue;
+      }
+
+      for each (Phx::IR::Operand ^ srcOperand in instruction->DataflowSourceOperands)
+      {
+         array<Phx::IR::Instruction ^> ^ definitions =
+            this->GetReachingDefinitions(srcOperand);
+
+         if (definitions->Length == 0)
+         {
+            continue;
+         }
+
+         if (debugInfo->IsValidTag(instruction->DebugTag))
+         {
+            output->AppendLine(String::Format(
+               L"Use of {0} at {1} line {2}: {3} Reaching Definitions",
+               gcnew array<Object ^> {
+                  srcOperand->ToString(),
+                  Path::GetFileName(debugInfo->GetFileName(instruction->DebugTag)),
+                  debugInfo->GetLineNumber(instruction->DebugTag),
+                  definitions->Length
+               }));
+         }
+         else
+         {
+            output->AppendLine(String::Format(
+               L"Use of {0} (no source location available): " +
+               L"{1} Reaching Definitions",
+               srcOperand->ToString(),
+               definitions->Length));
+         }
+
+         for each (Phx::IR::Instruction ^ definition in definitions)
+         {
+            output->AppendLine(String::Format(L"   {0}", definition->ToString()));
+         }
+      }
+   }
+}
+
+} // ReachingDefs
+} // Samples
+} // Phx
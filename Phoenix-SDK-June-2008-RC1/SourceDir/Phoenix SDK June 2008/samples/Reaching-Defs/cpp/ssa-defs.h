@@ -0,0 +1,217 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Reaching definitions answered from SSA.
+//
+//    Walker::CollectOperandInfo attaches to every source operand a bit
+//    vector of all the definitions that reach it, so its memory grows with
+//    operands times definitions, whether or not anyone asks.
+//
+//    SsaDefs answers the same question, "which definitions reach this
+//    operand", from aliased SSA instead. The SSA links of a use already
+//    lead to the one SSA definition that reaches it; when that definition
+//    is a phi, the definitions reaching the use are the union of those
+//    reaching the phi's sources, so the query walks the phi web backwards
+//    to the real definitions. Nothing is computed until an operand is
+//    queried, and the answer is cached on the operand's first query.
+//
+// Remarks:
+//
+//    Aliased SSA also links memory operands and partial definitions. A
+//    definition that does not exactly overlap the queried operand does not
+//    kill the earlier value, so the walk records it and continues to the
+//    source of the same alias tag on the defining instruction.
+//
+//    That source is how aliased SSA itself represents a may or partial
+//    definition: the instruction that may write part of a location takes
+//    the location's previous value as an alias source of the same tag as
+//    its alias destination. A use is linked to a definition of its own
+//    tag, so a write to an overlapping but different location reaches the
+//    walk as such a same-tag pair, never as a bare definition of another
+//    tag. The walk therefore only stops at a definition that must exactly
+//    overlap the queried operand. If a definition without that source
+//    turned up, the walk would stop there and report fewer definitions
+//    than the bit vector mode; PartialDefinitions counts the definitions
+//    the walk passed through and PartialDeadEnds those it could not, so a
+//    mismatch shows in the -reachingDefsBench report.
+//
+//    The answers are definition instructions, not DefIds: SSA numbers
+//    values, not the (location tag, instruction) pairs DefsTable numbers.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+namespace ReachingDefs
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Lazily computed, per operand cached reaching definitions over SSA
+//
+//-----------------------------------------------------------------------------
+
+public ref class SsaDefs
+{
+
+public:
+
+   static SsaDefs ^
+   New
+   (
+      Phx::FunctionUnit ^ functionUnit
+   );
+
+   void Delete();
+
+   array<Phx::IR::Instruction ^> ^
+   GetReachingDefinitions
+   (
+      Phx::IR::Operand ^ operand
+   );
+
+   void CollectOperandInfo(System::Text::StringBuilder ^ output);
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of queries answered, and how many of them came from the
+   //    cache
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 QueryCount
+   {
+      Phx::Int32 get() { return this->queryCount; }
+   }
+
+   property Phx::Int32 CacheHits
+   {
+      Phx::Int32 get() { return this->cacheHits; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of SSA definitions visited by all walks, and the number of
+   //    definition instructions held in the cache
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 VisitCount
+   {
+      Phx::Int32 get() { return this->visitCount; }
+   }
+
+   property Phx::Int32 CachedDefinitions
+   {
+      Phx::Int32 get() { return this->cachedDefinitions; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of definitions that do not exactly overlap the queried
+   //    operand and that the walks passed through, and the number of such
+   //    definitions that had no source of their tag to pass through to
+   //
+   // Remarks:
+   //
+   //    Get only
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Int32 PartialDefinitions
+   {
+      Phx::Int32 get() { return this->partialDefinitions; }
+   }
+
+   property Phx::Int32 PartialDeadEnds
+   {
+      Phx::Int32 get() { return this->partialDeadEnds; }
+   }
+
+private:
+
+   void
+   PushUse
+   (
+      Phx::IR::Operand ^ useOperand
+   );
+
+   void
+   Walk
+   (
+      Phx::IR::Operand ^ operand
+   );
+
+private:
+
+   Phx::FunctionUnit ^ functionUnit;
+
+   // True if SSA was built for this object and must be deleted with it
+
+   Phx::Boolean isSsaOwned;
+
+   // Answers, keyed by the queried operand
+
+   System::Collections::Generic::Dictionary<Phx::IR::Operand ^,
+      array<Phx::IR::Instruction ^> ^> ^ cache;
+
+   // Scratch state of a walk, kept between queries. A definition operand
+   // has been visited, and an instruction found, by the current walk if its
+   // stamp equals walkStamp.
+
+   System::Collections::Generic::Stack<Phx::IR::Operand ^> ^ pending;
+
+   System::Collections::Generic::Dictionary<Phx::IR::Operand ^,
+      Phx::Int32> ^ visitStamps;
+
+   System::Collections::Generic::Dictionary<Phx::IR::Instruction ^,
+      Phx::Int32> ^ foundStamps;
+
+   System::Collections::Generic::List<Phx::IR::Instruction ^> ^ found;
+
+   Phx::Int32 walkStamp;
+
+   // Statistics
+
+   Phx::Int32 queryCount;
+
+   Phx::Int32 cacheHits;
+
+   Phx::Int32 visitCount;
+
+   Phx::Int32 cachedDefinitions;
+
+   Phx::Int32 partialDefinitions;
+
+   Phx::Int32 partialDeadEnds;
+};
+
+} // namespace ReachingDefs
+} // namespace Samples
+} // namespace Phx
@@ -33,6 +33,11 @@
 //   uninitialized when used. The control WarnMayUninit, if present on the
 //   command line, indicates that these potential errors are to be reported.
 //
+//   The phase derives from ParallelFunctionPhase, so c2 may run it on
+//   several functions at once (-threads). Each function's warnings are
+//   printed as one block, in source order, headed by the function and the
+//   compiland it belongs to.
+//
 //------------------------------------------------------------------------------
 
 #include "UninitializedLocal.h"
@@ -67,7 +72,6 @@ Phase::New
    Phase ^ phase = gcnew Phase();
 
    phase->Initialize(config, L"Detect uninitialized local variable uses");
-   phase->hasPrintedFileName = false;
 
 #if defined(PHX_DEBUG_SUPPORT)
 
@@ -82,38 +86,35 @@ Phase::New
 //
 // Description:
 //
-//    Execute is the phase's prime mover; all unit-centric processing occurs
-//    here.  Note that Execute might be thought of as a "callback": as the
-//    C2 host compiles each FunctionUnit, passing it from phase to phase, the
-//    plug-in Execute method is called to do its work.
+//    ExecuteFunction is the phase's prime mover; all unit-centric
+//    processing occurs here.  Note that it might be thought of as a
+//    "callback": as the C2 host compiles each FunctionUnit, passing it from
+//    phase to phase, ParallelFunctionPhase::Execute calls it to do its work.
 //
 // Arguments:
 //
-//    unit - [in] The unit to process.
+//    functionUnit - [in] The function to process.
+//    output - [in] The buffer for the function's warnings.
+//    lifetime - [in] Temporary lifetime for the function, unused.
 //
 // Remarks:
 //
-//    Since IR exists only at the FunctionUnit level, we ignore ModuleUnits.
+//    Since IR exists only at the FunctionUnit level, the base class ignores
+//    ModuleUnits.
 //
-//    The order of units in a compiland passed to Execute is indeterminate.
+//    The order in which c2 hands the units of a compiland to the phase is
+//    indeterminate, but the warnings are printed in source order.
 //
 //-----------------------------------------------------------------------------
 
 void
-Phase::Execute
+Phase::ExecuteFunction
 (
-   Phx::Unit ^ unit
+   Phx::FunctionUnit ^           functionUnit,
+   System::Text::StringBuilder ^ output,
+   Phx::Lifetime ^               lifetime
 )
 {
-   // Only FunctionUnit's have associated SSA info.
-
-   if (!unit->IsFunctionUnit)
-   {
-      return;
-   }
-
-   Phx::FunctionUnit ^ functionUnit = unit->AsFunctionUnit;
-
    // Unless a previous phase has built SSA info, build it now.
 
    bool isSsaCleanUpRequired = false;
@@ -186,18 +187,15 @@ Phase::Execute
    }
 
    // Issue first must warnings, then may warnings for variables
-   // not yet reported.
+   // not yet reported. Each function names its compiland, since which
+   // function reports first no longer depends on the order they run in.
 
    if ((mustList->Count > 0) || ((mayList->Count > 0) && WarnMayCtrl->IsEnabled(nullptr)))
    {
-      if (!this->hasPrintedFileName)
-      {
-         Phx::Output::WriteLine(
-            L"While compiling {0}", functionUnit->ParentModuleUnit->NameString);
-         this->hasPrintedFileName = true;
-      }
-      Phx::Output::WriteLine(
-         L"In function {0}", Phx::Utility::Undecorate(functionUnit->NameString, true));
+      output->AppendLine(System::String::Format(
+         L"In function {0} while compiling {1}",
+         Phx::Utility::Undecorate(functionUnit->NameString, true),
+         functionUnit->ParentModuleUnit->NameString));
    }
 
    for each (Phx::Symbols::Symbol ^ sym in mustList)
@@ -206,20 +204,20 @@ Phase::Execute
 
       mayList->Remove(sym);
 
-      Phx::Output::WriteLine(
+      output->AppendLine(System::String::Format(
          L"Warning C4700: local variable '{0}' "
          L"used without having been initialized.",
-         sym->Name.NameString);
+         sym->Name.NameString));
    }
 
    if (WarnMayCtrl->IsEnabled(nullptr))
    {
       for each (Phx::Symbols::Symbol ^ sym in mayList)
       {
-         Phx::Output::WriteLine(
+         output->AppendLine(System::String::Format(
             L"Warning C4701: local variable '{0}' may "
             L"be used without having been initialized.",
-            sym->Name.NameString);
+            sym->Name.NameString));
       }
    }
 
@@ -259,6 +257,9 @@ PlugIn::RegisterObjects()
          L"Warn on possibly uninitialized uses of local variables",
          L"UninitializedLocal.cpp");
 
+   Phx::Samples::ParallelFunctionPhase::RegisterObjects(L"uninitializedLocal",
+      L"UninitializedLocal.cpp");
+
 #if defined(PHX_DEBUG_SUPPORT)
 
    Phase::UninitializedLocalCtrl =
@@ -323,5 +324,7 @@ PlugIn::BuildPhases
 
    Phx::Phases::Phase ^ phase = Phase::New(config);
    basePhase->InsertAfter(phase);
+
+   Phx::Samples::ParallelFunctionPhase::BuildPhases(config);
 }
 }
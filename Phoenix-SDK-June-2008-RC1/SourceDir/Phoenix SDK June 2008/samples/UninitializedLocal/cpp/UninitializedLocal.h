@@ -12,6 +12,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "..\..\common\parallel-phase.h"
+
 namespace UninitializedLocal
 {
 
@@ -28,10 +30,14 @@ namespace UninitializedLocal
 //    instance of the phase.  Execute is responsible for performing the
 //    actual work of the phase.
 //
+//    This phase only reads the function it is handed, so it derives from
+//    ParallelFunctionPhase and implements ExecuteFunction instead, and c2
+//    may run it on several functions at once.
+//
 //------------------------------------------------------------------------------
 
 public
-ref class Phase : Phx::Phases::Phase
+ref class Phase : Phx::Samples::ParallelFunctionPhase
 {
 
 public:
@@ -45,9 +51,11 @@ public:
 protected:
 
    virtual void
-   Execute
+   ExecuteFunction
    (
-      Phx::Unit ^ unit
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
    ) override;
 
 public:
@@ -59,11 +67,6 @@ public:
    static Phx::Controls::ComponentControl ^ UninitializedLocalCtrl;
 
 #endif
-
-private:
-
-   bool hasPrintedFileName;
-
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,676 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Per function cache of flow graph analyses
+//
+// Remarks:
+//
+//    Most samples start Execute by building the flow graph and whatever
+//    they compute from it, and end it by deleting the flow graph, whether
+//    or not an earlier phase had built it and still needed it.
+//
+//    AnalysisCache keeps, for one function unit, the flow graph, the
+//    Phoenix dominators, a GraphOrder and a LoopForest, and builds each
+//    only when it is asked for and not already valid:
+//
+//       The flow graph is taken from the unit if some earlier phase built
+//          it; otherwise the cache builds it, and deletes it again when the
+//          cache is released, so later phases see the unit as they would
+//          without the plug-in.
+//       The dominators are Phoenix's own, built on the flow graph; the
+//          flow graph says whether they are valid, so dominators another
+//          phase built or dropped are seen as such.
+//       The dominators, order and loops are dropped when the control flow
+//          of the function changes, and rebuilt on the next request.
+//
+//    The cache lives from the first Get for a function to the end of the
+//    plug-in's last phase that uses it, so every phase of the plug-in that
+//    runs on the function shares it. The end is the release phase
+//    BuildPhases adds after that phase, which unhooks the cache from the
+//    unit and drops it. Functions may be compiled on several threads, so
+//    the table of caches is locked.
+//
+//    Changes are seen through the same unit events the IR-Longevity sample
+//    listens to. A new or deleted branch or label instruction, or a new or
+//    deleted label operand, changes the control flow; other instructions
+//    and operands leave the cached analyses valid. The flow graph itself
+//    is kept, since edits through the FlowGraph methods keep it current.
+//
+//    Each request counts as a hit or a miss, and each time valid analyses
+//    are dropped counts as an invalidation. The counts are printed through
+//    Phx::Output when the cache is dropped, if the plug-in's
+//    "...CacheStatistics" control is set.
+//
+//    The class is defined entirely in this header, like GraphOrder, so
+//    each plug-in that includes it has its own caches. The flow graph is
+//    the one analysis shared between plug-ins, through the unit.
+//
+// Usage:
+//
+//    Call AnalysisCache::RegisterObjects from PlugIn::RegisterObjects,
+//    AnalysisCache::BuildPhases from PlugIn::BuildPhases with the last
+//    phase of the plug-in that uses the cache, and in Execute
+//
+//       Phx::Samples::AnalysisCache ^ cache =
+//          Phx::Samples::AnalysisCache::Get(functionUnit);
+//       ... cache->FlowGraph, cache->Loops ...
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include "loop-forest.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The cached analyses of one function unit
+//
+//-----------------------------------------------------------------------------
+
+public ref class AnalysisCache
+{
+public:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Create the statistics control and the event dependency objects.
+   //
+   // Arguments:
+   //
+   //    prefix - [in] Prefix for the control name, such as "naturalLoops",
+   //          so that plug-ins loaded together do not clash.
+   //    fileName - [in] The plug-in's source file, for the control.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   RegisterObjects
+   (
+      System::String ^ prefix,
+      System::String ^ fileName
+   )
+   {
+      System::String ^ dependencyName = prefix + L"AnalysisCache";
+
+      AnalysisCache::StatisticsControl =
+         Phx::Controls::SetBooleanControl::New(prefix + L"CacheStatistics",
+            L"Print the analysis cache hits, misses and invalidations of each function",
+            fileName);
+
+      AnalysisCache::newInstructionDependencyObject =
+         Phx::DependencyObject::New(&Phx::Unit::NewInstructionEventDependencyList,
+            dependencyName, "*");
+
+      AnalysisCache::deleteInstructionDependencyObject =
+         Phx::DependencyObject::New(&Phx::Unit::DeleteInstructionEventDependencyList,
+            dependencyName, "*");
+
+      AnalysisCache::newOperandDependencyObject =
+         Phx::DependencyObject::New(&Phx::Unit::NewOperandEventDependencyList,
+            dependencyName, "*");
+
+      AnalysisCache::deleteOperandDependencyObject =
+         Phx::DependencyObject::New(&Phx::Unit::DeleteOperandEventDependencyList,
+            dependencyName, "*");
+   }
+
+   static Phx::Controls::SetBooleanControl ^ StatisticsControl;
+
+   static void
+   BuildPhases
+   (
+      Phx::Phases::PhaseConfiguration ^ config,
+      Phx::Phases::Phase ^              lastClientPhase
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Get the cache of a function unit, creating it on first use.
+   //
+   //--------------------------------------------------------------------------
+
+   static AnalysisCache ^
+   Get
+   (
+      Phx::FunctionUnit ^ functionUnit
+   )
+   {
+      AnalysisCache ^ cache;
+
+      System::Threading::Monitor::Enter(cachesLock);
+
+      try
+      {
+         if (!AnalysisCache::caches->TryGetValue(functionUnit, cache))
+         {
+            cache = gcnew AnalysisCache();
+            cache->functionUnit = functionUnit;
+            cache->AddEventHandlers();
+
+            AnalysisCache::caches->Add(functionUnit, cache);
+         }
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(cachesLock);
+      }
+
+      return cache;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Drop the cache of a function unit after the last phase that uses
+   //    it.
+   //
+   // Remarks:
+   //
+   //    A flow graph the cache built is deleted, unless the unit has
+   //    another one by now. One an earlier phase built stays on the unit.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   Discard
+   (
+      Phx::FunctionUnit ^ functionUnit
+   )
+   {
+      AnalysisCache ^ cache;
+
+      System::Threading::Monitor::Enter(cachesLock);
+
+      try
+      {
+         if (!AnalysisCache::caches->TryGetValue(functionUnit, cache))
+         {
+            return;
+         }
+
+         AnalysisCache::caches->Remove(functionUnit);
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(cachesLock);
+      }
+
+      if ((AnalysisCache::StatisticsControl != nullptr)
+         && AnalysisCache::StatisticsControl->IsEnabled(functionUnit))
+      {
+         Phx::Output::WriteLine(
+            "Analysis cache for {0}: {1} hits, {2} misses, {3} invalidations",
+            Phx::Utility::Undecorate(functionUnit->NameString, false),
+            cache->hitCount, cache->missCount, cache->invalidationCount);
+      }
+
+      cache->RemoveEventHandlers();
+      cache->DropAnalyses();
+
+      if (cache->isFlowGraphOwned
+         && (functionUnit->FlowGraph == cache->flowGraph))
+      {
+         functionUnit->DeleteFlowGraph();
+      }
+
+      cache->flowGraph = nullptr;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The flow graph of the function
+   //
+   //--------------------------------------------------------------------------
+
+   property Phx::Graphs::FlowGraph ^ FlowGraph
+   {
+      Phx::Graphs::FlowGraph ^ get()
+      {
+         int missCount = this->missCount;
+
+         Phx::Graphs::FlowGraph ^ flowGraph = this->CurrentFlowGraph();
+
+         if (this->missCount == missCount)
+         {
+            this->hitCount++;
+         }
+
+         return flowGraph;
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Build the flow graph afresh with the given block style, replacing
+   //    the one the unit has, for phases that need blocks split other than
+   //    the default way.
+   //
+   // Remarks:
+   //
+   //    The new flow graph is the cache's to delete if the unit had none
+   //    before the cache first looked at it. Counts as a miss.
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::Graphs::FlowGraph ^
+   BuildFlowGraph
+   (
+      Phx::Graphs::BlockStyle blockStyle
+   )
+   {
+      Phx::FunctionUnit ^ functionUnit = this->functionUnit;
+
+      if (this->flowGraph == nullptr)
+      {
+         this->isFlowGraphOwned = (functionUnit->FlowGraph == nullptr);
+      }
+
+      this->DropAnalyses();
+      this->missCount++;
+
+      functionUnit->BuildFlowGraph(blockStyle);
+
+      this->flowGraph = functionUnit->FlowGraph;
+
+      return this->flowGraph;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Make sure the flow graph's dominators are built, so BasicBlock
+   //    Dominates can be used.
+   //
+   // Remarks:
+   //
+   //    Whether they are valid is the flow graph's to say, since any phase
+   //    may build or drop them.
+   //
+   // Returns:
+   //
+   //    The flow graph.
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::Graphs::FlowGraph ^
+   BuildDominators()
+   {
+      Phx::Graphs::FlowGraph ^ flowGraph = this->CurrentFlowGraph();
+
+      if (flowGraph->AreDominatorsValid)
+      {
+         this->hitCount++;
+      }
+      else
+      {
+         this->missCount++;
+         flowGraph->BuildDominators();
+      }
+
+      return flowGraph;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The depth first numbering of the flow graph
+   //
+   //--------------------------------------------------------------------------
+
+   property GraphOrder ^ Order
+   {
+      GraphOrder ^ get()
+      {
+         Phx::Graphs::FlowGraph ^ flowGraph = this->CurrentFlowGraph();
+
+         if (this->order != nullptr)
+         {
+            this->hitCount++;
+         }
+         else
+         {
+            this->missCount++;
+            this->order = GraphOrder::New(flowGraph);
+         }
+
+         return this->order;
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The loop forest of the flow graph
+   //
+   //--------------------------------------------------------------------------
+
+   property LoopForest ^ Loops
+   {
+      LoopForest ^ get()
+      {
+         Phx::Graphs::FlowGraph ^ flowGraph = this->CurrentFlowGraph();
+
+         if (this->forest != nullptr)
+         {
+            this->hitCount++;
+         }
+         else
+         {
+            this->missCount++;
+            this->forest = LoopForest::New(flowGraph);
+
+            // The forest numbered the blocks on the way.
+
+            if (this->order == nullptr)
+            {
+               this->order = this->forest->Order;
+            }
+         }
+
+         return this->forest;
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Drop everything computed from the control flow, for changes the
+   //    unit events do not show.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   InvalidateControlFlow()
+   {
+      Phx::Graphs::FlowGraph ^ flowGraph = this->flowGraph;
+      bool                     areDominatorsValid = (flowGraph != nullptr)
+         && (this->functionUnit->FlowGraph == flowGraph)
+         && flowGraph->AreDominatorsValid;
+
+      if (areDominatorsValid || (this->order != nullptr) || (this->forest != nullptr))
+      {
+         this->invalidationCount++;
+      }
+
+      if (areDominatorsValid)
+      {
+         flowGraph->DropDominators();
+      }
+
+      this->DropAnalyses();
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Requests answered from the cache, requests that built something,
+   //    and the number of times valid analyses were dropped
+   //
+   //--------------------------------------------------------------------------
+
+   property int HitCount
+   {
+      int get() { return this->hitCount; }
+   }
+
+   property int MissCount
+   {
+      int get() { return this->missCount; }
+   }
+
+   property int InvalidationCount
+   {
+      int get() { return this->invalidationCount; }
+   }
+
+private:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Get the unit's flow graph, building it if there is none, and drop
+   //    whatever was computed from a flow graph the unit no longer has.
+   //    Only building counts, as a miss. The first look decides whether
+   //    the flow graph is the cache's to delete.
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::Graphs::FlowGraph ^
+   CurrentFlowGraph()
+   {
+      Phx::FunctionUnit ^ functionUnit = this->functionUnit;
+
+      if ((this->flowGraph != nullptr) && (functionUnit->FlowGraph == this->flowGraph))
+      {
+         return this->flowGraph;
+      }
+
+      if (this->flowGraph == nullptr)
+      {
+         this->isFlowGraphOwned = (functionUnit->FlowGraph == nullptr);
+      }
+
+      this->DropAnalyses();
+
+      // Use the one an earlier phase built, if there is one.
+
+      if (functionUnit->FlowGraph == nullptr)
+      {
+         this->missCount++;
+         functionUnit->BuildFlowGraph();
+      }
+
+      this->flowGraph = functionUnit->FlowGraph;
+
+      return this->flowGraph;
+   }
+
+   void
+   DropAnalyses()
+   {
+      this->order = nullptr;
+      this->forest = nullptr;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Unit event handlers: a change to a branch or a label changes the
+   //    control flow.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   InstructionEventHandler
+   (
+      Phx::IR::Instruction ^ instruction
+   )
+   {
+      if (instruction->IsBranchInstruction || instruction->IsLabelInstruction)
+      {
+         this->InvalidateControlFlow();
+      }
+   }
+
+   void
+   OperandEventHandler
+   (
+      Phx::IR::Operand ^ operand
+   )
+   {
+      if (operand->IsLabelOperand)
+      {
+         this->InvalidateControlFlow();
+      }
+   }
+
+   void
+   AddEventHandlers()
+   {
+      Phx::FunctionUnit ^ functionUnit = this->functionUnit;
+
+      this->instructionDelegate = gcnew Phx::Unit::InstructionEventDelegate(this,
+         &AnalysisCache::InstructionEventHandler);
+      this->operandDelegate = gcnew Phx::Unit::OperandEventDelegate(this,
+         &AnalysisCache::OperandEventHandler);
+
+      functionUnit->NewInstructionEvent.Insert(this->instructionDelegate,
+         AnalysisCache::newInstructionDependencyObject);
+      functionUnit->DeleteInstructionEvent.Insert(this->instructionDelegate,
+         AnalysisCache::deleteInstructionDependencyObject);
+      functionUnit->NewOperandEvent.Insert(this->operandDelegate,
+         AnalysisCache::newOperandDependencyObject);
+      functionUnit->DeleteOperandEvent.Insert(this->operandDelegate,
+         AnalysisCache::deleteOperandDependencyObject);
+   }
+
+   void
+   RemoveEventHandlers()
+   {
+      Phx::FunctionUnit ^ functionUnit = this->functionUnit;
+
+      functionUnit->NewInstructionEvent.Remove(this->instructionDelegate);
+      functionUnit->DeleteInstructionEvent.Remove(this->instructionDelegate);
+      functionUnit->NewOperandEvent.Remove(this->operandDelegate);
+      functionUnit->DeleteOperandEvent.Remove(this->operandDelegate);
+   }
+
+private:
+
+   // The live caches, indexed by function unit, updated under cachesLock
+
+   static System::Collections::Generic::Dictionary<Phx::FunctionUnit ^, AnalysisCache ^> ^ caches =
+      gcnew System::Collections::Generic::Dictionary<Phx::FunctionUnit ^, AnalysisCache ^>();
+
+   static System::Object ^ cachesLock = gcnew System::Object();
+
+   static Phx::DependencyObject ^ newInstructionDependencyObject;
+
+   static Phx::DependencyObject ^ deleteInstructionDependencyObject;
+
+   static Phx::DependencyObject ^ newOperandDependencyObject;
+
+   static Phx::DependencyObject ^ deleteOperandDependencyObject;
+
+   Phx::FunctionUnit ^ functionUnit;
+
+   Phx::Unit::InstructionEventDelegate ^ instructionDelegate;
+
+   Phx::Unit::OperandEventDelegate ^ operandDelegate;
+
+   // The flow graph the analyses below were computed from, and whether
+   // the cache built it
+
+   Phx::Graphs::FlowGraph ^ flowGraph;
+
+   bool isFlowGraphOwned;
+
+   GraphOrder ^ order;
+
+   LoopForest ^ forest;
+
+   int hitCount;
+
+   int missCount;
+
+   int invalidationCount;
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Phase that drops the analysis caches of each function once the
+//    plug-in's phases are done with it
+//
+//-----------------------------------------------------------------------------
+
+public ref class AnalysisCacheReleasePhase : Phx::Phases::Phase
+{
+public:
+
+   static AnalysisCacheReleasePhase ^
+   New
+   (
+      Phx::Phases::PhaseConfiguration ^ config
+   )
+   {
+      AnalysisCacheReleasePhase ^ phase = gcnew AnalysisCacheReleasePhase();
+
+      phase->Initialize(config, L"Analysis Cache Release");
+
+      return phase;
+   }
+
+protected:
+
+   virtual void
+   Execute
+   (
+      Phx::Unit ^ unit
+   ) override
+   {
+      if (unit->IsFunctionUnit)
+      {
+         AnalysisCache::Discard(unit->AsFunctionUnit);
+      }
+   }
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add the release phase right after the last phase of the plug-in that
+//    uses the cache.
+//
+// Arguments:
+//
+//    config - [in] The configuration whose phase list the plug-in is
+//          adding its phases to.
+//    lastClientPhase - [in] The plug-in's phase that runs last on each
+//          function among those that use the cache. It must already be in
+//          the phase list.
+//
+//-----------------------------------------------------------------------------
+
+inline void
+AnalysisCache::BuildPhases
+(
+   Phx::Phases::PhaseConfiguration ^ config,
+   Phx::Phases::Phase ^              lastClientPhase
+)
+{
+   lastClientPhase->InsertAfter(AnalysisCacheReleasePhase::New(config));
+}
+
+} // namespace Samples
+} // namespace Phx
@@ -0,0 +1,500 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Batched edge splitting with incremental dominator update
+//
+// Remarks:
+//
+//    The preheader and post exit samples decide which edges to split loop
+//    by loop. Splitting as they go adds blocks that the loop and dominator
+//    information computed beforehand does not know about, so either the
+//    information has to be rebuilt after every loop or the loops after the
+//    first cannot use it.
+//
+//    FlowGraphEdit separates deciding from editing. Edges are recorded
+//    with SplitEdge, which ignores an edge recorded before, so an edge that
+//    leaves one loop and enters another is split once. Apply then splits
+//    every recorded edge in one pass, and keeps the immediate dominators
+//    computed by New up to date as it goes:
+//
+//       Splitting p->s with a new block n makes p the immediate dominator
+//       of n. n becomes the immediate dominator of s exactly when every
+//       other predecessor of s is dominated by s, that is, when p->s was
+//       the only way into s, as for the single entry edge of a loop
+//       header. No other block's immediate dominator changes.
+//
+//    Afterwards each split is available as the (predecessor, successor,
+//    new block) it made, which is what a caller needs to update its own
+//    per-block information, such as loop membership, without a rebuild.
+//
+//    The initial immediate dominators come from Cooper, Harvey and
+//    Kennedy's iterative algorithm over a GraphOrder of the graph.
+//
+//    The class is defined entirely in this header, like GraphOrder.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include "graph-order.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    A batch of edge splits on a flow graph, and its dominator tree
+//
+//-----------------------------------------------------------------------------
+
+public ref class FlowGraphEdit
+{
+public:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Start a batch of edits to the flow graph, and find the immediate
+   //    dominators of its blocks.
+   //
+   // Remarks:
+   //
+   //    The flow graph must not be changed other than through the object
+   //    while it is in use.
+   //
+   //--------------------------------------------------------------------------
+
+   static FlowGraphEdit ^
+   New
+   (
+      Phx::Graphs::FlowGraph ^ flowGraph
+   )
+   {
+      FlowGraphEdit ^ edit = gcnew FlowGraphEdit();
+      GraphOrder ^    order = GraphOrder::New(flowGraph);
+      int             maxId = 0;
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         maxId = System::Math::Max(maxId, (int) block->Id);
+      }
+
+      edit->flowGraph = flowGraph;
+      edit->blocks = gcnew array<Phx::Graphs::BasicBlock ^>(maxId + 1);
+      edit->immediateDominators = gcnew array<int>(maxId + 1);
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         edit->blocks[block->Id] = block;
+         edit->immediateDominators[block->Id] = -1;
+      }
+
+      edit->FindDominators(order);
+
+      edit->recordedEdgeIds = Phx::BitVector::Sparse::New(flowGraph->Lifetime);
+      edit->pendingEdges = gcnew System::Collections::Generic::List<Phx::Graphs::FlowEdge ^>();
+      edit->splitPredecessors = gcnew System::Collections::Generic::List<Phx::Graphs::BasicBlock ^>();
+      edit->splitSuccessors = gcnew System::Collections::Generic::List<Phx::Graphs::BasicBlock ^>();
+      edit->splitBlocks = gcnew System::Collections::Generic::List<Phx::Graphs::BasicBlock ^>();
+
+      return edit;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Record an edge to be split by the next Apply.
+   //
+   // Returns:
+   //
+   //    false if the edge was already recorded.
+   //
+   //--------------------------------------------------------------------------
+
+   bool
+   SplitEdge
+   (
+      Phx::Graphs::FlowEdge ^ edge
+   )
+   {
+      if (this->recordedEdgeIds->GetBit(edge->Id))
+      {
+         return false;
+      }
+
+      this->recordedEdgeIds->SetBit(edge->Id);
+      this->pendingEdges->Add(edge);
+
+      return true;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of edges recorded and not yet split
+   //
+   //--------------------------------------------------------------------------
+
+   property int PendingCount
+   {
+      int get() { return this->pendingEdges->Count; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Split the recorded edges, in the order they were recorded, and
+   //    update the immediate dominators.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   Apply()
+   {
+      for each (Phx::Graphs::FlowEdge ^ edge in this->pendingEdges)
+      {
+         Phx::Graphs::BasicBlock ^ predecessor = edge->PredecessorNode;
+         Phx::Graphs::BasicBlock ^ successor = edge->SuccessorNode;
+         Phx::Graphs::BasicBlock ^ block = this->flowGraph->SplitEdge(edge);
+
+         this->AddBlock(block);
+
+         this->splitPredecessors->Add(predecessor);
+         this->splitSuccessors->Add(successor);
+         this->splitBlocks->Add(block);
+
+         // A split of an unreachable edge leaves an unreachable block.
+
+         if (this->immediateDominators[predecessor->Id] == -1)
+         {
+            continue;
+         }
+
+         this->immediateDominators[block->Id] = predecessor->Id;
+
+         bool isOnlyEntry = true;
+
+         for (Phx::Graphs::FlowEdge ^ otherEdge = successor->PredecessorEdgeList;
+            otherEdge != nullptr; otherEdge = otherEdge->NextPredecessorEdge)
+         {
+            Phx::Graphs::BasicBlock ^ otherPredecessor = otherEdge->PredecessorNode;
+
+            if ((otherPredecessor != block)
+               && this->IsReachable(otherPredecessor)
+               && !this->Dominates(successor, otherPredecessor))
+            {
+               isOnlyEntry = false;
+               break;
+            }
+         }
+
+         if (isOnlyEntry)
+         {
+            this->immediateDominators[successor->Id] = block->Id;
+         }
+      }
+
+      // Edge Ids are only meaningful until the edges are split.
+
+      this->pendingEdges->Clear();
+      this->recordedEdgeIds->Delete();
+      this->recordedEdgeIds = Phx::BitVector::Sparse::New(this->flowGraph->Lifetime);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The splits made so far, for 0 <= split < SplitCount: the ends of
+   //    the edge that was split and the block put between them
+   //
+   //--------------------------------------------------------------------------
+
+   property int SplitCount
+   {
+      int get() { return this->splitBlocks->Count; }
+   }
+
+   Phx::Graphs::BasicBlock ^
+   SplitPredecessor
+   (
+      int split
+   )
+   {
+      return this->splitPredecessors[split];
+   }
+
+   Phx::Graphs::BasicBlock ^
+   SplitSuccessor
+   (
+      int split
+   )
+   {
+      return this->splitSuccessors[split];
+   }
+
+   Phx::Graphs::BasicBlock ^
+   SplitBlock
+   (
+      int split
+   )
+   {
+      return this->splitBlocks[split];
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Determine whether a block can be reached from the start block.
+   //
+   //--------------------------------------------------------------------------
+
+   bool
+   IsReachable
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      return (this->immediateDominators[block->Id] != -1);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The immediate dominator of a block
+   //
+   // Returns:
+   //
+   //    nullptr for the start block and for unreachable blocks.
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::Graphs::BasicBlock ^
+   ImmediateDominator
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int dominatorId = this->immediateDominators[block->Id];
+
+      if ((dominatorId == -1) || (dominatorId == (int) block->Id))
+      {
+         return nullptr;
+      }
+
+      return this->blocks[dominatorId];
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Determine whether one block dominates another. A block dominates
+   //    itself.
+   //
+   // Remarks:
+   //
+   //    Walks up the dominator tree from the block, so the cost is the
+   //    block's depth in the tree.
+   //
+   //--------------------------------------------------------------------------
+
+   bool
+   Dominates
+   (
+      Phx::Graphs::BasicBlock ^ dominator,
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int dominatorId = dominator->Id;
+      int id = block->Id;
+
+      if (this->immediateDominators[id] == -1)
+      {
+         return false;
+      }
+
+      while (id != dominatorId)
+      {
+         int parentId = this->immediateDominators[id];
+
+         if (parentId == id)
+         {
+            return false;
+         }
+
+         id = parentId;
+      }
+
+      return true;
+   }
+
+private:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Find the immediate dominators with Cooper, Harvey and Kennedy's
+   //    algorithm: visit the blocks in reverse post order, and intersect
+   //    the dominator tree paths of each block's visited predecessors until
+   //    nothing changes.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   FindDominators
+   (
+      GraphOrder ^ order
+   )
+   {
+      Phx::Graphs::BasicBlock ^ startBlock = order->BlockInReversePostorder(1);
+      bool                      isChanged = true;
+
+      this->immediateDominators[startBlock->Id] = startBlock->Id;
+
+      while (isChanged)
+      {
+         isChanged = false;
+
+         for (int number = 2; number <= order->BlockCount; number++)
+         {
+            Phx::Graphs::BasicBlock ^ block = order->BlockInReversePostorder(number);
+            int                       newDominatorId = -1;
+
+            for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+               edge != nullptr; edge = edge->NextPredecessorEdge)
+            {
+               int predecessorId = edge->PredecessorNode->Id;
+
+               // Skip predecessors that are unreachable or not visited yet.
+
+               if (this->immediateDominators[predecessorId] == -1)
+               {
+                  continue;
+               }
+
+               newDominatorId = (newDominatorId == -1)
+                  ? predecessorId
+                  : this->Intersect(order, predecessorId, newDominatorId);
+            }
+
+            if (this->immediateDominators[block->Id] != newDominatorId)
+            {
+               this->immediateDominators[block->Id] = newDominatorId;
+               isChanged = true;
+            }
+         }
+      }
+   }
+
+   int
+   Intersect
+   (
+      GraphOrder ^ order,
+      int          id1,
+      int          id2
+   )
+   {
+      while (id1 != id2)
+      {
+         while (order->ReversePostorderNumber(this->blocks[id1])
+            > order->ReversePostorderNumber(this->blocks[id2]))
+         {
+            id1 = this->immediateDominators[id1];
+         }
+
+         while (order->ReversePostorderNumber(this->blocks[id2])
+            > order->ReversePostorderNumber(this->blocks[id1]))
+         {
+            id2 = this->immediateDominators[id2];
+         }
+      }
+
+      return id1;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Make room in the per-block arrays for a block made by a split.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   AddBlock
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int id = block->Id;
+      int oldCount = this->blocks->Length;
+
+      if (id >= oldCount)
+      {
+         int newCount = System::Math::Max(id + 1, 2 * oldCount);
+
+         array<Phx::Graphs::BasicBlock ^> ^ newBlocks =
+            gcnew array<Phx::Graphs::BasicBlock ^>(newCount);
+         array<int> ^ newDominators = gcnew array<int>(newCount);
+
+         System::Array::Copy(this->blocks, newBlocks, oldCount);
+         System::Array::Copy(this->immediateDominators, newDominators, oldCount);
+
+         for (int newId = oldCount; newId < newCount; newId++)
+         {
+            newDominators[newId] = -1;
+         }
+
+         this->blocks = newBlocks;
+         this->immediateDominators = newDominators;
+      }
+
+      this->blocks[id] = block;
+      this->immediateDominators[id] = -1;
+   }
+
+private:
+
+   Phx::Graphs::FlowGraph ^ flowGraph;
+
+   // Indexed by block Id. The immediate dominator is -1 for unreachable
+   // blocks; the start block is its own immediate dominator.
+
+   array<Phx::Graphs::BasicBlock ^> ^ blocks;
+
+   array<int> ^ immediateDominators;
+
+   // Edges waiting for Apply, and their Ids
+
+   Phx::BitVector::Sparse ^ recordedEdgeIds;
+
+   System::Collections::Generic::List<Phx::Graphs::FlowEdge ^> ^ pendingEdges;
+
+   // One entry per split made
+
+   System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^ splitPredecessors;
+
+   System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^ splitSuccessors;
+
+   System::Collections::Generic::List<Phx::Graphs::BasicBlock ^> ^ splitBlocks;
+};
+
+} // namespace Samples
+} // namespace Phx
@@ -0,0 +1,378 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Depth first numbering and edge classification of a flow graph
+//
+// Remarks:
+//
+//    Several samples walk the flow graph depth first to number its blocks.
+//    Written as a recursive function, such a walk uses one stack frame per
+//    block on the current path, which overflows the thread's stack on large
+//    generated functions; and keeping the numbers in extension objects on
+//    the blocks costs an allocation per block and a search of the block's
+//    extension list on every lookup.
+//
+//    GraphOrder does the walk once, with an explicit stack of
+//    (block, next successor edge) pairs, and records the results in arrays
+//    indexed by block Id:
+//
+//       Prenumber and Postnumber - the order in which the walk first
+//          reaches and finally leaves each block, counting from 1.
+//       ReversePostorderNumber - the position of each block in reverse post
+//          order, counting from 1.
+//
+//    Successors are visited in successor edge list order, so the numbers
+//    are the ones the recursive formulation gives. Blocks the walk does not
+//    reach from the start block have the number 0.
+//
+//    Every edge between reached blocks is classified as a tree edge (the
+//    edge the walk first reached its successor through), a back edge (to
+//    an ancestor on the spanning tree, or to the block itself), a forward
+//    edge (to a proper descendant reached some other way), or a cross edge
+//    (anything else).
+//
+//    The class is defined entirely in this header, like the macros in
+//    samples.h, so a plug-in only needs to include it.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The kinds of flow graph edges with respect to a depth first spanning
+//    tree
+//
+//-----------------------------------------------------------------------------
+
+public enum class EdgeKind
+{
+   Unreached,
+   Tree,
+   Back,
+   Forward,
+   Cross
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Depth first numbers of the blocks of a flow graph
+//
+//-----------------------------------------------------------------------------
+
+public ref class GraphOrder
+{
+public:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Walk the flow graph depth first from its start block and number its
+   //    blocks.
+   //
+   // Remarks:
+   //
+   //    The numbers describe the graph as it is now. Blocks and edges added
+   //    later are not known to the object; build a new one.
+   //
+   //--------------------------------------------------------------------------
+
+   static GraphOrder ^
+   New
+   (
+      Phx::Graphs::FlowGraph ^ flowGraph
+   )
+   {
+      GraphOrder ^ order = gcnew GraphOrder();
+      int          maxId = 0;
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         maxId = System::Math::Max(maxId, (int) block->Id);
+      }
+
+      int idCount = maxId + 1;
+
+      order->prenumbers = gcnew array<int>(idCount);
+      order->postnumbers = gcnew array<int>(idCount);
+      order->reversePostorderNumbers = gcnew array<int>(idCount);
+      order->treeEdges = gcnew array<Phx::Graphs::FlowEdge ^>(idCount);
+      order->preorder = gcnew array<Phx::Graphs::BasicBlock ^>(idCount);
+      order->reversePostorder = gcnew array<Phx::Graphs::BasicBlock ^>(idCount);
+
+      order->Walk(flowGraph->StartBlock);
+
+      return order;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of blocks reached from the start block
+   //
+   //--------------------------------------------------------------------------
+
+   property int BlockCount
+   {
+      int get() { return this->blockCount; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The per-block numbers; 0 for blocks not reached
+   //
+   //--------------------------------------------------------------------------
+
+   int
+   Prenumber
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      return this->prenumbers[block->Id];
+   }
+
+   int
+   Postnumber
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      return this->postnumbers[block->Id];
+   }
+
+   int
+   ReversePostorderNumber
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      return this->reversePostorderNumbers[block->Id];
+   }
+
+   bool
+   IsReached
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      return (this->prenumbers[block->Id] != 0);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The reached blocks by number, for 1 <= number <= BlockCount
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::Graphs::BasicBlock ^
+   BlockInPreorder
+   (
+      int number
+   )
+   {
+      return this->preorder[number - 1];
+   }
+
+   Phx::Graphs::BasicBlock ^
+   BlockInReversePostorder
+   (
+      int number
+   )
+   {
+      return this->reversePostorder[number - 1];
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Determine whether one block is an ancestor of another on the depth
+   //    first spanning tree. A block is its own ancestor.
+   //
+   //--------------------------------------------------------------------------
+
+   bool
+   IsAncestor
+   (
+      Phx::Graphs::BasicBlock ^ ancestor,
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int ancestorId = ancestor->Id;
+      int id = block->Id;
+
+      return (this->prenumbers[ancestorId] != 0)
+         && (this->prenumbers[id] != 0)
+         && (this->prenumbers[ancestorId] <= this->prenumbers[id])
+         && (this->postnumbers[id] <= this->postnumbers[ancestorId]);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Classify an edge with respect to the depth first spanning tree
+   //
+   // Returns:
+   //
+   //    The kind of the edge; Unreached if its predecessor was not reached.
+   //
+   //--------------------------------------------------------------------------
+
+   EdgeKind
+   Classify
+   (
+      Phx::Graphs::FlowEdge ^ edge
+   )
+   {
+      Phx::Graphs::BasicBlock ^ predecessor = edge->PredecessorNode;
+      Phx::Graphs::BasicBlock ^ successor = edge->SuccessorNode;
+
+      if (this->prenumbers[predecessor->Id] == 0)
+      {
+         return EdgeKind::Unreached;
+      }
+
+      if (this->treeEdges[successor->Id] == edge)
+      {
+         return EdgeKind::Tree;
+      }
+
+      if (this->IsAncestor(successor, predecessor))
+      {
+         return EdgeKind::Back;
+      }
+
+      if (this->prenumbers[predecessor->Id] < this->prenumbers[successor->Id])
+      {
+         return EdgeKind::Forward;
+      }
+
+      return EdgeKind::Cross;
+   }
+
+private:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The depth first walk itself
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   Walk
+   (
+      Phx::Graphs::BasicBlock ^ startBlock
+   )
+   {
+      int                                  idCount = this->prenumbers->Length;
+      array<Phx::Graphs::BasicBlock ^> ^   stackBlocks =
+         gcnew array<Phx::Graphs::BasicBlock ^>(idCount);
+      array<Phx::Graphs::FlowEdge ^> ^     stackEdges =
+         gcnew array<Phx::Graphs::FlowEdge ^>(idCount);
+      int                                  depth = 0;
+      int                                  prenumber = 0;
+      int                                  postnumber = 0;
+
+      this->preorder[prenumber] = startBlock;
+      this->prenumbers[startBlock->Id] = ++prenumber;
+
+      stackBlocks[depth] = startBlock;
+      stackEdges[depth] = startBlock->SuccessorEdgeList;
+      depth++;
+
+      while (depth > 0)
+      {
+         Phx::Graphs::FlowEdge ^ edge = stackEdges[depth - 1];
+
+         if (edge == nullptr)
+         {
+            // All successors are done, so the block is finished.
+
+            this->postnumbers[stackBlocks[depth - 1]->Id] = ++postnumber;
+            this->reversePostorder[idCount - postnumber] = stackBlocks[depth - 1];
+            depth--;
+
+            continue;
+         }
+
+         stackEdges[depth - 1] = edge->NextSuccessorEdge;
+
+         Phx::Graphs::BasicBlock ^ successor = edge->SuccessorNode;
+
+         if (this->prenumbers[successor->Id] != 0)
+         {
+            continue;
+         }
+
+         this->preorder[prenumber] = successor;
+         this->prenumbers[successor->Id] = ++prenumber;
+         this->treeEdges[successor->Id] = edge;
+
+         stackBlocks[depth] = successor;
+         stackEdges[depth] = successor->SuccessorEdgeList;
+         depth++;
+      }
+
+      // The reverse post order was filled from the end of the array; move
+      // it to the front.
+
+      this->blockCount = prenumber;
+
+      System::Array::Copy(this->reversePostorder, idCount - postnumber,
+         this->reversePostorder, 0, postnumber);
+
+      for (int number = 1; number <= postnumber; number++)
+      {
+         this->reversePostorderNumbers[this->reversePostorder[number - 1]->Id] = number;
+      }
+   }
+
+private:
+
+   int blockCount;
+
+   // Indexed by block Id
+
+   array<int> ^ prenumbers;
+
+   array<int> ^ postnumbers;
+
+   array<int> ^ reversePostorderNumbers;
+
+   // The edge each block was first reached through
+
+   array<Phx::Graphs::FlowEdge ^> ^ treeEdges;
+
+   // Indexed by number - 1
+
+   array<Phx::Graphs::BasicBlock ^> ^ preorder;
+
+   array<Phx::Graphs::BasicBlock ^> ^ reversePostorder;
+};
+
+} // namespace Samples
+} // namespace Phx
@@ -0,0 +1,911 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    Loop nesting forest of a flow graph
+//
+// Remarks:
+//
+//    The loop samples used to find loops by building dominators, calling a
+//    block a loop header when it dominates one of its predecessors, and
+//    collecting each loop's body into fresh bit vectors with a backward
+//    walk from its back edges. A nested loop was walked again for every
+//    loop around it, and a region with more than one entry, whose blocks no
+//    single block dominates, was not found at all.
+//
+//    LoopForest finds every loop in one pass with Havlak's algorithm. The
+//    blocks are visited in reverse depth first preorder, so inner loops are
+//    found before the loops around them. Once a loop is found its blocks
+//    are merged into its header with union-find, and the loops around it
+//    see the inner loop as a single block. No dominator information is
+//    needed, and each edge is looked at a near-constant number of times.
+//
+//    A loop is headed by the target of a depth first back edge. When the
+//    graph is reducible, the loops are exactly the natural loops of the
+//    dominator formulation. A loop that can also be entered other than
+//    through its header is marked irreducible; its header is the block the
+//    depth first walk entered it through.
+//
+//    Loops are numbered from 1 in preorder of the forest, so a loop and the
+//    loops nested in it have consecutive numbers; 0 means "no loop". The
+//    blocks are kept sorted by innermost loop, so the blocks of a loop,
+//    nested loops included, are a contiguous range, and membership is two
+//    comparisons.
+//
+//    Blocks the walk does not reach from the start block are in no loop.
+//
+//    The class is defined entirely in this header, like GraphOrder.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+#include "graph-order.h"
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    The loops of a flow graph and how they nest
+//
+//-----------------------------------------------------------------------------
+
+public ref class LoopForest
+{
+public:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Find the loops of the flow graph.
+   //
+   // Remarks:
+   //
+   //    The forest describes the graph as it is now. Blocks and edges added
+   //    later are not known to the object; build a new one.
+   //
+   //--------------------------------------------------------------------------
+
+   static LoopForest ^
+   New
+   (
+      Phx::Graphs::FlowGraph ^ flowGraph
+   )
+   {
+      LoopForest ^ forest = gcnew LoopForest();
+      int          maxId = 0;
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         maxId = System::Math::Max(maxId, (int) block->Id);
+      }
+
+      forest->blocks = gcnew array<Phx::Graphs::BasicBlock ^>(maxId + 1);
+
+      for each (Phx::Graphs::BasicBlock ^ block in flowGraph->BasicBlocks)
+      {
+         forest->blocks[block->Id] = block;
+      }
+
+      forest->order = GraphOrder::New(flowGraph);
+
+      forest->FindHeaders();
+      forest->NumberLoops();
+      forest->CollectBlocks();
+      forest->CollectExits();
+
+      return forest;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The depth first numbering the forest was built on
+   //
+   //--------------------------------------------------------------------------
+
+   property GraphOrder ^ Order
+   {
+      GraphOrder ^ get() { return this->order; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of loops, and the depth of the most deeply nested one
+   //
+   //--------------------------------------------------------------------------
+
+   property int LoopCount
+   {
+      int get() { return this->loopCount; }
+   }
+
+   property int MaxDepth
+   {
+      int get() { return this->maxDepth; }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The innermost loop containing a block, and the loop a block heads;
+   //    0 if none
+   //
+   //--------------------------------------------------------------------------
+
+   int
+   LoopOf
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      return this->innermostLoops[block->Id];
+   }
+
+   int
+   LoopHeadedBy
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int loop = this->innermostLoops[block->Id];
+
+      return ((loop != 0) && (this->headers[loop] == block)) ? loop : 0;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number of loops containing a block
+   //
+   //--------------------------------------------------------------------------
+
+   int
+   LoopDepth
+   (
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int loop = this->innermostLoops[block->Id];
+
+      return (loop == 0) ? 0 : this->depths[loop];
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Determine whether a block is in a loop, nested loops included.
+   //
+   //--------------------------------------------------------------------------
+
+   bool
+   Contains
+   (
+      int                       loop,
+      Phx::Graphs::BasicBlock ^ block
+   )
+   {
+      int innermostLoop = this->innermostLoops[block->Id];
+
+      return (innermostLoop != 0)
+         && (loop <= innermostLoop)
+         && (innermostLoop <= this->lastNestedLoops[loop]);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Determine whether an edge goes from inside a loop to its header.
+   //
+   //--------------------------------------------------------------------------
+
+   bool
+   IsBackEdge
+   (
+      Phx::Graphs::FlowEdge ^ edge
+   )
+   {
+      int loop = this->LoopHeadedBy(edge->SuccessorNode);
+
+      return (loop != 0) && this->Contains(loop, edge->PredecessorNode);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Per loop properties, for 1 <= loop <= LoopCount
+   //
+   // Remarks:
+   //
+   //    Depth is 1 for a loop no other loop contains. Parent is 0 for such a
+   //    loop. FirstChild and NextSibling list the loops directly nested in a
+   //    loop, ending with 0, in post order of their headers.
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::Graphs::BasicBlock ^
+   Header
+   (
+      int loop
+   )
+   {
+      return this->headers[loop];
+   }
+
+   int
+   Parent
+   (
+      int loop
+   )
+   {
+      return this->parents[loop];
+   }
+
+   int
+   FirstChild
+   (
+      int loop
+   )
+   {
+      return this->firstChildren[loop];
+   }
+
+   int
+   NextSibling
+   (
+      int loop
+   )
+   {
+      return this->nextSiblings[loop];
+   }
+
+   int
+   Depth
+   (
+      int loop
+   )
+   {
+      return this->depths[loop];
+   }
+
+   bool
+   IsIrreducible
+   (
+      int loop
+   )
+   {
+      return this->irreducibles[loop];
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The blocks of a loop as a new bit vector of block Ids, with or
+   //    without the blocks of the loops nested in it
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::BitVector::Sparse ^
+   GetBlocks
+   (
+      int             loop,
+      Phx::Lifetime ^ lifetime
+   )
+   {
+      return this->GetBlockRange(this->blockStarts[loop],
+         this->blockStarts[this->lastNestedLoops[loop] + 1], lifetime);
+   }
+
+   Phx::BitVector::Sparse ^
+   GetExclusiveBlocks
+   (
+      int             loop,
+      Phx::Lifetime ^ lifetime
+   )
+   {
+      return this->GetBlockRange(this->blockStarts[loop],
+         this->blockStarts[loop + 1], lifetime);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The edges that leave a loop, ordered by the Id of their predecessor
+   //    and then by successor edge list order
+   //
+   //--------------------------------------------------------------------------
+
+   array<Phx::Graphs::FlowEdge ^> ^
+   GetExitEdges
+   (
+      int loop
+   )
+   {
+      int start = this->exitStarts[loop];
+      int count = this->exitStarts[loop + 1] - start;
+
+      array<Phx::Graphs::FlowEdge ^> ^ exits =
+         gcnew array<Phx::Graphs::FlowEdge ^>(count);
+
+      System::Array::Copy(this->exitEdges, start, exits, 0, count);
+
+      return exits;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The blocks of a loop that have a successor outside it, as a new bit
+   //    vector of block Ids
+   //
+   //--------------------------------------------------------------------------
+
+   Phx::BitVector::Sparse ^
+   GetExitBlocks
+   (
+      int             loop,
+      Phx::Lifetime ^ lifetime
+   )
+   {
+      Phx::BitVector::Sparse ^ exitBlocks = Phx::BitVector::Sparse::New(lifetime);
+
+      for (int i = this->exitStarts[loop]; i < this->exitStarts[loop + 1]; i++)
+      {
+         exitBlocks->SetBit(this->exitEdges[i]->PredecessorNode->Id);
+      }
+
+      return exitBlocks;
+   }
+
+private:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Havlak's loop finding. Works on depth first preorder numbers.
+   //
+   // Remarks:
+   //
+   //    For each block w, last to first in preorder: the sources of the
+   //    back edges into w, with each replaced by the outermost loop found
+   //    so far that contains it, start a loop headed by w. The loop grows
+   //    backwards over predecessors, again replaced by their outermost
+   //    loops, as long as they are depth first descendants of w. A
+   //    predecessor that is not means the loop has a second entry; it is
+   //    recorded as an entry of w, to be seen by the loops around w.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   FindHeaders()
+   {
+      int count = this->order->BlockCount;
+
+      this->postnumbers = gcnew array<int>(count + 1);
+      this->representatives = gcnew array<int>(count + 1);
+      this->enclosingHeaders = gcnew array<int>(count + 1);
+      this->isHeader = gcnew array<bool>(count + 1);
+      this->isIrreducibleHeader = gcnew array<bool>(count + 1);
+      this->extraEntries =
+         gcnew array<System::Collections::Generic::List<int> ^>(count + 1);
+      this->poolStamps = gcnew array<int>(count + 1);
+      this->pool = gcnew array<int>(count);
+      this->worklist = gcnew array<int>(count);
+
+      // Predecessors by preorder number, leaving out blocks not reached.
+
+      array<int> ^ predecessorStarts = gcnew array<int>(count + 2);
+      int          predecessorCount = 0;
+
+      for (int number = 1; number <= count; number++)
+      {
+         Phx::Graphs::BasicBlock ^ block = this->order->BlockInPreorder(number);
+
+         this->postnumbers[number] = this->order->Postnumber(block);
+         this->representatives[number] = number;
+         predecessorStarts[number] = predecessorCount;
+
+         for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+            edge != nullptr; edge = edge->NextPredecessorEdge)
+         {
+            if (this->order->IsReached(edge->PredecessorNode))
+            {
+               predecessorCount++;
+            }
+         }
+      }
+
+      predecessorStarts[count + 1] = predecessorCount;
+
+      array<int> ^ predecessors = gcnew array<int>(predecessorCount);
+
+      for (int number = 1; number <= count; number++)
+      {
+         Phx::Graphs::BasicBlock ^ block = this->order->BlockInPreorder(number);
+         int                       next = predecessorStarts[number];
+
+         for (Phx::Graphs::FlowEdge ^ edge = block->PredecessorEdgeList;
+            edge != nullptr; edge = edge->NextPredecessorEdge)
+         {
+            int predecessor = this->order->Prenumber(edge->PredecessorNode);
+
+            if (predecessor != 0)
+            {
+               predecessors[next++] = predecessor;
+            }
+         }
+      }
+
+      for (int header = count; header >= 1; header--)
+      {
+         this->poolCount = 0;
+         this->worklistCount = 0;
+
+         for (int i = predecessorStarts[header]; i < predecessorStarts[header + 1]; i++)
+         {
+            if (this->IsAncestor(header, predecessors[i]))
+            {
+               this->isHeader[header] = true;
+               this->Reach(header, predecessors[i]);
+            }
+         }
+
+         while (this->worklistCount > 0)
+         {
+            int member = this->worklist[--this->worklistCount];
+
+            for (int i = predecessorStarts[member]; i < predecessorStarts[member + 1]; i++)
+            {
+               this->Reach(header, predecessors[i]);
+            }
+
+            if (this->extraEntries[member] != nullptr)
+            {
+               for each (int entry in this->extraEntries[member])
+               {
+                  this->Reach(header, entry);
+               }
+            }
+         }
+
+         for (int i = 0; i < this->poolCount; i++)
+         {
+            this->enclosingHeaders[this->pool[i]] = header;
+            this->representatives[this->pool[i]] = header;
+         }
+      }
+
+      // Only the results are kept.
+
+      this->representatives = nullptr;
+      this->extraEntries = nullptr;
+      this->poolStamps = nullptr;
+      this->pool = nullptr;
+      this->worklist = nullptr;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Add the outermost loop found so far around a predecessor to the
+   //    loop being found, or record it as another entry.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   Reach
+   (
+      int header,
+      int predecessor
+   )
+   {
+      int member = this->Find(predecessor);
+
+      if (!this->IsAncestor(header, member))
+      {
+         this->isIrreducibleHeader[header] = true;
+
+         if (this->extraEntries[header] == nullptr)
+         {
+            this->extraEntries[header] = gcnew System::Collections::Generic::List<int>();
+         }
+
+         this->extraEntries[header]->Add(member);
+
+         return;
+      }
+
+      if ((member == header) || (this->poolStamps[member] == header))
+      {
+         return;
+      }
+
+      this->poolStamps[member] = header;
+      this->pool[this->poolCount++] = member;
+      this->worklist[this->worklistCount++] = member;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Union-find lookup with path compression
+   //
+   //--------------------------------------------------------------------------
+
+   int
+   Find
+   (
+      int number
+   )
+   {
+      int root = number;
+
+      while (this->representatives[root] != root)
+      {
+         root = this->representatives[root];
+      }
+
+      while (this->representatives[number] != root)
+      {
+         int next = this->representatives[number];
+
+         this->representatives[number] = root;
+         number = next;
+      }
+
+      return root;
+   }
+
+   bool
+   IsAncestor
+   (
+      int ancestor,
+      int number
+   )
+   {
+      return (ancestor <= number)
+         && (this->postnumbers[number] <= this->postnumbers[ancestor]);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number the loops in preorder of the forest and record, for each
+   //    block, its innermost loop.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   NumberLoops()
+   {
+      int count = this->order->BlockCount;
+
+      // Link each header to the header around it, by preorder number, with
+      // 0 standing for the root of the forest. Visiting the headers in post
+      // order and pushing each on the front of its parent's list leaves the
+      // lists in reverse post order.
+
+      array<int> ^ childHeaders = gcnew array<int>(count + 1);
+      array<int> ^ siblingHeaders = gcnew array<int>(count + 1);
+
+      this->loopCount = 0;
+
+      for (int position = count; position >= 1; position--)
+      {
+         int header = this->order->Prenumber(this->order->BlockInReversePostorder(position));
+
+         if (!this->isHeader[header])
+         {
+            continue;
+         }
+
+         int parentHeader = this->enclosingHeaders[header];
+
+         siblingHeaders[header] = childHeaders[parentHeader];
+         childHeaders[parentHeader] = header;
+         this->loopCount++;
+      }
+
+      int loopIdCount = this->loopCount + 2;
+
+      this->headers = gcnew array<Phx::Graphs::BasicBlock ^>(loopIdCount);
+      this->parents = gcnew array<int>(loopIdCount);
+      this->firstChildren = gcnew array<int>(loopIdCount);
+      this->nextSiblings = gcnew array<int>(loopIdCount);
+      this->depths = gcnew array<int>(loopIdCount);
+      this->irreducibles = gcnew array<bool>(loopIdCount);
+      this->lastNestedLoops = gcnew array<int>(loopIdCount);
+
+      // Walk the forest depth first. Pushing the reverse post order lists
+      // onto the stack pops the children in post order of their headers.
+
+      array<int> ^ loopOfHeader = gcnew array<int>(count + 1);
+      array<int> ^ lastChild = gcnew array<int>(loopIdCount);
+      array<int> ^ stack = gcnew array<int>(count + 1);
+      int          depth = 0;
+      int          loop = 0;
+
+      for (int header = childHeaders[0]; header != 0; header = siblingHeaders[header])
+      {
+         stack[depth++] = header;
+      }
+
+      while (depth > 0)
+      {
+         int header = stack[--depth];
+         int parent = this->enclosingHeaders[header];
+         int parentLoop = (parent == 0) ? 0 : loopOfHeader[parent];
+
+         loop++;
+         loopOfHeader[header] = loop;
+
+         this->headers[loop] = this->order->BlockInPreorder(header);
+         this->parents[loop] = parentLoop;
+         this->depths[loop] = (parentLoop == 0) ? 1 : this->depths[parentLoop] + 1;
+         this->irreducibles[loop] = this->isIrreducibleHeader[header];
+         this->maxDepth = System::Math::Max(this->maxDepth, this->depths[loop]);
+
+         if (lastChild[parentLoop] == 0)
+         {
+            this->firstChildren[parentLoop] = loop;
+         }
+         else
+         {
+            this->nextSiblings[lastChild[parentLoop]] = loop;
+         }
+
+         lastChild[parentLoop] = loop;
+
+         for (int child = childHeaders[header]; child != 0; child = siblingHeaders[child])
+         {
+            stack[depth++] = child;
+         }
+      }
+
+      // A loop's nested loops follow it in preorder, so the last of them is
+      // found by folding each loop into its parent, last loop first.
+
+      for (loop = this->loopCount; loop >= 1; loop--)
+      {
+         this->lastNestedLoops[loop] = System::Math::Max(this->lastNestedLoops[loop], loop);
+         this->lastNestedLoops[this->parents[loop]] = System::Math::Max(
+            this->lastNestedLoops[this->parents[loop]], this->lastNestedLoops[loop]);
+      }
+
+      this->innermostLoops = gcnew array<int>(this->blocks->Length);
+
+      for (int number = 1; number <= count; number++)
+      {
+         int header = this->isHeader[number] ? number : this->enclosingHeaders[number];
+
+         if (header != 0)
+         {
+            this->innermostLoops[this->order->BlockInPreorder(number)->Id] =
+               loopOfHeader[header];
+         }
+      }
+
+      this->postnumbers = nullptr;
+      this->enclosingHeaders = nullptr;
+      this->isHeader = nullptr;
+      this->isIrreducibleHeader = nullptr;
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Sort the blocks in loops by innermost loop, and then by Id.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   CollectBlocks()
+   {
+      this->blockStarts = gcnew array<int>(this->loopCount + 2);
+
+      for each (Phx::Graphs::BasicBlock ^ block in this->blocks)
+      {
+         if ((block != nullptr) && (this->innermostLoops[block->Id] != 0))
+         {
+            this->blockStarts[this->innermostLoops[block->Id] + 1]++;
+         }
+      }
+
+      for (int loop = 1; loop <= this->loopCount; loop++)
+      {
+         this->blockStarts[loop + 1] += this->blockStarts[loop];
+      }
+
+      array<int> ^ next = safe_cast<array<int> ^>(this->blockStarts->Clone());
+
+      this->loopBlocks =
+         gcnew array<Phx::Graphs::BasicBlock ^>(this->blockStarts[this->loopCount + 1]);
+
+      for each (Phx::Graphs::BasicBlock ^ block in this->blocks)
+      {
+         if ((block != nullptr) && (this->innermostLoops[block->Id] != 0))
+         {
+            this->loopBlocks[next[this->innermostLoops[block->Id]]++] = block;
+         }
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Find the edges that leave each loop.
+   //
+   // Remarks:
+   //
+   //    An edge leaves the innermost loop of its predecessor and the loops
+   //    around that one, up to the first that contains its successor, so
+   //    the work is proportional to the number of exits found. The first
+   //    pass counts them, the second stores them.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   CollectExits()
+   {
+      this->exitStarts = gcnew array<int>(this->loopCount + 2);
+
+      for (int pass = 0; pass < 2; pass++)
+      {
+         array<int> ^ next = nullptr;
+
+         if (pass == 1)
+         {
+            for (int loop = 1; loop <= this->loopCount; loop++)
+            {
+               this->exitStarts[loop + 1] += this->exitStarts[loop];
+            }
+
+            next = safe_cast<array<int> ^>(this->exitStarts->Clone());
+
+            this->exitEdges =
+               gcnew array<Phx::Graphs::FlowEdge ^>(this->exitStarts[this->loopCount + 1]);
+         }
+
+         for each (Phx::Graphs::BasicBlock ^ block in this->blocks)
+         {
+            if ((block == nullptr) || (this->innermostLoops[block->Id] == 0))
+            {
+               continue;
+            }
+
+            for (Phx::Graphs::FlowEdge ^ edge = block->SuccessorEdgeList;
+               edge != nullptr; edge = edge->NextSuccessorEdge)
+            {
+               for (int loop = this->innermostLoops[block->Id];
+                  (loop != 0) && !this->Contains(loop, edge->SuccessorNode);
+                  loop = this->parents[loop])
+               {
+                  if (pass == 0)
+                  {
+                     this->exitStarts[loop + 1]++;
+                  }
+                  else
+                  {
+                     this->exitEdges[next[loop]++] = edge;
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   Phx::BitVector::Sparse ^
+   GetBlockRange
+   (
+      int             start,
+      int             end,
+      Phx::Lifetime ^ lifetime
+   )
+   {
+      Phx::BitVector::Sparse ^ blockSet = Phx::BitVector::Sparse::New(lifetime);
+
+      for (int i = start; i < end; i++)
+      {
+         blockSet->SetBit(this->loopBlocks[i]->Id);
+      }
+
+      return blockSet;
+   }
+
+private:
+
+   GraphOrder ^ order;
+
+   // Indexed by block Id
+
+   array<Phx::Graphs::BasicBlock ^> ^ blocks;
+
+   array<int> ^ innermostLoops;
+
+   // Indexed by loop number; entry 0 stands for the root of the forest
+
+   int loopCount;
+
+   int maxDepth;
+
+   array<Phx::Graphs::BasicBlock ^> ^ headers;
+
+   array<int> ^ parents;
+
+   array<int> ^ firstChildren;
+
+   array<int> ^ nextSiblings;
+
+   array<int> ^ depths;
+
+   array<bool> ^ irreducibles;
+
+   array<int> ^ lastNestedLoops;
+
+   // The blocks of loop n are loopBlocks[blockStarts[n]] up to
+   // loopBlocks[blockStarts[n + 1]], and its exits are laid out the same
+   // way.
+
+   array<Phx::Graphs::BasicBlock ^> ^ loopBlocks;
+
+   array<int> ^ blockStarts;
+
+   array<Phx::Graphs::FlowEdge ^> ^ exitEdges;
+
+   array<int> ^ exitStarts;
+
+   // Working state of FindHeaders and NumberLoops, indexed by preorder
+   // number
+
+   array<int> ^ postnumbers;
+
+   array<int> ^ representatives;
+
+   array<int> ^ enclosingHeaders;
+
+   array<bool> ^ isHeader;
+
+   array<bool> ^ isIrreducibleHeader;
+
+   array<System::Collections::Generic::List<int> ^> ^ extraEntries;
+
+   array<int> ^ poolStamps;
+
+   array<int> ^ pool;
+
+   array<int> ^ worklist;
+
+   int poolCount;
+
+   int worklistCount;
+};
+
+} // namespace Samples
+} // namespace Phx
@@ -0,0 +1,629 @@
+//-----------------------------------------------------------------------------
+//
+// Phoenix
+// Copyright (C) Microsoft Corporation.  All Rights Reserved.
+//
+// Description:
+//
+//    A base class for sample phases whose work is local to one function
+//
+// Remarks:
+//
+//    C2 already compiles independent function units on a pool of threads
+//    when it is given -threads:N, and decides which thread runs which
+//    function. ParallelFunctionPhase does not add a second pool on top of
+//    that one. It gives a phase whose work only reads and rewrites the
+//    function it is handed what it needs to run on all of c2's threads at
+//    once, and to produce the same output whatever the number of threads:
+//
+//       The function unit is the current unit of the thread's
+//          Phx::Threading::Context while the phase runs, so Phoenix
+//          allocations and lookups that go through the context find it.
+//       The phase gets a temporary lifetime of its own for each function,
+//          which is deleted when the function is done, so nothing it
+//          allocates on the side outlives the function or is shared with
+//          another thread.
+//       The phase writes its reports into a buffer rather than to
+//          Phx::Output. The buffers are committed in the order c2 created
+//          the function units, which is the order of the source, through
+//          a reorder buffer: a report that is ready before those of the
+//          functions ahead of it waits for them.
+//
+//    The IR of a function is only ever changed by the thread that owns
+//    it, so its changes are the same whatever order the functions finish
+//    in; only the reports and any totals kept across functions need
+//    ordering, and the totals need a lock.
+//
+//    Each function unit is numbered by a NewUnitEvent handler when it is
+//    created. A report is written as soon as the reports of all the
+//    functions numbered before it are written, or known not to come: the
+//    release phase that BuildPhases adds after Encoding marks a function
+//    the phase did not report on as done. Whatever is still waiting when
+//    Phoenix terminates, such as the reports after a function that never
+//    reached Encoding, is written then, still in order.
+//
+//    The base class also times every function. If the plug-in's
+//    "...ParallelTiming" control is set, each phase prints at termination
+//    the time spent in its functions and the wall clock time from the
+//    first function's start to the last function's end. Their ratio is
+//    the phase's concurrency, not its speedup: the speedup is the elapsed
+//    time of a -threads:1 compilation over that of a -threads:N one, which
+//    is what parallel-speedup.cmd measures, printing the phase's timing
+//    from both runs alongside.
+//
+//    The class is defined entirely in this header, like the macros in
+//    samples.h, so a plug-in only needs to include it.
+//
+// Usage:
+//
+//    Derive the phase from ParallelFunctionPhase and implement
+//    ExecuteFunction instead of Execute. Call
+//    ParallelFunctionPhase::RegisterObjects from PlugIn::RegisterObjects
+//    and ParallelFunctionPhase::BuildPhases from PlugIn::BuildPhases.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace Phx
+{
+
+namespace Samples
+{
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    A phase that runs function by function and commits each function's
+//    report in source order
+//
+//-----------------------------------------------------------------------------
+
+public ref class ParallelFunctionPhase abstract : Phx::Phases::Phase
+{
+public:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Create the timing control and the event dependency objects, and
+   //    hook the static events once Phoenix is initialized.
+   //
+   // Arguments:
+   //
+   //    prefix - [in] Prefix for the control name, such as "localOpt",
+   //          so that plug-ins loaded together do not clash.
+   //    fileName - [in] The plug-in's source file, for the control.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   RegisterObjects
+   (
+      System::String ^ prefix,
+      System::String ^ fileName
+   )
+   {
+      System::String ^ dependencyName = prefix + L"ParallelFunctionPhase";
+
+      ParallelFunctionPhase::TimingControl =
+         Phx::Controls::SetBooleanControl::New(prefix + L"ParallelTiming",
+            L"Print the time spent in each parallel phase and its concurrency at termination",
+            fileName);
+
+      ParallelFunctionPhase::newUnitDependencyObject =
+         Phx::DependencyObject::New(&Phx::Unit::NewUnitEventDependencyList,
+            dependencyName, "*");
+
+      ParallelFunctionPhase::termDependencyObject =
+         Phx::DependencyObject::New(&Phx::Term::TermEventDependencyList,
+            dependencyName, "*");
+
+      Phx::Initialize::EndInitializationEvent.Insert(
+         gcnew Phx::Initialize::EndInitializationEventDelegate(
+            &ParallelFunctionPhase::EndInitialization));
+   }
+
+   static Phx::Controls::SetBooleanControl ^ TimingControl;
+
+   static void
+   BuildPhases
+   (
+      Phx::Phases::PhaseConfiguration ^ config
+   );
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Mark a function as done for every phase, writing the reports that
+   //    were only waiting for it, and forget its number.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   Release
+   (
+      Phx::FunctionUnit ^ functionUnit
+   )
+   {
+      System::Threading::Monitor::Enter(commitLock);
+
+      try
+      {
+         int sequence;
+
+         if (!ParallelFunctionPhase::sequences->TryGetValue(functionUnit, sequence))
+         {
+            return;
+         }
+
+         ParallelFunctionPhase::sequences->Remove(functionUnit);
+
+         for each (ParallelFunctionPhase ^ phase in ParallelFunctionPhase::phases)
+         {
+            if ((sequence >= phase->nextSequence)
+               && !phase->pendingReports->ContainsKey(sequence))
+            {
+               phase->pendingReports->Add(sequence, nullptr);
+               phase->WriteReadyReports();
+            }
+         }
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(commitLock);
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Format the running totals of the phase
+   //
+   // Remarks:
+   //
+   //    Must be called with the commit lock held, or after all functions
+   //    are done.
+   //
+   //--------------------------------------------------------------------------
+
+   System::String ^
+   ReportTiming ()
+   {
+      double busyMs = (double) this->busyTicks * 1000.0
+         / System::Diagnostics::Stopwatch::Frequency;
+      double wallMs = (double) (this->lastStopTicks - this->firstStartTicks) * 1000.0
+         / System::Diagnostics::Stopwatch::Frequency;
+
+      return System::String::Format(
+         "{0}: {1} functions, {2:F2} ms in functions, {3:F2} ms elapsed,"
+         + " {4:F2} concurrency", gcnew array<System::Object ^> {
+            this->NameString, this->functionCount, busyMs, wallMs,
+            (wallMs > 0.0) ? (busyMs / wallMs) : 0.0
+         });
+   }
+
+protected:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Enter the phase in the list the release phase and termination
+   //    walk. Phases are built on the main thread, before any function is
+   //    compiled.
+   //
+   //--------------------------------------------------------------------------
+
+   ParallelFunctionPhase ()
+   {
+      this->pendingReports = gcnew
+         System::Collections::Generic::SortedDictionary<int, System::String ^>();
+
+      System::Threading::Monitor::Enter(commitLock);
+
+      try
+      {
+         ParallelFunctionPhase::phases->Add(this);
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(commitLock);
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Run the phase on a function unit, time it, and commit its report
+   //
+   // Arguments:
+   //
+   //    unit - The unit the phase should run for. Other units than function
+   //       units are ignored.
+   //
+   //--------------------------------------------------------------------------
+
+   virtual void
+   Execute
+   (
+      Phx::Unit ^ unit
+   ) override sealed
+   {
+      if (!unit->IsFunctionUnit)
+      {
+         return;
+      }
+
+      Phx::FunctionUnit ^           functionUnit = unit->AsFunctionUnit;
+      System::Text::StringBuilder ^ output = gcnew System::Text::StringBuilder();
+      Phx::Threading::Context ^     context = Phx::Threading::Context::GetCurrent();
+      bool                          isUnitPushed = (context->Unit != functionUnit);
+
+      if (isUnitPushed)
+      {
+         context->PushUnit(functionUnit);
+      }
+
+      Phx::Lifetime ^ lifetime = Phx::Lifetime::New(Phx::LifetimeKind::Temporary,
+         functionUnit, L"parallel-phase.h", __LINE__);
+
+      long long startTicks = System::Diagnostics::Stopwatch::GetTimestamp();
+      long long stopTicks;
+
+      try
+      {
+         this->ExecuteFunction(functionUnit, output, lifetime);
+      }
+      finally
+      {
+         stopTicks = System::Diagnostics::Stopwatch::GetTimestamp();
+
+         lifetime->Delete();
+
+         if (isUnitPushed)
+         {
+            context->PopUnit();
+         }
+      }
+
+      this->Commit(functionUnit, output, startTicks, stopTicks);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    The per-function work of the derived phase
+   //
+   // Arguments:
+   //
+   //    functionUnit - The function unit to process. Only this unit's IR
+   //       may be changed.
+   //    output - The buffer for the function's report. Use AppendLine
+   //       rather than Phx::Output::WriteLine.
+   //    lifetime - A temporary lifetime for allocations that do not need
+   //       to outlive this call. It is deleted on return.
+   //
+   //--------------------------------------------------------------------------
+
+   virtual void
+   ExecuteFunction
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      Phx::Lifetime ^               lifetime
+   ) abstract;
+
+private:
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Add a function's time to the totals and queue its report, then
+   //    write every report whose turn has come
+   //
+   // Remarks:
+   //
+   //    The lock is shared by all phases built from this header in the
+   //    plug-in, so reports of different phases do not interleave either.
+   //    A function created before the NewUnitEvent handler was hooked has
+   //    no number, and its report is written at once.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   Commit
+   (
+      Phx::FunctionUnit ^           functionUnit,
+      System::Text::StringBuilder ^ output,
+      long long                     startTicks,
+      long long                     stopTicks
+   )
+   {
+      System::Threading::Monitor::Enter(commitLock);
+
+      try
+      {
+         if ((this->functionCount == 0) || (startTicks < this->firstStartTicks))
+         {
+            this->firstStartTicks = startTicks;
+         }
+
+         if (stopTicks > this->lastStopTicks)
+         {
+            this->lastStopTicks = stopTicks;
+         }
+
+         this->busyTicks += stopTicks - startTicks;
+         this->functionCount++;
+
+         System::String ^ report = (output->Length > 0) ? output->ToString() : nullptr;
+         int              sequence;
+
+         if (!ParallelFunctionPhase::sequences->TryGetValue(functionUnit, sequence))
+         {
+            if (report != nullptr)
+            {
+               Phx::Output::Write(report);
+            }
+         }
+         else if ((sequence >= this->nextSequence)
+            && !this->pendingReports->ContainsKey(sequence))
+         {
+            this->pendingReports->Add(sequence, report);
+            this->WriteReadyReports();
+         }
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(commitLock);
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Write the queued reports from the next expected one on, as long as
+   //    they follow one another without a gap. Called under the lock.
+   //
+   //--------------------------------------------------------------------------
+
+   void
+   WriteReadyReports ()
+   {
+      System::String ^ report;
+
+      while (this->pendingReports->TryGetValue(this->nextSequence, report))
+      {
+         this->pendingReports->Remove(this->nextSequence);
+         this->nextSequence++;
+
+         if (report != nullptr)
+         {
+            Phx::Output::Write(report);
+         }
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Hook the unit creation and termination events.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   EndInitialization ()
+   {
+      Phx::Unit::NewUnitEvent.Insert(
+         gcnew Phx::Unit::NewUnitEventDelegate(&ParallelFunctionPhase::NewUnitEventHandler),
+         ParallelFunctionPhase::newUnitDependencyObject);
+
+      Phx::Term::TermEvent.Insert(
+         gcnew Phx::Term::TermEventDelegate(&ParallelFunctionPhase::TermEventHandler),
+         ParallelFunctionPhase::termDependencyObject);
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Number each function unit in the order it is created.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   NewUnitEventHandler
+   (
+      Phx::Unit ^ unit
+   )
+   {
+      if (!unit->IsFunctionUnit)
+      {
+         return;
+      }
+
+      System::Threading::Monitor::Enter(commitLock);
+
+      try
+      {
+         ParallelFunctionPhase::sequences[unit->AsFunctionUnit] =
+            ParallelFunctionPhase::sequenceCount++;
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(commitLock);
+      }
+   }
+
+   //--------------------------------------------------------------------------
+   //
+   // Description:
+   //
+   //    Write the reports still waiting, in order, and the timing of each
+   //    phase if it was asked for.
+   //
+   //--------------------------------------------------------------------------
+
+   static void
+   TermEventHandler
+   (
+      Phx::Term::Mode mode
+   )
+   {
+      System::Threading::Monitor::Enter(commitLock);
+
+      try
+      {
+         bool isTimingReported = (ParallelFunctionPhase::TimingControl != nullptr)
+            && ParallelFunctionPhase::TimingControl->IsEnabled(nullptr);
+
+         for each (ParallelFunctionPhase ^ phase in ParallelFunctionPhase::phases)
+         {
+            for each (System::String ^ report in phase->pendingReports->Values)
+            {
+               if (report != nullptr)
+               {
+                  Phx::Output::Write(report);
+               }
+            }
+
+            phase->pendingReports->Clear();
+
+            if (isTimingReported && (phase->functionCount > 0))
+            {
+               Phx::Output::WriteLine(phase->ReportTiming());
+            }
+         }
+
+         ParallelFunctionPhase::sequences->Clear();
+      }
+      finally
+      {
+         System::Threading::Monitor::Exit(commitLock);
+      }
+   }
+
+private:
+
+   static System::Object ^ commitLock = gcnew System::Object();
+
+   static Phx::DependencyObject ^ newUnitDependencyObject;
+
+   static Phx::DependencyObject ^ termDependencyObject;
+
+   // The phases built from this header, the number of each function unit
+   // not yet released, and the next number to hand out; all updated under
+   // commitLock
+
+   static System::Collections::Generic::List<ParallelFunctionPhase ^> ^ phases =
+      gcnew System::Collections::Generic::List<ParallelFunctionPhase ^>();
+
+   static System::Collections::Generic::Dictionary<Phx::FunctionUnit ^, int> ^ sequences =
+      gcnew System::Collections::Generic::Dictionary<Phx::FunctionUnit ^, int>();
+
+   static int sequenceCount;
+
+   // The reorder buffer: reports by function number, null for a function
+   // with nothing to report, and the number of the next one to write
+
+   System::Collections::Generic::SortedDictionary<int, System::String ^> ^ pendingReports;
+
+   int nextSequence;
+
+   // Running totals, updated under commitLock
+
+   int functionCount;
+
+   long long busyTicks;
+
+   long long firstStartTicks;
+
+   long long lastStopTicks;
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Phase that marks each function as done for the parallel phases once
+//    the function is compiled
+//
+//-----------------------------------------------------------------------------
+
+public ref class ParallelFunctionReleasePhase : Phx::Phases::Phase
+{
+public:
+
+   static ParallelFunctionReleasePhase ^
+   New
+   (
+      Phx::Phases::PhaseConfiguration ^ config
+   )
+   {
+      ParallelFunctionReleasePhase ^ phase = gcnew ParallelFunctionReleasePhase();
+
+      phase->Initialize(config, L"Parallel Function Release");
+
+      return phase;
+   }
+
+protected:
+
+   virtual void
+   Execute
+   (
+      Phx::Unit ^ unit
+   ) override
+   {
+      if (unit->IsFunctionUnit)
+      {
+         ParallelFunctionPhase::Release(unit->AsFunctionUnit);
+      }
+   }
+};
+
+//-----------------------------------------------------------------------------
+//
+// Description:
+//
+//    Add the release phase after the Encoding phase, or at the end of the
+//    phase list if there is no Encoding phase.
+//
+// Arguments:
+//
+//    config - [in] The configuration whose phase list the plug-in is
+//          adding its phases to.
+//
+//-----------------------------------------------------------------------------
+
+inline void
+ParallelFunctionPhase::BuildPhases
+(
+   Phx::Phases::PhaseConfiguration ^ config
+)
+{
+   ParallelFunctionReleasePhase ^ releasePhase = ParallelFunctionReleasePhase::New(config);
+   Phx::Phases::Phase ^           encodingPhase = config->PhaseList->FindByName(L"Encoding");
+
+   if (encodingPhase != nullptr)
+   {
+      encodingPhase->InsertAfter(releasePhase);
+   }
+   else
+   {
+      config->PhaseList->AppendPhase(releasePhase);
+   }
+}
+
+} // namespace Samples
+} // namespace Phx
@@ -0,0 +1,61 @@
+@ECHO OFF
+:: Syntax: parallel-speedup <path of plug-in> <control prefix> <source file> [threads]
+::
+:: Compiles a source file with a plug-in built on ParallelFunctionPhase
+:: (common\parallel-phase.h) twice: once with -threads:1, the baseline, and
+:: once with -threads:N, N being the number of processors unless given.
+:: Prints the elapsed time of each compilation, the speedup (baseline time
+:: over threaded time), and the timing line the plug-in's phase printed in
+:: each run through its <prefix>ParallelTiming control. Use a large
+:: translation unit with many functions. Run from an SDK command prompt.
+::
+:: Example: parallel-speedup LocalOpt.dll localOpt big.cpp 4
+
+IF "%3"=="" GOTO error
+
+SETLOCAL ENABLEDELAYEDEXPANSION
+
+SET threads=%4
+IF "%threads%"=="" SET threads=%NUMBER_OF_PROCESSORS%
+
+SET outDir=%TEMP%\parallel-speedup
+IF NOT EXIST %outDir% MKDIR %outDir%
+
+CALL :compile %1 %2 %3 1
+SET baseTime=%elapsed%
+CALL :compile %1 %2 %3 %threads%
+SET threadedTime=%elapsed%
+
+IF %threadedTime% LEQ 0 GOTO exit
+
+SET /A speedup=baseTime * 100 / threadedTime
+SET /A whole=speedup / 100, fraction=speedup %% 100
+SET fraction=0%fraction%
+ECHO Speedup with %threads% threads: %whole%.%fraction:~-2%x
+ENDLOCAL
+GOTO exit
+
+:: Compile the source once with the given number of threads and set
+:: elapsed to the time it took, in hundredths of a second.
+
+:compile
+CALL :now startTime
+FOR /F "delims=" %%a IN ('cl /nologo /c /O2 /EHsc /Fo"%outDir%\\" -d2plugin:%1 -d2%2ParallelTiming -d2threads:%4 "%3" ^| findstr /C:"ms elapsed"') DO ECHO -threads:%4  %%a
+CALL :now stopTime
+SET /A elapsed=stopTime - startTime
+IF %elapsed% LSS 0 SET /A elapsed+=8640000
+ECHO -threads:%4  compilation took %elapsed%0 ms
+GOTO :EOF
+
+:: Set the variable named by %1 to the time of day in hundredths of a second.
+
+:now
+FOR /F "tokens=1-4 delims=:.," %%a IN ("%TIME: =0%") DO (
+   SET /A %1=^(1%%a - 100^) * 360000 + ^(1%%b - 100^) * 6000 + ^(1%%c - 100^) * 100 + ^(1%%d - 100^)
+)
+GOTO :EOF
+
+:error
+ECHO "Format: parallel-speedup.cmd <path of plug-in> <control prefix> <source file> [threads]"
+
+:exit